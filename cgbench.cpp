@@ -0,0 +1,496 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <bitset>
+
+#include <csg.h>
+
+using namespace std;
+using namespace csg;
+
+
+// compile this with command:
+// 			clang++ -std=c++14 -O3 -pthread -I./ cgbench.cpp -o cgbench
+//
+// run with an optional upper limit on the problem size:
+// 			./cgbench 10000000
+
+typedef std::chrono::steady_clock 		bench_clock;
+
+double seconds_since(const bench_clock::time_point & t0){
+	return std::chrono::duration<double>(bench_clock::now() - t0).count();
+}
+
+int main(int argc, char * argv[])
+{
+	std::size_t nmax = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	std::mt19937 rng(0);
+	std::uniform_real_distribution<double> unif(0.0, 1.0);
+
+
+	// 3D Delaunay tetrahedralization
+	cout << "\n******* Delaunay3D *******" << endl;
+	for (std::size_t n=10000; n<=nmax; n*=10){
+		vector<Point<3>> pts(n);
+		for (auto i=0; i<n; i++) pts[i] = Point<3>(unif(rng), unif(rng), unif(rng));
+		auto t0 = bench_clock::now();
+		Delaunay3D del(pts);
+		double t = seconds_since(t0);
+		cout << "random   n=" << n << ": " << del.get_tetrahedralization().tetrahedra.size() << " tets in " << t << " s (" << n/t << " pts/s)" << endl;
+
+		// gridded points, as sampled from an Octree
+		std::size_t m = std::cbrt(double(n));
+		vector<Point<3>> grid;
+		grid.reserve(m*m*m);
+		for (auto i=0; i<m; i++) for (auto j=0; j<m; j++) for (auto k=0; k<m; k++) grid.push_back(Point<3>(i, j, k));
+		t0 = bench_clock::now();
+		Delaunay3D gdel(grid);
+		t = seconds_since(t0);
+		cout << "gridded  n=" << grid.size() << ": " << gdel.get_tetrahedralization().tetrahedra.size() << " tets in " << t << " s (" << grid.size()/t << " pts/s)" << endl;
+	}
+
+	// point classification against deep CSG trees built with push_back,
+	// recursively, compiled to a CSGProgram and rebalanced.
+	// Each primitive is a small circle in a 10x10 domain, so most of the
+	// tree is skipped by its bounding boxes
+	cout << "\n******* CSGTree contains_point *******" << endl;
+	std::size_t nq = std::min<std::size_t>(nmax, 1000000);
+	vector<Point<2>> queries(nq);
+	for (auto i=0; i<nq; i++) queries[i] = Point<2>(10*unif(rng), 10*unif(rng));
+	for (auto nprim : {25, 50, 100, 200, 400, 1000}){
+		for (auto op : {UNION, DIFFERENCE}){
+			CSGTree<Primitive2D> tree(Rectangle(Point<2>(5, 5), Point<2>(10, 10)));
+			if (op == UNION) tree = CSGTree<Primitive2D>(Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.3));
+			for (auto i=1; i<nprim; i++) tree.push_back(Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.3), op);
+			auto t0 = bench_clock::now();
+			std::size_t nin = 0;
+			for (auto i=0; i<nq; i++) nin += tree.contains_point(queries[i]);
+			double t = seconds_since(t0);
+
+			// the same tree compiled to a flat program
+			CSGProgram<2> prog(tree);
+			t0 = bench_clock::now();
+			std::size_t nprog = 0;
+			for (auto i=0; i<nq; i++) nprog += prog.contains_point(queries[i]);
+			double tp = seconds_since(t0);
+
+			// the same tree rebalanced
+			CSGTree<Primitive2D> btree = tree;
+			t0 = bench_clock::now();
+			btree.rebalance();
+			double trb = seconds_since(t0);
+			t0 = bench_clock::now();
+			std::size_t nbal = 0;
+			for (auto i=0; i<nq; i++) nbal += btree.contains_point(queries[i]);
+			double tb = seconds_since(t0);
+			cout << (op == UNION ? "union     " : "difference") << " nprim=" << nprim << ": " << nin << " inside, " << 1.0e9*t/nq << " ns/query, compiled: " << nprog << " inside, " << 1.0e9*tp/nq << " ns/query, rebalanced in " << trb << " s: " << nbal << " inside, " << 1.0e9*tb/nq << " ns/query" << endl;
+		}
+	}
+
+	// the same rebalanced unions with the circles held by value in
+	// PrimitiveVariant leaves, which are tested without virtual calls
+	for (auto nprim : {25, 100, 400, 1000}){
+		CSGTree<Primitive2D> tree;
+		CSGTree<PrimitiveVariant2D> vartree;
+		for (auto i=0; i<nprim; i++){
+			Circle c(Point<2>(10*unif(rng), 10*unif(rng)), 0.3);
+			tree.push_back(c, UNION);
+			vartree.push_back(c, UNION);
+		}
+		tree.rebalance();
+		vartree.rebalance();
+		auto t0 = bench_clock::now();
+		std::size_t nin = 0;
+		for (auto i=0; i<nq; i++) nin += tree.contains_point(queries[i]);
+		double t = seconds_since(t0);
+		t0 = bench_clock::now();
+		std::size_t nvin = 0;
+		for (auto i=0; i<nq; i++) nvin += vartree.contains_point(queries[i]);
+		double tv = seconds_since(t0);
+		cout << "variant    nprim=" << nprim << ": " << nvin << " inside, " << 1.0e9*tv/nq << " ns/query, virtual: " << nin << " inside, " << 1.0e9*t/nq << " ns/query" << endl;
+	}
+
+	// a brute-force scan over a list of mixed primitives, held by value in
+	// a contiguous vector of variants or behind pointers to the base
+	{
+		std::vector<PrimitiveVariant2D> vlist;
+		std::vector<std::shared_ptr<Primitive2D>> plist;
+		for (auto i=0; i<300; i++){
+			Point<2> c(10*unif(rng), 10*unif(rng));
+			if (i % 3 == 0) vlist.push_back(Circle(c, 0.3));
+			else if (i % 3 == 1) vlist.push_back(Rectangle(c, Point<2>(0.4, 0.2)));
+			else vlist.push_back(Triangle(c, c + Point<2>(0.3, 0), c + Point<2>(0, 0.3)));
+			plist.push_back(vlist.back().to_primitive());
+		}
+		std::size_t nscan = std::min<std::size_t>(nq, 100000), nvin = 0, npin = 0;
+		auto t0 = bench_clock::now();
+		for (auto i=0; i<nscan; i++) for (auto & v : vlist) nvin += v.contains_point(queries[i]);
+		double tv = seconds_since(t0);
+		t0 = bench_clock::now();
+		for (auto i=0; i<nscan; i++) for (auto & p : plist) npin += p->contains_point(queries[i]);
+		double tp = seconds_since(t0);
+		cout << "variant list of 300: " << nvin << " hits, " << 1.0e9*tv/(300*nscan) << " ns/test, virtual: " << npin << " hits, " << 1.0e9*tp/(300*nscan) << " ns/test" << endl;
+	}
+
+	// scene queries against a growing number of small circles, walking
+	// the objects in identifier order as the scene used to and through
+	// its bounding volume hierarchy. Batches are rasters of the domain
+	cout << "\n******* Scene query_point *******" << endl;
+	std::size_t sm = std::sqrt(double(nq));
+	vector<double> sx, sy;
+	for (auto i=0; i<sm; i++) for (auto j=0; j<sm; j++) {sx.push_back(10.0*j/sm); sy.push_back(10.0*i/sm);}
+	PointBatch<2> sbatch{{sx.data(), sy.data()}, sx.size()};
+	for (std::size_t nobj=10; nobj<=10000; nobj*=10){
+		Scene<int, Primitive2D> scene(-1);
+		for (auto i=0; i<nobj; i++) scene.insert(i, Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.2));
+		const std::map<int, std::shared_ptr<Primitive2D>> & smap = scene;
+		std::size_t nlin = std::min<std::size_t>(nq, 10000000/nobj);
+		auto t0 = bench_clock::now();
+		long long sum = 0;
+		for (auto i=0; i<nlin; i++){
+			int id = -1;
+			for (auto it=smap.begin(); it!=smap.end(); it++){
+				if (it->second->contains_point(queries[i])) {id = it->first; break;}
+			}
+			sum += id;
+		}
+		double t = seconds_since(t0);
+
+		scene.query_point(queries[0]);
+		t0 = bench_clock::now();
+		long long isum = 0;
+		for (auto i=0; i<nlin; i++) isum += scene.query_point(queries[i]);
+		double ti = seconds_since(t0);
+
+		vector<int> ids(sbatch.size);
+		t0 = bench_clock::now();
+		scene.query_points(sbatch, ids.data());
+		double tb = seconds_since(t0);
+		cout << "objects=" << nobj << ": linear " << 1.0e9*t/nlin << " ns/query, indexed " << 1.0e9*ti/nlin << " ns/query" << (sum == isum ? "" : " (MISMATCH)") << ", batched raster " << 1.0e9*tb/sbatch.size << " ns/point" << endl;
+	}
+
+	// material maps of a scene through a 2D frame, one query per pixel, as
+	// one batch of points and rasterized by scan lines in parallel tiles
+	cout << "\n******* Frame2 rasterize *******" << endl;
+	Scene<int, Primitive2D> rscene(-1);
+	for (auto i=0; i<1000; i++) rscene.insert(i, Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.2));
+	auto rframe = make_frame_2d(rscene, Point<2>(0, 0), Point<2>(10, 10), Point<2>(1, 0));
+	for (std::size_t m=256; m*m<=std::max<std::size_t>(nmax, 65536)*16; m*=4){
+		auto t0 = bench_clock::now();
+		long long sum = 0;
+		for (auto j=0; j<m; j++) for (auto i=0; i<m; i++) sum += rframe.query_point(Point<2>((i+0.5)*10.0/m, (j+0.5)*10.0/m));
+		double t = seconds_since(t0);
+
+		vector<double> rx, ry;
+		for (auto j=0; j<m; j++) for (auto i=0; i<m; i++) {rx.push_back((i+0.5)*10.0/m); ry.push_back((j+0.5)*10.0/m);}
+		PointBatch<2> rbatch{{rx.data(), ry.data()}, rx.size()};
+		vector<int> rids(rbatch.size);
+		t0 = bench_clock::now();
+		rscene.query_points(rbatch, rids.data());
+		double tb = seconds_since(t0);
+
+		t0 = bench_clock::now();
+		auto raster = rframe.rasterize(m, m, 1);
+		double t1 = seconds_since(t0);
+
+		t0 = bench_clock::now();
+		raster = rframe.rasterize(m, m);
+		double tr = seconds_since(t0);
+		long long rsum = 0;
+		for (auto id : raster) rsum += id;
+		cout << "raster " << m << "^2: query_point " << 1.0e9*t/(m*m) << " ns/pixel, batched " << 1.0e9*tb/(m*m) << " ns/pixel, rasterize 1 thread " << 1.0e9*t1/(m*m) << " ns/pixel, " << std::thread::hardware_concurrency() << " threads " << 1.0e9*tr/(m*m) << " ns/pixel" << (sum == rsum ? "" : " (MISMATCH)") << endl;
+	}
+
+	// voxelization of a 3D CSG tree, one point at a time and batched in
+	// structure-of-arrays layout
+	cout << "\n******* CSGTree contains_points *******" << endl;
+	CSGTree<Primitive3D> vtree(Sphere(Point<3>(0, 0, 0), 1.5));
+	vtree.push_back(Cylinder(Point<3>(0, 0, -2), Point<3>(0, 0, 1), Point<3>(1, 0, 0), 0.5, 4.0), DIFFERENCE);
+	vtree.push_back(RectangularPrism(Point<3>(0, 0, -0.2), Point<3>(0, 0, 1), Point<3>(1, 0, 0), Point<2>(3, 0.4), 0.4), UNION);
+	for (std::size_t m=32; m*m*m<=std::max<std::size_t>(nmax, 32768); m*=2){
+		vector<double> vx, vy, vz;
+		vx.reserve(m*m*m); vy.reserve(m*m*m); vz.reserve(m*m*m);
+		for (auto i=0; i<m; i++) for (auto j=0; j<m; j++) for (auto k=0; k<m; k++){
+			vx.push_back(-2+4.0*i/m); vy.push_back(-2+4.0*j/m); vz.push_back(-2+4.0*k/m);
+		}
+		PointBatch<3> batch{{vx.data(), vy.data(), vz.data()}, vx.size()};
+		auto t0 = bench_clock::now();
+		std::size_t nin = 0;
+		for (auto i=0; i<batch.size; i++) nin += vtree.contains_point(batch.point(i));
+		double t = seconds_since(t0);
+
+		vector<Ullong> mask(batch.nwords());
+		t0 = bench_clock::now();
+		vtree.contains_points(batch, mask.data());
+		double tb = seconds_since(t0);
+		std::size_t nbatch = 0;
+		for (auto w : mask) nbatch += std::bitset<64>(w).count();
+		cout << "grid " << m << "^3: " << nin << " inside, " << 1.0e9*t/batch.size << " ns/point, batched: " << nbatch << " inside, " << 1.0e9*tb/batch.size << " ns/point" << endl;
+	}
+
+	// each 3D primitive on its own, in a tilted frame, over the same kind
+	// of grid
+	{
+		std::vector<std::pair<std::string, std::shared_ptr<Primitive3D>>> prims3 = {
+			{"Cylinder", Cylinder(Point<3>(0, 0, -1), Point<3>(0, 0.6, 0.8), Point<3>(1, 0, 0), 0.8, 2.0).copy()},
+			{"RectangularPrism", RectangularPrism(Point<3>(0, 0, -1), Point<3>(0, 0.6, 0.8), Point<3>(1, 0, 0), Point<2>(1.5, 1.0), 2.0).copy()},
+			{"Pyramid", Pyramid(Rectangle(Point<2>(0, 0), Point<2>(1.5, 1.0)), Point<3>(0, 0, -1), Point<3>(0, 0.6, 0.8), Point<3>(1, 0, 0), 2.0).copy()},
+			{"Extrusion", Extrusion(Circle(Point<2>(0, 0), 0.8), Point<3>(0, 0, -1), Point<3>(0, 0.6, 0.8), Point<3>(1, 0, 0), 2.0).copy()},
+			{"Sweep", Sweep(Circle(Point<2>(0, 0), 0.3), Point<3>(1, 0, 0), Point<3>(0, 1, 0), Point<3>(1, 0, 0), Line<3>(Point<3>(0, 0, 0), Point<3>(0, 0.6, 0.8)), 270.0).copy()}};
+		std::size_t m = 64;
+		vector<Point<3>> grid;
+		for (auto i=0; i<m; i++) for (auto j=0; j<m; j++) for (auto k=0; k<m; k++) grid.push_back(Point<3>(-2+4.0*i/m, -2+4.0*j/m, -2+4.0*k/m));
+		for (auto & pr : prims3){
+			std::size_t nin = 0;
+			auto t0 = bench_clock::now();
+			for (auto & p : grid) nin += pr.second->contains_point(p);
+			double t = seconds_since(t0);
+			double dsum = 0;
+			t0 = bench_clock::now();
+			for (auto & p : grid) dsum += pr.second->signed_distance(p);
+			double td = seconds_since(t0);
+			cout << pr.first << " " << m << "^3: " << nin << " inside, " << 1.0e9*t/grid.size() << " ns/point, signed_distance " << 1.0e9*td/grid.size() << " ns/point (sum " << dsum << ")" << endl;
+		}
+	}
+
+	// signed distance of the same tree, one point at a time and batched,
+	// and adaptively sampled onto an octree
+	cout << "\n******* CSGTree signed_distance *******" << endl;
+	for (std::size_t m=32; m*m*m<=std::max<std::size_t>(nmax, 32768); m*=2){
+		vector<double> vx, vy, vz;
+		vx.reserve(m*m*m); vy.reserve(m*m*m); vz.reserve(m*m*m);
+		for (auto i=0; i<m; i++) for (auto j=0; j<m; j++) for (auto k=0; k<m; k++){
+			vx.push_back(-2+4.0*i/m); vy.push_back(-2+4.0*j/m); vz.push_back(-2+4.0*k/m);
+		}
+		PointBatch<3> batch{{vx.data(), vy.data(), vz.data()}, vx.size()};
+		auto t0 = bench_clock::now();
+		double sum = 0;
+		for (auto i=0; i<batch.size; i++) sum += vtree.signed_distance(batch.point(i));
+		double t = seconds_since(t0);
+
+		vector<double> dist(batch.size);
+		t0 = bench_clock::now();
+		vtree.signed_distances(batch, dist.data());
+		double tb = seconds_since(t0);
+		double bsum = 0;
+		for (auto d : dist) bsum += d;
+		cout << "grid " << m << "^3: sum " << sum << ", " << 1.0e9*t/batch.size << " ns/point, batched: sum " << bsum << ", " << 1.0e9*tb/batch.size << " ns/point" << endl;
+	}
+	for (std::size_t lvl=5; lvl<=8; lvl++){
+		auto t0 = bench_clock::now();
+		Octree<double> sdf = sample_signed_distance(vtree, Box<3>(Point<3>(-2, -2, -2), Point<3>(2, 2, 2)), 2, lvl);
+		double t = seconds_since(t0);
+		std::size_t nleaves = 0;
+		for (auto it=sdf.leaf_begin(); it!=sdf.leaf_end(); it++) nleaves++;
+		cout << "octree lvlmax=" << lvl << ": " << nleaves << " leaves (uniform: " << (1ULL << 3*lvl) << ") in " << t << " s" << endl;
+	}
+
+	// adaptive quadtrees over a union of circles, and octrees over the
+	// voxelized tree above, refined wherever box classification finds a
+	// cell neither inside nor outside
+	cout << "\n******* CSGTree box refinement *******" << endl;
+	struct EmptyCell{
+		DefaultNode<int> getValue(std::size_t key) const {int v = 0; return DefaultNode<int>(v, true);};
+	};
+	CSGTree<Primitive2D> ctree(Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.3));
+	for (auto i=1; i<200; i++) ctree.push_back(Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.3), UNION);
+	ctree.rebalance();
+	for (std::size_t lvl=6; lvl<=12; lvl+=2){
+		Quadtree<int> qt;
+		auto t0 = bench_clock::now();
+		qt.buildTree(2, lvl, EmptyCell(), geometry_refine_oracle(qt, ctree, Box<2>(Point<2>(0, 0), Point<2>(10, 10))), LevelInserter(), 0, 0);
+		double t = seconds_since(t0);
+		std::size_t nleaves = 0;
+		for (auto it=qt.leaf_begin(); it!=qt.leaf_end(); it++) nleaves++;
+		cout << "quadtree lvlmax=" << lvl << ": " << nleaves << " leaves (uniform: " << (1ULL << 2*lvl) << ") in " << t << " s" << endl;
+	}
+	for (std::size_t lvl=4; lvl<=8; lvl++){
+		Octree<int> ot;
+		auto t0 = bench_clock::now();
+		ot.buildTree(2, lvl, EmptyCell(), geometry_refine_oracle(ot, vtree, Box<3>(Point<3>(-2, -2, -2), Point<3>(2, 2, 2))), LevelInserter(), 0, 0);
+		double t = seconds_since(t0);
+		std::size_t nleaves = 0;
+		for (auto it=ot.leaf_begin(); it!=ot.leaf_end(); it++) nleaves++;
+		cout << "octree lvlmax=" << lvl << ": " << nleaves << " leaves (uniform: " << (1ULL << 3*lvl) << ") in " << t << " s" << endl;
+	}
+
+	// point queries through stacks of rotations about the ctree above. The
+	// stack is fused into one affine map; the chained column walks down
+	// the wrappers and applies each map in turn as a reference
+	// point-in-polygon against ragged footprints with many vertices, one
+	// point at a time and batched
+	cout << "\n******* Polygon contains_point *******" << endl;
+	for (std::size_t nv : {16, 256, 4096, 16384}){
+		vector<LineSegment> segs;
+		vector<Point<2>> verts(nv);
+		for (auto i=0; i<nv; i++){
+			double th = 2*pi*i/nv, r = 3.5 + 0.5*sin(7*th) + 0.2*sin(61*th) + 0.02*unif(rng);
+			verts[i] = Point<2>(5 + r*cos(th), 5 + r*sin(th));
+		}
+		for (auto i=0; i<nv; i++) segs.push_back(LineSegment(verts[i], verts[(i+1)%nv]));
+		Polygon poly(segs);
+		std::size_t np = std::min<std::size_t>(nq, std::max<std::size_t>(1000, 400000000/nv));
+		vector<double> px(np), py(np);
+		for (auto i=0; i<np; i++){px[i] = queries[i].x[0]; py[i] = queries[i].x[1];}
+		PointBatch<2> batch{{px.data(), py.data()}, np};
+		std::size_t nin = 0;
+		auto t0 = bench_clock::now();
+		for (auto i=0; i<np; i++) nin += poly.contains_point(queries[i]);
+		double t = seconds_since(t0);
+		vector<Ullong> mask(batch.nwords());
+		t0 = bench_clock::now();
+		poly.contains_points(batch, mask.data());
+		double tb = seconds_since(t0);
+		std::size_t nbatch = 0;
+		for (auto w : mask) nbatch += std::bitset<64>(w).count();
+		cout << "vertices=" << nv << ": " << nin << "/" << np << " inside, " << 1.0e9*t/np << " ns/query, batched: " << nbatch << " inside, " << 1.0e9*tb/np << " ns/query" << endl;
+	}
+
+	// outlines of a union of circles of very different sizes, with a fixed
+	// number of points per circle or to a chordal tolerance
+	cout << "\n******* CSGTree get_outline *******" << endl;
+	for (auto nprim : {50, 200, 800}){
+		CSGTree<Primitive2D> otree(Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.02 + unif(rng)*unif(rng)));
+		for (auto i=1; i<nprim; i++) otree.push_back(Circle(Point<2>(10*unif(rng), 10*unif(rng)), 0.02 + unif(rng)*unif(rng)), UNION);
+		otree.rebalance();
+		for (unsigned int npts : {64, 512}){
+			auto t0 = bench_clock::now();
+			auto o = otree.get_outline(npts);
+			double t = seconds_since(t0);
+			std::size_t n = 0;
+			for (auto & h : o) n += h.points.size();
+			cout << "nprim=" << nprim << " npts=" << npts << ": " << n << " points, " << 1.0e3*t << " ms" << endl;
+		}
+		for (double tol : {1.0e-3, 1.0e-5}){
+			auto t0 = bench_clock::now();
+			auto o = otree.get_adaptive_outline(tol);
+			double t = seconds_since(t0);
+			std::size_t n = 0;
+			for (auto & h : o) n += h.points.size();
+			cout << "nprim=" << nprim << " tol=" << tol << ": " << n << " points, " << 1.0e3*t << " ms" << endl;
+		}
+	}
+
+	// booleans of two ragged rings, which cross each other about once per
+	// ten vertices
+	cout << "\n******* polygon_boolean *******" << endl;
+	for (auto nv : {1000, 10000, 100000}){
+		std::vector<Hull<2>> ra(1), rb(1);
+		for (auto i=0; i<nv; i++){
+			double t = 2*pi*i/nv;
+			ra[0].points.push_back((1.0 + 0.05*sin(0.1*nv*t))*Point<2>(cos(t), sin(t)));
+			rb[0].points.push_back(Point<2>(0.3, 0) + (0.9 + 0.05*sin(0.1*nv*t + 1))*Point<2>(cos(t), sin(t)));
+		}
+		for (auto op : {UNION, INTERSECT, DIFFERENCE, XOR}){
+			auto t0 = bench_clock::now();
+			auto o = polygon_boolean(ra, rb, op);
+			double t = seconds_since(t0);
+			std::size_t n = 0;
+			for (auto & h : o) n += h.points.size();
+			cout << "vertices=" << nv << " op=" << op << ": " << o.size() << " rings, " << n << " points, " << 1.0e3*t << " ms" << endl;
+		}
+	}
+
+	cout << "\n******* LinearTransformation contains_point *******" << endl;
+	typedef LinearTransformation<Primitive2D, RotationMap2D> RotT;
+	std::shared_ptr<Primitive2D> rstack = ctree.copy();
+	std::size_t nstacked = 0;
+	for (std::size_t depth=1; depth<=8; depth*=2){
+		for (; nstacked<depth; nstacked++) rstack = rotation_transformation(*rstack, 0.1).copy();
+		std::size_t nin = 0;
+		auto t0 = bench_clock::now();
+		for (auto i=0; i<nq; i++) nin += rstack->contains_point(queries[i]);
+		double t = seconds_since(t0);
+		t0 = bench_clock::now();
+		for (auto i=0; i<nq; i++){
+			const Primitive2D * q = rstack.get();
+			Point<2> p = queries[i];
+			while (auto r = dynamic_cast<const RotT *>(q)){
+				p = r->mMap.inverse_map(p);
+				q = r->mPrim.get();
+			}
+			nin -= q->contains_point(p);
+		}
+		double tchain = seconds_since(t0);
+		cout << "depth=" << depth << ": " << 1.0e+9*t/nq << " ns/query (chained: " << 1.0e+9*tchain/nq << " ns/query), count difference " << nin << endl;
+	}
+
+	// symmetry inverse maps for points out to many periods (or, for the
+	// rotation, far around the circle) from the base cell; the stepping
+	// column walks back one period or sector at a time as a reference
+	cout << "\n******* SymmetryTransformation inverse_map *******" << endl;
+	auto tsym = discrete_translation_symmetry(Circle(Point<2>(0.5, 0.5), 0.3), Point<2>(1.0, 0.0));
+	auto rsym = discrete_rotation_symmetry(Circle(Point<2>(1.5, 0.0), 0.3), Point<2>(0, 0), 64);
+	std::size_t nsym = std::min<std::size_t>(nmax, 100000);
+	for (double dist=1; dist<=10000; dist*=10){
+		vector<Point<2>> spts(nsym);
+		for (auto i=0; i<nsym; i++) spts[i] = Point<2>(dist*(2*unif(rng)-1), unif(rng));
+		double sx = 0;
+		auto t0 = bench_clock::now();
+		for (auto i=0; i<nsym; i++) sx += tsym.mMap.inverse_map(spts[i]).x[0];
+		double t = seconds_since(t0);
+		t0 = bench_clock::now();
+		for (auto i=0; i<nsym; i++){
+			Point<2> v = spts[i] - tsym.mMap.mCen;
+			double proj = Point<2>::dot(v, tsym.mMap.mSvec);
+			while (fabs(proj) > 0.5){
+				v = v - static_cast<double>(sgn(proj))*tsym.mMap.mSvec;
+				proj = Point<2>::dot(v, tsym.mMap.mSvec);
+			}
+			sx -= v.x[0] + tsym.mMap.mCen.x[0];
+		}
+		double tstep = seconds_since(t0);
+		cout << "translation  periods<=" << dist << ": " << 1.0e+9*t/nsym << " ns/query (stepping: " << 1.0e+9*tstep/nsym << " ns/query) residual " << sx << endl;
+	}
+	{
+		vector<Point<2>> spts(nsym);
+		for (auto i=0; i<nsym; i++) spts[i] = Point<2>(4*unif(rng)-2, 4*unif(rng)-2);
+		double sx = 0;
+		auto t0 = bench_clock::now();
+		for (auto i=0; i<nsym; i++) sx += rsym.mMap.inverse_map(spts[i]).x[0];
+		double t = seconds_since(t0);
+		double angle = 2.0*pi/64.0;
+		t0 = bench_clock::now();
+		for (auto i=0; i<nsym; i++){
+			Point<2> pp = spts[i], w = rsym.mMap.mCen;
+			while (Point<2>::dot(pp, w) < 0 || fabs(asin(cross(pp, w)/(w.norm()*pp.norm()))) > angle/2.0){
+				pp = Point<2>(cos(angle)*pp.x[0] + sin(angle)*pp.x[1], -sin(angle)*pp.x[0] + cos(angle)*pp.x[1]);
+			}
+			sx -= pp.x[0];
+		}
+		double tstep = seconds_since(t0);
+		cout << "rotation     N=64: " << 1.0e+9*t/nsym << " ns/query (stepping: " << 1.0e+9*tstep/nsym << " ns/query) residual " << sx << endl;
+	}
+	// outlines of the translated copies inside viewports of growing width,
+	// visited one hull at a time without materializing them
+	for (double width=10; width<=100000; width*=100){
+		auto view = tsym.outline_view(64, Box<2>(Point<2>(-0.5*width, 0), Point<2>(0.5*width, 1)));
+		std::size_t nhulls = 0, npts = 0;
+		auto t0 = bench_clock::now();
+		for (auto it=view.begin(); it!=view.end(); ++it, nhulls++) npts += (*it).points.size();
+		double t = seconds_since(t0);
+		cout << "outline view width=" << width << ": " << nhulls << " hulls, " << npts << " points in " << t << " s" << endl;
+	}
+	// a cubic lattice of spheres and a helix of them, each a single
+	// primitive however many copies the queries reach
+	auto lsym = discrete_translation_symmetry(Sphere(Point<3>(0.5, 0.5, 0.5), 0.3), std::vector<Point<3>>{Point<3>(1, 0, 0), Point<3>(0, 1, 0), Point<3>(0, 0, 1)});
+	auto hsym = helical_symmetry(Sphere(Point<3>(1.5, 0, 0), 0.3), Point<3>(0, 0, 0), Point<3>(0, 0, 1), 2.0, 12);
+	for (double dist=1; dist<=10000; dist*=100){
+		vector<Point<3>> spts(nsym), hpts(nsym);
+		for (auto i=0; i<nsym; i++){
+			spts[i] = Point<3>(dist*(2*unif(rng)-1), dist*(2*unif(rng)-1), dist*(2*unif(rng)-1));
+			hpts[i] = Point<3>(4*unif(rng)-2, 4*unif(rng)-2, spts[i].x[2]);
+		}
+		std::size_t nlin = 0, nhin = 0;
+		auto t0 = bench_clock::now();
+		for (auto i=0; i<nsym; i++) nlin += lsym.contains_point(spts[i]);
+		double tl = seconds_since(t0);
+		t0 = bench_clock::now();
+		for (auto i=0; i<nsym; i++) nhin += hsym.contains_point(hpts[i]);
+		double th = seconds_since(t0);
+		cout << "3D lattice   periods<=" << dist << ": " << 1.0e+9*tl/nsym << " ns/query (" << nlin << " in), helix: " << 1.0e+9*th/nsym << " ns/query (" << nhin << " in)" << endl;
+	}
+
+	return 0;
+}
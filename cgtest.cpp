@@ -7,7 +7,7 @@ using namespace csg;
 
 
 // compile this with command:
-// 			clang++ -std=c++14 -I./ cgtest.cpp -o cgtest		
+// 			clang++ -std=c++14 -pthread -I./ cgtest.cpp -o cgtest		
 
 int main(int argc, char * argv[])
 {
@@ -226,6 +226,95 @@ int main(int argc, char * argv[])
 
 
 
+	// Delaunay triangulation of a degenerate (gridded) point set
+	cout << "\n******* Delaunay *******" << endl;
+	vector<Point<2>> gridpts;
+	for (auto i=0; i<10; i++) for (auto j=0; j<10; j++) gridpts.push_back(Point<2>(0.1*i, 0.1*j));
+	gridpts.push_back(Point<2>(0.5, 0.5)); // duplicate point
+	Delaunay gdel(gridpts, 0);
+	cout << "Grid triangles: " << gdel.ntri << endl;
+	cout << "orient2d " << Point<2>(0,0) << "," << Point<2>(1,1) << "," << Point<2>(2,2) << ": " << orient2d(Point<2>(0,0), Point<2>(1,1), Point<2>(2,2)) << endl;
+	cout << "in_circle " << Point<2>(0,1) << " vs " << Point<2>(0,0) << "," << Point<2>(1,0) << "," << Point<2>(1,1) << ": " << in_circle(Point<2>(0,1), Point<2>(0,0), Point<2>(1,0), Point<2>(1,1)) << endl;
+
+	// point location and interpolation on the finished triangulation
+	TriangulationLocator gloc(gdel);
+	vector<double> gvals(gdel.npts);
+	for (auto i=0; i<gdel.npts; i++) gvals[i] = 2*gdel.points[i].x[0] - gdel.points[i].x[1];
+	vector<Point<2>> gqueries = {Point<2>(0.25, 0.35), Point<2>(0.5, 0.55), Point<2>(2.0, 0.5)};
+	vector<int> gtris = gloc.locate(gqueries);
+	vector<double> glin = gloc.interpolate_linear(gqueries, gvals);
+	vector<double> gnn = gloc.interpolate_natural_neighbor(gqueries, gvals);
+	for (auto i=0; i<gqueries.size(); i++) cout << "locate " << gqueries[i] << ": triangle " << gtris[i] << " linear " << glin[i] << " natural neighbor " << gnn[i] << endl;
+
+	// constrained Delaunay triangulation of a concave (L-shaped) polygon
+	vector<Point<2>> lring = {Point<2>(0,0), Point<2>(2,0), Point<2>(2,1), Point<2>(1,1), Point<2>(1,2), Point<2>(0,2)};
+	vector<Point<2>> lpts;
+	vector<IntPoint2> lsegs;
+	get_hull_segments(vector<Hull<2>>(1, Hull<2>(lring)), lpts, lsegs);
+	Delaunay ldel(lpts, lsegs, 1);
+	ldel.remove_exterior();
+	Triangulation<2> ltri = ldel.get_triangulation();
+	double larea = 0;
+	for (auto i=0; i<ltri.triangles.size(); i++){
+		const IntPoint<3> & lt = ltri.triangles[i];
+		larea += 0.5*orient2d(ltri.points[lt.x[0]], ltri.points[lt.x[1]], ltri.points[lt.x[2]]);
+	}
+	cout << "L-shape triangles: " << ltri.triangles.size() << " area: " << larea << endl;
+	Int ladd = ldel.refine(25.0, 0.05);
+	cout << "L-shape refined (25 degrees, area 0.05): " << ladd << " points added, triangles: " << ldel.ntri << endl;
+
+	// Delaunay tetrahedralization of a gridded cube
+	cout << "\n******* Delaunay3D *******" << endl;
+	vector<Point<3>> cubepts;
+	for (auto i=0; i<5; i++) for (auto j=0; j<5; j++) for (auto k=0; k<5; k++) cubepts.push_back(Point<3>(0.25*i, 0.25*j, 0.25*k));
+	Delaunay3D tdel(cubepts);
+	Tetrahedralization tets = tdel.get_tetrahedralization();
+	double tvol = 0;
+	for (auto i=0; i<tets.tetrahedra.size(); i++){
+		const IntPoint<4> & tt = tets.tetrahedra[i];
+		tvol += orient3d(tets.points[tt.x[0]], tets.points[tt.x[1]], tets.points[tt.x[2]], tets.points[tt.x[3]])/6.0;
+	}
+	cout << "Tetrahedra: " << tets.tetrahedra.size() << " total volume: " << tvol << endl;
+
+	// a lattice is full of cospherical points, which the tie-breaking
+	// must resolve the same way whatever the insertion order, leaving no
+	// point strictly inside any circumsphere. This one is large enough to
+	// be inserted in a random order
+	vector<Point<3>> latpts;
+	for (auto i=0; i<11; i++) for (auto j=0; j<11; j++) for (auto k=0; k<11; k++) latpts.push_back(Point<3>(0.1*i, 0.1*j, 0.1*k));
+	Delaunay3D ldel1(latpts), ldel2(latpts);
+	Tetrahedralization ltets1 = ldel1.get_tetrahedralization(), ltets2 = ldel2.get_tetrahedralization();
+	auto tet_keys = [](const Tetrahedralization & tz){
+		std::vector<std::array<Int, 4>> keys;
+		for (auto & tt : tz.tetrahedra){
+			std::array<Int, 4> key = {{tt.x[0], tt.x[1], tt.x[2], tt.x[3]}};
+			std::sort(key.begin(), key.end());
+			keys.push_back(key);
+		}
+		std::sort(keys.begin(), keys.end());
+		return keys;
+	};
+	std::size_t nempty = 0;
+	double lvol = 0;
+	for (auto & tt : ltets1.tetrahedra){
+		const Point<3> & a = latpts[tt.x[0]], & b = latpts[tt.x[1]], & c = latpts[tt.x[2]], & d = latpts[tt.x[3]];
+		lvol += orient3d(a, b, c, d)/6.0;
+		Point<3> lo = a, hi = a;
+		for (auto q : {b, c, d}) for (auto k=0; k<3; k++) {lo.x[k] = std::min(lo.x[k], q.x[k]); hi.x[k] = std::max(hi.x[k], q.x[k]);}
+		for (auto & q : latpts){
+			if (Point<3>::dist(q, 0.5*(lo+hi)) > 0.3) continue;
+			nempty += in_sphere(a, b, c, d, q) > 0;
+		}
+	}
+	cout << "lattice: " << ltets1.tetrahedra.size() << " tetrahedra, volume " << lvol << ", " << (ldel1.perm != ldel2.perm ? "reordered" : "same order");
+	cout << ", same tetrahedra " << (tet_keys(ltets1) == tet_keys(ltets2)) << ", " << nempty << " points inside circumspheres" << endl;
+	cout << "in_sphere " << Point<3>(0.5,0.5,0.5) << ": " << in_sphere(Point<3>(1,0,0), Point<3>(0,1,0), Point<3>(0,0,1), Point<3>(0,0,0), Point<3>(0.5,0.5,0.5)) << endl;
+
+
+
+
+
+
 	// trees 
 	Orthtree<2,3,int> tree3;
 	std::size_t k = 17;
@@ -310,6 +399,26 @@ int main(int argc, char * argv[])
 		cout << endl;
 	}
 
+	// rasterized frames must agree with queries at the cell centers
+	std::size_t nrastermismatch = 0;
+	auto raster2 = frame3.rasterize(67, 23, 3);
+	for (auto j=0; j<23; j++) for (auto i=0; i<67; i++){
+		nrastermismatch += raster2[67*j+i] != frame3.query_point(Point<2>((i+0.5)*frame3.lengthx()/67, (j+0.5)*frame3.lengthy()/23));
+	}
+	auto frame3d = make_frame_3d(scene3, Point<3>(-0.6, -0.6, -0.6), Point<3>(1.2, 0.6, 0.6), Point<3>(1,0,0), Point<3>(0,1,0));
+	auto raster3 = frame3d.rasterize(45, 30, 20);
+	for (auto k=0; k<20; k++) for (auto j=0; j<30; j++) for (auto i=0; i<45; i++){
+		nrastermismatch += raster3[45*(30*k+j)+i] != frame3d.query_point(Point<3>((i+0.5)*frame3d.lengthx()/45, (j+0.5)*frame3d.lengthy()/30, (k+0.5)*frame3d.lengthz()/20));
+	}
+	Scene<bool, Primitive2D> sceneb(false);
+	sceneb.insert(true, Circle({0,0}, 0.5));
+	auto frameb = make_frame_2d(sceneb, Point<2>(-0.5, -0.5), Point<2>(1.5, 0.5), Point<2>(1,0));
+	std::vector<bool> rasterb = frameb.rasterize(67, 23, 3);
+	for (auto j=0; j<23; j++) for (auto i=0; i<67; i++){
+		nrastermismatch += rasterb[67*j+i] != frameb.query_point(Point<2>((i+0.5)*frameb.lengthx()/67, (j+0.5)*frameb.lengthy()/23));
+	}
+	cout << "rasterized frames: " << raster2.size() << " + " << raster3.size() << " + " << rasterb.size() << " cells, " << nrastermismatch << " mismatches" << endl;
+
 
 	// test the linear transformations and symmetry transformations
 	CSGTree<Primitive2D> ctreep2d(Circle({0,0},0.5));
@@ -323,6 +432,339 @@ int main(int argc, char * argv[])
 	ctreep3d.push_back(Cylinder({0,0,1},{0,0,1},{1,0,0},0.3,1.0), XOR);
 	ctreep3d.print_summary();
 
+	// cached bounding boxes: an empty tree and a disjoint intersection
+	// hold nothing, and a leaf moved in place is found once the boxes
+	// are recomputed
+	CSGTree<Primitive2D> cempty;
+	auto cmoved = std::make_shared<Circle>(Circle({0,0}, 0.5));
+	CSGTree<Primitive2D> cdisjoint(std::make_shared<Circle>(Circle({0,0}, 0.5)), std::make_shared<Circle>(Circle({3,0}, 0.5)), INTERSECT);
+	CSGTree<Primitive2D> cmovedtree(cmoved);
+	cmoved->translate(Point<2>(2, 0));
+	cout << "cached boxes: empty " << cempty.contains_point(Point<2>(0,0)) << " " << cdisjoint.get_bounding_box();
+	cout << ", moved leaf " << cmovedtree.contains_point(Point<2>(2,0));
+	cmovedtree.update_bounding_boxes();
+	cout << " " << cmovedtree.contains_point(Point<2>(2,0)) << endl;
+
+	// the closed-form symmetry inverse maps must agree with stepping back
+	// one period or sector at a time
+	auto tsym = discrete_translation_symmetry(Circle({1.5, 0.2}, 0.3), Point<2>(1.0, 0.5));
+	auto rsym = discrete_rotation_symmetry(Circle({1.5, 0.2}, 0.3), Point<2>(0.1, -0.2), 7);
+	std::size_t nsymmismatch = 0;
+	for (double x=-40.0; x<=40.0; x+=0.37){
+		for (double y=-40.0; y<=40.0; y+=0.41){
+			Point<2> p(x, y);
+			Point<2> v = p - tsym.mMap.mCen;
+			double proj = Point<2>::dot(v, tsym.mMap.mSvec), a2 = Point<2>::dot(tsym.mMap.mSvec, tsym.mMap.mSvec);
+			while (fabs(proj/a2) > 0.5){
+				v = v - static_cast<double>(sgn(proj))*tsym.mMap.mSvec;
+				proj = Point<2>::dot(v, tsym.mMap.mSvec);
+			}
+			nsymmismatch += Point<2>::dist(tsym.mMap.inverse_map(p), v + tsym.mMap.mCen) > 1.0e-9;
+
+			double angle = 2.0*pi/7.0;
+			Point<2> pp = p - rsym.mMap.mRpt, w = rsym.mMap.mCen - rsym.mMap.mRpt;
+			while (Point<2>::dot(pp, w) < 0 || fabs(asin(cross(pp, w)/(w.norm()*pp.norm()))) > angle/2.0){
+				pp = Point<2>(cos(angle)*pp.x[0] + sin(angle)*pp.x[1], -sin(angle)*pp.x[0] + cos(angle)*pp.x[1]);
+			}
+			nsymmismatch += Point<2>::dist(rsym.mMap.inverse_map(p), pp + rsym.mMap.mRpt) > 1.0e-9;
+		}
+	}
+	cout << "symmetry inverse maps: " << nsymmismatch << " mismatches" << endl;
+
+	// 3D symmetries of a small sphere must agree with the explicit union of
+	// its copies, and the continuous ones must be invariant under the motion
+	auto turn = [](const Point<3> & p, const Point<3> & rpt, const Point<3> & u, double angle){
+		Point<3> q = p - rpt;
+		return rpt + cos(angle)*q + sin(angle)*cross(u, q) + (1-cos(angle))*Point<3>::dot(u, q)*u;
+	};
+	Sphere ball({1.0, 0.2, 0.5}, 0.3);
+	std::vector<Point<3>> lattice = {Point<3>(1, 0, 0), Point<3>(0.3, 1, 0), Point<3>(0, 0.2, 1.1)};
+	Point<3> axpt(0.1, 0, 0), axis = Point<3>(0.2, 0.1, 1).normalize();
+	auto lsym = discrete_translation_symmetry(ball, lattice);
+	auto rsym3 = discrete_rotation_symmetry(ball, axpt, axis, 5);
+	auto hsym = helical_symmetry(ball, axpt, axis, 1.2, 4);
+	auto crsym = continuous_rotation_symmetry(ball, axpt, axis);
+	auto chsym = helical_symmetry(ball, axpt, axis, 1.2);
+	auto ctsym = continuous_translation_symmetry(ball, Point<3>(0.3, -0.4, 1.0));
+	std::size_t nsym3 = 0, nsym3mismatch = 0;
+	for (double x=-1.987; x<=2.0; x+=0.1){
+		for (double y=-1.991; y<=2.0; y+=0.1){
+			for (double z=-1.993; z<=2.0; z+=0.1){
+				Point<3> p(x, y, z);
+				bool inl = false, inr = false, inh = false;
+				for (auto i=-3; i<=3; i++) for (auto j=-3; j<=3; j++) for (auto k=-3; k<=3; k++){
+					inl = inl || ball.contains_point(p - (double(i)*lattice[0] + double(j)*lattice[1] + double(k)*lattice[2]));
+				}
+				for (auto k=0; k<5; k++) inr = inr || ball.contains_point(turn(p, axpt, axis, -2.0*pi*k/5.0));
+				for (auto k=-12; k<=12; k++) inh = inh || ball.contains_point(turn(p, axpt, axis, -2.0*pi*k/4.0) - 0.3*k*axis);
+				nsym3 += inl + inr + inh;
+				nsym3mismatch += (lsym.contains_point(p) != inl) + (rsym3.contains_point(p) != inr) + (hsym.contains_point(p) != inh);
+
+				double phi = 0.37*x + 1.3*y - 0.71*z;
+				nsym3mismatch += crsym.contains_point(p) != crsym.contains_point(turn(p, axpt, axis, phi));
+				nsym3mismatch += chsym.contains_point(p) != chsym.contains_point(turn(p, axpt, axis, phi) + 1.2*phi/(2.0*pi)*axis);
+				nsym3mismatch += ctsym.contains_point(p) != ctsym.contains_point(p + phi*Point<3>(0.3, -0.4, 1.0));
+			}
+		}
+	}
+	cout << "3D symmetry maps: " << nsym3 << " samples inside copies, " << nsym3mismatch << " mismatches" << endl;
+
+	// lazy outline views visit exactly the copies whose box meets the
+	// viewport, in agreement with the materialized outlines
+	auto tview = discrete_translation_symmetry(Circle({0.2, 0.1}, 0.3), Point<2>(0.7, 0.2));
+	auto rview = discrete_rotation_symmetry(Circle({1.5, 0.2}, 0.3), Point<2>(0.1, -0.2), 7);
+	std::vector<Box<2>> viewports = {Box<2>(Point<2>(-3, -1), Point<2>(3, 1)), Box<2>(Point<2>(40, 11), Point<2>(41, 12)), Box<2>(Point<2>(1.2, -0.5), Point<2>(1.8, 0.5))};
+	std::size_t nviewed = 0, nviewmismatch = 0;
+	for (auto & vp : viewports){
+		std::vector<Hull<2>> tall = tview.get_outline(30);
+		std::vector<long> tcopies;
+		for (long k=-100; k<=100; k++){
+			Box<2> bx = Box<2>::translate(Circle({0.2, 0.1}, 0.3).get_bounding_box(), static_cast<double>(k)*Point<2>(0.7, 0.2));
+			if (Box<2>::collides(bx, vp)) tcopies.push_back(k);
+		}
+		std::size_t c = 0;
+		auto view = tview.outline_view(30, vp);
+		for (auto it=view.begin(); it!=view.end(); ++it, c++){
+			Hull<2> h = *it;
+			nviewmismatch += c >= tcopies.size() || it.copy() != tcopies[c];
+			for (auto i=0; i<h.points.size(); i++) nviewmismatch += Point<2>::dist(h.points[i], tall[10].points[i] + static_cast<double>(it.copy())*Point<2>(0.7, 0.2)) > 1.0e-12;
+		}
+		nviewmismatch += c != tcopies.size();
+		nviewed += c;
+
+		auto rv = rview.outline_view(30, vp);
+		std::vector<Hull<2>> rall = rview.get_outline(30);
+		for (auto it=rv.begin(); it!=rv.end(); ++it, nviewed++){
+			Hull<2> h = *it;
+			for (auto i=0; i<h.points.size(); i++) nviewmismatch += Point<2>::dist(h.points[i], rall[it.copy()].points[i]) > 1.0e-12;
+		}
+	}
+	nviewmismatch += tview.get_outline(30).size() != 21;
+	// a primitive wider than the period still gets exactly 21 copies
+	nviewmismatch += discrete_translation_symmetry(Circle(Point<2>(0, 0), 1.0), Point<2>(0.5, 0)).get_outline(16).size() != 21;
+	cout << "symmetry outline views: " << nviewed << " copies visited, " << nviewmismatch << " mismatches" << endl;
+
+	// compile the trees to flat programs, which must agree everywhere
+	CSGProgram<2> progp2d(ctreep2d);
+	CSGProgram<3> progp3d(ctreep3d);
+	unsigned int nmismatch2 = 0, nmismatch3 = 0;
+	for (double x=-1.0; x<=1.0; x+=0.01){
+		for (double y=-1.0; y<=1.0; y+=0.01){
+			nmismatch2 += progp2d.contains_point(Point<2>(x, y)) != ctreep2d.contains_point(Point<2>(x, y));
+			for (double z=-1.0; z<=2.0; z+=0.1){
+				nmismatch3 += progp3d.contains_point(Point<3>(x, y, z)) != ctreep3d.contains_point(Point<3>(x, y, z));
+			}
+		}
+	}
+	cout << "compiled 2D program: " << progp2d.size() << " instructions, " << nmismatch2 << " mismatches" << endl;
+	cout << "compiled 3D program: " << progp3d.size() << " instructions, " << nmismatch3 << " mismatches" << endl;
+
+	// a mixed tree: a rebalanced union of circles and triangles, whose
+	// nested jumps get threaded, subtrees on the right of an XOR, a
+	// difference and a union, a whole tree held as a leaf, and rectangles
+	// and generic leaves
+	CSGTree<Primitive2D> mblob(Circle({0.6, 0}, 0.2));
+	for (auto i=1; i<12; i++){
+		Point<2> c(0.6*cos(2*pi*i/12), 0.6*sin(2*pi*i/12));
+		if (i%3 == 0) mblob.push_back(Triangle(c + Point<2>(-0.2, -0.1), c + Point<2>(0.2, -0.15), c + Point<2>(0, 0.25)), UNION);
+		else mblob.push_back(Circle(c, 0.15 + 0.01*i), UNION);
+	}
+	mblob.rebalance();
+	CSGTree<Primitive2D> mcut(Rectangle({0.2, 0.1}, {0.9, 0.5}));
+	mcut.push_back(Triangle({-0.6, -0.4}, {0.7, -0.5}, {0.1, 0.6}), INTERSECT);
+	mcut.push_back(Ellipse({-0.2, -0.3}, {0.5, 0.2}), UNION);
+	CSGTree<Primitive2D> mholes(Circle({0.3, 0.3}, 0.1));
+	mholes.push_back(RegularPolygon(5, {-0.3, 0.2}, 0.15), UNION);
+	mholes.push_back(Rectangle({0.55, -0.35}, {0.2, 0.3}), UNION);
+	auto mxor = std::make_shared<CSGTree<Primitive2D>>(std::make_shared<CSGTree<Primitive2D>>(mblob), std::make_shared<CSGTree<Primitive2D>>(mcut), XOR);
+	CSGTree<Primitive2D> mixed(mxor, std::make_shared<CSGTree<Primitive2D>>(mholes), DIFFERENCE);
+	mixed.push_back(mcut.copy(), UNION);
+	mixed.push_back(Rectangle({0, 0}, {1.5, 1.4}), INTERSECT);
+	CSGProgram<2> progmixed(mixed);
+	unsigned int nmismatchmixed = 0;
+	for (double x=-1.0; x<=1.0; x+=0.005){
+		for (double y=-1.0; y<=1.0; y+=0.005){
+			nmismatchmixed += progmixed.contains_point(Point<2>(x, y)) != mixed.contains_point(Point<2>(x, y));
+		}
+	}
+	cout << "compiled mixed program: " << progmixed.size() << " instructions, " << nmismatchmixed << " mismatches" << endl;
+
+	// batched queries on a structure-of-arrays grid, which must agree with
+	// the pointwise queries
+	vector<double> bx, by, bz;
+	for (double x=-1.0; x<=1.0; x+=0.01){
+		for (double y=-1.0; y<=1.0; y+=0.01){
+			for (double z=-1.0; z<=2.0; z+=0.1){
+				bx.push_back(x); by.push_back(y); bz.push_back(z);
+			}
+		}
+	}
+	PointBatch<2> batch2d{{bx.data(), by.data()}, bx.size()};
+	PointBatch<3> batch3d{{bx.data(), by.data(), bz.data()}, bx.size()};
+	vector<Ullong> mask2d(batch2d.nwords()), mask3d(batch3d.nwords());
+	ctreep2d.contains_points(batch2d, &mask2d.front());
+	ctreep3d.contains_points(batch3d, &mask3d.front());
+	nmismatch2 = 0; nmismatch3 = 0;
+	for (auto i=0; i<bx.size(); i++){
+		nmismatch2 += bool(mask2d[i/64] >> (i%64) & 1) != ctreep2d.contains_point(batch2d.point(i));
+		nmismatch3 += bool(mask3d[i/64] >> (i%64) & 1) != ctreep3d.contains_point(batch3d.point(i));
+	}
+	cout << "batched 2D queries: " << bx.size() << " points, " << nmismatch2 << " mismatches" << endl;
+	cout << "batched 3D queries: " << bx.size() << " points, " << nmismatch3 << " mismatches" << endl;
+
+	// rebalanced chains of unions and differences, which must agree with
+	// the left-deep trees built by push_back
+	CSGTree<Primitive2D> cchain(Circle({0,0}, 0.1));
+	CSGeometry2D gchain(Rectangle({0,0}, {2, 2}));
+	for (auto i=0; i<64; i++){
+		cchain.push_back(Circle({cos(0.1*i), sin(0.3*i)}, 0.1), UNION);
+		gchain.push_back(make_shared<Circle>(Point<2>(cos(0.2*i), sin(0.5*i)), 0.15), DIFFERENCE);
+	}
+	CSGTree<Primitive2D> cbal = cchain;
+	CSGeometry2D gbal = gchain;
+	cbal.rebalance();
+	gbal.rebalance();
+	nmismatch2 = 0;
+	for (double x=-1.0; x<=1.0; x+=0.01){
+		for (double y=-1.0; y<=1.0; y+=0.01){
+			nmismatch2 += cbal.contains_point(Point<2>(x, y)) != cchain.contains_point(Point<2>(x, y));
+			nmismatch2 += gbal.contains_point(Point<2>(x, y)) != gchain.contains_point(Point<2>(x, y));
+		}
+	}
+	cout << "rebalanced trees: " << nmismatch2 << " mismatches" << endl;
+
+	// signed distances, whose sign must agree with contains_point(), and
+	// the same values batched. Then sample the 3D tree onto an octree
+	vector<double> dist2d(bx.size()), dist3d(bx.size());
+	ctreep2d.signed_distances(batch2d, &dist2d.front());
+	ctreep3d.signed_distances(batch3d, &dist3d.front());
+	nmismatch2 = 0; nmismatch3 = 0;
+	for (auto i=0; i<bx.size(); i++){
+		double d2 = ctreep2d.signed_distance(batch2d.point(i)), d3 = ctreep3d.signed_distance(batch3d.point(i));
+		nmismatch2 += (d2 != dist2d[i]) || (d2 != 0 && (d2 < 0) != ctreep2d.contains_point(batch2d.point(i)));
+		nmismatch3 += (d3 != dist3d[i]) || (d3 != 0 && (d3 < 0) != ctreep3d.contains_point(batch3d.point(i)));
+	}
+	cout << "signed distance 2D: " << nmismatch2 << " mismatches" << endl;
+	cout << "signed distance 3D: " << nmismatch3 << " mismatches" << endl;
+	Octree<double> sdf = sample_signed_distance(ctreep3d, ctreep3d.get_bounding_box(), 2, 6);
+	std::size_t nsdfleaves = 0;
+	for (auto it=sdf.leaf_begin(); it!=sdf.leaf_end(); it++) nsdfleaves++;
+	cout << "signed distance octree: " << nsdfleaves << " leaves" << endl;
+
+	// adaptive quadtree over the 2D tree, refined only where a cell is
+	// neither inside nor outside the geometry. Samples in each leaf above
+	// the finest level must all agree
+	struct EmptyCell{
+		DefaultNode<int> getValue(std::size_t key) const {int v = 0; return DefaultNode<int>(v, true);};
+	};
+	Quadtree<int> qt;
+	auto qoracle = geometry_refine_oracle(qt, ctreep2d, ctreep2d.get_bounding_box());
+	qt.buildTree(2, 8, EmptyCell(), qoracle, LevelInserter(), 0, 0);
+	std::size_t nqleaves = 0, nqmismatch = 0;
+	for (auto it=qt.leaf_begin(); it!=qt.leaf_end(); it++){
+		nqleaves++;
+		if (qt.getLevel(it->first) == 8) continue;
+		Box<2> cell = qoracle.getBox(it->first);
+		bool in = ctreep2d.contains_point(0.5*(cell.lo+cell.hi));
+		for (auto i=0; i<=8; i++) for (auto j=0; j<=8; j++){
+			Point<2> p(cell.lo.x[0] + i*(cell.hi.x[0]-cell.lo.x[0])/8, cell.lo.x[1] + j*(cell.hi.x[1]-cell.lo.x[1])/8);
+			nqmismatch += ctreep2d.contains_point(p) != in;
+		}
+	}
+	cout << "adaptive quadtree: " << nqleaves << " leaves (uniform: " << (1 << 16) << "), " << nqmismatch << " mismatches" << endl;
+
+	// the same over the 3D tree, whose cells are classified in one pass
+	Octree<int> ot;
+	auto ooracle = geometry_refine_oracle(ot, ctreep3d, ctreep3d.get_bounding_box());
+	ot.buildTree(2, 6, EmptyCell(), ooracle, LevelInserter(), 0, 0);
+	std::size_t noleaves = 0, nomismatch = 0;
+	for (auto it=ot.leaf_begin(); it!=ot.leaf_end(); it++){
+		noleaves++;
+		if (ot.getLevel(it->first) == 6) continue;
+		Box<3> cell = ooracle.getBox(it->first);
+		RegionClass c = ctreep3d.classify_box(cell);
+		nomismatch += c == AMBIGUOUS;
+		for (auto i=0; i<=4; i++) for (auto j=0; j<=4; j++) for (auto k=0; k<=4; k++){
+			Point<3> p = cell.lo + Point<3>(i*(cell.hi.x[0]-cell.lo.x[0])/4, j*(cell.hi.x[1]-cell.lo.x[1])/4, k*(cell.hi.x[2]-cell.lo.x[2])/4);
+			nomismatch += ctreep3d.contains_point(p) != (c == INSIDE);
+		}
+	}
+	cout << "adaptive octree: " << noleaves << " leaves (uniform: " << (1 << 18) << "), " << nomismatch << " mismatches" << endl;
+
+	// a scene of many overlapping circles, whose indexed queries must
+	// return the first circle in identifier order, as a walk over the
+	// map does
+	Scene<int, Primitive2D> scenen(-1);
+	for (auto i=0; i<500; i++) scenen.insert(i, Circle(Point<2>(-1.0+0.02*((37*i)%101), -1.0+0.02*((61*i)%101)), 0.05+0.0004*i));
+	const std::map<int, std::shared_ptr<Primitive2D>> & scenemap = scenen;
+	vector<int> sceneids(bx.size());
+	scenen.query_points(batch2d, &sceneids.front());
+	std::size_t nscenemismatch = 0;
+	for (auto i=0; i<bx.size(); i+=7){
+		int id = -1;
+		for (auto it=scenemap.begin(); it!=scenemap.end(); it++){
+			if (it->second->contains_point(batch2d.point(i))) {id = it->first; break;}
+		}
+		nscenemismatch += (scenen.query_point(batch2d.point(i)) != id) + (sceneids[i] != id);
+	}
+	cout << "indexed scene: " << scenen.size() << " objects, " << nscenemismatch << " mismatches" << endl;
+
+	// objects replaced through the map's accessors, or inserted from a
+	// braced pair, must be seen by the next query
+	Scene<int, Primitive2D> scener(-1);
+	std::shared_ptr<Primitive2D> rcirc = std::make_shared<Circle>(Circle({0,0}, 1));
+	scener.insert({1, rcirc});
+	cout << "replaced scene objects: " << scener.query_point(Point<2>(0,0));
+	scener.find(1)->second = std::make_shared<Circle>(Circle({5,5}, 1));
+	cout << " " << scener.query_point(Point<2>(0,0));
+	scener.at(1) = rcirc;
+	cout << " " << scener.query_point(Point<2>(0,0));
+	scener.rbegin()->second = std::make_shared<Circle>(Circle({5,5}, 1));
+	cout << " " << scener.query_point(Point<2>(0,0)) << endl;
+
+	// scan lines through a CSG tree and a rotated copy of it, in various
+	// directions, must give the samples that contains_point() accepts
+	auto rotp2d = rotation_transformation(ctreep2d, 0.3);
+	std::size_t nscan = 0, nscanmismatch = 0;
+	for (auto l=0; l<200; l++){
+		Point<2> a(-0.7, -0.7+0.007*l), step(0.0014, 0.0002*(l%5)-0.0004);
+		vector<Span> spans, rspans;
+		ctreep2d.scan_line(a, step, 0, 1000, spans);
+		rotp2d.scan_line(a, step, 0, 1000, rspans);
+		vector<char> in(1000, 0), rin(1000, 0);
+		for (auto & sp : spans) for (auto i=sp.begin; i<sp.end; i++) in[i] = 1;
+		for (auto & sp : rspans) for (auto i=sp.begin; i<sp.end; i++) rin[i] = 1;
+		for (auto i=0; i<1000; i++){
+			nscan += in[i];
+			nscanmismatch += (in[i] != ctreep2d.contains_point(scan_sample(a, step, i))) + (rin[i] != rotp2d.contains_point(scan_sample(a, step, i)));
+		}
+	}
+	cout << "scan lines: " << nscan << " samples inside, " << nscanmismatch << " mismatches" << endl;
+
+	// the same in 3D, through a tree, a geometry with a hole through it
+	// and an extrusion, none of which may take a run as uniform from its
+	// ends alone
+	Extrusion lext(Triangle({-0.6,-0.6}, {0.6,-0.6}, {0,0.6}), {0,0,-0.5}, {0,0,1}, {1,0,0}, 1.0);
+	std::size_t nscan3 = 0, nscan3mismatch = 0;
+	for (auto l=0; l<200; l++){
+		Point<3> a(-1.1, -0.7+0.007*l, 0.05*(l%7)-0.15), step(0.0022, 0.0001*(l%5), 0.0001*(l%3));
+		vector<Span> spans[3];
+		ctreep3d.scan_line(a, step, 0, 1000, spans[0]);
+		obj31.scan_line(a, step, 0, 1000, spans[1]);
+		lext.scan_line(a, step, 0, 1000, spans[2]);
+		for (auto g=0; g<3; g++){
+			vector<char> in(1000, 0);
+			for (auto & sp : spans[g]) for (auto i=sp.begin; i<sp.end; i++) in[i] = 1;
+			for (auto i=0; i<1000; i++){
+				Point<3> p = scan_sample(a, step, i);
+				bool c = (g == 0) ? ctreep3d.contains_point(p) : (g == 1) ? obj31.contains_point(p) : lext.contains_point(p);
+				nscan3 += in[i];
+				nscan3mismatch += in[i] != c;
+			}
+		}
+	}
+	cout << "3D scan lines: " << nscan3 << " samples inside, " << nscan3mismatch << " mismatches" << endl;
+
 
 
 	// LinearTransformation<Primitive2D, ShearMap> ellip = shear_transformation(Circle({0,0},1),Point<2>(0.5,0));
@@ -340,6 +782,301 @@ int main(int argc, char * argv[])
 	auto cgshear2 = shear_transformation(ctreep2d, Point<2>(0.5, 0));
 	cgshear2.print_summary();
 
+	// stacked transformations are fused into one affine map, which must
+	// agree with applying each map in turn
+	auto stack2 = translation_transformation(rotation_transformation(dilatation_transformation(cgshear2, Point<2>(0.2, -0.3)), 0.7), Point<2>(0.1, 0.4));
+	std::size_t naffmismatch = 0;
+	for (double x=-1.0; x<=1.0; x+=0.01){
+		for (double y=-1.0; y<=1.0; y+=0.01){
+			Point<2> p(x, y);
+			Point<2> q = ShearMap2D(Point<2>(0.5, 0)).inverse_map(DilatationMap2D(Point<2>(0.2, -0.3)).inverse_map(RotationMap2D(0.7).inverse_map(TranslationMap2D(Point<2>(0.1, 0.4)).inverse_map(p))));
+			naffmismatch += Point<2>::dist(stack2.mAffine.inverse_map(p), q) > 1.0e-12;
+			naffmismatch += Point<2>::dist(stack2.mAffine.forward_map(q), p) > 1.0e-12;
+			naffmismatch += stack2.contains_point(p) != ctreep2d.contains_point(q);
+		}
+	}
+	ShearMap3D shear3(Point<3>(0.3, -0.2, 0.1), Point<3>(0.2, 0.4, -0.5));
+	AffineMap3D aff3 = AffineMap3D::from_map(shear3);
+	for (double x=-1.0; x<=1.0; x+=0.1){
+		for (double y=-1.0; y<=1.0; y+=0.1){
+			for (double z=-1.0; z<=1.0; z+=0.1){
+				naffmismatch += Point<3>::dist(aff3.inverse_map(Point<3>(x, y, z)), shear3.inverse_map(Point<3>(x, y, z))) > 1.0e-12;
+			}
+		}
+	}
+	bool fused = dynamic_cast<const AffineChain<Primitive2D> *>(stack2.mBase.get()) == nullptr;
+	cout << "fused affine maps: " << (fused ? "one level" : "nested") << ", " << naffmismatch << " mismatches" << endl;
+
+	// transformed bounding boxes must hold every inside point, and for
+	// circles, rectangles and triangles they must also be tight
+	std::vector<std::shared_ptr<Primitive2D>> tprims = {
+		rotation_transformation(shear_transformation(Circle({0.2, 0.1}, 0.4), Point<2>(0.6, 0.2)), 0.5).copy(),
+		shear_transformation(rotation_transformation(Rectangle({-0.1, 0.2}, {0.8, 0.3}), 0.9), Point<2>(-0.3, 0.4)).copy(),
+		rotation_transformation(Triangle({-0.3, -0.2}, {0.4, 0.0}, {0.1, 0.5}), 2.0).copy(),
+		stack2.copy()};
+	std::size_t nboxmiss = 0, nboxloose = 0;
+	for (auto k=0; k<tprims.size(); k++){
+		Box<2> bb = tprims[k]->get_bounding_box();
+		Box<2> in(Point<2>(1.0e+9, 1.0e+9), Point<2>(-1.0e+9, -1.0e+9));
+		for (double x=-2.0; x<=2.0; x+=0.002){
+			for (double y=-2.0; y<=2.0; y+=0.002){
+				if (!tprims[k]->contains_point(Point<2>(x, y))) continue;
+				nboxmiss += !Box<2>::contains(bb, Point<2>(x, y));
+				in = Box<2>::bounding_box(in, Box<2>(Point<2>(x, y), Point<2>(x, y)));
+			}
+		}
+		if (k == 3) continue;
+		for (auto d=0; d<2; d++) nboxloose += (in.lo.x[d]-bb.lo.x[d] > 0.004) + (bb.hi.x[d]-in.hi.x[d] > 0.004);
+	}
+	cout << "transformed bounding boxes: " << nboxmiss << " points outside, " << nboxloose << " loose sides" << endl;
+
+	// trees with leaves held by value in a variant must give the same
+	// answers as trees of primitives behind the virtual interface
+	CSGTree<PrimitiveVariant2D> vtreep2d(PrimitiveVariant2D(Circle({0,0},0.5)));
+	vtreep2d.push_back(PrimitiveVariant2D(Rectangle({0,0},{0.1, 0.5})), DIFFERENCE);
+	vtreep2d.push_back(PrimitiveVariant2D(Circle({0,0}, 0.05)), DIFFERENCE);
+	CSGTree<PrimitiveVariant3D> vtreep3d(PrimitiveVariant3D(Sphere({0,0,0},0.5)));
+	vtreep3d.push_back(PrimitiveVariant3D(Cylinder({0,0,1},{0,0,1},{1,0,0},0.3,1.0)), XOR);
+	std::size_t nvarmismatch = 0;
+	for (double x=-1.0; x<=1.0; x+=0.01){
+		for (double y=-1.0; y<=1.0; y+=0.01){
+			Point<2> p(x, y);
+			nvarmismatch += vtreep2d.contains_point(p) != ctreep2d.contains_point(p);
+			nvarmismatch += std::abs(vtreep2d.signed_distance(p) - ctreep2d.signed_distance(p)) > 1.0e-12;
+		}
+	}
+	for (double x=-1.0; x<=1.0; x+=0.05){
+		for (double y=-1.0; y<=1.0; y+=0.05){
+			for (double z=-1.0; z<=1.0; z+=0.05){
+				Point<3> p(x, y, z);
+				nvarmismatch += vtreep3d.contains_point(p) != ctreep3d.contains_point(p);
+				nvarmismatch += std::abs(vtreep3d.signed_distance(p) - ctreep3d.signed_distance(p)) > 1.0e-12;
+			}
+		}
+	}
+	cout << "variant leaves: " << nvarmismatch << " mismatches" << endl;
+
+	// the cached frames: a quarter-open torus swept about a tilted axis
+	// against its closed form, and every inside point of a tilted solid
+	// within its cached box, before and after a translation
+	Point<3> tax = Point<3>(0, 0.6, 0.8), te1(1, 0, 0), te2 = cross(tax, te1);
+	Sweep tor(Circle({0,0},0.3), Point<3>(1,0,0), Point<3>(0,1,0), Point<3>(1,0,0), Line<3>(Point<3>(0,0,0), tax), 270.0);
+	Cylinder fcyl(Point<3>(0,0,-1), tax, te1, 0.8, 2.0);
+	RectangularPrism fprism(Point<3>(0,0,-1), tax, te1, Point<2>(1.5, 1.0), 2.0);
+	Pyramid fpyr(Rectangle({0,0},{1.5, 1.0}), Point<3>(0,0,-1), tax, te1, 2.0);
+	Extrusion fext(Circle({0,0},0.8), Point<3>(0,0,-1), tax, te1, 2.0);
+	std::vector<std::shared_ptr<Primitive3D>> fprims = {fcyl.copy(), fprism.copy(), fpyr.copy(), fext.copy(), tor.copy()};
+	fcyl.translate(Point<3>(0.3, -0.2, 0.1)); fprism.translate(Point<3>(0.3, -0.2, 0.1)); fpyr.translate(Point<3>(0.3, -0.2, 0.1));
+	fext.translate(Point<3>(0.3, -0.2, 0.1)); tor.translate(Point<3>(0.3, -0.2, 0.1));
+	std::vector<std::shared_ptr<Primitive3D>> fmoved = {fcyl.copy(), fprism.copy(), fpyr.copy(), fext.copy(), tor.copy()};
+	std::size_t nframemismatch = 0, nframeboxmiss = 0;
+	for (double x=-1.987; x<=2.0; x+=0.04){
+		for (double y=-1.991; y<=2.0; y+=0.04){
+			for (double z=-1.993; z<=2.0; z+=0.04){
+				Point<3> p(x, y, z);
+				double a = Point<3>::dot(p, tax), u = Point<3>::dot(p, te1), v = Point<3>::dot(p, te2);
+				double theta = atan2(v, u);
+				if (theta < 0) theta += 2*pi;
+				bool in = (sqrt(u*u + v*v) - 1.0)*(sqrt(u*u + v*v) - 1.0) + a*a <= 0.09 && theta <= 1.5*pi;
+				nframemismatch += fprims[4]->contains_point(p) != in;
+				nframemismatch += (fprims[4]->signed_distance(p) <= 0) != in;
+				for (auto & fp : fprims){
+					if (!fp->contains_point(p)) continue;
+					nframeboxmiss += !Box<3>::contains(fp->get_bounding_box(), p);
+				}
+			}
+		}
+	}
+	for (auto k=0; k<fprims.size(); k++){
+		for (double x=-1.987; x<=2.0; x+=0.08){
+			for (double y=-1.991; y<=2.0; y+=0.08){
+				for (double z=-1.993; z<=2.0; z+=0.08){
+					Point<3> p(x, y, z);
+					if (!fmoved[k]->contains_point(p)) continue;
+					nframeboxmiss += !Box<3>::contains(fmoved[k]->get_bounding_box(), p);
+					nframemismatch += !fprims[k]->contains_point(p - Point<3>(0.3, -0.2, 0.1));
+				}
+			}
+		}
+	}
+	cout << "cached 3D frames: " << nframemismatch << " mismatches, " << nframeboxmiss << " points outside boxes" << endl;
+
+	// the slab index of a polygon with many ragged edges must wind the
+	// same as a plain loop over the edges, also at the heights of the
+	// vertices, and must follow the polygon when it is translated
+	vector<LineSegment> rsegs;
+	vector<Point<2>> rverts(400);
+	for (auto i=0; i<400; i++) rverts[i] = (1.0 + 0.5*sin(0.37*i*i))*Point<2>(cos(2*pi*i/400), sin(2*pi*i/400));
+	for (auto i=0; i<400; i++) rsegs.push_back(LineSegment(rverts[i], rverts[(i+1)%400]));
+	Polygon rpoly(rsegs);
+	auto ref_winding = [&](const Point<2> & p){
+		int wn = 0;
+		for (auto & sg : rsegs){
+			if (sg.begin.x[1] <= p.x[1]){ if (sg.end.x[1] > p.x[1] && sg.isLeft(p) >= 0) wn++;}
+			else { if (sg.end.x[1] <= p.x[1] && sg.isLeft(p) < 0) wn--;}
+		}
+		return wn != 0;
+	};
+	std::vector<Point<2>> rpts;
+	for (double x=-1.6; x<=1.6; x+=0.013) for (double y=-1.6; y<=1.6; y+=0.013) rpts.push_back(Point<2>(x, y));
+	for (auto & v : rverts) for (double dx : {-0.01, 0.0, 0.01}) rpts.push_back(Point<2>(v.x[0]+dx, v.x[1]));
+	std::size_t npolymismatch = 0;
+	for (auto & p : rpts) npolymismatch += rpoly.contains_point(p) != ref_winding(p);
+	Polygon rmoved(rpoly);
+	rmoved.translate(Point<2>(0.25, -0.5));
+	for (auto & p : rpts){
+		npolymismatch += rmoved.contains_point(p + Point<2>(0.25, -0.5)) != ref_winding(p);
+		npolymismatch += rpoly.contains_point(p) != ref_winding(p);
+	}
+	cout << "prepared polygon: " << rpts.size() << " points, " << npolymismatch << " mismatches" << endl;
+
+	// adaptive outlines: every point of a curved boundary must lie within
+	// the tolerance of the outline, and every point of a tree's outline on
+	// the tree's boundary
+	double otol = 1.0e-3;
+	Circle ocirc({0.3, -0.2}, 1.0);
+	Ellipse oell({0.1, 0.2}, {4.0, 0.5});
+	auto oshear = shear_transformation(Ellipse({0, 0}, {1.0, 0.4}), Point<2>(0.5, 0));
+	double ostray = 0;
+	auto max_stray = [](const std::vector<Hull<2>> & hv, const std::vector<Point<2>> & bnd){
+		double m = 0;
+		for (auto & q : bnd){
+			double d = std::numeric_limits<double>::max();
+			for (auto & h : hv) for (auto i=0; i<h.points.size(); i++) d = std::min(d, segment_distance(q, h.points[i], h.points[(i+1)%h.points.size()]));
+			m = std::max(m, d);
+		}
+		return m;
+	};
+	std::vector<Point<2>> cbnd, ebnd, sbnd;
+	for (auto i=0; i<20000; i++){
+		double t = 2*pi*i/20000;
+		cbnd.push_back(Point<2>(0.3 + cos(t), -0.2 + sin(t)));
+		ebnd.push_back(Point<2>(0.1 + 2.0*cos(t), 0.2 + 0.25*sin(t)));
+		sbnd.push_back(ShearMap2D(Point<2>(0.5, 0)).forward_map(Point<2>(0.5*cos(t), 0.2*sin(t))));
+	}
+	auto cout_ = ocirc.get_adaptive_outline(otol), eout = oell.get_adaptive_outline(otol), sout = oshear.get_adaptive_outline(otol);
+	ostray = std::max(max_stray(cout_, cbnd), std::max(max_stray(eout, ebnd), max_stray(sout, sbnd)));
+	auto tout = ctreep2d.get_adaptive_outline(otol);
+	std::size_t ntpts = 0, noffbnd = 0;
+	for (auto & h : tout){
+		for (auto & q : h.points){
+			ntpts++;
+			noffbnd += fabs(ctreep2d.signed_distance(q)) > otol;
+		}
+	}
+	cout << "adaptive outlines: circle " << cout_[0].points.size() << " points, ellipse " << eout[0].points.size() << " points, stray " << (ostray <= otol ? "within" : "beyond") << " tolerance, tree " << ntpts << " points, " << noffbnd << " off the boundary" << endl;
+
+	// polygon booleans: overlapping squares of either orientation, and
+	// squares that share an edge, must come out with the right areas, and
+	// the rings of a tree's outline must wind around what the tree contains
+	auto ring_area = [](const std::vector<Hull<2>> & hv){
+		double a = 0;
+		for (auto & h : hv) for (auto i=0; i<h.points.size(); i++){
+			const Point<2> & p = h.points[i], & q = h.points[(i+1)%h.points.size()];
+			a += 0.5*(p.x[0]*q.x[1] - q.x[0]*p.x[1]);
+		}
+		return a;
+	};
+	std::vector<Hull<2>> sqa = {Hull<2>({{0,0}, {2,0}, {2,2}, {0,2}})};
+	std::vector<Hull<2>> sqb = {Hull<2>({{1,1}, {1,3}, {3,3}, {3,1}})};
+	std::vector<Hull<2>> sqc = {Hull<2>({{2,0}, {4,0}, {4,2}, {2,2}})};
+	cout << "polygon booleans: square areas " << ring_area(polygon_boolean(sqa, sqb, UNION)) << " " << ring_area(polygon_boolean(sqa, sqb, INTERSECT));
+	cout << " " << ring_area(polygon_boolean(sqa, sqb, DIFFERENCE)) << " " << ring_area(polygon_boolean(sqa, sqb, XOR));
+	auto sqac = polygon_boolean(sqa, sqc, UNION);
+	cout << ", shared edge " << sqac.size() << " ring of " << sqac[0].points.size() << " points";
+	auto bout = ctreep2d.get_outline(200);
+	std::size_t nbpts = 0, nbmismatch = 0;
+	for (double x=-0.6; x<=0.6; x+=0.0071) for (double y=-0.6; y<=0.6; y+=0.0071){
+		Point<2> p(x, y);
+		if (fabs(ctreep2d.signed_distance(p)) < 0.01) continue;
+		int wn = 0;
+		for (auto & h : bout) for (auto i=0; i<h.points.size(); i++){
+			LineSegment sg(h.points[i], h.points[(i+1)%h.points.size()]);
+			if (sg.begin.x[1] <= y){ if (sg.end.x[1] > y && sg.isLeft(p) >= 0) wn++;}
+			else { if (sg.end.x[1] <= y && sg.isLeft(p) < 0) wn--;}
+		}
+		nbpts++;
+		nbmismatch += (wn != 0) != ctreep2d.contains_point(p);
+	}
+	cout << ", tree " << bout.size() << " rings, area " << ring_area(bout) << ", " << nbmismatch << "/" << nbpts << " mismatches" << endl;
+
+	// near-degenerate polygon booleans: edges along a shared line crossed by
+	// another, and triangles whose corners miss edges by rounding, must keep
+	// union + intersection = both, and the difference and xor areas in line
+	std::vector<std::pair<std::vector<Hull<2>>, std::vector<Hull<2>>>> degen = {
+		{{Hull<2>({{0.2,0.3}, {0.9,0.3}, {0.9,0.7}, {0.2,0.7}}), Hull<2>({{0.2,0.3}, {1,0.3}, {1,0.5}, {0.2,0.5}})},
+		 {Hull<2>({{0.5,0}, {0.25,0.6}, {0.9,0.1}})}},
+		{{Hull<2>({{0.1*3,0.1*8}, {0.5,0.1*2}, {0.1,0.1*6}})},
+		 {Hull<2>({{0.1*7,0.1*7}, {0.1*4,0.5}, {0,0.1*6}})}}
+	};
+	std::size_t ndmismatch = 0;
+	for (auto & dg : degen){
+		double da = ring_area(polygon_boolean(dg.first, std::vector<Hull<2>>(), UNION));
+		double db = ring_area(polygon_boolean(dg.second, std::vector<Hull<2>>(), UNION));
+		double du = ring_area(polygon_boolean(dg.first, dg.second, UNION));
+		double di = ring_area(polygon_boolean(dg.first, dg.second, INTERSECT));
+		double dd = ring_area(polygon_boolean(dg.first, dg.second, DIFFERENCE));
+		double dx = ring_area(polygon_boolean(dg.first, dg.second, XOR));
+		ndmismatch += fabs(du + di - da - db) > 1.0e-9;
+		ndmismatch += fabs(dd - da + di) > 1.0e-9;
+		ndmismatch += fabs(dx - du + di) > 1.0e-9;
+	}
+	cout << "polygon booleans: near-degenerate " << ndmismatch << "/" << 3*degen.size() << " mismatches" << endl;
+
+	// random rings on a skewed lattice whose rows are a rounding error
+	// apart: the winding of every result, at points clear of the edges,
+	// must come out as the operation on the windings of the operands
+	auto ring_winding = [](const std::vector<Hull<2>> & hv, const Point<2> & p){
+		int wn = 0;
+		for (auto & h : hv) for (auto i=0; i<h.points.size(); i++){
+			LineSegment sg(h.points[i], h.points[(i+1)%h.points.size()]);
+			if (sg.begin.x[1] <= p.x[1]){ if (sg.end.x[1] > p.x[1] && sg.isLeft(p) >= 0) wn++;}
+			else { if (sg.end.x[1] <= p.x[1] && sg.isLeft(p) < 0) wn--;}
+		}
+		return wn;
+	};
+	auto ring_distance = [](const std::vector<Hull<2>> & hv, const Point<2> & p){
+		double d = std::numeric_limits<double>::max();
+		for (auto & h : hv) for (auto i=0; i<h.points.size(); i++) d = std::min(d, segment_distance(p, h.points[i], h.points[(i+1)%h.points.size()]));
+		return d;
+	};
+	RandomHash rh;
+	Ullong rseed = 0;
+	std::size_t nrsamples = 0, nrmismatch = 0, nrfailed = 0;
+	for (auto t=0; t<400; t++){
+		std::vector<Hull<2>> rops[2];
+		for (auto & ro : rops){
+			for (Uint r=0, nr=1+rh.int32(rseed++)%2; r<nr; r++){
+				Hull<2> h;
+				for (Uint v=0, nv=3+rh.int32(rseed++)%4; v<nv; v++){
+					Uint i = rh.int32(rseed++)%5, j = rh.int32(rseed++)%5, k = rh.int32(rseed++)%5;
+					h.points.push_back(Point<2>(cos(0.3)*i + 0.1*j, 0.7*k + 1.0e-9*(2*rh.doub(rseed++) - 1)));
+				}
+				ro.push_back(h);
+			}
+		}
+		for (auto op : {UNION, INTERSECT, DIFFERENCE, XOR}){
+			std::vector<Hull<2>> rres;
+			try {rres = polygon_boolean(rops[0], rops[1], op);}
+			catch (const char *) {nrfailed++; continue;}
+			for (auto s=0; s<100; s++){
+				double px = -0.1 + 4.3*rh.doub(rseed++), py = -0.1 + 3.0*rh.doub(rseed++);
+				Point<2> p(px, py);
+				if (std::min(std::min(ring_distance(rops[0], p), ring_distance(rops[1], p)), ring_distance(rres, p)) < 1.0e-6) continue;
+				bool l = ring_winding(rops[0], p) != 0, r = ring_winding(rops[1], p) != 0, in = false;
+				switch (op){
+					case UNION:			in = l || r; break;
+					case INTERSECT:		in = l && r; break;
+					case DIFFERENCE:	in = l && !r; break;
+					case XOR:			in = l != r; break;
+				}
+				nrsamples++;
+				nrmismatch += (ring_winding(rres, p) != 0) != in;
+			}
+		}
+	}
+	cout << "polygon booleans: random near-degenerate " << nrsamples << " samples, " << nrmismatch << " mismatches, " << nrfailed << " failed" << endl;
+
 	auto cgshear3 = shear_transformation(ctreep3d, Point<3>(0.5, 0, 0));
 	cgshear3.print_summary();
 
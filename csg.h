@@ -3,17 +3,23 @@
 
 #include "include/Point.hpp"
 #include "include/GeomUtils.hpp"
+#include "include/Predicates.hpp"
 #include "include/PrimitiveTypes.hpp"
 #include "include/Primitive2D.hpp"
 #include "include/Primitive3D.hpp"
+#include "include/PrimitiveVariant.hpp"
 #include "include/PrimitiveIO.hpp"
 #include "include/CSGeometry2D.hpp"
 #include "include/CSGeometry3D.hpp"
 #include "include/Delaunay.hpp"
+#include "include/PolygonBoolean.hpp"
+#include "include/TriangulationLocator.hpp"
+#include "include/Delaunay3D.hpp"
 #include "include/Orthtree.hpp"
 #include "include/Quadtree.hpp"
 #include "include/Octree.hpp"
 #include "include/CSGTree.hpp"
+#include "include/CSGProgram.hpp"
 #include "include/LinearTransformation.hpp"
 #include "include/SymmetryTransformation.hpp"
 #include "include/Scene.hpp"
@@ -0,0 +1,368 @@
+#ifndef _CSGPROGRAM_H
+#define _CSGPROGRAM_H
+
+#include <memory>
+#include "GeomUtils.hpp"
+#include "PrimitiveTypes.hpp"
+#include "Primitive2D.hpp"
+#include "Primitive3D.hpp"
+#include "CSGTree.hpp"
+
+namespace csg{
+
+
+// A CSGTree compiled into a flat postfix program for point classification
+//
+// The program runs on a bool accumulator that holds the latest result, and
+// a small stack of pending left operands. Each leaf is one instruction that
+// either pushes the accumulator and replaces it (for left operands), or
+// combines its result into it with the CSG operation of its parent (for
+// right operands), so trees built with push_back need no stack at all.
+// Circles, spheres, rectangles and triangles are evaluated inline from
+// parameters packed in one contiguous array, and consecutive leaves of the
+// same kind combined by the same operation form a single run instruction.
+// Any other leaf is called through its virtual interface. Every leaf is
+// guarded by its bounding box.
+//
+// Like the recursive evaluator, the right operand of a UNION is skipped
+// when the left is already true (and of an INTERSECT or DIFFERENCE when
+// it is false), and a right subtree whose box excludes the point yields
+// false without being run. So results are identical to
+// CSGTree::contains_point().
+//
+// The program holds its own copies of the parameters and shares ownership
+// of the generic leaves, so it has to be recompiled if the tree changes.
+template <std::size_t dim>
+class CSGProgram
+{
+public:
+	typedef PrimitiveGeometry<dim> 		LeafT;
+	typedef CSGTree<LeafT> 				TreeT;
+	typedef Box<dim> 					BoxT;
+
+	CSGProgram() : m_depth(0), m_label(0) {};
+
+	CSGProgram(const TreeT & tree)
+	: m_depth(0), m_label(0), m_bbox(tree.m_bbox) {
+		Uint depth = 0;
+		if (!(tree.m_isleaf && tree.m_leaf == nullptr)) emit(tree, false, PUSH, depth);
+		thread_jumps();
+	}
+
+	BoxT get_bounding_box() const {return m_bbox;};
+
+	// number of instructions
+	std::size_t size() const {return m_code.size();};
+
+	bool contains_point(const Point<dim> & pt) const{
+		if (m_code.empty() || !BoxT::contains(m_bbox, pt)) return false;
+
+		// pending left operands, on the heap only for unusually right-deep trees
+		char local[64];
+		std::vector<char> heap;
+		char * st = local;
+		if (m_depth > 64){
+			heap.resize(m_depth);
+			st = heap.data();
+		}
+
+		const Instruction * code = m_code.data();
+		const double * prm = m_params.data();
+		int sp = -1;
+		bool acc = false;
+		for (std::size_t pc=0, n=m_code.size(); pc<n; pc++){
+			const Instruction & in = code[pc];
+			const double * p = prm + in.param;
+			if (in.mode == PUSH) st[++sp] = acc;
+			switch (in.op){
+				case BALL:
+					acc = run<leaf_ball>(in, p, pt, acc);
+					break;
+				case RECTANGLE:
+					acc = run<leaf_rectangle>(in, p, pt, acc);
+					break;
+				case TRIANGLE:
+					acc = run<leaf_triangle>(in, p, pt, acc);
+					break;
+				case CALL:
+					if (in.mode == PUSH) acc = leaf_call(in, p, pt);
+					else if (!short_circuit(in.mode, acc)) acc = combine(in.mode, acc, leaf_call(in, p, pt));
+					break;
+				case COMBINE:
+					acc = combine(in.mode, st[sp--], acc);
+					break;
+				case SKIP:
+					if (!in_box(p, pt)){
+						st[++sp] = acc;
+						acc = false;
+						pc = in.arg-1;
+					}
+					break;
+				case JUMP_IF_TRUE:
+					if (acc) pc = in.arg-1;
+					break;
+				case JUMP_IF_FALSE:
+					if (!acc) pc = in.arg-1;
+					break;
+			}
+		}
+		return acc;
+	}
+
+private:
+
+	enum Opcode {BALL, RECTANGLE, TRIANGLE, CALL, COMBINE, SKIP, JUMP_IF_TRUE, JUMP_IF_FALSE};
+
+	// the mode of an instruction that produces a result is the Operation
+	// that combines it into the accumulator, or PUSH. Jumps have no mode
+	static const Uint PUSH = XOR+1;
+	static const Uint NONE = XOR+2;
+
+	// param is the offset into m_params. arg is the number of leaves for
+	// the inline kernels, the jump target for SKIP and the jumps, and the
+	// index into m_calls for CALL
+	struct Instruction{
+		Uint op, mode, param, arg;
+	};
+
+	std::vector<Instruction> 				m_code;
+	std::vector<double> 					m_params;
+	std::vector<std::shared_ptr<LeafT>> 	m_calls;
+	Uint 									m_depth;	// maximum stack depth
+	Uint 									m_label;	// latest jump target
+	BoxT 									m_bbox;
+
+
+	// true if the right operand can't change the accumulator
+	static bool short_circuit(Uint mode, bool acc){
+		return (mode == UNION && acc) || ((mode == INTERSECT || mode == DIFFERENCE) && !acc);
+	}
+
+	static bool combine(Uint mode, bool left, bool right){
+		switch (mode){
+			case UNION: 		return left || right;
+			case INTERSECT: 	return left && right;
+			case DIFFERENCE: 	return left && !right;
+			default: 			return left != right;
+		}
+	}
+
+	// evaluate a run of leaves that share a kernel and a mode. Their
+	// records are consecutive in m_params and start with the leaf box
+	template <bool (*kernel)(const double *, const Point<dim> &)>
+	static bool run(const Instruction & in, const double * p, const Point<dim> & pt, bool acc){
+		const Uint stride = record_size(in.op);
+		const double * end = p + in.arg*stride;
+		switch (in.mode){
+			case PUSH:
+				return kernel(p, pt);
+			case UNION:
+				for (; p<end && !acc; p+=stride) acc = kernel(p, pt);
+				return acc;
+			case INTERSECT:
+				for (; p<end && acc; p+=stride) acc = kernel(p, pt);
+				return acc;
+			case DIFFERENCE:
+				for (; p<end && acc; p+=stride) acc = !kernel(p, pt);
+				return acc;
+			default:
+				for (; p<end; p+=stride) acc = acc != kernel(p, pt);
+				return acc;
+		}
+	}
+
+	// number of parameters per leaf
+	static Uint record_size(Uint op){
+		switch (op){
+			case BALL: 		return 3*dim+1;
+			case RECTANGLE: return 2*dim+6;
+			case TRIANGLE: 	return 2*dim+6;
+			default: 		return 2*dim;
+		}
+	}
+
+	static bool leaf_ball(const double * p, const Point<dim> & pt){
+		return in_box(p, pt) && in_ball(p+2*dim, pt);
+	}
+
+	static bool leaf_rectangle(const double * p, const Point<dim> & pt){
+		return in_box(p, pt) && in_rectangle(p+2*dim, pt);
+	}
+
+	static bool leaf_triangle(const double * p, const Point<dim> & pt){
+		return in_box(p, pt) && in_triangle(p+2*dim, pt);
+	}
+
+	bool leaf_call(const Instruction & in, const double * p, const Point<dim> & pt) const{
+		return in_box(p, pt) && m_calls[in.arg]->contains_point(pt);
+	}
+
+	static bool in_box(const double * b, const Point<dim> & pt){
+		for (auto i=0; i<dim; i++){
+			if (pt.x[i] < b[i] || pt.x[i] > b[dim+i]) return false;
+		}
+		return true;
+	}
+
+	// these repeat the arithmetic of the primitives' contains_point()
+	// exactly, so that the results are bitwise the same
+
+	// center, squared radius
+	static bool in_ball(const double * p, const Point<dim> & pt){
+		double dsq = 0.0;
+		for (auto i=0; i<dim; i++) dsq += (pt.x[i]-p[i])*(pt.x[i]-p[i]);
+		return dsq <= p[dim];
+	}
+
+	// center, cos and sin of the rotation, half lengths
+	static bool in_rectangle(const double * p, const Point<dim> & pt){
+		double x0 = pt.x[0]-p[0], x1 = pt.x[1]-p[1];
+		double r[2] = {p[2]*x0+p[3]*x1, -p[3]*x0+p[2]*x1};
+		double dsq = 0.0;
+		for (auto i=0; i<2; i++){
+			if (r[i] < -p[4+i]) dsq += (r[i] + p[4+i])*(r[i] + p[4+i]);
+			if (r[i] > p[4+i]) dsq += (r[i] - p[4+i])*(r[i] - p[4+i]);
+		}
+		return dsq < 1.0e-16;
+	}
+
+	// three vertices, by winding number
+	static bool in_triangle(const double * p, const Point<dim> & pt){
+		int wn = 0;
+		for (auto k=0; k<3; k++){
+			const double * a = p+2*k;
+			const double * b = p+2*((k+1)%3);
+			double left = (b[0]-a[0])*(pt.x[1]-a[1]) - (pt.x[0]-a[0])*(b[1]-a[1]);
+			if (a[1] <= pt.x[1]){
+				if (b[1] > pt.x[1] && left >= 0) wn++;
+			}
+			else {
+				if (b[1] <= pt.x[1] && left < 0) wn--;
+			}
+		}
+		return wn != 0;
+	}
+
+
+	Uint emit_instruction(Uint op, Uint mode=PUSH){
+		m_code.push_back(Instruction{op, mode, Uint(m_params.size()), 0});
+		return m_code.size()-1;
+	}
+
+	void emit_box(const BoxT & bx){
+		for (auto i=0; i<dim; i++) m_params.push_back(bx.lo.x[i]);
+		for (auto i=0; i<dim; i++) m_params.push_back(bx.hi.x[i]);
+	}
+
+	// a leaf that holds a whole tree is compiled inline
+	static const TreeT & resolve(const TreeT & node){
+		const TreeT * n = &node;
+		while (n->m_isleaf){
+			const TreeT * sub = dynamic_cast<const TreeT *>(n->m_leaf.get());
+			if (sub == nullptr) break;
+			n = sub;
+		}
+		return *n;
+	}
+
+	// append the code for a tree node. Only leaves are combined into the
+	// accumulator directly; other subtrees push it and are combined at the
+	// end. Subtrees that are not on the left spine are guarded by their box,
+	// since their box is usually much smaller than that of their parent.
+	void emit(const TreeT & tree, bool guard, Uint mode, Uint & depth){
+		const TreeT & node = resolve(tree);
+		if (node.m_isleaf){
+			emit_leaf(node.m_leaf, node.m_bbox, mode);
+			if (mode == PUSH) m_depth = std::max(m_depth, ++depth);
+			return;
+		}
+		if (mode != PUSH){
+			emit(node, guard, PUSH, depth);
+			emit_instruction(COMBINE, mode);
+			depth--;
+			return;
+		}
+
+		Uint skip = 0;
+		if (guard){
+			skip = emit_instruction(SKIP, NONE);
+			emit_box(node.m_bbox);
+		}
+
+		emit(*node.m_ldaughter, false, PUSH, depth);
+		if (resolve(*node.m_rdaughter).m_isleaf || node.m_op == XOR){
+			emit(*node.m_rdaughter, true, node.m_op, depth);
+		}
+		else {
+			Uint jump = emit_instruction(node.m_op == UNION ? JUMP_IF_TRUE : JUMP_IF_FALSE, NONE);
+			emit(*node.m_rdaughter, true, node.m_op, depth);
+			m_code[jump].arg = m_label = m_code.size();
+		}
+
+		if (guard) m_code[skip].arg = m_label = m_code.size();
+	}
+
+	// a leaf joins the previous instruction if that is a run of the same
+	// kind with the same mode, and nothing jumps in between them
+	void emit_leaf(const std::shared_ptr<LeafT> & leaf, const BoxT & bx, Uint mode){
+		std::vector<double> packed;
+		Uint op = pack_leaf(leaf.get(), packed);
+		if (op != CALL && mode != PUSH && !m_code.empty() && m_label != m_code.size()
+			&& m_code.back().op == op && m_code.back().mode == mode){
+			m_code.back().arg++;
+		}
+		else if (op == CALL){
+			Uint pc = emit_instruction(op, mode);
+			m_code[pc].arg = m_calls.size();
+			m_calls.push_back(leaf);
+		}
+		else {
+			Uint pc = emit_instruction(op, mode);
+			m_code[pc].arg = 1;
+		}
+		emit_box(bx);
+		m_params.insert(m_params.end(), packed.begin(), packed.end());
+	}
+
+	// pack the parameters of the leaf and return its opcode
+	Uint pack_leaf(const Primitive2D * leaf, std::vector<double> & packed){
+		if (auto c = dynamic_cast<const Circle *>(leaf)){
+			packed = {c->center().x[0], c->center().x[1], c->radius()*c->radius()};
+			return BALL;
+		}
+		if (auto r = dynamic_cast<const Rectangle *>(leaf)){
+			packed = {r->center().x[0], r->center().x[1], cos(r->rotation()), sin(r->rotation()),
+						r->dims().x[0]/2, r->dims().x[1]/2};
+			return RECTANGLE;
+		}
+		if (auto t = dynamic_cast<const Triangle *>(leaf)){
+			for (auto k=0; k<3; k++){
+				packed.push_back(t->vertex(k).x[0]);
+				packed.push_back(t->vertex(k).x[1]);
+			}
+			return TRIANGLE;
+		}
+		return CALL;
+	}
+
+	Uint pack_leaf(const Primitive3D * leaf, std::vector<double> & packed){
+		if (auto s = dynamic_cast<const Sphere *>(leaf)){
+			packed = {s->center().x[0], s->center().x[1], s->center().x[2], s->radius()*s->radius()};
+			return BALL;
+		}
+		return CALL;
+	}
+
+	// a jump that lands on a jump taken under the same condition can go
+	// straight to its target
+	void thread_jumps(){
+		for (auto pc=m_code.size(); pc-- > 0;){
+			Instruction & in = m_code[pc];
+			if (in.op != JUMP_IF_TRUE && in.op != JUMP_IF_FALSE) continue;
+			if (in.arg < m_code.size() && m_code[in.arg].op == in.op) in.arg = m_code[in.arg].arg;
+		}
+	}
+};
+
+}
+#endif
@@ -4,36 +4,46 @@
 #include <memory>
 #include "GeomUtils.hpp"
 #include "Delaunay.hpp"
+#include "PolygonBoolean.hpp"
 
 namespace csg{
 
+template <std::size_t dim> class CSGProgram;
+
 template <class PrimitiveType>
 class CSGTree : public PrimitiveType
 {
+	// compiles the tree into a flat program
+	template <std::size_t dim> friend class CSGProgram;
+
+	// rebuilds the tree in rebalance()
+	friend struct TreeBalancer<CSGTree>;
+
 public:
 	typedef PrimitiveType				LeafT;
+	typedef typename BoxTypedef<PrimitiveType>::type 	BoxT;
 
 
-	CSGTree() : m_isleaf(true), m_leaf(nullptr) {};
+	CSGTree() : m_isleaf(true), m_leaf(nullptr), m_bbox(BoxT::empty()) {};
 
 	CSGTree(std::shared_ptr<LeafT> leaf)
-	: m_isleaf(true), m_leaf(leaf) {};
+	: m_isleaf(true), m_leaf(leaf) {update_bounding_box();};
 
 	CSGTree(std::shared_ptr<CSGTree> left, std::shared_ptr<CSGTree> right, Operation op)
 	: m_isleaf(false), m_leaf(nullptr)
-	, m_ldaughter(left), m_rdaughter(right), m_op(op) {};
+	, m_ldaughter(left), m_rdaughter(right), m_op(op) {update_bounding_box();};
 
 	CSGTree(std::shared_ptr<LeafT> left, std::shared_ptr<CSGTree> right, Operation op)
 	: m_isleaf(false), m_leaf(nullptr)
-	, m_ldaughter(std::shared_ptr<CSGTree>(new CSGTree(left))), m_rdaughter(right), m_op(op) {};
+	, m_ldaughter(std::shared_ptr<CSGTree>(new CSGTree(left))), m_rdaughter(right), m_op(op) {update_bounding_box();};
 
 	CSGTree(std::shared_ptr<CSGTree> left, std::shared_ptr<LeafT> right, Operation op)
 	: m_isleaf(false), m_leaf(nullptr)
-	, m_ldaughter(left), m_rdaughter(std::shared_ptr<CSGTree>(new CSGTree(right))), m_op(op) {};
+	, m_ldaughter(left), m_rdaughter(std::shared_ptr<CSGTree>(new CSGTree(right))), m_op(op) {update_bounding_box();};
 
 	CSGTree(std::shared_ptr<LeafT> left, std::shared_ptr<LeafT> right, Operation op)
 	: m_isleaf(false), m_leaf(nullptr)
-	, m_ldaughter(std::shared_ptr<CSGTree>(new CSGTree(left))), m_rdaughter(std::shared_ptr<CSGTree>(new CSGTree(right))), m_op(op) {};
+	, m_ldaughter(std::shared_ptr<CSGTree>(new CSGTree(left))), m_rdaughter(std::shared_ptr<CSGTree>(new CSGTree(right))), m_op(op) {update_bounding_box();};
 
 	// std::shared_ptr<CSGTree> copy() const {return std::make_shared<CSGTree>(*this);};
 
@@ -44,14 +54,20 @@ public:
 			m_leaf 		= obj;
 		}
 		else {
-			// auto cp = this->copy();
-			m_ldaughter = std::make_shared<CSGTree>(*this);//this->copy();//std::shared_ptr<CSGTree>(new CSGTree(*this));
+			// the current root is moved into the left daughter, not copied
+			m_ldaughter = std::make_shared<CSGTree>(std::move(*this));
 			m_rdaughter = std::make_shared<CSGTree>(obj);
 			m_op 		= op;
 			m_isleaf 	= false;
 			m_leaf 		= nullptr;
 		}
-		
+		update_bounding_box();
+	}
+
+	// rebuild the chains made by push_back as balanced trees, see TreeBalancer
+	void rebalance(){
+		if (m_isleaf) return;
+		*this = *TreeBalancer<CSGTree>::balanced(std::make_shared<CSGTree>(*this));
 	}
 
 
@@ -60,192 +76,267 @@ public:
 
 	// convenience constructors
 	CSGTree(const LeafT & leaf)
-	: m_isleaf(true), m_leaf(leaf.copy()) {};
+	: m_isleaf(true), m_leaf(leaf.copy()) {update_bounding_box();};
 
 	// convenience construction function
 	void push_back(const LeafT & leaf, Operation op){push_back(leaf.copy(),op);};
 
 	std::shared_ptr<PrimitiveType> copy() const {return std::make_shared<CSGTree>(*this);};
 
-	// returns a bounding box
-	// - only compiles if the LeafT has a function "get_bounding_box()"
-	typename BoxTypedef<PrimitiveType>::type get_bounding_box() const{
-		if (m_isleaf) return m_leaf->get_bounding_box();
-		return bounding_box(m_ldaughter->get_bounding_box(), m_rdaughter->get_bounding_box());
+	// returns a bounding box, cached when the tree is built. Leaves
+	// changed in place through their pointers need update_bounding_boxes()
+	BoxT get_bounding_box() const {return m_bbox;};
+
+	// recompute the cached bounding boxes of the whole tree
+	void update_bounding_boxes(){
+		if (!m_isleaf){
+			m_ldaughter->update_bounding_boxes();
+			m_rdaughter->update_bounding_boxes();
+		}
+		update_bounding_box();
 	}
 
 
-	// returns a Hull that outlines the object (2D Feature ONLY)
+	// returns the rings that outline the object (2D Feature ONLY), the
+	// daughters' outlines combined by a polygon boolean operation
 	// - only compiles if the LeafT has a function "get_outline(int numpoints)"
 	std::vector<Hull<2>> get_outline(unsigned int npts) const {
 		if (m_isleaf) return m_leaf->get_outline(npts);
 
 		std::vector<Hull<2>> oleft = m_ldaughter->get_outline(npts);
 		std::vector<Hull<2>> oright = m_rdaughter->get_outline(npts);
-		
+		return polygon_boolean(oleft, oright, m_op);
+	}
 
-		switch (m_op){
-			case UNION:
-				for (auto j=0; j<oleft.size(); j++){
-					bool state0 = m_rdaughter->contains_point(*(--oleft[j].points.end()));
-					for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-						if (m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-						else it++;
-					}
-				}
-
-				for (auto j=0; j<oright.size(); j++){
-					for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-						if (m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-						else it++;
-					}
-				}
-				break;
-			case INTERSECT:
-				for (auto j=0; j<oleft.size(); j++){
-					for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-						if (!m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-						else it++;
-					}
-				}
-
-				for (auto j=0; j<oright.size(); j++){
-					for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-						if (!m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-						else it++;
-					}
-				}
-				break;
-			case DIFFERENCE:
-				for (auto j=0; j<oleft.size(); j++){
-					for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-						if (m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-						else it++;
-					}
-				}
-
-				for (auto j=0; j<oright.size(); j++){
-					for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-						if (!m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-						else it++;
-					}
-				}
-				break;
-			case XOR:
-				// no culling necessary for XOR
-				// for (auto j=0; j<oleft.size(); j++){
-				// 	for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-				// 		if (m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-				// 		else it++;
-				// 	}
-				// }
-
-				// for (auto j=0; j<oright.size(); j++){
-				// 	for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-				// 		if (!m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-				// 		else it++;
-				// 	}
-				// }
-				break;
-		}
-		oleft.insert(oleft.end(), oright.begin(), oright.end());
-		return oleft;
+	// an outline whose chords stray at most tol from the boundary. The
+	// daughters' outlines are joined where their chords cross
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		if (m_isleaf) return m_leaf->get_adaptive_outline(tol);
+
+		std::vector<Hull<2>> oleft = m_ldaughter->get_adaptive_outline(tol);
+		std::vector<Hull<2>> oright = m_rdaughter->get_adaptive_outline(tol);
+		return polygon_boolean(oleft, oright, m_op);
 	}
 
 
 	// detects if the CSGTree contains the given point
 	// - only compiles if the LeafT has a function "contains_point(Point)"
+	// - trees built with push_back are left-deep, so the left spine is
+	//   walked in a loop and only right daughters are recursed into.
+	//   Subtrees whose bounding box excludes the point are skipped, and a
+	//   right daughter is only evaluated if it can change the result
 	template <typename PointType>
 	bool contains_point_impl(const PointType & pt) const{
 		if (m_isleaf) return m_leaf->contains_point(pt);
 
-		bool lc = m_ldaughter->contains_point(pt);
-		bool rc = m_rdaughter->contains_point(pt);
+		// go down the left spine until a leaf or a box that excludes the point
+		static thread_local std::vector<const CSGTree *> spine;
+		std::size_t base = spine.size();
+		const CSGTree * n = this;
+		bool in = false;
+		while (true){
+			spine.push_back(n);
+			n = n->m_ldaughter.get();
+			if (!BoxT::contains(n->m_bbox, pt)) break;
+			if (n->m_isleaf) {in = n->m_leaf->contains_point(pt); break;}
+		}
 
-		switch (m_op){
-			case UNION:
-				return lc || rc;
-				break;
-			case INTERSECT:
-				return lc && rc;
-				break;
-			case DIFFERENCE:
-				return lc && !rc;
-				break;
-			case XOR:
-				return (lc || rc) && !(lc && rc);
-				break;
+		// combine with the right daughters on the way back up
+		for (auto i=spine.size(); i-- > base;){
+			const CSGTree * s = spine[i];
+			switch (s->m_op){
+				case UNION:
+					in = in || daughter_contains(s->m_rdaughter, pt);
+					break;
+				case INTERSECT:
+					in = in && daughter_contains(s->m_rdaughter, pt);
+					break;
+				case DIFFERENCE:
+					in = in && !daughter_contains(s->m_rdaughter, pt);
+					break;
+				case XOR:
+					in = in != daughter_contains(s->m_rdaughter, pt);
+					break;
+			}
+		}
+		spine.resize(base);
+		return in;
+	}
+
+	bool contains_point(const Point<2> & pt) const {return BoxT::contains(m_bbox, pt) && contains_point_impl(pt);};
+	bool contains_point(const Point<3> & pt) const {return BoxT::contains(m_bbox, pt) && contains_point_impl(pt);};
+
+	// classifies a batch of points into a bitmask
+	// - only compiles if the LeafT has a function "contains_points(PointBatch, Ullong *)"
+	// - the daughters' masks are combined with bitwise operations, and the
+	//   right daughter is skipped if the left mask leaves nothing for it to change
+	// - leaves are only evaluated on runs of points inside their bounding box,
+	//   using the bounds of each word of the batch
+	template <typename BatchType>
+	void contains_points_impl(const BatchType & batch, Ullong * mask) const{
+		if (batch.bounds == nullptr){
+			auto bounds = word_bounds(batch);
+			BatchType bounded = batch;
+			bounded.bounds = bounds.data();
+			contains_points_impl(bounded, mask);
+			return;
+		}
+		if (m_isleaf){
+			classify_in_box(m_leaf, m_bbox, batch, mask);
+			return;
 		}
+
+		std::size_t nw = batch.nwords();
+		m_ldaughter->contains_points(batch, mask);
+		if (m_op != UNION && m_op != XOR && mask_empty(mask, nw)) return;
+
+		std::vector<Ullong> right(nw);
+		m_rdaughter->contains_points(batch, right.data());
+		combine_masks(mask, right.data(), nw, m_op);
 	}
 
-	bool contains_point(const Point<2> & pt) const {return contains_point_impl(pt);};
-	bool contains_point(const Point<3> & pt) const {return contains_point_impl(pt);};
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const {contains_points_impl(batch, mask);};
+	void contains_points(const PointBatch<3> & batch, Ullong * mask) const {contains_points_impl(batch, mask);};
 
-	// detects if the CSGTree contains the given box
+	// the samples of a scan line that the tree contains, as sorted spans
+	// - only compiles if the LeafT has a function "scan_line(Point, Point, size_t, size_t, vector<Span>)"
+	// - each node narrows the line to its bounding box, and the spans of
+	//   the daughters are combined with combine_spans(). For intersections
+	//   and differences the right daughter only sees the extent of the left
+	template <typename PointType>
+	void scan_line_impl(const PointType & a, const PointType & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_range(m_bbox, a, step, i0, i1);
+		if (i0 >= i1) return;
+		if (m_isleaf){
+			m_leaf->scan_line(a, step, i0, i1, spans);
+			return;
+		}
+
+		std::vector<Span> left, right;
+		m_ldaughter->scan_line_impl(a, step, i0, i1, left);
+		if (m_op == INTERSECT || m_op == DIFFERENCE){
+			if (left.empty()) return;
+			i0 = left.front().begin;
+			i1 = left.back().end;
+		}
+		m_rdaughter->scan_line_impl(a, step, i0, i1, right);
+		combine_spans(left, right, m_op, spans);
+	}
+
+	void scan_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const {scan_line_impl(a, step, i0, i1, spans);};
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const {scan_line_impl(a, step, i0, i1, spans);};
+
+	// signed distance to the boundary, negative inside
+	// - only compiles if the LeafT has a function "signed_distance(Point)"
+	// - daughters are combined with combine_distances(), so the result is
+	//   conservative if the leaves are
+	// - the right daughter is skipped where it cannot change the result
+	template <typename PointType>
+	double signed_distance_impl(const PointType & pt) const{
+		if (m_isleaf) return m_leaf->signed_distance(pt);
+		double a = m_ldaughter->signed_distance_impl(pt);
+		double bd = BoxT::dist(m_rdaughter->m_bbox, pt);
+		if (!right_matters(a, bd, m_op)) return a;
+		return combine_distances(a, right_distance(m_rdaughter->signed_distance_impl(pt), bd), m_op);
+	}
+
+	double signed_distance(const Point<2> & pt) const {return signed_distance_impl(pt);};
+	double signed_distance(const Point<3> & pt) const {return signed_distance_impl(pt);};
+
+	// signed distances of a batch of points
+	// - only compiles if the LeafT has a function "signed_distances(PointBatch, double *)"
+	// - gives the same values as signed_distance(), with the right daughter
+	//   evaluated on a batch of the points where it can change the result
+	template <std::size_t dim>
+	void signed_distances_impl(const PointBatch<dim> & batch, double * dist) const{
+		if (m_isleaf){
+			m_leaf->signed_distances(batch, dist);
+			return;
+		}
+
+		combine_signed_distances(batch, dist, m_op, m_rdaughter->m_bbox,
+			[this](const PointBatch<dim> & b, double * d){m_ldaughter->signed_distances_impl(b, d);},
+			[this](const PointBatch<dim> & b, double * d){m_rdaughter->signed_distances_impl(b, d);});
+	}
+
+	void signed_distances(const PointBatch<2> & batch, double * dist) const {signed_distances_impl(batch, dist);};
+	void signed_distances(const PointBatch<3> & batch, double * dist) const {signed_distances_impl(batch, dist);};
+
+	// detects if the CSGTree contains the given box, or for 2D trees the
+	// given convex polygon. The leaves answer exactly, and operands are
+	// only visited as far as the operation needs them
 	// - only compiles if the LeafT has a function "contains_box(Box)"
 	template <typename BoxType>
 	bool contains_box_impl(const BoxType & bx) const{
-		if (m_isleaf) return m_leaf->contains_box(bx);
-
-		bool lc = m_ldaughter->contains_box(bx);
-		bool rc = m_rdaughter->contains_box(bx);
-		bool rcoll, lcoll;
-		
+		if (!BoxT::contains(m_bbox, region_bounds(bx))) return false;
+		if (m_isleaf) return leaf_contains(bx);
 
 		switch (m_op){
 			case UNION:
-				return lc || rc;
-				break;
+				return m_ldaughter->contains_box_impl(bx) || m_rdaughter->contains_box_impl(bx);
 			case INTERSECT:
-				return lc && rc;
-				break;
+				return m_ldaughter->contains_box_impl(bx) && m_rdaughter->contains_box_impl(bx);
 			case DIFFERENCE:
-				rcoll = m_rdaughter->collides_box(bx);
-				return lc && !rcoll;
-				break;
+				return m_ldaughter->contains_box_impl(bx) && !m_rdaughter->collides_box_impl(bx);
 			case XOR:
-				lcoll = m_ldaughter->collides_box(bx);
-				rcoll = m_rdaughter->collides_box(bx);
-				return (lc || rc) && !(lc && rc) && !lcoll && !rcoll;
-				break;
+				if (m_ldaughter->contains_box_impl(bx)) return !m_rdaughter->collides_box_impl(bx);
+				return m_rdaughter->contains_box_impl(bx) && !m_ldaughter->collides_box_impl(bx);
 		}
+		return false;
 	}
 
 	bool contains_box(const Box<2> & pt) const {return contains_box_impl(pt);};
 	bool contains_box(const Box<3> & pt) const {return contains_box_impl(pt);};
+	bool contains_polygon(const std::vector<Point<2>> & poly) const {return !poly.empty() && contains_box_impl(poly);};
 
-	// detects collisions between bounding boxes
+	// detects collisions with the given box, or for 2D trees the given
+	// convex polygon. Where the operands alone can't decide, a collision
+	// is reported
 	// - only compiles if the LeafT has a function "collides_box(Box)"
 	template <typename BoxType>
 	bool collides_box_impl(const BoxType & bx) const{
-		if (m_isleaf) return m_leaf->collides_box(bx);
-
-		bool lc = m_ldaughter->collides_box(bx);
-		bool rc = m_rdaughter->collides_box(bx);
-		bool lcont, rcont;
+		if (!BoxT::collides(m_bbox, region_bounds(bx))) return false;
+		if (m_isleaf) return leaf_collides(bx);
 
 		switch (m_op){
 			case UNION:
-				return lc || rc;
-				break;
+				return m_ldaughter->collides_box_impl(bx) || m_rdaughter->collides_box_impl(bx);
 			case INTERSECT:
-				return lc && rc;
-				break;
+				return m_ldaughter->collides_box_impl(bx) && m_rdaughter->collides_box_impl(bx);
 			case DIFFERENCE:
-				rcont = m_rdaughter->contains_box(bx);
-				return lc && !rcont;
-				break;
+				return m_ldaughter->collides_box_impl(bx) && !m_rdaughter->contains_box_impl(bx);
 			case XOR:
-				lcont = m_ldaughter->contains_box(bx);
-				rcont = m_rdaughter->contains_box(bx);
-				return (lc || rc) && !(lcont && rcont);
-				break;
+				if (!m_ldaughter->collides_box_impl(bx)) return m_rdaughter->collides_box_impl(bx);
+				if (!m_rdaughter->collides_box_impl(bx)) return true;
+				return !(m_ldaughter->contains_box_impl(bx) && m_rdaughter->contains_box_impl(bx));
 		}
+		return false;
 	}
 
 
 	bool collides_box(const Box<2> & pt) const {return collides_box_impl(pt);};
 	bool collides_box(const Box<3> & pt) const {return collides_box_impl(pt);};
+	bool collides_polygon(const std::vector<Point<2>> & poly) const {return !poly.empty() && collides_box_impl(poly);};
+
+
+	// classifies a box as inside, outside or ambiguous in one pass, with
+	// the leaves' classifications combined by combine_classes(). Subtrees
+	// whose bounding box misses the box are outside, and the right daughter
+	// is skipped where the left decides the result
+	// - only compiles if the LeafT has a function "classify_box(Box)"
+	template <typename BoxType>
+	RegionClass classify_box_impl(const BoxType & bx) const{
+		if (!BoxT::collides(m_bbox, bx)) return OUTSIDE;
+		if (m_isleaf) return m_leaf->classify_box(bx);
+
+		RegionClass lc = m_ldaughter->classify_box_impl(bx);
+		if (m_op == UNION && lc == INSIDE) return INSIDE;
+		if ((m_op == INTERSECT || m_op == DIFFERENCE) && lc == OUTSIDE) return OUTSIDE;
+		return combine_classes(lc, m_rdaughter->classify_box_impl(bx), m_op);
+	}
+
+	RegionClass classify_box(const Box<2> & bx) const {return classify_box_impl(bx);};
+	RegionClass classify_box(const Box<3> & bx) const {return classify_box_impl(bx);};
 
 
 	// prints an XML-style summary of the tree to an output stream
@@ -290,8 +381,53 @@ public:
 	}
 
 protected:
+
+	// the bounding box is checked before descending, and the daughter is
+	// called directly instead of through the virtual interface
+	template <typename PointType>
+	static bool daughter_contains(const std::shared_ptr<CSGTree> & d, const PointType & pt){
+		return BoxT::contains(d->m_bbox, pt) && d->contains_point_impl(pt);
+	}
+
+	// for TreeBalancer: every subtree can join its parent's run, and a
+	// node carries nothing besides its operation
+	static bool whole(const CSGTree &) {return false;};
+	static void mark(CSGTree &, const CSGTree &) {};
+
+	// the bounding box of a region tested by contains_box_impl() and
+	// collides_box_impl(), and the test on a leaf for each kind of region
+	static const Box<2> & region_bounds(const Box<2> & bx) {return bx;};
+	static const Box<3> & region_bounds(const Box<3> & bx) {return bx;};
+	static Box<2> region_bounds(const std::vector<Point<2>> & poly) {return bounding_box(poly);};
+
+	bool leaf_contains(const BoxT & bx) const {return m_leaf->contains_box(bx);};
+	bool leaf_contains(const std::vector<Point<2>> & poly) const {return m_leaf->contains_polygon(poly);};
+	bool leaf_collides(const BoxT & bx) const {return m_leaf->collides_box(bx);};
+	bool leaf_collides(const std::vector<Point<2>> & poly) const {return m_leaf->collides_polygon(poly);};
+
+	// cache the bounding box of this node from its leaf or daughters.
+	// Intersections and differences can only shrink their daughters.
+	void update_bounding_box(){
+		if (m_isleaf){
+			if (m_leaf != nullptr) m_bbox = m_leaf->get_bounding_box();
+			return;
+		}
+		switch (m_op){
+			case INTERSECT:
+				m_bbox = BoxT::intersection(m_ldaughter->m_bbox, m_rdaughter->m_bbox);
+				break;
+			case DIFFERENCE:
+				m_bbox = m_ldaughter->m_bbox;
+				break;
+			default:
+				m_bbox = BoxT::bounding_box(m_ldaughter->m_bbox, m_rdaughter->m_bbox);
+				break;
+		}
+	}
+
 	bool 							m_isleaf;
 	std::shared_ptr<LeafT> 			m_leaf;
+	BoxT 							m_bbox;
 
 
 	std::shared_ptr<CSGTree> 		m_ldaughter, m_rdaughter;
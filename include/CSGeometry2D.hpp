@@ -5,139 +5,104 @@
 #include "GeomUtils.hpp"
 #include "Primitive2D.hpp"
 #include "Delaunay.hpp"
+#include "PolygonBoolean.hpp"
 
 namespace csg{
 
 class CSGeometry2D 
 {
+	// rebuilds the tree in rebalance()
+	friend struct TreeBalancer<CSGeometry2D>;
+
 public:
+	// the flavor of a node that has none
+	static const unsigned int no_flavor = std::numeric_limits<unsigned int>::max();
 
 	// CSGeometry2D() {};
 
 	CSGeometry2D(const Primitive2D & leaf)
-	: m_isleaf(true), m_leaf(leaf.copy()), m_flavor(-1) {};
+	: m_isleaf(true), m_leaf(leaf.copy()), m_flavor(no_flavor) {update_bounding_box();};
 
 	// CSGeometry2D(const CSGeometry2D & obj)
-	// : m_isleaf(obj.m_isleaf), m_leaf(obj.m_leaf), m_flavor(-1) {};
+	// : m_isleaf(obj.m_isleaf), m_leaf(obj.m_leaf), m_flavor(no_flavor) {update_bounding_box();};
 
 	CSGeometry2D(std::shared_ptr<Primitive2D> leaf)
-	: m_isleaf(true), m_leaf(leaf), m_flavor(-1) {};
+	: m_isleaf(true), m_leaf(leaf), m_flavor(no_flavor) {update_bounding_box();};
 
 	CSGeometry2D(const CSGeometry2D & left, const CSGeometry2D & right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(left.copy()), m_rdaughter(right.copy()), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(left.copy()), m_rdaughter(right.copy()), m_op(op) {update_bounding_box();};
 
 	CSGeometry2D(std::shared_ptr<CSGeometry2D> left, std::shared_ptr<CSGeometry2D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(left), m_rdaughter(right), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(left), m_rdaughter(right), m_op(op) {update_bounding_box();};
 
 	CSGeometry2D(std::shared_ptr<Primitive2D> left, std::shared_ptr<CSGeometry2D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(left))), m_rdaughter(right), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(left))), m_rdaughter(right), m_op(op) {update_bounding_box();};
 
 	CSGeometry2D(std::shared_ptr<CSGeometry2D> left, std::shared_ptr<Primitive2D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(left), m_rdaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(right))), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(left), m_rdaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(right))), m_op(op) {update_bounding_box();};
 
 	CSGeometry2D(std::shared_ptr<Primitive2D> left, std::shared_ptr<Primitive2D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(left))), m_rdaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(right))), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(left))), m_rdaughter(std::shared_ptr<CSGeometry2D>(new CSGeometry2D(right))), m_op(op) {update_bounding_box();};
 
 	std::shared_ptr<CSGeometry2D> copy() const {return std::make_shared<CSGeometry2D>(*this);};
 
 	void push_back(std::shared_ptr<Primitive2D> obj, Operation op){
-		// auto cp = this->copy();
-		m_ldaughter = this->copy();//std::shared_ptr<CSGeometry2D>(new CSGeometry2D(*this));
+		// the current root is moved into the left daughter, not copied
+		m_ldaughter = std::make_shared<CSGeometry2D>(std::move(*this));
 		m_rdaughter = std::make_shared<CSGeometry2D>(obj);
 		m_op 		= op;
 		m_isleaf 	= false;
 		m_leaf 		= nullptr;
-		m_flavor 	= -1;
+		m_flavor 	= no_flavor;
+		update_bounding_box();
+	}
+
+	// rebuild the chains made by push_back as balanced trees, see TreeBalancer
+	void rebalance(){
+		if (m_isleaf) return;
+		*this = *TreeBalancer<CSGeometry2D>::balanced(copy());
 	}
 
 	void set_flavor(unsigned int flavor) {m_flavor = flavor;};
 
 	unsigned int get_flavor() const {return m_flavor;};
 
-	Box<2> get_bounding_box() const{
-		if (m_isleaf) return m_leaf->get_bounding_box();
+	// bounding box, cached when the tree is built. Leaves changed in
+	// place through their pointers need update_bounding_boxes()
+	Box<2> get_bounding_box() const {return m_bbox;};
 
-		return Box<2>::bounding_box(m_ldaughter->get_bounding_box(), m_rdaughter->get_bounding_box());
+	// recompute the cached bounding boxes of the whole tree
+	void update_bounding_boxes(){
+		if (!m_isleaf){
+			m_ldaughter->update_bounding_boxes();
+			m_rdaughter->update_bounding_boxes();
+		}
+		update_bounding_box();
 	}
 
+	// the rings that outline the geometry, the daughters' outlines
+	// combined by a polygon boolean operation
 	std::vector<Hull<2>> get_outline(unsigned int npts) const {
 		if (m_isleaf) return m_leaf->get_outline(npts);
 
 		std::vector<Hull<2>> oleft = m_ldaughter->get_outline(npts);
 		std::vector<Hull<2>> oright = m_rdaughter->get_outline(npts);
-		
+		return polygon_boolean(oleft, oright, m_op);
+	}
 
-		switch (m_op){
-			case UNION:
-				for (auto j=0; j<oleft.size(); j++){
-					bool state0 = m_rdaughter->contains_point(*(--oleft[j].points.end()));
-					for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-						if (m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-						else it++;
-					}
-				}
-
-				for (auto j=0; j<oright.size(); j++){
-					for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-						if (m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-						else it++;
-					}
-				}
-				break;
-			case INTERSECT:
-				for (auto j=0; j<oleft.size(); j++){
-					for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-						if (!m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-						else it++;
-					}
-				}
-
-				for (auto j=0; j<oright.size(); j++){
-					for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-						if (!m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-						else it++;
-					}
-				}
-				break;
-			case DIFFERENCE:
-				for (auto j=0; j<oleft.size(); j++){
-					for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-						if (m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-						else it++;
-					}
-				}
-
-				for (auto j=0; j<oright.size(); j++){
-					for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-						if (!m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-						else it++;
-					}
-				}
-				break;
-			case XOR:
-				// no culling necessary for XOR
-				// for (auto j=0; j<oleft.size(); j++){
-				// 	for (auto it=oleft[j].points.begin(); it != oleft[j].points.end();){
-				// 		if (m_rdaughter->contains_point(*it)) it = oleft[j].points.erase(it);
-				// 		else it++;
-				// 	}
-				// }
-
-				// for (auto j=0; j<oright.size(); j++){
-				// 	for (auto it=oright[j].points.begin(); it != oright[j].points.end();){
-				// 		if (!m_ldaughter->contains_point(*it)) it = oright[j].points.erase(it);
-				// 		else it++;
-				// 	}
-				// }
-				break;
-		}
-		oleft.insert(oleft.end(), oright.begin(), oright.end());
-		return oleft;
+	// an outline whose chords stray at most tol from the boundary. The
+	// daughters' outlines are joined where their chords cross
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		if (m_isleaf) return m_leaf->get_adaptive_outline(tol);
+
+		std::vector<Hull<2>> oleft = m_ldaughter->get_adaptive_outline(tol);
+		std::vector<Hull<2>> oright = m_rdaughter->get_adaptive_outline(tol);
+		return polygon_boolean(oleft, oright, m_op);
 	}
 
 
@@ -150,43 +115,21 @@ public:
 	}
 
 
-	// get a triangulation of the object
-	Triangulation<2> get_triangulation(unsigned int npts) const {
-		// first get set of points that define the outline
-		Triangulation<2> tout;
-		tout.points = get_outline_points(npts);
-
-		// do a Delaunay triangulation of these points
-		Delaunay del(tout.points, 1);
-
-		// go through the triangulation and remove triangles with
-		// 2 or more edges whose centerpoint is not contained 
-		// within the geometry
-		unsigned int ct;
-		for (auto it=del.triangles.begin(); it != del.triangles.end(); it++){
-			if (it->state <= 0) continue;
-
-			ct=0;
-			if (!contains_point(0.5*(del.points[it->vertices[0]]+del.points[it->vertices[1]]))) ct++;
-			if (!contains_point(0.5*(del.points[it->vertices[1]]+del.points[it->vertices[2]]))) ct++;
-			if (!contains_point(0.5*(del.points[it->vertices[2]]+del.points[it->vertices[0]]))) ct++;
-			
-			if (ct > 1){
-				del.erase_triangle(it->vertices[0], it->vertices[1], it->vertices[2],
-								   -1, -1, -1);
-			}
-		}
-
-		unsigned int pos = 0;
-		tout.triangles.resize(del.ntri);
-		for (auto it=del.triangles.begin(); it != del.triangles.end(); it++){
-			if (it->state <= 0) continue;
-
-			tout.triangles[pos] = {static_cast<int>(it->vertices[0]), static_cast<int>(it->vertices[1]), static_cast<int>(it->vertices[2])};
-			pos++;
-		}
-
-		return tout;
+	// get a triangulation of the object. If minangle (degrees) or
+	// maxarea are positive, the mesh is refined to meet them
+	Triangulation<2> get_triangulation(unsigned int npts, double minangle = 0, double maxarea = 0) const {
+		// the outline rings are closed and do not cross; their segments
+		// become constraints of the Delaunay triangulation
+		std::vector<Point<2>> pts;
+		std::vector<IntPoint2> segs;
+		get_hull_segments(get_outline(npts), pts, segs);
+		if (pts.empty()) return Triangulation<2>();
+		Delaunay del(pts, segs, 1);
+
+		// keep only the triangles enclosed by the rings
+		del.remove_exterior();
+		if (minangle > 0 || maxarea > 0) del.refine(minangle, maxarea);
+		return del.get_triangulation();
 	}
 
 	// void translate(const Point<2> & pt){
@@ -199,79 +142,138 @@ public:
 	// void rotate(const Point<2> & anchor, double degrees) = 0;
 	// virtual void rescale(const Point<2> & scalefactor) = 0;
 
+	// trees built with push_back are left-deep, so the left spine is walked
+	// in a loop and only right daughters are recursed into. Subtrees whose
+	// bounding box excludes the point are skipped, and a right daughter is
+	// only evaluated if it can change the result
 	bool contains_point(const Point<2> & pt) const{
+		if (!Box<2>::contains(m_bbox, pt)) return false;
 		if (m_isleaf) return m_leaf->contains_point(pt);
 
-		bool lc = m_ldaughter->contains_point(pt);
-		bool rc = m_rdaughter->contains_point(pt);
+		// go down the left spine until a leaf or a box that excludes the point
+		static thread_local std::vector<const CSGeometry2D *> spine;
+		std::size_t base = spine.size();
+		const CSGeometry2D * n = this;
+		bool in = false;
+		while (true){
+			spine.push_back(n);
+			n = n->m_ldaughter.get();
+			if (!Box<2>::contains(n->m_bbox, pt)) break;
+			if (n->m_isleaf) {in = n->m_leaf->contains_point(pt); break;}
+		}
 
-		switch (m_op){
-			case UNION:
-				return lc || rc;
-				break;
-			case INTERSECT:
-				return lc && rc;
-				break;
-			case DIFFERENCE:
-				return lc && !rc;
-				break;
-			case XOR:
-				return (lc || rc) && !(lc && rc);
-				break;
+		// combine with the right daughters on the way back up
+		for (auto i=spine.size(); i-- > base;){
+			const CSGeometry2D * s = spine[i];
+			switch (s->m_op){
+				case UNION:
+					in = in || s->m_rdaughter->contains_point(pt);
+					break;
+				case INTERSECT:
+					in = in && s->m_rdaughter->contains_point(pt);
+					break;
+				case DIFFERENCE:
+					in = in && !s->m_rdaughter->contains_point(pt);
+					break;
+				case XOR:
+					in = in != s->m_rdaughter->contains_point(pt);
+					break;
+			}
+		}
+		spine.resize(base);
+		return in;
+	}
+
+	// classify a batch of points into a bitmask. The daughters' masks are
+	// combined with bitwise operations, and the right daughter is skipped
+	// if the left mask leaves nothing for it to change. Leaves are only
+	// evaluated on runs of points inside their bounding box, using the
+	// bounds of each word of the batch
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		if (batch.bounds == nullptr){
+			std::vector<Box<2>> bounds = word_bounds(batch);
+			PointBatch<2> bounded = batch;
+			bounded.bounds = bounds.data();
+			contains_points(bounded, mask);
+			return;
 		}
+		if (m_isleaf){
+			classify_in_box(m_leaf, m_bbox, batch, mask);
+			return;
+		}
+
+		std::size_t nw = batch.nwords();
+		m_ldaughter->contains_points(batch, mask);
+		if (m_op != UNION && m_op != XOR && mask_empty(mask, nw)) return;
+
+		std::vector<Ullong> right(nw);
+		m_rdaughter->contains_points(batch, right.data());
+		combine_masks(mask, right.data(), nw, m_op);
 	}
 
+	// signed distance to the boundary, negative inside. The daughters are
+	// combined with combine_distances(), and the right daughter is skipped
+	// where it cannot change the result
+	double signed_distance(const Point<2> & pt) const{
+		if (m_isleaf) return m_leaf->signed_distance(pt);
+		double a = m_ldaughter->signed_distance(pt);
+		double bd = Box<2>::dist(m_rdaughter->m_bbox, pt);
+		if (!right_matters(a, bd, m_op)) return a;
+		return combine_distances(a, right_distance(m_rdaughter->signed_distance(pt), bd), m_op);
+	}
+
+	// signed distances of a batch of points, the same values as
+	// signed_distance(). The right daughter is evaluated on a batch of the
+	// points where it can change the result
+	void signed_distances(const PointBatch<2> & batch, double * dist) const{
+		if (m_isleaf){
+			m_leaf->signed_distances(batch, dist);
+			return;
+		}
+
+		combine_signed_distances(batch, dist, m_op, m_rdaughter->m_bbox,
+			[this](const PointBatch<2> & b, double * d){m_ldaughter->signed_distances(b, d);},
+			[this](const PointBatch<2> & b, double * d){m_rdaughter->signed_distances(b, d);});
+	}
+
+	// the leaves answer exactly, and operands are only visited as far as
+	// the operation needs them
 	bool contains_box(const Box<2> & bx) const{
+		if (!Box<2>::contains(m_bbox, bx)) return false;
 		if (m_isleaf) return m_leaf->contains_box(bx);
 
-		bool lc = m_ldaughter->contains_box(bx);
-		bool rc = m_rdaughter->contains_box(bx);
-		bool rcoll, lcoll;
-		
-
 		switch (m_op){
 			case UNION:
-				return lc || rc;
-				break;
+				return m_ldaughter->contains_box(bx) || m_rdaughter->contains_box(bx);
 			case INTERSECT:
-				return lc && rc;
-				break;
+				return m_ldaughter->contains_box(bx) && m_rdaughter->contains_box(bx);
 			case DIFFERENCE:
-				rcoll = m_rdaughter->collides_box(bx);
-				return lc && !rcoll;
-				break;
+				return m_ldaughter->contains_box(bx) && !m_rdaughter->collides_box(bx);
 			case XOR:
-				lcoll = m_ldaughter->collides_box(bx);
-				rcoll = m_rdaughter->collides_box(bx);
-				return (lc || rc) && !(lc && rc) && !lcoll && !rcoll;
-				break;
+				if (m_ldaughter->contains_box(bx)) return !m_rdaughter->collides_box(bx);
+				return m_rdaughter->contains_box(bx) && !m_ldaughter->collides_box(bx);
 		}
+		return false;
 	}
 
+	// where the operands alone can't decide, a collision is reported
 	bool collides_box(const Box<2> & bx) const{
+		if (!Box<2>::collides(m_bbox, bx)) return false;
 		if (m_isleaf) return m_leaf->collides_box(bx);
 
-		bool lc = m_ldaughter->collides_box(bx);
-		bool rc = m_rdaughter->collides_box(bx);
-		bool lcont, rcont;
-
 		switch (m_op){
 			case UNION:
-				return lc || rc;
-				break;
+				return m_ldaughter->collides_box(bx) || m_rdaughter->collides_box(bx);
 			case INTERSECT:
-				return lc && rc;
-				break;
+				return m_ldaughter->collides_box(bx) && m_rdaughter->collides_box(bx);
 			case DIFFERENCE:
-				rcont = m_rdaughter->contains_box(bx);
-				return lc && !rcont;
-				break;
+				return m_ldaughter->collides_box(bx) && !m_rdaughter->contains_box(bx);
 			case XOR:
-				lcont = m_ldaughter->contains_box(bx);
-				rcont = m_rdaughter->contains_box(bx);
-				return (lc || rc) && !(lcont && rcont);
-				break;
+				if (!m_ldaughter->collides_box(bx)) return m_rdaughter->collides_box(bx);
+				if (!m_rdaughter->collides_box(bx)) return true;
+				return !(m_ldaughter->contains_box(bx) && m_rdaughter->contains_box(bx));
 		}
+		return false;
 	}
 
 	void print_summary(std::ostream & os = std::cout, unsigned int level=0) const{
@@ -311,9 +313,36 @@ public:
 	}
 
 private:
+
+	// for TreeBalancer: subtrees with a flavor are kept whole, and
+	// rebuilt nodes keep the flavor of the node they replace
+	static bool whole(const CSGeometry2D & n) {return n.m_flavor != no_flavor;};
+	static void mark(CSGeometry2D & out, const CSGeometry2D & n) {out.m_flavor = n.m_flavor;};
+
+	// cache the bounding box of this node from its leaf or daughters.
+	// Intersections and differences can only shrink their daughters.
+	void update_bounding_box(){
+		if (m_isleaf){
+			m_bbox = m_leaf->get_bounding_box();
+			return;
+		}
+		switch (m_op){
+			case INTERSECT:
+				m_bbox = Box<2>::intersection(m_ldaughter->m_bbox, m_rdaughter->m_bbox);
+				break;
+			case DIFFERENCE:
+				m_bbox = m_ldaughter->m_bbox;
+				break;
+			default:
+				m_bbox = Box<2>::bounding_box(m_ldaughter->m_bbox, m_rdaughter->m_bbox);
+				break;
+		}
+	}
+
 	bool 							m_isleaf;
 	std::shared_ptr<Primitive2D> 	m_leaf;
 	unsigned int 					m_flavor;
+	Box<2> 							m_bbox;
 
 
 	std::shared_ptr<CSGeometry2D> 	m_ldaughter, m_rdaughter;
@@ -9,55 +9,75 @@ namespace csg{
 
 class CSGeometry3D 
 {
+	// rebuilds the tree in rebalance()
+	friend struct TreeBalancer<CSGeometry3D>;
+
 public:
+	// the flavor of a node that has none
+	static const unsigned int no_flavor = std::numeric_limits<unsigned int>::max();
 
-	CSGeometry3D() {};
+	CSGeometry3D() : m_bbox(Box<3>::empty()) {};
 
 	CSGeometry3D(const Primitive3D & leaf)
-	: m_isleaf(true), m_leaf(leaf.copy()), m_flavor(-1) {};
+	: m_isleaf(true), m_leaf(leaf.copy()), m_flavor(no_flavor) {update_bounding_box();};
 
 	CSGeometry3D(std::shared_ptr<Primitive3D> leaf)
-	: m_isleaf(true), m_leaf(leaf), m_flavor(-1) {};
+	: m_isleaf(true), m_leaf(leaf), m_flavor(no_flavor) {update_bounding_box();};
 
 	CSGeometry3D(const CSGeometry3D & left, const CSGeometry3D & right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(left.copy()), m_rdaughter(right.copy()), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(left.copy()), m_rdaughter(right.copy()), m_op(op) {update_bounding_box();};
 
 	CSGeometry3D(std::shared_ptr<CSGeometry3D> left, std::shared_ptr<CSGeometry3D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(left), m_rdaughter(right), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(left), m_rdaughter(right), m_op(op) {update_bounding_box();};
 
 	CSGeometry3D(std::shared_ptr<Primitive3D> left, std::shared_ptr<CSGeometry3D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(left))), m_rdaughter(right), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(left))), m_rdaughter(right), m_op(op) {update_bounding_box();};
 
 	CSGeometry3D(std::shared_ptr<CSGeometry3D> left, std::shared_ptr<Primitive3D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(left), m_rdaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(right))), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(left), m_rdaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(right))), m_op(op) {update_bounding_box();};
 
 	CSGeometry3D(std::shared_ptr<Primitive3D> left, std::shared_ptr<Primitive3D> right, Operation op)
-	: m_isleaf(false), m_leaf(nullptr), m_flavor(-1)
-	, m_ldaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(left))), m_rdaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(right))), m_op(op) {};
+	: m_isleaf(false), m_leaf(nullptr), m_flavor(no_flavor)
+	, m_ldaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(left))), m_rdaughter(std::shared_ptr<CSGeometry3D>(new CSGeometry3D(right))), m_op(op) {update_bounding_box();};
 
 	std::shared_ptr<CSGeometry3D> copy() const {return std::make_shared<CSGeometry3D>(*this);};
 
 	void push_back(std::shared_ptr<Primitive3D> obj, Operation op){
-		m_ldaughter = std::shared_ptr<CSGeometry3D>(new CSGeometry3D(*this));
-		m_rdaughter = std::shared_ptr<CSGeometry3D>(new CSGeometry3D(obj));
+		// the current root is moved into the left daughter, not copied
+		m_ldaughter = std::make_shared<CSGeometry3D>(std::move(*this));
+		m_rdaughter = std::make_shared<CSGeometry3D>(obj);
 		m_op 		= op;
 		m_isleaf 	= false;
 		m_leaf 		= nullptr;
-		m_flavor 	= -1;
+		m_flavor 	= no_flavor;
+		update_bounding_box();
+	}
+
+	// rebuild the chains made by push_back as balanced trees, see TreeBalancer
+	void rebalance(){
+		if (m_isleaf) return;
+		*this = *TreeBalancer<CSGeometry3D>::balanced(copy());
 	}
 
 	void set_flavor(unsigned int flavor) {m_flavor = flavor;};
 
 	unsigned int get_flavor() const {return m_flavor;};
 
-	Box<3> get_bounding_box() const{
-		if (m_isleaf) return m_leaf->get_bounding_box();
+	// bounding box, cached when the tree is built. Leaves changed in
+	// place through their pointers need update_bounding_boxes()
+	Box<3> get_bounding_box() const {return m_bbox;};
 
-		return Box<3>::bounding_box(m_ldaughter->get_bounding_box(), m_rdaughter->get_bounding_box());
+	// recompute the cached bounding boxes of the whole tree
+	void update_bounding_boxes(){
+		if (!m_isleaf){
+			m_ldaughter->update_bounding_boxes();
+			m_rdaughter->update_bounding_boxes();
+		}
+		update_bounding_box();
 	}
 
 	// void translate(const Point<3> & pt){
@@ -70,79 +90,145 @@ public:
 	// void rotate(const Point<3> & anchor, double degrees) = 0;
 	// virtual void rescale(const Point<3> & scalefactor) = 0;
 
+	// trees built with push_back are left-deep, so the left spine is walked
+	// in a loop and only right daughters are recursed into. Subtrees whose
+	// bounding box excludes the point are skipped, and a right daughter is
+	// only evaluated if it can change the result
 	bool contains_point(const Point<3> & pt) const{
+		if (!Box<3>::contains(m_bbox, pt)) return false;
 		if (m_isleaf) return m_leaf->contains_point(pt);
 
-		bool lc = m_ldaughter->contains_point(pt);
-		bool rc = m_rdaughter->contains_point(pt);
+		// go down the left spine until a leaf or a box that excludes the point
+		static thread_local std::vector<const CSGeometry3D *> spine;
+		std::size_t base = spine.size();
+		const CSGeometry3D * n = this;
+		bool in = false;
+		while (true){
+			spine.push_back(n);
+			n = n->m_ldaughter.get();
+			if (!Box<3>::contains(n->m_bbox, pt)) break;
+			if (n->m_isleaf) {in = n->m_leaf->contains_point(pt); break;}
+		}
 
-		switch (m_op){
-			case UNION:
-				return lc || rc;
-				break;
-			case INTERSECT:
-				return lc && rc;
-				break;
-			case DIFFERENCE:
-				return lc && !rc;
-				break;
-			case XOR:
-				return (lc || rc) && !(lc && rc);
-				break;
+		// combine with the right daughters on the way back up
+		for (auto i=spine.size(); i-- > base;){
+			const CSGeometry3D * s = spine[i];
+			switch (s->m_op){
+				case UNION:
+					in = in || s->m_rdaughter->contains_point(pt);
+					break;
+				case INTERSECT:
+					in = in && s->m_rdaughter->contains_point(pt);
+					break;
+				case DIFFERENCE:
+					in = in && !s->m_rdaughter->contains_point(pt);
+					break;
+				case XOR:
+					in = in != s->m_rdaughter->contains_point(pt);
+					break;
+			}
+		}
+		spine.resize(base);
+		return in;
+	}
+
+	// classify a batch of points into a bitmask. The daughters' masks are
+	// combined with bitwise operations, and the right daughter is skipped
+	// if the left mask leaves nothing for it to change. Leaves are only
+	// evaluated on runs of points inside their bounding box, using the
+	// bounds of each word of the batch
+	void contains_points(const PointBatch<3> & batch, Ullong * mask) const{
+		if (batch.bounds == nullptr){
+			std::vector<Box<3>> bounds = word_bounds(batch);
+			PointBatch<3> bounded = batch;
+			bounded.bounds = bounds.data();
+			contains_points(bounded, mask);
+			return;
+		}
+		if (m_isleaf){
+			classify_in_box(m_leaf, m_bbox, batch, mask);
+			return;
+		}
+
+		std::size_t nw = batch.nwords();
+		m_ldaughter->contains_points(batch, mask);
+		if (m_op != UNION && m_op != XOR && mask_empty(mask, nw)) return;
+
+		std::vector<Ullong> right(nw);
+		m_rdaughter->contains_points(batch, right.data());
+		combine_masks(mask, right.data(), nw, m_op);
+	}
+
+	// the samples a + (i+0.5)*step, for i in [i0, i1), that the geometry
+	// contains, as sorted spans. The box tests are only as good as the
+	// leaves', so the samples are classified in batches
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_samples(*this, a, step, i0, i1, spans);
+	}
+
+	// signed distance to the boundary, negative inside. The daughters are
+	// combined with combine_distances(), and the right daughter is skipped
+	// where it cannot change the result
+	double signed_distance(const Point<3> & pt) const{
+		if (m_isleaf) return m_leaf->signed_distance(pt);
+		double a = m_ldaughter->signed_distance(pt);
+		double bd = Box<3>::dist(m_rdaughter->m_bbox, pt);
+		if (!right_matters(a, bd, m_op)) return a;
+		return combine_distances(a, right_distance(m_rdaughter->signed_distance(pt), bd), m_op);
+	}
+
+	// signed distances of a batch of points, the same values as
+	// signed_distance(). The right daughter is evaluated on a batch of the
+	// points where it can change the result
+	void signed_distances(const PointBatch<3> & batch, double * dist) const{
+		if (m_isleaf){
+			m_leaf->signed_distances(batch, dist);
+			return;
 		}
+
+		combine_signed_distances(batch, dist, m_op, m_rdaughter->m_bbox,
+			[this](const PointBatch<3> & b, double * d){m_ldaughter->signed_distances(b, d);},
+			[this](const PointBatch<3> & b, double * d){m_rdaughter->signed_distances(b, d);});
 	}
 
+	// the leaves answer exactly, and operands are only visited as far as
+	// the operation needs them
 	bool contains_box(const Box<3> & bx) const{
+		if (!Box<3>::contains(m_bbox, bx)) return false;
 		if (m_isleaf) return m_leaf->contains_box(bx);
 
-		bool lc = m_ldaughter->contains_box(bx);
-		bool rc = m_rdaughter->contains_box(bx);
-		bool rcoll, lcoll;
-		
-
 		switch (m_op){
 			case UNION:
-				return lc || rc;
-				break;
+				return m_ldaughter->contains_box(bx) || m_rdaughter->contains_box(bx);
 			case INTERSECT:
-				return lc && rc;
-				break;
+				return m_ldaughter->contains_box(bx) && m_rdaughter->contains_box(bx);
 			case DIFFERENCE:
-				rcoll = m_rdaughter->collides_box(bx);
-				return lc && !rcoll;
-				break;
+				return m_ldaughter->contains_box(bx) && !m_rdaughter->collides_box(bx);
 			case XOR:
-				lcoll = m_ldaughter->collides_box(bx);
-				rcoll = m_rdaughter->collides_box(bx);
-				return (lc || rc) && !(lc && rc) && !lcoll && !rcoll;
-				break;
+				if (m_ldaughter->contains_box(bx)) return !m_rdaughter->collides_box(bx);
+				return m_rdaughter->contains_box(bx) && !m_ldaughter->collides_box(bx);
 		}
+		return false;
 	}
 
+	// where the operands alone can't decide, a collision is reported
 	bool collides_box(const Box<3> & bx) const{
+		if (!Box<3>::collides(m_bbox, bx)) return false;
 		if (m_isleaf) return m_leaf->collides_box(bx);
 
-		bool lc = m_ldaughter->collides_box(bx);
-		bool rc = m_rdaughter->collides_box(bx);
-		bool lcont, rcont;
-
 		switch (m_op){
 			case UNION:
-				return lc || rc;
-				break;
+				return m_ldaughter->collides_box(bx) || m_rdaughter->collides_box(bx);
 			case INTERSECT:
-				return lc && rc;
-				break;
+				return m_ldaughter->collides_box(bx) && m_rdaughter->collides_box(bx);
 			case DIFFERENCE:
-				rcont = m_rdaughter->contains_box(bx);
-				return lc && !rcont;
-				break;
+				return m_ldaughter->collides_box(bx) && !m_rdaughter->contains_box(bx);
 			case XOR:
-				lcont = m_ldaughter->contains_box(bx);
-				rcont = m_rdaughter->contains_box(bx);
-				return (lc || rc) && !(lcont && rcont);
-				break;
+				if (!m_ldaughter->collides_box(bx)) return m_rdaughter->collides_box(bx);
+				if (!m_rdaughter->collides_box(bx)) return true;
+				return !(m_ldaughter->contains_box(bx) && m_rdaughter->contains_box(bx));
 		}
+		return false;
 	}
 
 	void print_summary(std::ostream & os = std::cout, unsigned int level=0) const{
@@ -182,9 +268,35 @@ public:
 	}
 
 private:
+
+	// for TreeBalancer: subtrees with a flavor are kept whole, and
+	// rebuilt nodes keep the flavor of the node they replace
+	static bool whole(const CSGeometry3D & n) {return n.m_flavor != no_flavor;};
+	static void mark(CSGeometry3D & out, const CSGeometry3D & n) {out.m_flavor = n.m_flavor;};
+	// cache the bounding box of this node from its leaf or daughters.
+	// Intersections and differences can only shrink their daughters.
+	void update_bounding_box(){
+		if (m_isleaf){
+			m_bbox = m_leaf->get_bounding_box();
+			return;
+		}
+		switch (m_op){
+			case INTERSECT:
+				m_bbox = Box<3>::intersection(m_ldaughter->m_bbox, m_rdaughter->m_bbox);
+				break;
+			case DIFFERENCE:
+				m_bbox = m_ldaughter->m_bbox;
+				break;
+			default:
+				m_bbox = Box<3>::bounding_box(m_ldaughter->m_bbox, m_rdaughter->m_bbox);
+				break;
+		}
+	}
+
 	bool 							m_isleaf;
 	std::shared_ptr<Primitive3D> 	m_leaf;
 	unsigned int 					m_flavor;
+	Box<3> 							m_bbox;
 
 	std::shared_ptr<CSGeometry3D> 	m_ldaughter, m_rdaughter;
 	Operation 						m_op;
@@ -2,10 +2,14 @@
 #define _DELAUNAY_H
 
 #include "GeomUtils.hpp"
+#include "Predicates.hpp"
 // #include "Primitive2D.hpp"
 
 #include <unordered_map>
+#include <unordered_set>
 #include <stack>
+#include <queue>
+#include <deque>
 #include <iostream>
 
 // add some typedefs for consistency with the Numerical Recipes book
@@ -17,7 +21,7 @@ typedef int Int;
 namespace csg{
 
 struct RandomHash{
-	inline Ullong int64(Ullong u){
+	inline Ullong int64(Ullong u) const {
 		Ullong v = u * 3935559000370003845LL + 2691343689449507681LL;
 		v ^= v >> 21; v ^= v << 37; v ^= v >> 4;
 		v *= 4768777513237032717LL;
@@ -26,10 +30,10 @@ struct RandomHash{
 	}
 
 	// Returns hash of u as a 32-bit integer.
-	inline Uint int32(Ullong u)	{ return (Uint)(int64(u) & 0xffffffff) ; };
+	inline Uint int32(Ullong u) const { return (Uint)(int64(u) & 0xffffffff) ; };
 
 	//Returns hash of u as a double-precision floating value between 0. and 1.
-	inline Doub doub(Ullong u) { return 5.42101086242752217E-20 * int64(u); };
+	inline Doub doub(Ullong u) const { return 5.42101086242752217E-20 * int64(u); };
 
 };
 
@@ -38,22 +42,6 @@ struct RandomHash{
 
 
 
-// Return positive, zero, or negative value if point d is respectively inside, 
-// on, or outside the circle through points a, b, and c.
-inline double in_circle(const Point<2> & d, const Point<2> & a, const Point<2> & b, const Point<2> & c) {
-	
-	// Circle cc = Circle::circumcircle(a,b,c);
-	// Point<2> ccen = cc.center();
-	Point<2> ccen = circumcenter(a,b,c);
-	// double crad = cc.radius();
-	double crad = circumradius(a,b,c);
-	double radd = (d.x[0]-ccen.x[0])*(d.x[0]-ccen.x[0]) + (d.x[1]-ccen.x[1])*(d.x[1]-ccen.x[1]);
-	return ((crad)*(crad) - radd);
-}
-
-
-
-
 struct TriElem{
 	const Point<2> * 			points;	// the vector of points that this references
 	Int  						vertices[3];	// the 3 vertices in this element
@@ -70,16 +58,15 @@ struct TriElem{
 		state = 1;
 	}
 
+	// return 1 if pt is strictly inside, 0 if it lies on an edge, 
+	// and -1 if it is outside (exact)
 	Int contains_point(const Point<2> & pt){
 		Doub d;
 		Int ztest = 0;
 		Int i,j;
-		for (auto i=0; i<3; i++){
+		for (i=0; i<3; i++){
 			j = (i+1)%3;
-			d = (points[vertices[j]].x[0] - points[vertices[i]].x[0])
-				*(pt.x[1]-points[vertices[i]].x[1])
-				- (points[vertices[j]].x[1] - points[vertices[i]].x[1])
-				*(pt.x[0]-points[vertices[i]].x[0]);
+			d = orient2d(points[vertices[i]], points[vertices[j]], pt);
 			if (d<0.0) return -1;
 			if (d == 0.0) ztest = true;
 		}
@@ -103,16 +90,24 @@ struct Delaunay {
 	std::unordered_map<Ullong, Int> 	linehash;
 	std::unordered_map<Ullong, Int> 	trihash;
 	std::vector<Int> 					perm;	//Permutation for randomizing point order.
+	std::unordered_set<Ullong> 			constraints;	//Constrained edges, keyed independent of direction.
 	RandomHash 							hashfn;
 
 	static Uint jran;
-	static const Doub fuzz, bigscale;
+	static const Doub bigscale;
 
 
 	//Construct Delaunay triangulation from a vector of points pvec. If bit 0 in options is nonzero,
 	//hash memories used in the construction are deleted. (Some applications may want to use them
 	//and will set options to 1.)
 	Delaunay(std::vector<Point<2> > &pvec, Int options) 
+	: Delaunay(pvec, std::vector<IntPoint2>(), options) {};
+
+	//Construct the constrained Delaunay triangulation of the points in pvec, forcing each segment
+	//(pair of indices into pvec) to appear as an edge. Segments that cross each other are split at
+	//their intersection, which is appended to points. Options are as above; keep the hash memories
+	//(bit 0) to call remove_exterior() or remove_regions() afterwards.
+	Delaunay(std::vector<Point<2> > &pvec, const std::vector<IntPoint2> & segments, Int options) 
 	: npts(pvec.size()), ntri(0), ntree(0), ntreemax(10*npts+1000)
 	, opt(options), points(pvec){
 		
@@ -138,26 +133,34 @@ struct Delaunay {
 		dely = yh - yl;
 
 		//Store bounding box dimensions, then construct
-		//the three fictitious points and store them.
-		points.push_back(Point<2>(0.5*(xl + xh), yh + bigscale*dely));
-		points.push_back(Point<2>(xl - 0.5*bigscale*delx,yl - 0.5*bigscale*dely));
-		points.push_back(Point<2>(xh + 0.5*bigscale*delx,yl - 0.5*bigscale*dely));
+		//the three fictitious points and store them. The larger extent is
+		//used in both directions so that collinear inputs still get a
+		//nondegenerate bounding triangle.
+		Doub del = std::max(delx, dely);
+		if (del == 0.0) del = 1.0;
+		points.push_back(Point<2>(0.5*(xl + xh), yh + bigscale*del));
+		points.push_back(Point<2>(xl - 0.5*bigscale*del,yl - 0.5*bigscale*del));
+		points.push_back(Point<2>(xh + 0.5*bigscale*del,yl - 0.5*bigscale*del));
 		store_triangle(npts,npts+1,npts+2);
 
 		// mix up the order of insertion
 		for (auto j=npts; j>0; j--) std::swap(perm[j-1],perm[hashfn.int64(jran++) % j]);
 		
-		// insert points one-by-one
-		for (auto j=0; j<npts; j++) insert_point(perm[j]);
+		// insert points one-by-one, remembering which vertex represents
+		// each (possibly duplicate) input point
+		std::vector<Int> vertex(npts);
+		for (auto j=0; j<npts; j++) vertex[perm[j]] = insert_point(perm[j]);
+
+		// force the constrained segments into the triangulation
+		for (auto j=0; j<segments.size(); j++) insert_constraint(vertex[segments[j].x[0]], vertex[segments[j].x[1]]);
 		
 		// Deactivate the huge root triangle and all of its connecting edges.
 		for (auto j=0; j<ntree; j++) {
 			if (triangles[j].state > 0) {
-				if (triangles[j].vertices[0] >= npts || 
-					triangles[j].vertices[1] >= npts ||
-					triangles[j].vertices[2] >= npts) {
-					triangles[j].state = -1;
-					ntri--;
+				if (is_fictitious(triangles[j].vertices[0]) || 
+					is_fictitious(triangles[j].vertices[1]) ||
+					is_fictitious(triangles[j].vertices[2])) {
+					remove_triangle(j);
 				}
 			}
 		}
@@ -170,29 +173,57 @@ struct Delaunay {
 		}
 	}
 
-	//Add the point with index r incrementally to the Delaunay triangulation.
-	void insert_point(Int r) {
-		
-		Int i,j,k,l,s,tno,ntask,d0,d1,d2;
-		Ullong key;
-		std::stack<Int> tasks, taski, taskj;
-		//Stacks (3 vertices) for legalizing edges.
 
-		//Find triangle containing point. Fuzz if it lies on an edge.
-		for (j=0; j<3; j++) {
-			
-			tno = which_contains_point(points[r],1);
+	//True for the three vertices of the bounding triangle. Points added after construction
+	//(e.g. segment intersections) are stored after them.
+	bool is_fictitious(Int v) const {return v >= npts && v < npts+3;};
 
-			if (tno >= 0) break; //The desired result: Point is OK
+	//True if the edge between a and b is constrained.
+	bool is_constrained(Int a, Int b) const {
+		return !constraints.empty() && constraints.count(hashfn.int64(a) ^ hashfn.int64(b)) > 0;
+	}
+
+	//True if the edge between a and b exists in the triangulation.
+	bool edge_exists(Int a, Int b) const {
+		return linehash.count(hashfn.int64(a) - hashfn.int64(b)) > 0 || linehash.count(hashfn.int64(b) - hashfn.int64(a)) > 0;
+	}
 
 
-			points[r].x[0] += fuzz * delx * (hashfn.doub(jran++)-0.5);
-			points[r].x[1] += fuzz * dely * (hashfn.doub(jran++)-0.5);
+	//Append a point to the point store and return its index (it still has to be inserted with
+	//insert_point). Triangles reference the store by pointer, so refresh them if it moved.
+	Int add_point(const Point<2> & p) {
+		const Point<2> * old = &points.front();
+		points.push_back(p);
+		if (&points.front() != old){
+			for (auto j=0; j<ntree; j++) triangles[j].points = &points.front();
 		}
-		if (j == 3){
-			std::cerr << "Delaunay: points degenerate even after fuzzing!" << std::endl;
-			throw("points degenerate even after fuzzing");
-		} 
+		return points.size()-1;
+	}
+
+	//Add the point with index r incrementally to the Delaunay triangulation. Points that lie
+	//exactly on an edge split the edge and both adjacent triangles; exact duplicates of a
+	//point that is already in the triangulation are skipped. Returns the index of the vertex
+	//at the location of the point (r, or the vertex it duplicates).
+	Int insert_point(Int r) {
+		//Find triangle containing point, allowing it to lie on an edge.
+		Int tno = which_contains_point(points[r],0);
+		if (tno < 0){
+			std::cerr << "Delaunay: point lies outside of the bounding triangle!" << std::endl;
+			throw("point outside bounding triangle");
+		}
+		return insert_point(r, tno);
+	}
+
+	//Add the point with index r, which lies in the live triangle tno or on its boundary. If e
+	//is nonnegative the point is taken to lie on edge e of tno, which is then split even if
+	//the point is off the edge by roundoff (as for the midpoint of a segment).
+	Int insert_point(Int r, Int tno, Int e = -1) {
+		
+		Int i,j,k,l,s,ntask,nzero,d0,d1,d2,d3;
+		Ullong key;
+		Doub o[3];
+		std::stack<Int> tasks, taski, taskj;
+		//Stacks (3 vertices) for legalizing edges.
 
 		ntask = 0;
 		i = triangles[tno].vertices[0]; 
@@ -203,18 +234,73 @@ struct Delaunay {
 		//by the convex hull application and causes any points already known to be interior to the
 		//convex hull to be omitted from the triangulation, saving time (but giving in an incomplete
 		//triangulation).
-		if (opt & 2 && i < npts && j < npts && k < npts) return;
-
-		//Create three triangles and queue them for legal edge tests.
-		d0 = store_triangle(r,i,j);
-		tasks.push(r); taski.push(i); taskj.push(j);
-		d1 = store_triangle(r,j,k);
-		tasks.push(r); taski.push(j); taskj.push(k);
-		d2 = store_triangle(r,k,i);
-		tasks.push(r); taski.push(k); taskj.push(i);
-		
-		//Erase the old triangle.
-		erase_triangle(i,j,k,d0,d1,d2);
+		if (opt & 2 && i < npts && j < npts && k < npts) return r;
+
+		//Classify the point against the three edges (exact), unless the edge is given.
+		nzero = (e >= 0) ? 1 : 0;
+		if (e < 0) {
+			for (auto n=0; n<3; n++){
+				o[n] = orient2d(points[triangles[tno].vertices[n]], points[triangles[tno].vertices[(n+1)%3]], points[r]);
+				if (o[n] == 0.0) {nzero++; e = n;}
+			}
+		}
+
+		//Duplicate of an existing vertex.
+		if (nzero > 1) {
+			for (auto n=0; n<3; n++) if (o[n] != 0.0) return triangles[tno].vertices[(n+2)%3];
+		}
+
+		if (nzero == 0){
+			//Create three triangles and queue them for legal edge tests.
+			d0 = store_triangle(r,i,j);
+			tasks.push(r); taski.push(i); taskj.push(j);
+			d1 = store_triangle(r,j,k);
+			tasks.push(r); taski.push(j); taskj.push(k);
+			d2 = store_triangle(r,k,i);
+			tasks.push(r); taski.push(k); taskj.push(i);
+			
+			//Erase the old triangle.
+			erase_triangle(i,j,k,d0,d1,d2);
+		}
+		else {
+			//Point lies on edge i->j, rotated so that k is the opposite vertex.
+			i = triangles[tno].vertices[e];
+			j = triangles[tno].vertices[(e+1)%3];
+			k = triangles[tno].vertices[(e+2)%3];
+
+			//Look up the triangle on the other side of the edge.
+			key = hashfn.int64(j) - hashfn.int64(i);
+			l = (linehash.count(key) > 0) ? linehash[key] : -1;
+
+			//Split this side of the edge.
+			d0 = store_triangle(r,j,k);
+			tasks.push(r); taski.push(j); taskj.push(k);
+			d1 = store_triangle(r,k,i);
+			tasks.push(r); taski.push(k); taskj.push(i);
+			erase_triangle(i,j,k,d0,d1,-1);
+
+			//Split the other side of the edge.
+			if (l >= 0){
+				d2 = store_triangle(r,i,l);
+				tasks.push(r); taski.push(i); taskj.push(l);
+				d3 = store_triangle(r,l,j);
+				tasks.push(r); taski.push(l); taskj.push(j);
+				erase_triangle(l,j,i,d2,d3,-1);
+			}
+
+			//The split edge no longer exists in either direction.
+			key = hashfn.int64(i)-hashfn.int64(j);
+			linehash.erase(key);
+			key = 0 - key;	//Unsigned, hence binary minus.
+			linehash.erase(key);
+
+			//Both halves of a split constraint stay constrained.
+			if (is_constrained(i,j)) {
+				constraints.erase(hashfn.int64(i) ^ hashfn.int64(j));
+				constraints.insert(hashfn.int64(i) ^ hashfn.int64(r));
+				constraints.insert(hashfn.int64(r) ^ hashfn.int64(j));
+			}
+		}
 
 		//Legalize edges recursively.
 		while (tasks.size()>0) {
@@ -228,7 +314,10 @@ struct Delaunay {
 			if (linehash.count(key) == 0) continue;
 			l = linehash[key];
 
-			if (in_circle(points[l],points[j],points[s],points[i]) > 0.0){ //Needs legalizing
+			//Constrained edges are never flipped.
+			if (is_constrained(i,j)) continue;
+
+			if (in_circle(points[l],points[j],points[s],points[i],l,j,s,i) > 0.0){ //Needs legalizing
 				//Create two new triangles
 				d0 = store_triangle(s,l,j);
 				d1 = store_triangle(s,i,l);
@@ -248,6 +337,465 @@ struct Delaunay {
 				tasks.push(s); taski.push(i); taskj.push(l);
 			}
 		}
+		return r;
+	}
+
+
+	//Force the segment between vertices u and v into the triangulation as a constrained edge.
+	//Edges crossing the segment are flipped away (Sloan's algorithm) and the Delaunay property
+	//is then restored around the new edges. Vertices lying exactly on the segment split it, and
+	//so do crossing constrained edges, at a new vertex at the intersection.
+	void insert_constraint(Int u, Int v) {
+		std::stack<std::pair<Int,Int>> segs;
+		segs.push(std::make_pair(u,v));
+
+		while (segs.size() > 0) {
+			u = segs.top().first; v = segs.top().second; segs.pop();
+			if (u == v) continue;
+			if (edge_exists(u,v)) {
+				constraints.insert(hashfn.int64(u) ^ hashfn.int64(v));
+				continue;
+			}
+
+			//Rotate around u to the triangle (u,x,y) whose wedge contains the segment.
+			Int t = which_contains_point(points[u],0);
+			Int x = -1, y = -1, w = -1;
+			bool found = false;
+			for (auto n=0; n<3; n++) if (triangles[t].vertices[n] == u) {
+				x = triangles[t].vertices[(n+1)%3];
+				y = triangles[t].vertices[(n+2)%3];
+			}
+			for (auto n=0; x >= 0 && n<=ntri && w < 0 && !found; n++) {
+				Doub ox = orient2d(points[u], points[x], points[v]);
+				Doub oy = orient2d(points[u], points[y], points[v]);
+				if (ox == 0.0 && Point<2>::dot(points[x]-points[u], points[v]-points[u]) > 0.0) w = x;
+				else if (oy == 0.0 && Point<2>::dot(points[y]-points[u], points[v]-points[u]) > 0.0) w = y;
+				else if (ox > 0.0 && oy < 0.0) found = true;
+				else {
+					auto it = linehash.find(hashfn.int64(u) - hashfn.int64(y));
+					if (it == linehash.end()) break;
+					x = y;
+					y = it->second;
+				}
+			}
+			if (w < 0 && !found) {
+				std::cerr << "Delaunay: cannot find the segment direction around its first vertex!" << std::endl;
+				throw("constraint insertion failed");
+			}
+
+			//A vertex on the segment splits it.
+			if (w >= 0) {
+				segs.push(std::make_pair(w,v));
+				segs.push(std::make_pair(u,w));
+				continue;
+			}
+
+			//Collect the edges crossed by the segment, as (right, left) pairs.
+			std::deque<std::pair<Int,Int>> crossed;
+			bool split = false;
+			while (true) {
+				if (is_constrained(x,y)) {
+					//Crossing constraints: split both at the intersection.
+					Doub ou = orient2d(points[x], points[y], points[u]);
+					Doub ov = orient2d(points[x], points[y], points[v]);
+					w = add_point(points[u] + ou/(ou-ov)*(points[v]-points[u]));
+					w = insert_point(w);
+					if (w != x && w != y) {
+						constraints.erase(hashfn.int64(x) ^ hashfn.int64(y));
+						segs.push(std::make_pair(x,w));
+						segs.push(std::make_pair(w,y));
+					}
+					segs.push(std::make_pair(w,v));
+					segs.push(std::make_pair(u,w));
+					split = true;
+					break;
+				}
+				crossed.push_back(std::make_pair(x,y));
+				w = linehash[hashfn.int64(y) - hashfn.int64(x)];
+				if (w == v) break;
+				Doub o = orient2d(points[u], points[v], points[w]);
+				if (o == 0.0) {
+					segs.push(std::make_pair(w,v));
+					v = w;
+					break;
+				}
+				if (o > 0.0) y = w;
+				else x = w;
+			}
+			if (split) continue;
+
+			//Flip crossing edges until none is left.
+			std::vector<std::pair<Int,Int>> created;
+			while (crossed.size() > 0) {
+				Int i = crossed.front().first, j = crossed.front().second;
+				crossed.pop_front();
+				Int s = linehash[hashfn.int64(i) - hashfn.int64(j)];
+				Int l = linehash[hashfn.int64(j) - hashfn.int64(i)];
+				if (orient2d(points[s], points[l], points[j]) <= 0.0 || orient2d(points[s], points[i], points[l]) <= 0.0) {
+					crossed.push_back(std::make_pair(i,j));
+					continue;
+				}
+				flip_edge(i, j, s, l);
+				Doub os = orient2d(points[u], points[v], points[s]), ol = orient2d(points[u], points[v], points[l]);
+				if (s != u && s != v && l != u && l != v && ((os > 0.0 && ol < 0.0) || (os < 0.0 && ol > 0.0)))
+					crossed.push_back((os < 0.0) ? std::make_pair(s,l) : std::make_pair(l,s));
+				else
+					created.push_back(std::make_pair(s,l));
+			}
+			constraints.insert(hashfn.int64(u) ^ hashfn.int64(v));
+
+			//Restore the Delaunay property around the new edges.
+			legalize(created);
+		}
+	}
+
+
+	//Flip the edge i->j shared by triangles (s,i,j) and (l,j,i) into the edge s->l.
+	void flip_edge(Int i, Int j, Int s, Int l) {
+		Int d0 = store_triangle(s,l,j);
+		Int d1 = store_triangle(s,i,l);
+		erase_triangle(s,i,j,d0,d1,-1);
+		erase_triangle(l,j,i,d0,d1,-1);
+		Ullong key = hashfn.int64(i)-hashfn.int64(j);
+		linehash.erase(key);
+		key = 0 - key;	//Unsigned, hence binary minus.
+		linehash.erase(key);
+	}
+
+
+	//Flip unconstrained edges that fail the in-circle test, starting from the given edges and
+	//propagating to the edges around each flip.
+	void legalize(std::vector<std::pair<Int,Int>> edges) {
+		while (edges.size() > 0) {
+			Int i = edges.back().first, j = edges.back().second;
+			edges.pop_back();
+			if (is_constrained(i,j)) continue;
+			Ullong key = hashfn.int64(i) - hashfn.int64(j);
+			if (linehash.count(key) == 0) continue;
+			Int s = linehash[key];
+			key = hashfn.int64(j) - hashfn.int64(i);
+			if (linehash.count(key) == 0) continue;
+			Int l = linehash[key];
+			if (in_circle(points[l],points[j],points[s],points[i],l,j,s,i) > 0.0) {
+				flip_edge(i, j, s, l);
+				edges.push_back(std::make_pair(l,j));
+				edges.push_back(std::make_pair(j,s));
+				edges.push_back(std::make_pair(s,i));
+				edges.push_back(std::make_pair(i,l));
+			}
+		}
+	}
+
+
+	//Return the live triangle across edge e (from vertex e to vertex e+1) of triangle t, or -1.
+	//Requires the hash memories.
+	Int neighbor(Int t, Int e) const {
+		Int i = triangles[t].vertices[e], j = triangles[t].vertices[(e+1)%3];
+		auto it = linehash.find(hashfn.int64(j) - hashfn.int64(i));
+		if (it == linehash.end()) return -1;
+		auto jt = trihash.find(hashfn.int64(it->second) ^ hashfn.int64(j) ^ hashfn.int64(i));
+		return (jt == trihash.end()) ? -1 : jt->second;
+	}
+
+
+	//Remove a live triangle from the triangulation without leaving daughters, clearing its
+	//edges from the hash memories.
+	void remove_triangle(Int t) {
+		TriElem & tri = triangles[t];
+		for (auto e=0; e<3; e++){
+			Int a = tri.vertices[e], b = tri.vertices[(e+1)%3], c = tri.vertices[(e+2)%3];
+			auto it = linehash.find(hashfn.int64(a) - hashfn.int64(b));
+			if (it != linehash.end() && it->second == c) linehash.erase(it);
+		}
+		trihash.erase(hashfn.int64(tri.vertices[0]) ^ hashfn.int64(tri.vertices[1]) ^ hashfn.int64(tri.vertices[2]));
+		tri.state = -1;
+		ntri--;
+	}
+
+
+	//Label the live triangles by connected region, where regions are separated by constrained
+	//edges. Dead triangles get -1. Returns the number of regions. Requires the hash memories.
+	Int label_regions(std::vector<Int> & region) const {
+		if (ntri > 0 && linehash.size() == 0){
+			std::cerr << "Delaunay: hash memories were cleared, construct with options bit 0 set" << std::endl;
+			throw("hash memories cleared");
+		}
+		region.assign(ntree, -1);
+		Int nregion = 0;
+		std::stack<Int> todo;
+		for (auto t=0; t<ntree; t++){
+			if (triangles[t].state <= 0 || region[t] >= 0) continue;
+			region[t] = nregion;
+			todo.push(t);
+			while (todo.size() > 0){
+				Int c = todo.top(); todo.pop();
+				for (auto e=0; e<3; e++){
+					if (is_constrained(triangles[c].vertices[e], triangles[c].vertices[(e+1)%3])) continue;
+					Int n = neighbor(c, e);
+					if (n < 0 || region[n] >= 0) continue;
+					region[n] = nregion;
+					todo.push(n);
+				}
+			}
+			nregion++;
+		}
+		return nregion;
+	}
+
+
+	//Remove the triangles outside the constrained segments, treated as closed boundaries: a
+	//region is interior if an odd number of constraints separates it from the outside of the
+	//convex hull. Requires the hash memories.
+	void remove_exterior() {
+		std::vector<Int> region;
+		Int nregion = label_regions(region);
+
+		//Breadth-first over regions; crossing a constraint adds one to the depth.
+		std::vector<Int> depth(nregion, -1);
+		std::queue<Int> todo;
+		for (auto t=0; t<ntree; t++){
+			if (region[t] < 0) continue;
+			for (auto e=0; e<3; e++){
+				if (neighbor(t, e) >= 0) continue;
+				Int d = is_constrained(triangles[t].vertices[e], triangles[t].vertices[(e+1)%3]) ? 1 : 0;
+				if (depth[region[t]] < 0 || d < depth[region[t]]) depth[region[t]] = d;
+			}
+		}
+		for (auto r=0; r<nregion; r++) if (depth[r] == 0) todo.push(r);
+		for (auto r=0; r<nregion; r++) if (depth[r] == 1) todo.push(r);
+
+		//Region adjacency across constraints.
+		std::vector<std::vector<Int>> adjacent(nregion);
+		for (auto t=0; t<ntree; t++){
+			if (region[t] < 0) continue;
+			for (auto e=0; e<3; e++){
+				Int n = neighbor(t, e);
+				if (n >= 0 && region[n] != region[t]) adjacent[region[t]].push_back(region[n]);
+			}
+		}
+		while (todo.size() > 0){
+			Int r = todo.front(); todo.pop();
+			for (auto k=0; k<adjacent[r].size(); k++){
+				Int n = adjacent[r][k];
+				if (depth[n] >= 0) continue;
+				depth[n] = depth[r]+1;
+				todo.push(n);
+			}
+		}
+
+		for (auto t=0; t<ntree; t++){
+			if (region[t] >= 0 && depth[region[t]] % 2 == 0) remove_triangle(t);
+		}
+	}
+
+
+	//Remove whole regions (see label_regions) for which inside(pt) is false, where pt is the
+	//centroid of the largest triangle of the region. This classifies overlapping or crossing
+	//boundaries, such as those of CSG daughters, with one query per region. Requires the hash
+	//memories.
+	template <typename Predicate>
+	void remove_regions(const Predicate & inside) {
+		std::vector<Int> region;
+		Int nregion = label_regions(region);
+
+		std::vector<Int> rep(nregion, -1);
+		std::vector<Doub> area(nregion, 0.0);
+		for (auto t=0; t<ntree; t++){
+			if (region[t] < 0) continue;
+			const TriElem & tri = triangles[t];
+			Doub a = orient2d(points[tri.vertices[0]], points[tri.vertices[1]], points[tri.vertices[2]]);
+			if (rep[region[t]] < 0 || a > area[region[t]]) {rep[region[t]] = t; area[region[t]] = a;}
+		}
+
+		std::vector<bool> keep(nregion);
+		for (auto r=0; r<nregion; r++){
+			const TriElem & tri = triangles[rep[r]];
+			keep[r] = inside(1.0/3.0*(points[tri.vertices[0]]+points[tri.vertices[1]]+points[tri.vertices[2]]));
+		}
+
+		for (auto t=0; t<ntree; t++){
+			if (region[t] >= 0 && !keep[region[t]]) remove_triangle(t);
+		}
+	}
+
+
+	//Refine the triangulation with Steiner points (Ruppert's algorithm, with Chew's
+	//circumcenter insertion) until no triangle has an angle below minangle (in degrees) or, if
+	//maxarea is positive, an area above maxarea. Constrained edges and boundary edges are
+	//segments. A segment that is encroached (seen at more than 90 degrees from a vertex, or
+	//from a circumcenter about to be inserted) is split at its midpoint. Otherwise the worst
+	//triangle in a priority queue gets its circumcenter inserted, and the triangles this
+	//creates are queued in turn. Bounds above about 34 degrees, or small angles between input
+	//segments, may not be reachable. Edges shorter than a tiny fraction of the bounding box are
+	//left alone, and at most maxadd points are added; if it is negative, the cap is proportional
+	//to the number of triangles and to the area over maxarea. Returns the number of points
+	//added. Requires the hash memories, and is meant to be called after remove_exterior() or
+	//remove_regions().
+	Int refine(Doub minangle, Doub maxarea = 0.0, Int maxadd = -1) {
+		if (ntri > 0 && linehash.size() == 0){
+			std::cerr << "Delaunay: hash memories were cleared, construct with options bit 0 set" << std::endl;
+			throw("hash memories cleared");
+		}
+		const Doub ratio = (minangle > 0.0) ? 2.0*sin(minangle*pi/180.0) : 0.0;
+		const Doub minlen = 1.0e-10*std::max(delx, dely);
+
+		//Badness of a live triangle, greater than 1 if it violates a bound. The smallest angle
+		//is below minangle exactly when lmin/R < 2 sin(minangle).
+		auto badness = [&](Int t) -> Doub {
+			const Point<2> & a = points[triangles[t].vertices[0]];
+			const Point<2> & b = points[triangles[t].vertices[1]];
+			const Point<2> & c = points[triangles[t].vertices[2]];
+			Doub area = 0.5*orient2d(a, b, c);
+			if (area <= 0.0) return 0.0;
+			Doub lmin = sqrt(std::min(Point<2>::dot(b-a, b-a), std::min(Point<2>::dot(c-b, c-b), Point<2>::dot(a-c, a-c))));
+			if (lmin < minlen) return 0.0;
+			Doub q = (ratio > 0.0) ? ratio*circumradius(a, b, c)/lmin : 0.0;
+			if (maxarea > 0.0) q = std::max(q, area/maxarea);
+			return q;
+		};
+
+		std::priority_queue<std::pair<Doub,Int>> bad;
+		std::vector<std::pair<Int,Int>> encroached;
+		auto check = [&](Int t){
+			Doub q = badness(t);
+			if (q > 1.0) bad.push(std::make_pair(q, t));
+			for (auto e=0; e<3; e++){
+				if (!is_segment(t, e)) continue;
+				Int i = triangles[t].vertices[e], j = triangles[t].vertices[(e+1)%3], k = triangles[t].vertices[(e+2)%3];
+				if (Point<2>::dot(points[i]-points[k], points[j]-points[k]) < 0.0) encroached.push_back(std::make_pair(i,j));
+			}
+		};
+		for (auto t=0; t<ntree; t++) if (triangles[t].state > 0) check(t);
+
+		const Int base = points.size();
+		Int nadd = 0;
+		if (maxadd < 0){
+			Doub area = 0.0;
+			for (auto t=0; t<ntree; t++){
+				const TriElem & tri = triangles[t];
+				if (tri.state > 0) area += 0.5*orient2d(points[tri.vertices[0]], points[tri.vertices[1]], points[tri.vertices[2]]);
+			}
+			maxadd = 100*(ntri+1) + ((maxarea > 0.0) ? Int(std::min(4.0*area/maxarea, 1.0e9)) : 0);
+		}
+		while (maxadd < 0 || nadd < maxadd){
+			Int first = ntree;
+
+			if (encroached.size() > 0){
+				Int i = encroached.back().first, j = encroached.back().second;
+				encroached.pop_back();
+				if (!split_segment(i, j, minlen)) continue;
+			}
+			else if (bad.size() > 0){
+				Int t = bad.top().second;
+				Doub q = bad.top().first;
+				bad.pop();
+				if (triangles[t].state <= 0) continue;
+				const TriElem & tri = triangles[t];
+				Point<2> c = circumcenter(points[tri.vertices[0]], points[tri.vertices[1]], points[tri.vertices[2]]);
+
+				//A circumcenter beyond a segment, or encroaching upon a segment near it, splits
+				//the segment instead; the triangle is queued again.
+				Int bi, bj;
+				Int w = walk(t, c, bi, bj);
+				std::vector<std::pair<Int,Int>> near;
+				if (w < 0 && bi >= 0) near.push_back(std::make_pair(bi,bj));
+				for (auto n=-1; n<3 && w >= 0; n++){
+					Int u = (n < 0) ? w : neighbor(w, n);
+					if (u < 0) continue;
+					for (auto e=0; e<3; e++){
+						if (!is_segment(u, e)) continue;
+						Int i = triangles[u].vertices[e], j = triangles[u].vertices[(e+1)%3];
+						if (Point<2>::dot(points[i]-c, points[j]-c) < 0.0) near.push_back(std::make_pair(i,j));
+					}
+				}
+				if (near.size() > 0 || w < 0){
+					bool split = false;
+					for (auto n=0; n<near.size(); n++) split = split_segment(near[n].first, near[n].second, minlen) || split;
+					if (!split) continue;
+					if (triangles[t].state > 0) bad.push(std::make_pair(q, t));
+				}
+				else {
+					Int r = add_point(c);
+					if (insert_point(r, w) != r) {points.pop_back(); continue;}
+				}
+			}
+			else break;
+
+			nadd = points.size()-base;
+			for (auto t=first; t<ntree; t++) if (triangles[t].state > 0) check(t);
+		}
+		return nadd;
+	}
+
+
+	//True if edge e of the live triangle t is a segment for refinement: constrained, or on the
+	//boundary of the triangulation.
+	bool is_segment(Int t, Int e) const {
+		return is_constrained(triangles[t].vertices[e], triangles[t].vertices[(e+1)%3]) || neighbor(t, e) < 0;
+	}
+
+
+	//Split the segment between vertices i and j at its midpoint, unless the edge no longer exists
+	//or is shorter than minlen. Returns true if a vertex was added.
+	bool split_segment(Int i, Int j, Doub minlen) {
+		Point<2> d = points[j]-points[i];
+		if (sqrt(Point<2>::dot(d, d)) < minlen) return false;
+		auto it = linehash.find(hashfn.int64(i) - hashfn.int64(j));
+		if (it == linehash.end()) {
+			std::swap(i, j);
+			it = linehash.find(hashfn.int64(i) - hashfn.int64(j));
+			if (it == linehash.end()) return false;
+		}
+		auto jt = trihash.find(hashfn.int64(i) ^ hashfn.int64(j) ^ hashfn.int64(it->second));
+		if (jt == trihash.end()) return false;
+		Int t = jt->second, e = 0;
+		while (triangles[t].vertices[e] != i) e++;
+		Int r = add_point(0.5*(points[i]+points[j]));
+		insert_point(r, t, e);
+		return true;
+	}
+
+
+	//Walk from the live triangle t towards p across unconstrained edges. Returns the live
+	//triangle containing p (possibly on its boundary), or -1 if the walk is blocked, in which
+	//case (bi,bj) is the blocking segment (or -1 if the walk did not terminate).
+	Int walk(Int t, const Point<2> & p, Int & bi, Int & bj) const {
+		Uint rnd = 2463534242u;
+		bi = bj = -1;
+		for (auto step=0; step<=ntri; step++){
+			rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+			Int e0 = rnd%3, e = -1;
+			for (auto k=0; k<3; k++){
+				Int n = (e0+k)%3;
+				if (orient2d(points[triangles[t].vertices[n]], points[triangles[t].vertices[(n+1)%3]], p) < 0.0) {e = n; break;}
+			}
+			if (e < 0) return t;
+			if (is_segment(t, e)) {
+				bi = triangles[t].vertices[e];
+				bj = triangles[t].vertices[(e+1)%3];
+				return -1;
+			}
+			t = neighbor(t, e);
+		}
+		return -1;
+	}
+
+
+	//Return the live triangles and all points except the three fictitious ones. Points added
+	//after construction follow the input points.
+	Triangulation<2> get_triangulation() const {
+		Triangulation<2> tout;
+		tout.points.assign(points.begin(), points.begin()+npts);
+		tout.points.insert(tout.points.end(), points.begin()+npts+3, points.end());
+
+		auto index = [this](Int v){return (v < npts) ? v : v-3;};
+		tout.triangles.reserve(ntri);
+		for (auto t=0; t<ntree; t++){
+			const TriElem & tri = triangles[t];
+			if (tri.state <= 0) continue;
+			tout.triangles.push_back(IntPoint3(index(tri.vertices[0]), index(tri.vertices[1]), index(tri.vertices[2])));
+		}
+		return tout;
 	}
 
 
@@ -324,20 +872,36 @@ struct Delaunay {
 		key = hashfn.int64(a)-hashfn.int64(b);
 		linehash[key] = c;
 
+		//Grow the history storage if needed.
 		if (++ntree == ntreemax){
-			std::cerr << "Delaunay: Cannot store more triangles... out of space!" << std::endl;
-			throw("triangles is sized too small");
+			ntreemax *= 2;
+			triangles.resize(ntreemax);
 		} 
 		ntri++;
 		return (ntree-1);
 	}
 };
 
-const Doub Delaunay::fuzz = 1.0e-6;
 const Doub Delaunay::bigscale = 1000.0;
+
 Uint Delaunay::jran = 14921620;
 
 
+//Collect the points of a set of closed outline hulls, and the segments joining consecutive
+//points of each hull (including the closing one) as index pairs into pts.
+inline void get_hull_segments(const std::vector<Hull<2>> & hv, std::vector<Point<2>> & pts, std::vector<IntPoint2> & segs) {
+	for (auto h=0; h<hv.size(); h++){
+		Int off = pts.size(), n = hv[h].points.size();
+		pts.insert(pts.end(), hv[h].points.begin(), hv[h].points.end());
+		if (n < 2) continue;
+		for (auto i=0; i<n; i++){
+			if (hv[h].points[i] == hv[h].points[(i+1)%n]) continue;
+			segs.push_back(IntPoint2(off+i, off+(i+1)%n));
+		}
+	}
+}
+
+
 
 }
 
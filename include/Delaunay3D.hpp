@@ -0,0 +1,306 @@
+#ifndef _DELAUNAY3D_H
+#define _DELAUNAY3D_H
+
+#include "GeomUtils.hpp"
+#include "Predicates.hpp"
+#include "Delaunay.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace csg{
+
+
+// Incremental (Bowyer-Watson) Delaunay tetrahedralization
+//
+// Points are inserted in a biased randomized order: the shuffled input is
+// split into rounds of doubling size and each round is sorted along a
+// Morton curve, so consecutive insertions are spatially close. Each point
+// is located by a visibility walk starting from the most recently created
+// tetrahedron, and the cavity of tetrahedra whose circumsphere contains the
+// point is found through the adjacency array. All predicates are exact,
+// and cospherical ties are broken by Simulation of Simplicity, so the
+// result is the unique Delaunay tetrahedralization of the perturbed points.
+//
+// Tetrahedra are stored as flat arrays of 4 vertex indices and 4 neighbor
+// indices, where neighbor i is across the face opposite vertex i. All live
+// tetrahedra have orient3d(v0, v1, v2, v3) > 0.
+struct Delaunay3D {
+	Int 						npts, ntet;
+	std::vector<Point<3>> 		points;		// the input points followed by the 4 fictitious ones
+	std::vector<Int> 			tets;		// 4 vertex indices per tetrahedron, -1 if dead
+	std::vector<Int> 			neighbors;	// 4 neighbors per tetrahedron, -1 on the outer boundary
+	std::vector<Int> 			perm;		// insertion order
+	RandomHash 					hashfn;
+
+	static Uint jran;
+	static const Doub bigscale;
+
+
+	// Construct the Delaunay tetrahedralization of the points in pvec
+	Delaunay3D(const std::vector<Point<3>> & pvec)
+	: npts(pvec.size()), ntet(0), points(pvec), mLast(0), mStamp(0) {
+
+		tets.reserve(4*(7*npts+16));
+		neighbors.reserve(4*(7*npts+16));
+		mMark.reserve(7*npts+16);
+
+		// bounding box
+		Point<3> lo = pvec.empty() ? Point<3>(0,0,0) : pvec[0], hi = lo;
+		for (auto j=0; j<npts; j++){
+			for (auto d=0; d<3; d++){
+				lo.x[d] = std::min(lo.x[d], pvec[j].x[d]);
+				hi.x[d] = std::max(hi.x[d], pvec[j].x[d]);
+			}
+		}
+		Point<3> ctr = 0.5*(lo + hi);
+		Doub del = std::max(hi.x[0]-lo.x[0], std::max(hi.x[1]-lo.x[1], hi.x[2]-lo.x[2]));
+		if (del == 0.0) del = 1.0;
+		del *= bigscale;
+
+		// the four fictitious points of the enclosing tetrahedron. They are
+		// placed far away so that they do not shadow faces of the convex hull.
+		points.push_back(ctr + del*Point<3>( 1, 1, 1));
+		points.push_back(ctr + del*Point<3>( 1,-1,-1));
+		points.push_back(ctr + del*Point<3>(-1, 1,-1));
+		points.push_back(ctr + del*Point<3>(-1,-1, 1));
+		if (orient3d(points[npts], points[npts+1], points[npts+2], points[npts+3]) > 0)
+			store_tet(npts, npts+1, npts+2, npts+3);
+		else
+			store_tet(npts, npts+2, npts+1, npts+3);
+		for (auto f=0; f<4; f++) neighbors[f] = -1;
+
+		spatial_sort(lo, hi);
+		for (auto j=0; j<npts; j++) insert_point(perm[j]);
+	}
+
+
+	// Add the point with index r to the tetrahedralization. Exact duplicates
+	// of a point already in the tetrahedralization are skipped.
+	void insert_point(Int r){
+		const Point<3> & p = points[r];
+
+		Int t = locate(p, mLast);
+		if (t < 0){
+			std::cerr << "Delaunay3D: point lies outside of the bounding tetrahedron!" << std::endl;
+			throw("point outside bounding tetrahedron");
+		}
+		for (auto k=0; k<4; k++) if (points[tets[4*t+k]] == p) return;
+
+		// grow the cavity of tetrahedra whose circumsphere contains p.
+		// Marks are 2*stamp for cavity members and 2*stamp+1 for rejected
+		// neighbors, so nothing has to be cleared between insertions.
+		mStamp++;
+		const Uint in = 2*mStamp, out = 2*mStamp+1;
+		mCavity.clear();
+		mBoundary.clear();
+		mCavity.push_back(t);
+		mMark[t] = in;
+		for (auto i=0; i<mCavity.size(); i++){
+			Int c = mCavity[i];
+			for (auto f=0; f<4; f++){
+				Int n = neighbors[4*c+f];
+				if (n >= 0 && mMark[n] == in) continue;
+				if (n >= 0 && mMark[n] != out){
+					const Int * v = &tets[4*n];
+					if (in_sphere(points[v[0]], points[v[1]], points[v[2]], points[v[3]], p, v[0], v[1], v[2], v[3], r) > 0){
+						mMark[n] = in;
+						mCavity.push_back(n);
+						continue;
+					}
+					mMark[n] = out;
+				}
+				mBoundary.push_back(4*c+f);
+			}
+		}
+
+		// copy the boundary faces before the cavity is overwritten
+		mFaces.resize(mBoundary.size());
+		for (auto i=0; i<mBoundary.size(); i++){
+			Int c = mBoundary[i]/4, f = mBoundary[i]%4;
+			for (auto k=0; k<4; k++) mFaces[i].v[k] = tets[4*c+k];
+			mFaces[i].v[f] = r;
+			mFaces[i].slot = f;
+			mFaces[i].outside = neighbors[4*c+f];
+			mFaces[i].old = c;
+		}
+
+		// fill the cavity with the cone of boundary faces to p
+		mEdges.clear();
+		for (auto i=0; i<mFaces.size(); i++){
+			const Face & fc = mFaces[i];
+			Int nt = store_tet(fc.v[0], fc.v[1], fc.v[2], fc.v[3]);
+			mLast = nt;
+
+			// link to the tetrahedron outside the cavity
+			neighbors[4*nt+fc.slot] = fc.outside;
+			if (fc.outside >= 0){
+				for (auto k=0; k<4; k++){
+					if (neighbors[4*fc.outside+k] == fc.old) {neighbors[4*fc.outside+k] = nt; break;}
+				}
+			}
+
+			// link to the other new tetrahedra through the edges of the face
+			for (auto j=0; j<4; j++){
+				if (j == fc.slot) continue;
+				Int a = -1, b = -1;
+				for (auto k=0; k<4; k++){
+					if (k == j || k == fc.slot) continue;
+					if (a < 0) a = fc.v[k]; else b = fc.v[k];
+				}
+				Ullong key = (static_cast<Ullong>(std::min(a,b)) << 32) | static_cast<Uint>(std::max(a,b));
+				bool found = false;
+				for (auto e=0; e<mEdges.size(); e++){
+					if (mEdges[e].key != key) continue;
+					neighbors[4*nt+j] = mEdges[e].tet;
+					neighbors[4*mEdges[e].tet+mEdges[e].slot] = nt;
+					mEdges[e] = mEdges.back();
+					mEdges.pop_back();
+					found = true;
+					break;
+				}
+				if (!found) mEdges.push_back(Edge{key, nt, j});
+			}
+		}
+
+		// release the cavity only now, so that no new tetrahedron reuses the
+		// index of a cavity tetrahedron that is still referenced from outside
+		for (auto i=0; i<mCavity.size(); i++) erase_tet(mCavity[i]);
+	}
+
+
+	// Return a live tetrahedron containing p (possibly on its boundary),
+	// walking from the tetrahedron start, or -1 if p is outside.
+	Int locate(const Point<3> & p, Int start=0) const {
+		Int t = start;
+		if (t < 0 || t >= ntetmax() || tets[4*t] < 0){
+			for (t=0; t<ntetmax() && tets[4*t] < 0; t++);
+			if (t == ntetmax()) return -1;
+		}
+
+		Uint rnd = 2463534242u;
+		for (Ullong step=0; step<ntetmax()+4; step++){
+			rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+			Int f0 = rnd%4, f = -1;
+			for (auto k=0; k<4; k++){
+				const Point<3> * v[4] = {&points[tets[4*t]], &points[tets[4*t+1]], &points[tets[4*t+2]], &points[tets[4*t+3]]};
+				v[(f0+k)%4] = &p;
+				if (orient3d(*v[0], *v[1], *v[2], *v[3]) < 0) {f = (f0+k)%4; break;}
+			}
+			if (f < 0) return t;
+			t = neighbors[4*t+f];
+			if (t < 0) return -1;
+		}
+		return -1;
+	}
+
+
+	// Extract the tetrahedra that do not touch the fictitious points as a
+	// compact index array
+	Tetrahedralization get_tetrahedralization() const {
+		Tetrahedralization out;
+		out.points.assign(points.begin(), points.begin()+npts);
+		out.tetrahedra.reserve(ntet);
+		for (auto t=0; t<ntetmax(); t++){
+			if (tets[4*t] < 0) continue;
+			if (tets[4*t] >= npts || tets[4*t+1] >= npts || tets[4*t+2] >= npts || tets[4*t+3] >= npts) continue;
+			IntPoint<4> tet;
+			for (auto k=0; k<4; k++) tet.x[k] = tets[4*t+k];
+			out.tetrahedra.push_back(tet);
+		}
+		return out;
+	}
+
+	Int ntetmax() const {return tets.size()/4;};
+
+
+private:
+
+	struct Face{
+		Int v[4];		// vertices of the new tetrahedron
+		Int slot;		// position of the new point
+		Int outside;	// neighbor across the face
+		Int old;		// cavity tetrahedron the face came from
+	};
+
+	struct Edge{
+		Ullong key;
+		Int tet, slot;
+	};
+
+	Int 					mLast;		// most recently created tetrahedron
+	Uint 					mStamp;
+	std::vector<Uint> 		mMark;
+	std::vector<Int> 		mFree;		// dead tetrahedra available for reuse
+	std::vector<Int> 		mCavity, mBoundary;
+	std::vector<Face> 		mFaces;
+	std::vector<Edge> 		mEdges;
+
+
+	Int store_tet(Int a, Int b, Int c, Int d){
+		Int t;
+		if (!mFree.empty()){
+			t = mFree.back();
+			mFree.pop_back();
+		}
+		else {
+			t = ntetmax();
+			tets.resize(tets.size()+4);
+			neighbors.resize(neighbors.size()+4, -1);
+			mMark.push_back(0);
+		}
+		tets[4*t] = a; tets[4*t+1] = b; tets[4*t+2] = c; tets[4*t+3] = d;
+		mMark[t] = 0;
+		ntet++;
+		return t;
+	}
+
+	void erase_tet(Int t){
+		tets[4*t] = -1;
+		mFree.push_back(t);
+		ntet--;
+	}
+
+	// spread the low 21 bits of v so that there are two zeros between each bit
+	static Ullong spread_bits(Ullong v){
+		v &= 0x1fffff;
+		v = (v | v << 32) & 0x1f00000000ffffULL;
+		v = (v | v << 16) & 0x1f0000ff0000ffULL;
+		v = (v | v << 8)  & 0x100f00f00f00f00fULL;
+		v = (v | v << 4)  & 0x10c30c30c30c30c3ULL;
+		v = (v | v << 2)  & 0x1249249249249249ULL;
+		return v;
+	}
+
+	// biased randomized insertion order: shuffle, split into rounds of
+	// doubling size, and sort each round along a Morton curve
+	void spatial_sort(const Point<3> & lo, const Point<3> & hi){
+		perm.resize(npts);
+		for (auto j=0; j<npts; j++) perm[j] = j;
+		for (auto j=npts; j>0; j--) std::swap(perm[j-1], perm[hashfn.int64(jran++) % j]);
+
+		std::vector<std::pair<Ullong, Int>> keys(npts);
+		Doub scale[3];
+		for (auto d=0; d<3; d++) scale[d] = (hi.x[d] > lo.x[d]) ? 2097151.0/(hi.x[d]-lo.x[d]) : 0.0;
+		for (auto j=0; j<npts; j++){
+			const Point<3> & p = points[perm[j]];
+			Ullong key = 0;
+			for (auto d=0; d<3; d++) key |= spread_bits(static_cast<Ullong>((p.x[d]-lo.x[d])*scale[d])) << d;
+			keys[j] = std::make_pair(key, perm[j]);
+		}
+
+		Int end = npts;
+		while (end > 0){
+			Int begin = (end > 1000) ? end/2 : 0;
+			std::sort(keys.begin()+begin, keys.begin()+end);
+			end = begin;
+		}
+		for (auto j=0; j<npts; j++) perm[j] = keys[j].second;
+	}
+};
+
+const Doub Delaunay3D::bigscale = 1.0e6;
+Uint Delaunay3D::jran = 14921620;
+
+}
+#endif
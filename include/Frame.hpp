@@ -3,9 +3,79 @@
 
 #include <memory>
 #include <map>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include "PrimitiveTypes.hpp"
 
 namespace csg{
 
+// sample a scene at the centers of the cells of a grid, which has n[d]
+// cells along frame axis d and steps by step[d] in the scene. The results
+// go to out with the first axis fastest. Each row along the first axis is
+// a scan line, which the scene fills span by span with query_line(). The
+// rows are cut into tiles of up to 1024 cells by 16 rows, which the
+// threads take in turn. The first tile is done before the other threads
+// start, so that any index the scene builds on its first query is shared
+// by all of them
+template <std::size_t fdim, std::size_t scene_dim, typename SceneType, typename ValueT>
+void rasterize_grid(const SceneType & scene, const Point<scene_dim> & origin,
+					const std::array<Point<scene_dim>, fdim> & step,
+					const std::array<std::size_t, fdim> & n,
+					ValueT * out, unsigned int nthreads){
+	std::size_t nrows = 1;
+	for (auto d=1; d<fdim; d++) nrows *= n[d];
+	std::size_t ntx = (n[0]+1023)/1024;
+	std::size_t ntiles = ntx*((nrows+15)/16);
+	if (ntiles == 0) return;
+
+	auto tile = [&](std::size_t t){
+		std::size_t i0 = 1024*(t%ntx), i1 = std::min<std::size_t>(i0+1024, n[0]);
+		std::size_t r0 = 16*(t/ntx), r1 = std::min<std::size_t>(r0+16, nrows);
+		for (auto r=r0; r<r1; r++){
+			Point<scene_dim> p = origin;
+			for (std::size_t d=1, rr=r; d<fdim; rr/=n[d], d++) p = p + (double(rr%n[d])+0.5)*step[d];
+			scene.query_line(p, step[0], i0, i1, out + r*n[0]);
+		}
+	};
+
+	tile(0);
+	std::atomic<std::size_t> next(1);
+	auto work = [&](){
+		for (std::size_t t; (t = next++) < ntiles;) tile(t);
+	};
+
+	if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+	nthreads = std::min<std::size_t>(nthreads, ntiles);
+	std::vector<std::thread> pool;
+	for (auto i=1; i<nthreads; i++) pool.emplace_back(work);
+	work();
+	for (auto & th : pool) th.join();
+}
+
+// the same into a vector of the grid's size. A std::vector<bool> packs its
+// bits and has no array to write to, so bools go through a plain one
+template <std::size_t fdim, std::size_t scene_dim, typename SceneType, typename ValueT>
+void rasterize_grid(const SceneType & scene, const Point<scene_dim> & origin,
+					const std::array<Point<scene_dim>, fdim> & step,
+					const std::array<std::size_t, fdim> & n,
+					std::vector<ValueT> & out, unsigned int nthreads){
+	rasterize_grid<fdim>(scene, origin, step, n, out.data(), nthreads);
+}
+
+template <std::size_t fdim, std::size_t scene_dim, typename SceneType>
+void rasterize_grid(const SceneType & scene, const Point<scene_dim> & origin,
+					const std::array<Point<scene_dim>, fdim> & step,
+					const std::array<std::size_t, fdim> & n,
+					std::vector<bool> & out, unsigned int nthreads){
+	std::unique_ptr<bool[]> cells(new bool[out.size()]);
+	rasterize_grid<fdim>(scene, origin, step, n, cells.get(), nthreads);
+	std::copy(cells.get(), cells.get()+out.size(), out.begin());
+}
+
+
 template <typename SceneType, std::size_t scene_dim>
 class Frame1
 {
@@ -15,6 +85,9 @@ private:
 	Point<scene_dim>			mEnd;
 	Point<scene_dim>			mVec;
 public:
+	// the identifier type of the scene
+	typedef typename std::decay<decltype(std::declval<const SceneType &>().query_point(std::declval<Point<scene_dim>>()))>::type ValueT;
+
 	Frame1(const SceneType & s, Point<scene_dim> start, Point<scene_dim> end)
 	: mScene(std::make_shared<SceneType>(s)) 
 	, mStart(start)
@@ -28,6 +101,14 @@ public:
 
 	double length() const {return (mEnd-mStart).norm();};
 	Box<1> get_bounding_box() const {return Box<1>({0}, {length()});};
+
+	// the identifiers at the centers of n equal cells along the frame,
+	// sampled with nthreads threads (0 for all of the hardware threads)
+	std::vector<ValueT> rasterize(std::size_t n, unsigned int nthreads=0) const {
+		std::vector<ValueT> out(n);
+		rasterize_grid<1>(*mScene, mStart, std::array<Point<scene_dim>, 1>{{(length()/n)*mVec}}, std::array<std::size_t, 1>{{n}}, out, nthreads);
+		return out;
+	}
 };
 
 
@@ -51,25 +132,38 @@ private:
 	Point<scene_dim> 			mStart;
 	Point<scene_dim>			mEnd;
 	Point<scene_dim>			mVecX;
+	Point<scene_dim>			mVecY;		// derived from the corners once
 
 	double length_diag() const {return (mEnd-mStart).norm();};
-	Point<scene_dim> vecy() const {return ((mEnd-mStart) - lengthx()*mVecX).normalize();};
 public:
+	// the identifier type of the scene
+	typedef typename std::decay<decltype(std::declval<const SceneType &>().query_point(std::declval<Point<scene_dim>>()))>::type ValueT;
+
 	Frame2(const SceneType & s, Point<scene_dim> start, Point<scene_dim> end, Point<scene_dim> xvec)
 	: mScene(std::make_shared<SceneType>(s)) 
 	, mStart(start)
 	, mEnd(end)
 	, mVecX(xvec.normalize())
-	{};
+	{mVecY = ((mEnd-mStart) - lengthx()*mVecX).normalize();};
 
 	decltype(auto) query_point(Point<2> p) const {
-		// std::cout << " xvec: " << mVecX << " yvec: " << vecy() << " ";
-		return mScene->query_point(mStart + p.x[0]*mVecX + p.x[1]*vecy());
+		// std::cout << " xvec: " << mVecX << " yvec: " << mVecY << " ";
+		return mScene->query_point(mStart + p.x[0]*mVecX + p.x[1]*mVecY);
 	}
 
 	double lengthx() const {return Point<scene_dim>::dot((mEnd-mStart), mVecX);};
 	double lengthy() const {return sqrt(length_diag()*length_diag() - lengthx()*lengthx());};
 	Box<2> get_bounding_box() const {return Box<2>({0,0}, {lengthx(), lengthy()});};
+
+	// the identifiers at the centers of an nx by ny grid over the frame,
+	// in rows of x, sampled with nthreads threads (0 for all of the
+	// hardware threads)
+	std::vector<ValueT> rasterize(std::size_t nx, std::size_t ny, unsigned int nthreads=0) const {
+		std::vector<ValueT> out(nx*ny);
+		std::array<Point<scene_dim>, 2> step{{(lengthx()/nx)*mVecX, (lengthy()/ny)*mVecY}};
+		rasterize_grid<2>(*mScene, mStart, step, std::array<std::size_t, 2>{{nx, ny}}, out, nthreads);
+		return out;
+	}
 };
 
 
@@ -93,21 +187,24 @@ private:
 	Point<scene_dim>			mEnd;
 	Point<scene_dim>			mVecX;
 	Point<scene_dim> 			mVecY;
+	Point<scene_dim>			mVecZ;		// derived from the corners once
 
 	double length_diag() const {return (mEnd-mStart).norm();};
-	Point<scene_dim> vecz() const {return ((mEnd-mStart) - lengthx()*mVecX - lengthy()*mVecY).normalize();};
 public:
+	// the identifier type of the scene
+	typedef typename std::decay<decltype(std::declval<const SceneType &>().query_point(std::declval<Point<scene_dim>>()))>::type ValueT;
+
 	Frame3(const SceneType & s, Point<scene_dim> start, Point<scene_dim> end, Point<scene_dim> xvec, Point<scene_dim> yvec)
 	: mScene(std::make_shared<SceneType>(s)) 
 	, mStart(start)
 	, mEnd(end)
 	, mVecX(xvec.normalize())
 	, mVecY(yvec.normalize())
-	{};
+	{mVecZ = ((mEnd-mStart) - lengthx()*mVecX - lengthy()*mVecY).normalize();};
 
 	decltype(auto) query_point(Point<3> p) const {
-		// std::cout << " xvec: " << mVecX << " yvec: " << vecy() << " ";
-		return mScene->query_point(mStart + p.x[0]*mVecX + p.x[1]*mVecY + p.x[2]*vecz());
+		// std::cout << " xvec: " << mVecX << " yvec: " << mVecY << " ";
+		return mScene->query_point(mStart + p.x[0]*mVecX + p.x[1]*mVecY + p.x[2]*mVecZ);
 	}
 
 	double lengthx() const {return Point<scene_dim>::dot((mEnd-mStart), mVecX);};
@@ -115,6 +212,16 @@ public:
 	double lengthz() const {return sqrt(length_diag()*length_diag() - lengthx()*lengthx() - lengthy()*lengthy());};
 	Box<3> get_bounding_box() const {return Box<3>({0,0,0}, {lengthx(), lengthy(), lengthz()});};
 
+	// the identifiers at the centers of an nx by ny by nz grid over the
+	// frame, x fastest and z slowest, sampled with nthreads threads (0 for
+	// all of the hardware threads)
+	std::vector<ValueT> rasterize(std::size_t nx, std::size_t ny, std::size_t nz, unsigned int nthreads=0) const {
+		std::vector<ValueT> out(nx*ny*nz);
+		std::array<Point<scene_dim>, 3> step{{(lengthx()/nx)*mVecX, (lengthy()/ny)*mVecY, (lengthz()/nz)*mVecZ}};
+		rasterize_grid<3>(*mScene, mStart, step, std::array<std::size_t, 3>{{nx, ny, nz}}, out, nthreads);
+		return out;
+	}
+
 };
 
 
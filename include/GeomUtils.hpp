@@ -7,6 +7,7 @@
 #include <memory>
 #include <iterator>
 #include <algorithm>
+#include <limits>
 
 #include <sys/mman.h>
 #include <unistd.h>
@@ -64,7 +65,26 @@ struct Box{
 	}
 
 	static bool contains(const Box & bx, const Point<dim> & pt){
-		return distsq(bx, pt) == 0;
+		for (auto i=0; i<dim; i++){
+			if (pt.x[i] < bx.lo.x[i] || pt.x[i] > bx.hi.x[i]) return false;
+		}
+		return true;
+	}
+
+	// true if inner lies entirely within bx
+	static bool contains(const Box & bx, const Box & inner){
+		for (auto i=0; i<dim; i++){
+			if (inner.lo.x[i] < bx.lo.x[i] || inner.hi.x[i] > bx.hi.x[i]) return false;
+		}
+		return true;
+	}
+
+	// true if the boxes overlap (touching counts)
+	static bool collides(const Box & bx1, const Box & bx2){
+		for (auto i=0; i<dim; i++){
+			if (bx1.hi.x[i] < bx2.lo.x[i] || bx2.hi.x[i] < bx1.lo.x[i]) return false;
+		}
+		return true;
 	}
 
 	static Box bounding_box(const Box & bx1, const Box & bx2){
@@ -77,6 +97,29 @@ struct Box{
 		return Box(lo,hi);
 	}
 
+	// the overlap of two boxes, or the empty box if they don't collide
+	static Box intersection(const Box & bx1, const Box & bx2){
+		Point<dim> lo;
+		Point<dim> hi;
+		for (auto i=0; i<dim; i++){
+			lo.x[i] = std::max(bx1.lo.x[i], bx2.lo.x[i]);
+			hi.x[i] = std::min(bx1.hi.x[i], bx2.hi.x[i]);
+			if (lo.x[i] > hi.x[i]) return empty();
+		}
+		return Box(lo,hi);
+	}
+
+	// the box with lo at +infinity and hi at -infinity, which contains
+	// and collides with nothing and leaves bounding_box() unchanged
+	static Box empty(){
+		Point<dim> lo, hi;
+		for (auto i=0; i<dim; i++){
+			lo.x[i] = std::numeric_limits<double>::infinity();
+			hi.x[i] = -std::numeric_limits<double>::infinity();
+		}
+		return Box(lo,hi);
+	}
+
 	static Box translate(const Box & bx1, const Point<dim> & pt){
 		return Box(bx1.lo+pt, bx1.hi+pt);
 	}
@@ -99,6 +142,114 @@ BoxType bounding_box(const BoxType & bx1, const BoxType & bx2){
 	return BoxType::bounding_box(bx1, bx2);
 }
 
+// bounding box of a nonempty set of points
+template <std::size_t dim>
+Box<dim> bounding_box(const std::vector<Point<dim>> & pts){
+	Box<dim> bx(pts[0], pts[0]);
+	for (auto & p : pts){
+		for (auto d=0; d<dim; d++){
+			bx.lo.x[d] = std::min(bx.lo.x[d], p.x[d]);
+			bx.hi.x[d] = std::max(bx.hi.x[d], p.x[d]);
+		}
+	}
+	return bx;
+}
+
+
+// order the indices idx[begin, end) so that boxes close to each other are
+// close in the ordering. The range is split at its midpoint by the box
+// centers along the longest axis of their extent, and each half is
+// ordered recursively, so that halving the range again recovers the
+// same groups
+template <std::size_t dim>
+void locality_sort(const std::vector<Box<dim>> & boxes, std::vector<std::size_t> & idx, std::size_t begin, std::size_t end){
+	if (end - begin <= 2) return;
+
+	Point<dim> lo, hi;
+	for (auto d=0; d<dim; d++){
+		lo.x[d] = hi.x[d] = boxes[idx[begin]].lo.x[d] + boxes[idx[begin]].hi.x[d];
+	}
+	for (auto i=begin+1; i<end; i++){
+		for (auto d=0; d<dim; d++){
+			double c = boxes[idx[i]].lo.x[d] + boxes[idx[i]].hi.x[d];
+			lo.x[d] = std::min(lo.x[d], c);
+			hi.x[d] = std::max(hi.x[d], c);
+		}
+	}
+	std::size_t axis = 0;
+	for (auto d=1; d<dim; d++) if (hi.x[d]-lo.x[d] > hi.x[axis]-lo.x[axis]) axis = d;
+
+	std::size_t mid = begin + (end-begin)/2;
+	std::nth_element(idx.begin()+begin, idx.begin()+mid, idx.begin()+end, [&](std::size_t a, std::size_t b){
+		return boxes[a].lo.x[axis] + boxes[a].hi.x[axis] < boxes[b].lo.x[axis] + boxes[b].hi.x[axis];
+	});
+	locality_sort(boxes, idx, begin, mid);
+	locality_sort(boxes, idx, mid, end);
+}
+
+
+// rebuilds a tree for the rebalance() of the tree classes, which befriend
+// it. push_back makes a tree a left-deep chain as deep as its number of
+// parts, so each run of the same UNION, INTERSECT or XOR becomes a balanced
+// tree whose neighboring operands have nearby bounding boxes, and each
+// chain of differences ((a-b)-c)-... becomes a-(b|c|...), after which
+// queries only descend O(log N) levels. A subtree for which
+// NodeT::whole() holds is kept out of its parent's run, and NodeT::mark()
+// passes on what a rebuilt node carries besides its operation. Subtrees
+// shared with other trees are not modified
+template <class NodeT>
+struct TreeBalancer{
+	typedef std::shared_ptr<NodeT> 		NodePtr;
+
+	static NodePtr balanced(const NodePtr & node){
+		if (node->m_isleaf) return node;
+
+		std::vector<NodePtr> operands;
+		NodePtr out;
+		if (node->m_op == DIFFERENCE){
+			NodePtr n = node;
+			for (; !n->m_isleaf && n->m_op == DIFFERENCE && (n == node || !NodeT::whole(*n)); n = n->m_ldaughter){
+				operands.push_back(balanced(n->m_rdaughter));
+			}
+			out = std::make_shared<NodeT>(balanced(n), build(operands, UNION), DIFFERENCE);
+		}
+		else {
+			std::vector<NodePtr> stack(1, node);
+			while (!stack.empty()){
+				NodePtr n = stack.back();
+				stack.pop_back();
+				if (!n->m_isleaf && n->m_op == node->m_op && (n == node || !NodeT::whole(*n))){
+					stack.push_back(n->m_rdaughter);
+					stack.push_back(n->m_ldaughter);
+				}
+				else operands.push_back(balanced(n));
+			}
+			out = build(operands, node->m_op);
+		}
+		NodeT::mark(*out, *node);
+		return out;
+	}
+
+	// join the operands with op in a balanced tree, ordered by the
+	// locality of their bounding boxes
+	static NodePtr build(const std::vector<NodePtr> & operands, Operation op){
+		std::vector<decltype(operands[0]->get_bounding_box())> boxes(operands.size());
+		std::vector<std::size_t> idx(operands.size());
+		for (auto i=0; i<operands.size(); i++){
+			boxes[i] = operands[i]->get_bounding_box();
+			idx[i] = i;
+		}
+		locality_sort(boxes, idx, 0, idx.size());
+		return build(operands, idx, 0, idx.size(), op);
+	}
+
+	static NodePtr build(const std::vector<NodePtr> & operands, const std::vector<std::size_t> & idx, std::size_t begin, std::size_t end, Operation op){
+		if (end - begin == 1) return operands[idx[begin]];
+		std::size_t mid = begin + (end-begin)/2;
+		return std::make_shared<NodeT>(build(operands, idx, begin, mid, op), build(operands, idx, mid, end, op), op);
+	}
+};
+
 
 
 
@@ -138,6 +289,122 @@ inline double circumradius(const Point<2> & p1, const Point<2> & p2, const Point
 }
 
 
+// distance from pt to the line segment p1-->p2
+template <std::size_t dim>
+inline double segment_distance(const Point<dim> & pt, const Point<dim> & p1, const Point<dim> & p2){
+	Point<dim> d = p2 - p1, v = pt - p1;
+	double lsq = Point<dim>::dot(d, d);
+	double t = (lsq > 0) ? std::max(0.0, std::min(1.0, Point<dim>::dot(v, d)/lsq)) : 0.0;
+	return (v - t*d).norm();
+}
+
+// signed distance to the intersection of two regions that are each
+// extruded along the other's direction, such as the two slabs of a
+// rectangle or the base and height of a prism, from the signed distances
+// e0 and e1 to each region. Exact if e0 and e1 are
+inline double orthogonal_signed_distance(double e0, double e1){
+	double a = std::max(e0, 0.0), b = std::max(e1, 0.0);
+	return sqrt(a*a + b*b) + std::min(std::max(e0, e1), 0.0);
+}
+
+// the corners of a 2D box, counterclockwise
+inline std::vector<Point<2>> box_corners(const Box<2> & bx){
+	return {bx.lo, Point<2>(bx.hi.x[0], bx.lo.x[1]), bx.hi, Point<2>(bx.lo.x[0], bx.hi.x[1])};
+}
+
+// true if the convex polygons a and b, with vertices in consecutive
+// order, overlap. Either may also be a segment or a single point.
+// This is the separating axis test over the edge normals of both.
+// If closed is false, polygons that only touch do not overlap
+inline bool convex_overlap(const std::vector<Point<2>> & a, const std::vector<Point<2>> & b, bool closed = true){
+	if (a.empty() || b.empty()) return false;
+	for (auto pass=0; pass<2; pass++){
+		const std::vector<Point<2>> & p = pass ? b : a;
+		for (auto i=0; i<p.size(); i++){
+			const Point<2> & p1 = p[i];
+			const Point<2> & p2 = p[(i+1)%p.size()];
+			Point<2> n(p1.x[1]-p2.x[1], p2.x[0]-p1.x[0]);
+			if (n.x[0] == 0 && n.x[1] == 0) continue;
+
+			double alo = Point<2>::dot(a[0], n), ahi = alo;
+			for (auto j=1; j<a.size(); j++){
+				double s = Point<2>::dot(a[j], n);
+				alo = std::min(alo, s); ahi = std::max(ahi, s);
+			}
+			double blo = Point<2>::dot(b[0], n), bhi = blo;
+			for (auto j=1; j<b.size(); j++){
+				double s = Point<2>::dot(b[j], n);
+				blo = std::min(blo, s); bhi = std::max(bhi, s);
+			}
+			if (closed ? (ahi < blo || bhi < alo) : (ahi <= blo || bhi <= alo)) return false;
+		}
+	}
+	return true;
+}
+
+// clip the interval [tlo, thi] of parameters of the line a + t*dir to
+// where it crosses the convex polygon poly, with vertices in consecutive
+// order of either winding. Returns false if the line misses it
+inline bool clip_line_convex(const std::vector<Point<2>> & poly, const Point<2> & a, const Point<2> & dir, double & tlo, double & thi){
+	double area = 0;
+	for (auto i=0; i<poly.size(); i++){
+		const Point<2> & p = poly[i], & q = poly[(i+1)%poly.size()];
+		area += p.x[0]*q.x[1] - q.x[0]*p.x[1];
+	}
+	double orient = (area < 0) ? -1.0 : 1.0;
+	for (auto i=0; i<poly.size(); i++){
+		const Point<2> & p = poly[i], & q = poly[(i+1)%poly.size()];
+		Point<2> e = q - p;
+		double f0 = orient*(e.x[0]*(a.x[1]-p.x[1]) - e.x[1]*(a.x[0]-p.x[0]));
+		double f1 = orient*(e.x[0]*dir.x[1] - e.x[1]*dir.x[0]);
+		if (f1 == 0) {if (f0 < 0) return false; continue;}
+		if (f1 > 0) tlo = std::max(tlo, -f0/f1);
+		else thi = std::min(thi, -f0/f1);
+	}
+	return tlo <= thi;
+}
+
+// the interval [tlo, thi] of parameters of the line a + t*dir inside the
+// circle or sphere of given center and radius. Returns false if the line
+// misses it or dir is zero
+template <std::size_t dim>
+inline bool clip_line_ball(const Point<dim> & center, double radius, const Point<dim> & a, const Point<dim> & dir, double & tlo, double & thi){
+	Point<dim> d = a - center;
+	double qa = Point<dim>::dot(dir, dir), qb = Point<dim>::dot(dir, d), qc = Point<dim>::dot(d, d) - radius*radius;
+	double disc = qb*qb - qa*qc;
+	if (qa == 0 || disc < 0) return false;
+	double sq = sqrt(disc);
+	tlo = (-qb-sq)/qa;
+	thi = (-qb+sq)/qa;
+	return true;
+}
+
+// convex hull of a set of 2D points, counterclockwise without
+// collinear points (Andrew's monotone chain)
+inline std::vector<Point<2>> convex_hull(std::vector<Point<2>> pts){
+	std::sort(pts.begin(), pts.end(), [](const Point<2> & p, const Point<2> & q){
+		return p.x[0] < q.x[0] || (p.x[0] == q.x[0] && p.x[1] < q.x[1]);
+	});
+	if (pts.size() < 3) return pts;
+
+	auto cross = [](const Point<2> & o, const Point<2> & p, const Point<2> & q){
+		return (p.x[0]-o.x[0])*(q.x[1]-o.x[1]) - (p.x[1]-o.x[1])*(q.x[0]-o.x[0]);
+	};
+	std::vector<Point<2>> hull(2*pts.size());
+	std::size_t k = 0;
+	for (auto i=0; i<pts.size(); i++){
+		while (k >= 2 && cross(hull[k-2], hull[k-1], pts[i]) <= 0) k--;
+		hull[k++] = pts[i];
+	}
+	for (auto i=pts.size()-1, t=k+1; i>0; i--){
+		while (k >= t && cross(hull[k-2], hull[k-1], pts[i-1]) <= 0) k--;
+		hull[k++] = pts[i-1];
+	}
+	hull.resize(k > 1 ? k-1 : k);
+	return hull;
+}
+
+
 
 
 
@@ -190,32 +457,110 @@ struct Plane{
 
 	// empty constructor
 	Plane()
-	: origin(0,0,0), normal(0,0,1), posx(1,0,0) {};
+	: origin(0,0,0), normal(0,0,1), posx(1,0,0), posy(0,1,0) {};
 	// : origin(Point<3> (0,0,0)), normal(Point<3> (0,0,1), posx(Point<3> (1,0,0))) {};
 
 	// constructor
 	Plane(const Point<3> & p, const Point<3> & n, const Point<3> & px)
-	: origin(p), normal(n), posx(px) {};
+	: origin(p), normal(n), posx(px), posy(cross(n, px)) {};
 
 	// project a point onto the plane
 	Point<2> project(const Point<3> & pt) const{
 		Point<3> ptvec(pt.x[0]-origin.x[0], pt.x[1]-origin.x[1], pt.x[2]-origin.x[2]);
-		double px = Point<3>::dot(ptvec, posx);
-
-		// the y direction is Z x X
-		Point<3> posy(normal.x[1]*posx.x[2] - normal.x[2]*posx.x[1],
-					  normal.x[2]*posx.x[0] - normal.x[0]*posx.x[2],
-					  normal.x[0]*posx.x[1] - normal.x[1]*posx.x[0]);
-
-		double py = Point<3>::dot(ptvec, posy);
-		return Point<2>(px, py);
+		return Point<2>(Point<3>::dot(ptvec, posx), Point<3>::dot(ptvec, posy));
 	}
 
 	// data
 	Point<3> origin, normal, posx;
+	Point<3> posy;		// the y direction is Z x X, fixed at construction
 
 };
 
+// the projection onto the plane of the part of bx that lies between the
+// plane and its parallel at the given height, as a counterclockwise
+// convex polygon (empty if the box misses the slab). If clip is false
+// the whole box is projected
+inline std::vector<Point<2>> slab_section(const Plane & pl, double height, const Box<3> & bx, bool clip = true){
+	Point<3> c[8];
+	double h[8];
+	for (auto i=0; i<8; i++){
+		c[i] = Point<3>((i&1) ? bx.hi.x[0] : bx.lo.x[0], (i&2) ? bx.hi.x[1] : bx.lo.x[1], (i&4) ? bx.hi.x[2] : bx.lo.x[2]);
+		h[i] = Point<3>::dot(c[i] - pl.origin, pl.normal);
+	}
+
+	std::vector<Point<2>> pts;
+	for (auto i=0; i<8; i++){
+		if (!clip || (h[i] >= 0 && h[i] <= height)) pts.push_back(pl.project(c[i]));
+	}
+	if (clip){
+		// edges of the box that cross either face of the slab
+		for (auto i=0; i<8; i++){
+			for (auto d=0; d<3; d++){
+				if (i & (1<<d)) continue;
+				auto j = i | (1<<d);
+				for (double f : {0.0, height}){
+					if ((h[i] < f) == (h[j] < f) || h[i] == h[j]) continue;
+					double t = (f - h[i])/(h[j] - h[i]);
+					pts.push_back(pl.project(c[i] + t*(c[j] - c[i])));
+				}
+			}
+		}
+	}
+	return convex_hull(pts);
+}
+
+// unit vectors e1, e2 completing the unit axis u to a right-handed frame,
+// with e1 pointing from the axis toward the offset v where it can
+inline void axis_frame(const Point<3> & u, const Point<3> & v, Point<3> & e1, Point<3> & e2){
+	Point<3> w = v - Point<3>::dot(v, u)*u;
+	if (w.norm() == 0) w = fabs(u.x[0]) < 0.9 ? Point<3>(1, 0, 0) - u.x[0]*u : Point<3>(0, 1, 0) - u.x[1]*u;
+	e1 = w.normalize();
+	e2 = cross(u, e1);
+}
+
+// the box around the solid swept by turning bb about the axis through rpt
+// along the unit vector u, stretched along the axis by ext each way
+inline Box<3> revolved_bounding_box(const Point<3> & rpt, const Point<3> & u, const Box<3> & bb, double ext = 0){
+	double rmax = 0, amin = std::numeric_limits<double>::max(), amax = -std::numeric_limits<double>::max();
+	for (auto c=0; c<8; c++){
+		Point<3> q(c & 1 ? bb.hi.x[0] : bb.lo.x[0], c & 2 ? bb.hi.x[1] : bb.lo.x[1], c & 4 ? bb.hi.x[2] : bb.lo.x[2]);
+		q = q - rpt;
+		double a = Point<3>::dot(q, u);
+		amin = std::min(amin, a);
+		amax = std::max(amax, a);
+		rmax = std::max(rmax, (q - a*u).norm());
+	}
+	Point<3> d(rmax*sqrt(std::max(0.0, 1-u.x[0]*u.x[0])), rmax*sqrt(std::max(0.0, 1-u.x[1]*u.x[1])), rmax*sqrt(std::max(0.0, 1-u.x[2]*u.x[2])));
+	Point<3> p0 = rpt + (amin-ext)*u, p1 = rpt + (amax+ext)*u;
+	return Box<3>::bounding_box(Box<3>(p0-d, p0+d), Box<3>(p1-d, p1+d));
+}
+
+// the bounding box of the prism that sweeps the base box in the plane up
+// to the given height along the normal
+inline Box<3> slab_bounding_box(const Plane & pl, double height, const Box<2> & basebox){
+	Point<3> xhat = pl.posx.normalize(), yhat = pl.posy.normalize(), nhat = pl.normal.normalize();
+	Point<3> lo = pl.origin, hi = pl.origin;
+	for (auto i=0; i<8; i++){
+		Point<3> c = xhat*((i&1) ? basebox.hi.x[0] : basebox.lo.x[0]) + yhat*((i&2) ? basebox.hi.x[1] : basebox.lo.x[1]) + pl.origin + ((i&4) ? height : 0.0)*nhat;
+		if (i == 0) lo = hi = c;
+		for (auto d=0; d<3; d++){
+			lo.x[d] = std::min(lo.x[d], c.x[d]);
+			hi.x[d] = std::max(hi.x[d], c.x[d]);
+		}
+	}
+	return Box<3>(lo, hi);
+}
+
+// true if bx lies between the plane and its parallel at the given height
+inline bool slab_contains(const Plane & pl, double height, const Box<3> & bx){
+	for (auto i=0; i<8; i++){
+		Point<3> c((i&1) ? bx.hi.x[0] : bx.lo.x[0], (i&2) ? bx.hi.x[1] : bx.lo.x[1], (i&4) ? bx.hi.x[2] : bx.lo.x[2]);
+		double h = Point<3>::dot(c - pl.origin, pl.normal);
+		if (h < 0 || h > height) return false;
+	}
+	return true;
+}
+
 // static const Plane XYPlane = Plane(Point3(0,0,0),Point3(0,0,1),Point3(1,0,0));
 
 // typedef Plane(Point<3>(0,0,0),Point<3>(0,0,1),Point<3>(1,0,0)) XYPLANE;
@@ -391,6 +736,16 @@ struct Triangulation{
 };
 
 
+struct Tetrahedralization{
+
+	std::vector<Point<3>> points;			// list of points
+	std::vector<IntPoint<4>> tetrahedra;	// list of tetrahedra as indices in the points vector
+
+	Tetrahedralization() {};
+
+};
+
+
 #pragma pack(push,1)
 struct stl_tri{
 	float norm_x;
@@ -2,11 +2,23 @@
 #define _LINEARTRANSFORMATION_H
 
 #include "GeomUtils.hpp"
+#include "PrimitiveTypes.hpp"
+#include "Primitive2D.hpp"
+#include "Primitive3D.hpp"
 #include <memory>
+#include <type_traits>
 
 namespace csg{
 
 
+// the largest singular value of the 2x2 matrix with columns c0 and c1
+inline double spectral_norm(const Point<2> & c0, const Point<2> & c1){
+	double ssq = Point<2>::dot(c0, c0) + Point<2>::dot(c1, c1);
+	double det = c0.x[0]*c1.x[1] - c1.x[0]*c0.x[1];
+	return sqrt(0.5*(ssq + sqrt(std::max(0.0, ssq*ssq - 4*det*det))));
+}
+
+
 
 // shear map implemented as M = I + S, where I is diagonal and S is off-diagonals
 struct ShearMap2D{
@@ -26,6 +38,11 @@ public:
 		return PointT(p.x[0]+mL.x[0]*p.x[1], p.x[1] + mL.x[1]*p.x[0]);
 	};
 
+	// the norm of the inverse map
+	double inverse_norm() const{
+		return spectral_norm(inverse_map(PointT(1, 0)), inverse_map(PointT(0, 1)));
+	};
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
 		os << "<ShearMapping>" << mL << "</ShearMapping>" << std::endl;
@@ -60,6 +77,12 @@ public:
 		return PointT(p.x[0]+a*p.x[1]+b*p.x[2], d*p.x[0]+p.x[1]+c*p.x[2], e*p.x[0]+f*p.x[1]+p.x[2]);
 	};
 
+	// a bound on the norm of the inverse map, its Frobenius norm
+	double inverse_norm() const{
+		PointT c0 = inverse_map(PointT(1, 0, 0)), c1 = inverse_map(PointT(0, 1, 0)), c2 = inverse_map(PointT(0, 0, 1));
+		return sqrt(PointT::dot(c0, c0) + PointT::dot(c1, c1) + PointT::dot(c2, c2));
+	};
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<ShearMapping>" << std::endl;
@@ -96,6 +119,11 @@ public:
 		return PointT(p.x[0]*(1.0+mL.x[0]), p.x[1]*(1.0+mL.x[1]));
 	};
 
+	// the norm of the inverse map
+	double inverse_norm() const{
+		return std::max(1.0/fabs(1.0+mL.x[0]), 1.0/fabs(1.0+mL.x[1]));
+	};
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
 		os << "<DilatationMapping>" << mL << "</DilatationMapping>" << std::endl;
@@ -122,6 +150,9 @@ public:
 		return PointT(cos(mTheta)*p.x[0]-sin(mTheta)*p.x[1], cos(mTheta)*p.x[1]+sin(mTheta)*p.x[0]);
 	};
 
+	// the norm of the inverse map
+	double inverse_norm() const {return 1.0;};
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
 		os << "<RotationMapping>" << mTheta << "</RotationMapping>" << std::endl;
@@ -146,6 +177,9 @@ public:
 		return PointT(p.x[0] + mL.x[0], p.x[1] + mL.x[1]);
 	};
 
+	// the norm of the inverse map
+	double inverse_norm() const {return 1.0;};
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
 		os << "<TranslationMapping>" << mL << "</TranslationMapping>" << std::endl;
@@ -154,14 +188,233 @@ public:
 
 
 
+// general affine map x -> A x + t, with the inverse matrix and offset
+// computed once so that each inverse_map is a single multiply-add
+template <std::size_t dim>
+struct AffineMap{
+public:
+	typedef Point<dim> 					PointT;
+	typedef Box<dim>					BoxT;
+	double 								mA[dim][dim], mAinv[dim][dim]; // row major
+	PointT 								mT, mTinv; // inverse_map(p) = mAinv*p + mTinv
+
+	// the identity
+	AffineMap(){
+		for (auto i=0; i<dim; i++){
+			for (auto j=0; j<dim; j++) mA[i][j] = (i == j ? 1.0 : 0.0);
+			mT.x[i] = 0;
+		}
+		invert();
+	}
+
+	AffineMap(const double (&A)[dim][dim], const PointT & t) : mT(t) {
+		for (auto i=0; i<dim; i++) for (auto j=0; j<dim; j++) mA[i][j] = A[i][j];
+		invert();
+	}
+
+	// the affine map that agrees with any other map policy, read off
+	// from the images of the origin and the unit vectors
+	template <class MapPolicy>
+	static AffineMap from_map(const MapPolicy & m){
+		PointT o;
+		for (auto i=0; i<dim; i++) o.x[i] = 0;
+		AffineMap out;
+		out.mT = m.forward_map(o);
+		for (auto j=0; j<dim; j++){
+			PointT e(o);
+			e.x[j] = 1;
+			PointT c = m.forward_map(e) - out.mT;
+			for (auto i=0; i<dim; i++) out.mA[i][j] = c.x[i];
+		}
+		out.invert();
+		return out;
+	}
+
+	// the map x -> outer(inner(x))
+	static AffineMap compose(const AffineMap & outer, const AffineMap & inner){
+		AffineMap out;
+		for (auto i=0; i<dim; i++){
+			for (auto j=0; j<dim; j++){
+				out.mA[i][j] = 0;
+				for (auto k=0; k<dim; k++) out.mA[i][j] += outer.mA[i][k]*inner.mA[k][j];
+			}
+		}
+		out.mT = outer.forward_map(inner.mT);
+		out.invert();
+		return out;
+	}
+
+	PointT inverse_map(const PointT & p) const{
+		PointT out(mTinv);
+		for (auto i=0; i<dim; i++) for (auto j=0; j<dim; j++) out.x[i] += mAinv[i][j]*p.x[j];
+		return out;
+	};
+
+	PointT forward_map(const PointT & p) const{
+		PointT out(mT);
+		for (auto i=0; i<dim; i++) for (auto j=0; j<dim; j++) out.x[i] += mA[i][j]*p.x[j];
+		return out;
+	};
+
+	// the norm of the inverse map: exact in 2D, the Frobenius bound in 3D
+	double inverse_norm() const{
+		if (dim == 2) return spectral_norm(Point<2>(mAinv[0][0], mAinv[1][0]), Point<2>(mAinv[0][1], mAinv[1][1]));
+		double ssq = 0;
+		for (auto i=0; i<dim; i++) for (auto j=0; j<dim; j++) ssq += mAinv[i][j]*mAinv[i][j];
+		return sqrt(ssq);
+	};
+
+	// and of the forward map
+	double forward_norm() const{
+		if (dim == 2) return spectral_norm(Point<2>(mA[0][0], mA[1][0]), Point<2>(mA[0][1], mA[1][1]));
+		double ssq = 0;
+		for (auto i=0; i<dim; i++) for (auto j=0; j<dim; j++) ssq += mA[i][j]*mA[i][j];
+		return sqrt(ssq);
+	};
+
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<AffineMapping>" << std::endl;
+		for (auto i=0; i<dim; i++){
+			for (auto j=0; j<ntabs+2; j++) os << "\t" ;
+			os << "<Row>";
+			for (auto j=0; j<dim; j++) os << (j ? ", " : "") << mA[i][j];
+			os << "</Row>" << std::endl;
+		}
+		for (auto i=0; i<ntabs+2; i++) os << "\t" ;
+		os << "<Translation>" << mT << "</Translation>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "</AffineMapping>" << std::endl;
+	}
+
+private:
+
+	// Gauss-Jordan elimination with partial pivoting
+	void invert(){
+		double a[dim][dim];
+		for (auto i=0; i<dim; i++) for (auto j=0; j<dim; j++){
+			a[i][j] = mA[i][j];
+			mAinv[i][j] = (i == j ? 1.0 : 0.0);
+		}
+		for (auto c=0; c<dim; c++){
+			auto piv = c;
+			for (auto r=c+1; r<dim; r++) if (fabs(a[r][c]) > fabs(a[piv][c])) piv = r;
+			if (a[piv][c] == 0.0){
+				std::cerr << "AffineMap: the matrix is singular" << std::endl;
+				throw("singular affine map");
+			}
+			for (auto j=0; j<dim; j++){
+				std::swap(a[c][j], a[piv][j]);
+				std::swap(mAinv[c][j], mAinv[piv][j]);
+			}
+			double d = 1.0/a[c][c];
+			for (auto j=0; j<dim; j++){a[c][j] *= d; mAinv[c][j] *= d;}
+			for (auto r=0; r<dim; r++){
+				if (r == c || a[r][c] == 0.0) continue;
+				double f = a[r][c];
+				for (auto j=0; j<dim; j++){a[r][j] -= f*a[c][j]; mAinv[r][j] -= f*mAinv[c][j];}
+			}
+		}
+		for (auto i=0; i<dim; i++){
+			mTinv.x[i] = 0;
+			for (auto j=0; j<dim; j++) mTinv.x[i] -= mAinv[i][j]*mT.x[j];
+		}
+	}
+};
+
+typedef AffineMap<2> 		AffineMap2D;
+typedef AffineMap<3> 		AffineMap3D;
+
+
+
+// the box around the images of the corners of bx, which bounds the image
+// of anything inside bx
+template <std::size_t dim, class MapPolicy>
+Box<dim> mapped_box_corners(const MapPolicy & m, const Box<dim> & bx){
+	Box<dim> out(m.forward_map(bx.lo), m.forward_map(bx.lo));
+	for (auto c=1; c<(1<<dim); c++){
+		Point<dim> corner = bx.lo;
+		for (auto d=0; d<dim; d++) if (c & (1<<d)) corner.x[d] = bx.hi.x[d];
+		Point<dim> p = m.forward_map(corner);
+		out = Box<dim>::bounding_box(out, Box<dim>(p, p));
+	}
+	return out;
+}
+
+// the box around the images of a set of points
+template <std::size_t dim>
+Box<dim> mapped_points_box(const AffineMap<dim> & m, const std::vector<Point<dim>> & pts){
+	Point<dim> p = m.forward_map(pts[0]);
+	Box<dim> out(p, p);
+	for (auto k=1; k<pts.size(); k++){
+		p = m.forward_map(pts[k]);
+		out = Box<dim>::bounding_box(out, Box<dim>(p, p));
+	}
+	return out;
+}
+
+// the exact box around a ball mapped to an ellipsoid: along each axis it
+// reaches r times the length of the corresponding row of the matrix
+template <std::size_t dim>
+Box<dim> mapped_ball_box(const AffineMap<dim> & m, const Point<dim> & c, double r){
+	Point<dim> cen = m.forward_map(c), ext;
+	for (auto i=0; i<dim; i++){
+		double ssq = 0;
+		for (auto j=0; j<dim; j++) ssq += m.mA[i][j]*m.mA[i][j];
+		ext.x[i] = r*sqrt(ssq);
+	}
+	return Box<dim>(cen - ext, cen + ext);
+}
+
+// the box around a primitive mapped by an affine map. Circles, spheres,
+// rectangles and triangles are bounded exactly; anything else through
+// the corners of its own box
+inline Box<2> mapped_bounding_box(const AffineMap2D & m, const Primitive2D & prim){
+	if (auto c = dynamic_cast<const Circle *>(&prim)) return mapped_ball_box(m, c->center(), c->radius());
+	if (auto r = dynamic_cast<const Rectangle *>(&prim)){
+		double ct = cos(r->rotation()), st = sin(r->rotation());
+		double hx = 0.5*r->dims().x[0], hy = 0.5*r->dims().x[1];
+		return mapped_points_box(m, {r->center() + Point<2>(ct*hx - st*hy, st*hx + ct*hy), r->center() + Point<2>(-ct*hx - st*hy, -st*hx + ct*hy),
+									 r->center() + Point<2>(ct*hx + st*hy, st*hx - ct*hy), r->center() + Point<2>(-ct*hx + st*hy, -st*hx - ct*hy)});
+	}
+	if (auto t = dynamic_cast<const Triangle *>(&prim)) return mapped_points_box(m, {t->vertex(0), t->vertex(1), t->vertex(2)});
+	return mapped_box_corners(m, prim.get_bounding_box());
+}
+
+inline Box<3> mapped_bounding_box(const AffineMap3D & m, const Primitive3D & prim){
+	if (auto s = dynamic_cast<const Sphere *>(&prim)) return mapped_ball_box(m, s->center(), s->radius());
+	return mapped_box_corners(m, prim.get_bounding_box());
+}
+
+
+
+// every LinearTransformation also carries its map composed with those of
+// any LinearTransformations nested directly beneath it, together with the
+// innermost primitive. Queries go through this fused map, so a stack of
+// transformations costs one matrix multiply whatever its map policies
+template <class PrimitiveType>
+struct AffineChain{
+	static const std::size_t dim = std::extent<decltype(PrimitiveType::PointT::x)>::value;
+
+	AffineMap<dim> 						mAffine;
+	std::shared_ptr<PrimitiveType>		mBase;
+
+	virtual ~AffineChain() {};
+};
+
+
+
 template <class PrimitiveType, class MapPolicy>
-class LinearTransformation : public PrimitiveType
+class LinearTransformation : public PrimitiveType, public AffineChain<PrimitiveType>
 {
 public:
 	typedef LinearTransformation 		SelfT;
 	typedef PrimitiveType				PrimitiveT;
 	typedef typename MapPolicy::PointT 	PointT;
 	typedef typename MapPolicy::BoxT	BoxT;
+	typedef AffineChain<PrimitiveT>		ChainT;
+	using ChainT::mAffine;
+	using ChainT::mBase;
 
 
 	MapPolicy 							mMap; // holds the components of the transformation
@@ -169,10 +422,23 @@ public:
 
 
 	LinearTransformation(std::shared_ptr<PrimitiveT> prim, const MapPolicy & m)
-	: mPrim(prim), mMap(m) {};//{mPrim = std::make_shared<PrimitiveT>(prim
+	: mPrim(prim), mMap(m) {
+		mAffine = AffineMap<ChainT::dim>::from_map(mMap);
+		mBase = mPrim;
+		const ChainT * inner = dynamic_cast<const ChainT *>(mPrim.get());
+		if (inner != nullptr){
+			mAffine = AffineMap<ChainT::dim>::compose(mAffine, inner->mAffine);
+			mBase = inner->mBase;
+		}
+		// both the innermost primitive under the fused map and the box of
+		// the nested primitive under this map bound the image, so keep the
+		// overlap of the two. All corners are mapped, since a rotation or
+		// shear does not keep lo and hi at the extremes
+		mBox = BoxT::intersection(mapped_bounding_box(mAffine, *mBase), mapped_box_corners(mMap, mPrim->get_bounding_box()));
+	};
 
 	LinearTransformation(const LinearTransformation & t)
-	: mPrim(t.mPrim), mMap(t.mMap) {};
+	: ChainT(t), mPrim(t.mPrim), mMap(t.mMap), mBox(t.mBox) {};
 
 
 	///////////// functions that implement the Base Interface
@@ -180,10 +446,7 @@ public:
 		return std::make_shared<SelfT>(*this);
 	}
 
-	BoxT get_bounding_box() const {
-		BoxT bb = mPrim->get_bounding_box();
-		return BoxT(mMap.forward_map(bb.lo), mMap.forward_map(bb.hi));
-	}
+	BoxT get_bounding_box() const {return mBox;};
 
 	// this is only for 2D
 	std::vector<Hull<2>> get_outline(unsigned int npts) const {
@@ -196,21 +459,49 @@ public:
 		return o;
 	}
 
+	// the map stretches the stray of a chord by at most its norm, so the
+	// innermost primitive is outlined that much more finely
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		std::vector<Hull<2>> o = mBase->get_adaptive_outline(tol/mAffine.forward_norm());
+		for (auto & h : o) for (auto & p : h.points) p = mAffine.forward_map(p);
+		return o;
+	}
+
 	bool contains_point(const PointT & pt) const {
-		return mPrim->contains_point(mMap.inverse_map(pt));
+		return mBase->contains_point(mAffine.inverse_map(pt));
 	}
 
-	// bool contains_box(const BoxT & bx) const {
-	// 	return this->contains_point(bx.lo) && this->contains_point(bx.hi) &&
-	// 		   this->contains_point(PointT(bx.lo.x[0], bx.hi.x[1])) &&
-	// 		   this->contains_point(PointT(bx.hi.x[0], bx.lo.x[1]));
-	// }
+	// the distance in the frame of the primitive is at most the norm of the
+	// inverse map times the distance here, so dividing by it keeps the
+	// distance conservative. It stays exact for rotations and translations
+	double signed_distance(const PointT & pt) const {
+		return mBase->signed_distance(mAffine.inverse_map(pt))/mAffine.inverse_norm();
+	}
+
+	// the maps are affine, so a scan line maps back to a scan line of the
+	// primitive, whose samples match the mapped ones up to rounding
+	void scan_line(const PointT & a, const PointT & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const {
+		PointT ia = mAffine.inverse_map(a);
+		mBase->scan_line(ia, mAffine.inverse_map(a + step) - ia, i0, i1, spans);
+	}
 
-	// bool collides_box(const BoxT & bx) const {
-	// 	return this->contains_point(bx.lo) || this->contains_point(bx.hi) ||
-	// 		   this->contains_point(PointT(bx.lo.x[0], bx.hi.x[1])) ||
-	// 		   this->contains_point(PointT(bx.hi.x[0], bx.lo.x[1]));
-	// }
+	// the maps are affine, so in 2D a box or convex polygon maps back to a
+	// convex polygon that the primitive tests exactly. In 3D the box maps
+	// to a parallelepiped, which is resolved from the signed distance
+	bool contains_box(const Box<2> & bx) const {return contains_polygon(box_corners(bx));};
+	bool collides_box(const Box<2> & bx) const {return collides_polygon(box_corners(bx));};
+	bool contains_box(const Box<3> & bx) const {return sdf_contains_box(*this, bx);};
+	bool collides_box(const Box<3> & bx) const {return sdf_collides_box(*this, bx);};
+	RegionClass classify_box(const Box<2> & bx) const {return PrimitiveT::classify_box(bx);};
+	RegionClass classify_box(const Box<3> & bx) const {return sdf_classify_box(*this, bx);};
+
+	bool contains_polygon(const std::vector<Point<2>> & poly) const {
+		return mBase->contains_polygon(inverse_polygon(poly));
+	}
+
+	bool collides_polygon(const std::vector<Point<2>> & poly) const {
+		return mBase->collides_polygon(inverse_polygon(poly));
+	}
 
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
@@ -229,6 +520,16 @@ public:
 		os << "</LinearTransformation>" << std::endl;
 	}
 	///////////////////////////////////////
+
+private:
+
+	BoxT 								mBox; // cached bounding box of the transformed primitive
+
+	std::vector<Point<2>> inverse_polygon(const std::vector<Point<2>> & poly) const {
+		std::vector<Point<2>> q(poly.size());
+		for (auto i=0; i<poly.size(); i++) q[i] = mAffine.inverse_map(poly[i]);
+		return q;
+	}
 };
 
 
@@ -267,5 +568,17 @@ template <typename DerivedType>
 LinearTransformation<Primitive2D, TranslationMap2D> translation_transformation(const DerivedType & c, const Point<2> & p){
 	return LinearTransformation<Primitive2D, TranslationMap2D>(c.copy(), TranslationMap2D(p));
 }
+
+
+
+template <typename DerivedType>
+LinearTransformation<Primitive2D, AffineMap2D> affine_transformation(const DerivedType & c, const AffineMap2D & m){
+	return LinearTransformation<Primitive2D, AffineMap2D>(c.copy(), m);
+}
+
+template <typename DerivedType>
+LinearTransformation<Primitive3D, AffineMap3D> affine_transformation(const DerivedType & c, const AffineMap3D & m){
+	return LinearTransformation<Primitive3D, AffineMap3D>(c.copy(), m);
+}
 }
 #endif
\ No newline at end of file
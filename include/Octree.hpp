@@ -2,6 +2,7 @@
 #define _OCTREE_H
 
 #include "Orthtree.hpp"
+#include "PrimitiveTypes.hpp"
 
 namespace csg{
 
@@ -17,6 +18,49 @@ using Octree = typename OctreeTypedef<ValueT>::type;
 
 // partial template specializations would go here
 
+
+
+// sample the signed distance of a geometry g onto an Octree over domain,
+// with each cell holding the distance at its center. A cell is refined
+// while the surface can pass through it, i.e. while the distance is less
+// than half its diagonal, down to level lvlmax and at least to lvlmin.
+// The tree is built one level at a time, and the cells of a level are
+// evaluated as one batch with g.signed_distances()
+template <class GeometryT>
+Octree<double> sample_signed_distance(const GeometryT & g, const Box<3> & domain, std::size_t lvlmin, std::size_t lvlmax){
+	if (lvlmax > 16){
+		std::cerr << "sample_signed_distance: lvlmax cannot exceed 16" << std::endl;
+		throw("sample_signed_distance: lvlmax too large");
+	}
+
+	Octree<double> tree;
+	Point<3> size = domain.hi - domain.lo;
+	std::vector<std::size_t> keys(1, 0), next;
+	std::vector<double> x, y, z, dist;
+	for (std::size_t lvl=0; !keys.empty(); lvl++){
+		x.resize(keys.size()); y.resize(keys.size()); z.resize(keys.size()); dist.resize(keys.size());
+		for (auto i=0; i<keys.size(); i++){
+			Box<3> bx = tree.getBox(keys[i]);
+			x[i] = domain.lo.x[0] + 0.5*(bx.lo.x[0]+bx.hi.x[0])*size.x[0];
+			y[i] = domain.lo.x[1] + 0.5*(bx.lo.x[1]+bx.hi.x[1])*size.x[1];
+			z[i] = domain.lo.x[2] + 0.5*(bx.lo.x[2]+bx.hi.x[2])*size.x[2];
+		}
+		PointBatch<3> batch{{x.data(), y.data(), z.data()}, keys.size()};
+		g.signed_distances(batch, dist.data());
+
+		double halfdiag = 0.5*size.norm()/double(1 << lvl);
+		next.clear();
+		for (auto i=0; i<keys.size(); i++){
+			bool refine = lvl < lvlmax && (lvl < lvlmin || fabs(dist[i]) < halfdiag);
+			DefaultNode<double> n(dist[i], !refine);
+			tree.insert(std::pair<const std::size_t, DefaultNode<double>>(keys[i], n), lvl);
+			if (refine) for (auto so=0; so<8; so++) next.push_back(tree.getChildKey(keys[i], so));
+		}
+		keys.swap(next);
+	}
+	return tree;
+}
+
 }// end namespace csg
 
 #endif
\ No newline at end of file
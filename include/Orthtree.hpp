@@ -11,6 +11,7 @@
 
 
 #include "GeomUtils.hpp"
+#include "PrimitiveTypes.hpp"
 
 
 namespace csg{
@@ -1385,7 +1386,51 @@ public:
 
 
 
+// a refinement oracle for buildTree() over a geometry with classify_box(),
+// such as a CSGTree. The cells of the tree cover the unit box and are
+// mapped onto domain. A cell is uniform if the geometry contains it or
+// misses it, so refinement stops as soon as a cell is clear of the
+// boundary and its cost follows the surface rather than the volume
+template <class TreeT, class GeometryT, std::size_t dim>
+struct GeometryRefineOracle{
+	const TreeT & 		mTree;
+	const GeometryT & 	mGeom;
+	Box<dim> 			mDomain;
+
+	GeometryRefineOracle(const TreeT & tree, const GeometryT & g, const Box<dim> & domain)
+	: mTree(tree), mGeom(g), mDomain(domain) {};
+
+	// the box of a cell in the domain
+	Box<dim> getBox(typename TreeT::KeyType key) const{
+		Box<dim> bx = mTree.getBox(key);
+		for (auto d=0; d<dim; d++){
+			double size = mDomain.hi.x[d] - mDomain.lo.x[d];
+			bx.lo.x[d] = mDomain.lo.x[d] + bx.lo.x[d]*size;
+			bx.hi.x[d] = mDomain.lo.x[d] + bx.hi.x[d]*size;
+		}
+		return bx;
+	}
+
+	bool isUniform(typename TreeT::KeyType key) const{
+		return mGeom.classify_box(getBox(key)) != AMBIGUOUS;
+	}
+};
+
+template <class TreeT, class GeometryT, std::size_t dim>
+GeometryRefineOracle<TreeT, GeometryT, dim> geometry_refine_oracle(const TreeT & tree, const GeometryT & g, const Box<dim> & domain){
+	return GeometryRefineOracle<TreeT, GeometryT, dim>(tree, g, domain);
+}
+
+// a ContainerInserter for buildTree() that inserts each node at the
+// level of its key
+struct LevelInserter{
+	template <class TreeT>
+	auto insert(TreeT & tree, const std::pair<const typename TreeT::KeyType, typename TreeT::NodeType> & p) const
+	-> decltype(tree.insert(p, 0)){
+		return tree.insert(p, tree.getLevel(p.first));
+	}
+};
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,610 @@
+#ifndef _POLYGONBOOLEAN_H
+#define _POLYGONBOOLEAN_H
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <set>
+#include <iterator>
+#include <iostream>
+#include "GeomUtils.hpp"
+#include "Predicates.hpp"
+
+namespace csg{
+
+
+// a boolean operation between two sets of closed rings, each set standing
+// for the region where its rings wind a nonzero number of times. The rings
+// may go either way around, and may overlap or touch themselves and each
+// other.
+//
+// Every edge is cut wherever another edge crosses or touches it, with the
+// exact orientation predicates deciding which pairs meet, so that the
+// pieces only meet at their ends. The pairs to check are found by binning
+// the edges in a uniform grid, binned again where crowded, rather than by
+// a sweep, as the pieces left off their edges by rounded cuts have to be
+// checked again. For n edges of similar lengths with k crossings that
+// takes about O(n + k) checks, and O(k log k) to order the cuts, but many
+// long edges across a cluster of short ones can take up to O(n^2) checks.
+// A piece, together with the pieces that coincide with it, is on the
+// boundary of the result if the operation comes out differently on its
+// two sides. A sweep across the pieces hands the windings of each side up
+// from the piece below. The kept pieces are turned to have the result on
+// their left and linked into rings: counterclockwise around the outside,
+// clockwise around holes
+class PolygonBoolean{
+public:
+
+	PolygonBoolean(const std::vector<Hull<2>> & a, const std::vector<Hull<2>> & b, Operation op)
+	: m_op(op), m_nvertices(0) {
+		add_rings(a, 0);
+		add_rings(b, 1);
+		split_edges();
+		select_pieces();
+		link_rings();
+	}
+
+	const std::vector<Hull<2>> & rings() const {return m_rings;};
+
+private:
+
+	struct Edge{
+		Point<2> 			a, b;
+		unsigned int 		operand;	// 0 or 1
+		double 				tol;		// within rounding of it, for its size
+		bool 				loose;		// to be checked against the others
+	};
+
+	// a piece of an edge, between its lower and upper ends in the
+	// lexicographic order. up is 1 if the edge runs that way, else -1
+	struct Piece{
+		Point<2> 			lo, hi;
+		unsigned int 		operand;
+		int 				up;
+	};
+
+	// a kept piece, directed with the result on its left, and the numbers
+	// of the vertices it leaves and goes to
+	struct Link{
+		Point<2> 			a, b;
+		std::size_t 		from, to;
+	};
+
+	// a point where an edge is cut, rounded if it is off the edge, and
+	// along if it is the end of an edge that runs along this one
+	struct Cut{
+		std::size_t 		edge;
+		Point<2> 			p;
+		bool 				rounded;
+		bool 				along;
+	};
+
+	// a uniform grid over part of the plane, where the points beyond its
+	// sides fall in the cells along them
+	struct Grid{
+		Point<2> 			lo;
+		double 				size;
+		std::size_t 		nx, ny;
+
+		std::size_t cell(double v, int i) const{
+			double f = (v - lo.x[i])/size;
+			std::size_t n = i ? ny : nx;
+			return !(f > 0) ? 0 : (f >= n ? n-1 : static_cast<std::size_t>(f));
+		}
+		std::size_t cell(const Point<2> & p) const {return cell(p.x[1], 1)*nx + cell(p.x[0], 0);};
+	};
+
+	static bool less(const Point<2> & p, const Point<2> & q){
+		return p.x[0] < q.x[0] || (p.x[0] == q.x[0] && p.x[1] < q.x[1]);
+	}
+
+	// p is on the line through a and b; is it strictly between them
+	static bool strictly_within(const Point<2> & p, const Point<2> & a, const Point<2> & b){
+		if (p == a || p == b) return false;
+		for (auto i=0; i<2; i++){
+			if (p.x[i] < std::min(a.x[i], b.x[i]) || p.x[i] > std::max(a.x[i], b.x[i])) return false;
+		}
+		return true;
+	}
+
+	// is p, at orientation o to the edge from a to b, on the edge or within
+	// tol of it, strictly between its ends. tol is relative to the size of
+	// the coordinates
+	static bool touches(double o, const Point<2> & p, const Point<2> & a, const Point<2> & b, double tol){
+		if (o == 0) return strictly_within(p, a, b);
+		return fabs(o) <= tol*(fabs(b.x[0] - a.x[0]) + fabs(b.x[1] - a.x[1])) && ahead(a, p, a, b) && ahead(p, b, a, b);
+	}
+
+	// does q come after p going from a to b. Points near the edge are
+	// ordered by the coordinate it changes most in, and then the other,
+	// which keeps cuts a few ulps apart in order
+	static bool ahead(const Point<2> & p, const Point<2> & q, const Point<2> & a, const Point<2> & b){
+		int k = fabs(b.x[1] - a.x[1]) > fabs(b.x[0] - a.x[0]) ? 1 : 0;
+		for (auto i : {k, 1-k}){
+			if (p.x[i] != q.x[i] && a.x[i] != b.x[i]) return (q.x[i] > p.x[i]) == (b.x[i] > a.x[i]);
+		}
+		return false;
+	}
+
+	// p, a point near the edge from a to b, or the end of it that p is not
+	// strictly inside of
+	static Point<2> clamp(const Point<2> & p, const Point<2> & a, const Point<2> & b){
+		if (!ahead(a, p, a, b)) return a;
+		if (!ahead(p, b, a, b)) return b;
+		return p;
+	}
+
+	bool inside(int wa, int wb) const{
+		bool l = wa != 0, r = wb != 0;
+		switch (m_op){
+			case UNION:			return l || r;
+			case INTERSECT:		return l && r;
+			case DIFFERENCE:	return l && !r;
+			case XOR:			return l != r;
+		}
+		return false;
+	}
+
+	void add_rings(const std::vector<Hull<2>> & hv, unsigned int operand){
+		for (auto & h : hv){
+			std::size_t n = h.points.size();
+			for (auto i=0; i<n; i++){
+				const Point<2> & p = h.points[i], & q = h.points[(i+1)%n];
+				if (p == q) continue;
+				double size = std::max(std::max(fabs(p.x[0]), fabs(p.x[1])), std::max(fabs(q.x[0]), fabs(q.x[1])));
+				m_edges.push_back(Edge{p, q, operand, 1.0e-10*size, true});
+			}
+		}
+	}
+
+	// record where edges i and j cut each other. A crossing point is
+	// computed once and given to both, so their pieces meet exactly. An end
+	// within rounding of the other edge is taken onto it, so that rounded
+	// cuts elsewhere cannot move the edge across it. Edges that run along
+	// each other are still cut apart by rounding where others cross them,
+	// which the cuts of their ends record
+	void cut(std::size_t i, std::size_t j, std::vector<Cut> & cuts) const{
+		const Point<2> & a = m_edges[i].a, & b = m_edges[i].b, & c = m_edges[j].a, & d = m_edges[j].b;
+		double tol = std::max(m_edges[i].tol, m_edges[j].tol);
+
+		// edges that share an end, such as neighbors along a ring, can
+		// only cut each other by folding back over one another
+		if (a == c || a == d || b == c || b == d){
+			const Point<2> & s = (a == c || a == d) ? a : b, & u = (s == a) ? b : a, & v = (s == c) ? d : c;
+			if (u == v) return;
+			double o = orient2d(s, u, v);
+			if (touches(o, v, s, u, tol)) cuts.push_back(Cut{i, v, o != 0, true});
+			if (touches(o, u, s, v, tol)) cuts.push_back(Cut{j, u, o != 0, true});
+			return;
+		}
+
+		double oc = orient2d(a, b, c), od = orient2d(a, b, d);
+		bool apart = (oc > 0 && od > 0) || (oc < 0 && od < 0);
+		double near = tol*(fabs(b.x[0] - a.x[0]) + fabs(b.x[1] - a.x[1]));
+		if (apart && fabs(oc) > near && fabs(od) > near) return;
+		double oa = orient2d(c, d, a), ob = orient2d(c, d, b);
+		apart = apart || (oa > 0 && ob > 0) || (oa < 0 && ob < 0);
+
+		// an end on or next to the other edge, which includes collinear
+		// overlaps
+		std::size_t n = cuts.size();
+		double nearj = tol*(fabs(d.x[0] - c.x[0]) + fabs(d.x[1] - c.x[1]));
+		bool along = (fabs(oc) <= near && fabs(od) <= near) || (fabs(oa) <= nearj && fabs(ob) <= nearj);
+		if (touches(oc, c, a, b, tol)) cuts.push_back(Cut{i, c, oc != 0, along});
+		if (touches(od, d, a, b, tol)) cuts.push_back(Cut{i, d, od != 0, along});
+		if (touches(oa, a, c, d, tol)) cuts.push_back(Cut{j, a, oa != 0, along});
+		if (touches(ob, b, c, d, tol)) cuts.push_back(Cut{j, b, ob != 0, along});
+		if (apart || cuts.size() > n || oc == 0 || od == 0 || oa == 0 || ob == 0) return;
+
+		// the crossing is worked out the same way whichever edge comes first
+		// and whichever way they run, so that edges that coincide are cut at
+		// the same points. A crossing next to an end can round past it, and
+		// is then taken to be that end. One with an axis-aligned edge is put
+		// exactly on it
+		Point<2> s = less(a, b) ? a : b, u = less(a, b) ? b : a, v = less(c, d) ? c : d, w = less(c, d) ? d : c;
+		if (less(v, s) || (v == s && less(w, u))){
+			std::swap(s, v);
+			std::swap(u, w);
+		}
+		double os = orient2d(v, w, s), ou = orient2d(v, w, u);
+		Point<2> p = s + os/(os - ou)*(u - s);
+		p = clamp(p, v, w);
+		p = clamp(p, s, u);
+		for (auto k=0; k<2; k++){
+			if (s.x[k] == u.x[k]) p.x[k] = s.x[k];
+			else if (v.x[k] == w.x[k]) p.x[k] = v.x[k];
+		}
+		cuts.push_back(Cut{i, p, orient2d(a, b, p) != 0, false});
+		cuts.push_back(Cut{j, p, orient2d(c, d, p) != 0, false});
+	}
+
+	// check the pairs among the edges ids[0, n) whose boxes overlap, where
+	// the low corner of the overlap lies in the cells of path. Only pairs
+	// with a loose edge are checked, so those are moved to the front
+	void check_pairs(std::size_t * ids, std::size_t n, const std::vector<Box<2>> & boxes,
+					 const std::vector<std::pair<Grid, std::size_t>> & path, std::vector<Cut> & cuts) const{
+		std::size_t nl = std::partition(ids, ids+n, [this](std::size_t i){return m_edges[i].loose;}) - ids;
+		for (auto k=0; k<nl; k++){
+			for (auto l=k+1; l<n; l++){
+				std::size_t i = ids[k], j = ids[l];
+				const Box<2> & bi = boxes[i], & bj = boxes[j];
+				if (bi.hi.x[0] < bj.lo.x[0] || bj.hi.x[0] < bi.lo.x[0] || bi.hi.x[1] < bj.lo.x[1] || bj.hi.x[1] < bi.lo.x[1]) continue;
+				Point<2> corner(std::max(bi.lo.x[0], bj.lo.x[0]), std::max(bi.lo.x[1], bj.lo.x[1]));
+				bool here = true;
+				for (auto & f : path) here = here && f.first.cell(corner) == f.second;
+				if (here) cut(i, j, cuts);
+			}
+		}
+	}
+
+	// find the cuts between the edges ids, whose boxes meet region. The
+	// edges are binned in a uniform grid, coarse enough that they take
+	// about four cells each, and the pairs that share a cell are checked,
+	// each in the cell holding the low corner of the overlap of their boxes.
+	// A crowded cell is binned again on a finer grid of its own, so that
+	// clustered edges are not all checked against each other. path holds
+	// the grids above and the cells of them being searched. A finer grid
+	// that does not halve the pairs to check is dropped, which keeps long
+	// edges from being binned over and over
+	void find_cuts(std::vector<std::size_t> & ids, const Box<2> & region, const std::vector<Box<2>> & boxes,
+				   std::vector<std::pair<Grid, std::size_t>> & path, std::vector<Cut> & cuts) const{
+		std::size_t n = ids.size();
+		double w = region.hi.x[0] - region.lo.x[0], h = region.hi.x[1] - region.lo.x[1];
+		Grid grid{region.lo, std::max(sqrt(w*h/n), std::max(w, h)/n), 1, 1};
+		if (!(grid.size > 0)) grid.size = 1;
+		while (true){
+			grid.nx = static_cast<std::size_t>(w/grid.size) + 1;
+			grid.ny = static_cast<std::size_t>(h/grid.size) + 1;
+			double ncopies = 0;
+			for (auto i : ids) ncopies += (grid.cell(boxes[i].hi.x[0], 0) - grid.cell(boxes[i].lo.x[0], 0) + 1.0)*(grid.cell(boxes[i].hi.x[1], 1) - grid.cell(boxes[i].lo.x[1], 1) + 1.0);
+			if (ncopies <= 4.0*n) break;
+			grid.size *= 2;
+		}
+
+		std::size_t ncells = grid.nx*grid.ny;
+		std::vector<std::size_t> offsets(ncells+1, 0), binned;
+		for (int pass=0; pass<2; pass++){
+			std::vector<std::size_t> fill(offsets.begin(), offsets.end()-1);
+			for (auto i : ids){
+				std::size_t x0 = grid.cell(boxes[i].lo.x[0], 0), x1 = grid.cell(boxes[i].hi.x[0], 0), y1 = grid.cell(boxes[i].hi.x[1], 1);
+				for (auto cy=grid.cell(boxes[i].lo.x[1], 1); cy<=y1; cy++){
+					for (auto cx=x0; cx<=x1; cx++){
+						if (pass == 0) offsets[cy*grid.nx+cx+1]++;
+						else binned[fill[cy*grid.nx+cx]++] = i;
+					}
+				}
+			}
+			if (pass == 0){
+				for (auto c=0; c<ncells; c++) offsets[c+1] += offsets[c];
+				binned.resize(offsets[ncells]);
+			}
+		}
+
+		double npairs = 0;
+		for (auto c=0; c<ncells; c++) npairs += 0.5*(offsets[c+1] - offsets[c])*(offsets[c+1] - offsets[c] - 1.0);
+		if (ncells == 1 || path.size() == 16 || (!path.empty() && 4*npairs > n*(n - 1.0))){
+			check_pairs(&ids[0], n, boxes, path, cuts);
+			return;
+		}
+
+		for (auto c=0; c<ncells; c++){
+			std::size_t count = offsets[c+1] - offsets[c];
+			if (count < 2 || std::none_of(&binned[offsets[c]], &binned[offsets[c+1]], [this](std::size_t i){return m_edges[i].loose;})) continue;
+			path.push_back(std::make_pair(grid, c));
+			if (count <= 32) check_pairs(&binned[offsets[c]], count, boxes, path, cuts);
+			else {
+				std::vector<std::size_t> sub(binned.begin()+offsets[c], binned.begin()+offsets[c+1]);
+				Box<2> bx = boxes[sub[0]];
+				for (auto i : sub) bx = Box<2>::bounding_box(bx, boxes[i]);
+				std::size_t cx = c % grid.nx, cy = c / grid.nx;
+				if (cx > 0) bx.lo.x[0] = std::max(bx.lo.x[0], grid.lo.x[0] + cx*grid.size);
+				if (cy > 0) bx.lo.x[1] = std::max(bx.lo.x[1], grid.lo.x[1] + cy*grid.size);
+				if (cx+1 < grid.nx) bx.hi.x[0] = std::min(bx.hi.x[0], grid.lo.x[0] + (cx+1)*grid.size);
+				if (cy+1 < grid.ny) bx.hi.x[1] = std::min(bx.hi.x[1], grid.lo.x[1] + (cy+1)*grid.size);
+				bx.hi.x[0] = std::max(bx.hi.x[0], bx.lo.x[0]);
+				bx.hi.x[1] = std::max(bx.hi.x[1], bx.lo.x[1]);
+				find_cuts(sub, bx, boxes, path, cuts);
+			}
+			path.pop_back();
+		}
+	}
+
+	// find the cuts between the loose edges and the others, in order along
+	// each edge. The boxes are padded so that near misses are checked too
+	std::vector<Cut> find_cuts() const{
+		std::size_t n = m_edges.size();
+		std::vector<Box<2>> boxes(n);
+		std::vector<std::size_t> ids(n);
+		Box<2> all;
+		for (auto i=0; i<n; i++){
+			const Point<2> & a = m_edges[i].a, & b = m_edges[i].b;
+			double pad = 2*m_edges[i].tol;
+			boxes[i] = Box<2>(Point<2>(std::min(a.x[0], b.x[0]) - pad, std::min(a.x[1], b.x[1]) - pad), Point<2>(std::max(a.x[0], b.x[0]) + pad, std::max(a.x[1], b.x[1]) + pad));
+			all = (i == 0) ? boxes[i] : Box<2>::bounding_box(all, boxes[i]);
+			ids[i] = i;
+		}
+		std::vector<Cut> cuts;
+		std::vector<std::pair<Grid, std::size_t>> path;
+		find_cuts(ids, all, boxes, path, cuts);
+
+		std::sort(cuts.begin(), cuts.end(), [&](const Cut & u, const Cut & v){
+			if (u.edge != v.edge) return u.edge < v.edge;
+			const Edge & e = m_edges[u.edge];
+			return ahead(u.p, v.p, e.a, e.b) || (!ahead(v.p, u.p, e.a, e.b) && less(u.p, v.p));
+		});
+		return cuts;
+	}
+
+	// is p, a rounded cut of edge e, far enough off it to meet edges that e
+	// did not. Edges that come within rounding of one another cross, and
+	// share the cut, or touch, and are cut at the end that does, so a piece
+	// that keeps well within the tolerance of its edge can only meet the
+	// pieces of an edge that runs along it
+	static bool astray(const Point<2> & p, const Edge & e){
+		return fabs(orient2d(e.a, e.b, p)) > 0.25*e.tol*(fabs(e.b.x[0] - e.a.x[0]) + fabs(e.b.x[1] - e.a.x[1]));
+	}
+
+	// cut the edges into pieces that only meet at their ends, then group
+	// the pieces that coincide. A piece with a cut rounded far off its edge,
+	// or on an edge that another runs along, can cross edges that the edge
+	// itself did not, so it is loose and checked again. A rounded cut that
+	// lands next to another, as where an edge crosses two collinear ones, or
+	// next to an end, makes a very short piece, whose ends are merged into
+	// the lowest of them, and the pieces that end there are loose too. This
+	// goes on until a pass cuts nothing, which takes a few passes; pieces
+	// left crossing would give wrong windings, so running out of passes
+	// throws
+	void split_edges(){
+		for (auto pass=0; std::any_of(m_edges.begin(), m_edges.end(), [](const Edge & e){return e.loose;}); pass++){
+			std::vector<Cut> cuts = find_cuts();
+			if (cuts.empty()) break;
+
+			std::vector<Edge> pieces;
+			std::vector<Point<2>> ends;
+			auto cit = cuts.begin();
+			for (auto i=0; i<m_edges.size(); i++){
+				const Edge & e = m_edges[i];
+				auto cend = cit;
+				bool along = false;
+				for (; cend != cuts.end() && cend->edge == i; cend++) along = along || cend->along;
+				auto add_piece = [&](const Point<2> & p, const Point<2> & q, bool rounded){
+					if (rounded && std::max(fabs(q.x[0] - p.x[0]), fabs(q.x[1] - p.x[1])) <= 4*e.tol){
+						ends.push_back(p);
+						ends.push_back(q);
+					}
+					pieces.push_back(Edge{p, q, e.operand, e.tol, rounded && (along || astray(p, e) || astray(q, e))});
+				};
+				Point<2> from = e.a;
+				bool rounded = false;
+				for (; cit != cend; cit++){
+					if (cit->p == from || !ahead(e.a, cit->p, e.a, e.b) || !ahead(cit->p, e.b, e.a, e.b)) continue;
+					add_piece(from, cit->p, rounded || cit->rounded);
+					from = cit->p;
+					rounded = cit->rounded;
+				}
+				if (!(from == e.b)) add_piece(from, e.b, rounded);
+			}
+			if (pieces.size() == m_edges.size()) break;
+			if (pass == 16){
+				std::cerr << "PolygonBoolean: edges still cross after " << pass << " passes!" << std::endl;
+				throw("polygon boolean edges not separated");
+			}
+			if (ends.empty()){
+				m_edges.swap(pieces);
+				continue;
+			}
+
+			// the ends of each short piece are joined, and every point
+			// ends up joined to the lowest of its cluster
+			std::vector<Point<2>> points(ends);
+			std::sort(points.begin(), points.end(), less);
+			points.erase(std::unique(points.begin(), points.end()), points.end());
+			auto index = [&points](const Point<2> & p){return std::lower_bound(points.begin(), points.end(), p, less) - points.begin();};
+			std::vector<std::size_t> root(points.size());
+			std::iota(root.begin(), root.end(), 0);
+			auto find = [&root](std::size_t k){
+				while (root[k] != k) k = root[k] = root[root[k]];
+				return k;
+			};
+			for (auto k=0; k<ends.size(); k+=2){
+				std::size_t u = find(index(ends[k])), v = find(index(ends[k+1]));
+				root[std::max(u, v)] = std::min(u, v);
+			}
+
+			m_edges.clear();
+			for (auto & e : pieces){
+				for (auto p : {&e.a, &e.b}){
+					std::size_t k = index(*p);
+					if (k == points.size() || !(points[k] == *p)) continue;
+					*p = points[find(k)];
+					e.loose = true;
+				}
+				if (!(e.a == e.b)) m_edges.push_back(e);
+			}
+		}
+
+		for (auto & e : m_edges){
+			bool up = less(e.a, e.b);
+			m_pieces.push_back(Piece{up ? e.a : e.b, up ? e.b : e.a, e.operand, up ? 1 : -1});
+		}
+
+		// coinciding pieces are adjacent once sorted by their lower and
+		// upper ends, which also sorts the groups by their lower ends
+		std::sort(m_pieces.begin(), m_pieces.end(), [](const Piece & e, const Piece & f){
+			return less(e.lo, f.lo) || (e.lo == f.lo && less(e.hi, f.hi));
+		});
+		for (auto k=0; k<m_pieces.size(); k++){
+			if (k > 0 && m_pieces[k].lo == m_lo.back() && m_pieces[k].hi == m_hi.back()) continue;
+			m_first.push_back(k);
+			m_lo.push_back(m_pieces[k].lo);
+			m_hi.push_back(m_pieces[k].hi);
+		}
+		m_first.push_back(m_pieces.size());
+	}
+
+	// is piece s below piece t, where both cross the sweep line. The line
+	// sweeps in lexicographic order, so a vertical piece goes up through
+	// it and its right side counts as below. Rounded cut points can leave
+	// collinear pieces that overlap without coinciding; they are ordered
+	// by number, so that no two groups are ever equivalent in the sweep
+	bool below(std::size_t s, std::size_t t) const{
+		if (s == t) return false;
+		const Point<2> & sl = m_lo[s], & sr = m_hi[s], & tl = m_lo[t], & tr = m_hi[t];
+		if (!less(sl, tl)){
+			double o = orient2d(tl, tr, sl);
+			if (o == 0) o = orient2d(tl, tr, sr);
+			return (o == 0) ? s < t : o < 0;
+		}
+		double o = orient2d(sl, sr, tl);
+		if (o == 0) o = orient2d(sl, sr, tr);
+		return (o == 0) ? s < t : o > 0;
+	}
+
+	// keep the groups of pieces with the result on one side only. The sweep
+	// meets the groups at their lower ends, in order, and keeps those that
+	// cross it ordered from below. As the pieces only meet at their ends,
+	// the windings just below a group are those just above the group under
+	// it, and crossing the group adds the windings of its own pieces
+	void select_pieces(){
+		std::size_t ng = m_lo.size();
+
+		// the groups join in the order of their lower ends, from the bottom
+		// up where they share one, and leave in the order of their upper ends
+		std::vector<std::size_t> starts(ng), ends(ng);
+		std::iota(starts.begin(), starts.end(), 0);
+		std::iota(ends.begin(), ends.end(), 0);
+		for (std::size_t g=0, h=0; g<ng; g=h){
+			for (h=g+1; h<ng && m_lo[h] == m_lo[g]; h++);
+			if (h - g > 1) std::sort(starts.begin()+g, starts.begin()+h, [this](std::size_t s, std::size_t t){return below(s, t);});
+		}
+		std::sort(ends.begin(), ends.end(), [this](std::size_t g, std::size_t h){return less(m_hi[g], m_hi[h]);});
+
+		// number the vertices in order, merging the lower and upper ends
+		std::vector<std::size_t> vlo(ng), vhi(ng);
+		const Point<2> * last = nullptr;
+		m_nvertices = 0;
+		for (std::size_t g=0, r=0; g<ng || r<ng; ){
+			bool lo = r == ng || (g < ng && !less(m_hi[ends[r]], m_lo[g]));
+			const Point<2> & p = lo ? m_lo[g] : m_hi[ends[r]];
+			if (last == nullptr || !(p == *last)) m_nvertices++;
+			last = &p;
+			if (lo) vlo[g++] = m_nvertices-1;
+			else vhi[ends[r++]] = m_nvertices-1;
+		}
+
+		auto cmp = [this](std::size_t s, std::size_t t){return below(s, t);};
+		std::set<std::size_t, decltype(cmp)> status(cmp);
+		std::vector<typename std::set<std::size_t, decltype(cmp)>::iterator> where(ng);
+		std::vector<int> above(2*ng);		// windings just above each group
+		std::size_t r = 0;
+
+		// a group that starts where others end mostly takes their place,
+		// and one that starts with others goes right above the last
+		auto hint = status.end();
+		for (auto g : starts){
+			// the groups that end at or before the start of this one leave
+			while (r < ng && !less(m_lo[g], m_hi[ends[r]])) hint = status.erase(where[ends[r++]]);
+
+			where[g] = status.insert(hint, g);
+			hint = std::next(where[g]);
+			int wlo[2] = {0, 0};
+			if (where[g] != status.begin()){
+				std::size_t h = *std::prev(where[g]);
+				wlo[0] = above[2*h];
+				wlo[1] = above[2*h+1];
+			}
+			int whi[2] = {wlo[0], wlo[1]};
+			// the left of a piece is above it when it runs upwards
+			for (auto k=m_first[g]; k<m_first[g+1]; k++) whi[m_pieces[k].operand] += m_pieces[k].up;
+			above[2*g] = whi[0];
+			above[2*g+1] = whi[1];
+
+			bool inhi = inside(whi[0], whi[1]);
+			if (inhi == inside(wlo[0], wlo[1])) continue;
+			m_kept.push_back(inhi ? Link{m_lo[g], m_hi[g], vlo[g], vhi[g]} : Link{m_hi[g], m_lo[g], vhi[g], vlo[g]});
+		}
+	}
+
+	// link the kept pieces into rings. Where several leave the same
+	// vertex, a ring takes the first one clockwise from where it came in,
+	// which keeps touching rings apart. As many pieces leave each vertex as
+	// come in, so a ring can only end where it started; one that cannot go
+	// on throws rather than being left open
+	void link_rings(){
+		// the pieces in the order of the vertices they leave, so that the
+		// pieces leaving vertex v are [offsets[v], offsets[v+1])
+		std::size_t m = m_kept.size();
+		std::vector<std::size_t> offsets(m_nvertices+1, 0);
+		for (auto & e : m_kept) offsets[e.from+1]++;
+		for (auto v=0; v<m_nvertices; v++) offsets[v+1] += offsets[v];
+		std::vector<Link> sorted(m);
+		std::vector<std::size_t> fill(offsets.begin(), offsets.end()-1);
+		for (auto & e : m_kept) sorted[fill[e.from]++] = e;
+		m_kept.swap(sorted);
+
+		std::vector<char> used(m, 0);
+		for (auto start=0; start<m; start++){
+			if (used[start]) continue;
+			Hull<2> ring;
+			std::size_t e = start;
+			while (true){
+				used[e] = 1;
+				ring.points.push_back(m_kept[e].a);
+				std::size_t next = m, obegin = offsets[m_kept[e].to], oend = offsets[m_kept[e].to+1];
+				if (oend - obegin == 1) next = obegin;
+				else{
+					Point<2> back = m_kept[e].a - m_kept[e].b;
+					double aback = atan2(back.x[1], back.x[0]), best = 3*pi;
+					for (auto o=obegin; o<oend; o++){
+						if (used[o] && o != start) continue;
+						Point<2> d = m_kept[o].b - m_kept[o].a;
+						double turn = aback - atan2(d.x[1], d.x[0]);
+						while (turn <= 0) turn += 2*pi;
+						while (turn > 2*pi) turn -= 2*pi;
+						if (turn < best) {best = turn; next = o;}
+					}
+				}
+				if (next == start) break;
+				if (next == m || used[next]){
+					std::cerr << "PolygonBoolean: ring open at vertex " << m_kept[e].to << "!" << std::endl;
+					throw("polygon boolean ring not closed");
+				}
+				e = next;
+			}
+			simplify(ring);
+			if (ring.points.size() >= 3) m_rings.push_back(ring);
+		}
+	}
+
+	// drop the vertices that lie on a straight run between their neighbors
+	static void simplify(Hull<2> & ring){
+		std::size_t n = ring.points.size();
+		std::vector<Point<2>> out;
+		for (auto i=0; i<n; i++){
+			const Point<2> & p = ring.points[(i+n-1)%n], & q = ring.points[i], & r = ring.points[(i+1)%n];
+			if (orient2d(p, q, r) == 0 && Point<2>::dot(q - p, r - q) > 0) continue;
+			out.push_back(q);
+		}
+		ring.points.swap(out);
+	}
+
+	Operation 				m_op;
+	std::vector<Edge> 		m_edges;		// of the input rings, then their pieces
+	std::vector<Piece> 		m_pieces;		// cut, and sorted into groups that coincide
+	std::vector<std::size_t> m_first;		// the first piece of each group
+	std::vector<Point<2>> 	m_lo, m_hi;		// lexicographic ends of each group
+	std::size_t 			m_nvertices;	// distinct ends of the groups
+	std::vector<Link> 		m_kept;			// directed, result on the left
+	std::vector<Hull<2>> 	m_rings;
+};
+
+
+// the rings that outline the result of op between the regions outlined
+// by a and b
+inline std::vector<Hull<2>> polygon_boolean(const std::vector<Hull<2>> & a, const std::vector<Hull<2>> & b, Operation op){
+	return PolygonBoolean(a, b, op).rings();
+}
+
+
+}
+#endif
@@ -0,0 +1,513 @@
+#ifndef _PREDICATES_H
+#define _PREDICATES_H
+
+#include <math.h>
+#include <vector>
+#include <algorithm>
+#include <initializer_list>
+
+#include "Point.hpp"
+
+// Adaptive-precision geometric predicates
+//
+// Each predicate first evaluates the determinant in plain double
+// arithmetic and compares it against a forward error bound
+// (Shewchuk, "Adaptive Precision Floating-Point Arithmetic and Fast
+// Robust Geometric Predicates", 1997). Only when the sign cannot be
+// certified does it fall back to exact evaluation with floating-point
+// expansions, so the common case costs a handful of extra flops.
+
+namespace csg{
+
+
+struct ExactArithmetic{
+	// an expansion is a sum of nonoverlapping doubles, sorted
+	// by increasing magnitude. Short expansions (the common case once
+	// zero components are eliminated) live on the stack.
+	class Expansion{
+	public:
+		Expansion() : mSize(0), mCapacity(Inline), mData(mBuffer) {};
+
+		Expansion(std::initializer_list<double> l) : Expansion() {
+			reserve(l.size());
+			for (auto it=l.begin(); it!=l.end(); it++) mData[mSize++] = *it;
+		}
+
+		Expansion(const Expansion & e) : Expansion() {
+			reserve(e.mSize);
+			std::copy(e.mData, e.mData+e.mSize, mData);
+			mSize = e.mSize;
+		}
+
+		Expansion(Expansion && e) : Expansion() {
+			if (e.mData == e.mBuffer) std::copy(e.mData, e.mData+e.mSize, mData);
+			else {mData = e.mData; mCapacity = e.mCapacity; e.mData = e.mBuffer; e.mCapacity = Inline;}
+			mSize = e.mSize;
+			e.mSize = 0;
+		}
+
+		Expansion & operator=(Expansion e){
+			if (mData != mBuffer) delete[] mData;
+			mData = mBuffer; mCapacity = Inline; mSize = 0;
+			if (e.mData == e.mBuffer) std::copy(e.mData, e.mData+e.mSize, mData);
+			else {mData = e.mData; mCapacity = e.mCapacity; e.mData = e.mBuffer; e.mCapacity = Inline;}
+			mSize = e.mSize;
+			e.mSize = 0;
+			return *this;
+		}
+
+		~Expansion() {if (mData != mBuffer) delete[] mData;};
+
+		void reserve(std::size_t n){
+			if (n <= mCapacity) return;
+			double * d = new double[n];
+			std::copy(mData, mData+mSize, d);
+			if (mData != mBuffer) delete[] mData;
+			mData = d;
+			mCapacity = n;
+		}
+
+		void push_back(double v){
+			if (mSize == mCapacity) reserve(2*mCapacity);
+			mData[mSize++] = v;
+		}
+
+		std::size_t size() const {return mSize;};
+		bool empty() const {return mSize == 0;};
+		double & operator[](std::size_t i) {return mData[i];};
+		const double & operator[](std::size_t i) const {return mData[i];};
+
+	private:
+		static constexpr std::size_t Inline = 16;
+		std::size_t 	mSize, mCapacity;
+		double * 		mData;
+		double 			mBuffer[Inline];
+	};
+
+	static constexpr double epsilon = 1.1102230246251565e-16; // 2^-53
+	static constexpr double ccwerrboundA = (3.0 + 16.0*epsilon)*epsilon;
+	static constexpr double iccerrboundA = (10.0 + 96.0*epsilon)*epsilon;
+	static constexpr double o3derrboundA = (7.0 + 56.0*epsilon)*epsilon;
+	static constexpr double isperrboundA = (16.0 + 224.0*epsilon)*epsilon;
+
+	static inline void fast_two_sum(double a, double b, double & x, double & y){
+		x = a + b;
+		y = b - (x - a);
+	}
+
+	static inline void two_sum(double a, double b, double & x, double & y){
+		x = a + b;
+		double bvirt = x - a;
+		double avirt = x - bvirt;
+		y = (a - avirt) + (b - bvirt);
+	}
+
+	static inline void two_product(double a, double b, double & x, double & y){
+		x = a*b;
+		y = fma(a, b, -x);
+	}
+
+	// rounded a+b, a-b and a*b that flag whether any rounding occurred.
+	// A determinant evaluated without rounding is exact, which is the
+	// usual outcome for gridded inputs with small integer-like coordinates.
+	static inline double checked_sum(double a, double b, bool & rounded){
+		double x, y;
+		two_sum(a, b, x, y);
+		rounded |= (y != 0.0);
+		return x;
+	}
+
+	static inline double checked_diff(double a, double b, bool & rounded){
+		return checked_sum(a, -b, rounded);
+	}
+
+	static inline double checked_product(double a, double b, bool & rounded){
+		double x, y;
+		two_product(a, b, x, y);
+		rounded |= (y != 0.0);
+		return x;
+	}
+
+	// exact difference a-b as a two-component expansion
+	static Expansion diff(double a, double b){
+		double x, y;
+		two_sum(a, -b, x, y);
+		return {y, x};
+	}
+
+	// h = e + f, with zero components eliminated
+	static Expansion sum(const Expansion & e, const Expansion & f){
+		Expansion h;
+		h.reserve(e.size() + f.size());
+		std::size_t ei = 0, fi = 0;
+		double enow = e[0], fnow = f[0];
+		double Q, Qnew, hh;
+
+		if ((fnow > enow) == (fnow > -enow)){
+			Q = enow; enow = (++ei < e.size()) ? e[ei] : 0.0;
+		}
+		else {
+			Q = fnow; fnow = (++fi < f.size()) ? f[fi] : 0.0;
+		}
+
+		if (ei < e.size() && fi < f.size()){
+			if ((fnow > enow) == (fnow > -enow)){
+				fast_two_sum(enow, Q, Qnew, hh); enow = (++ei < e.size()) ? e[ei] : 0.0;
+			}
+			else {
+				fast_two_sum(fnow, Q, Qnew, hh); fnow = (++fi < f.size()) ? f[fi] : 0.0;
+			}
+			Q = Qnew;
+			if (hh != 0.0) h.push_back(hh);
+
+			while (ei < e.size() && fi < f.size()){
+				if ((fnow > enow) == (fnow > -enow)){
+					two_sum(Q, enow, Qnew, hh); enow = (++ei < e.size()) ? e[ei] : 0.0;
+				}
+				else {
+					two_sum(Q, fnow, Qnew, hh); fnow = (++fi < f.size()) ? f[fi] : 0.0;
+				}
+				Q = Qnew;
+				if (hh != 0.0) h.push_back(hh);
+			}
+		}
+
+		while (ei < e.size()){
+			two_sum(Q, enow, Qnew, hh); enow = (++ei < e.size()) ? e[ei] : 0.0;
+			Q = Qnew;
+			if (hh != 0.0) h.push_back(hh);
+		}
+		while (fi < f.size()){
+			two_sum(Q, fnow, Qnew, hh); fnow = (++fi < f.size()) ? f[fi] : 0.0;
+			Q = Qnew;
+			if (hh != 0.0) h.push_back(hh);
+		}
+
+		if (Q != 0.0 || h.empty()) h.push_back(Q);
+		return h;
+	}
+
+	static Expansion negate(const Expansion & e){
+		Expansion h(e);
+		for (auto i=0; i<h.size(); i++) h[i] = -h[i];
+		return h;
+	}
+
+	// h = b*e, with zero components eliminated
+	static Expansion scale(const Expansion & e, double b){
+		Expansion h;
+		h.reserve(2*e.size());
+		double Q, hh, product1, product0, s;
+
+		two_product(e[0], b, Q, hh);
+		if (hh != 0.0) h.push_back(hh);
+		for (auto i=1; i<e.size(); i++){
+			two_product(e[i], b, product1, product0);
+			two_sum(Q, product0, s, hh);
+			if (hh != 0.0) h.push_back(hh);
+			fast_two_sum(product1, s, Q, hh);
+			if (hh != 0.0) h.push_back(hh);
+		}
+		if (Q != 0.0 || h.empty()) h.push_back(Q);
+		return h;
+	}
+
+	// h = e*f
+	static Expansion product(const Expansion & e, const Expansion & f){
+		Expansion h = scale(e, f[0]);
+		for (auto i=1; i<f.size(); i++) h = sum(h, scale(e, f[i]));
+		return h;
+	}
+
+	// the largest component carries the sign
+	static double estimate(const Expansion & e){
+		double s = 0.0;
+		for (auto i=0; i<e.size(); i++) s += e[i];
+		return s;
+	}
+};
+
+
+
+
+// Return a positive value if the points a, b, c occur in counterclockwise
+// order, a negative value if they occur in clockwise order, and zero
+// if they are collinear. The sign is exact.
+inline double orient2d(const Point<2> & a, const Point<2> & b, const Point<2> & c){
+	typedef ExactArithmetic EA;
+
+	double detleft = (a.x[0] - c.x[0])*(b.x[1] - c.x[1]);
+	double detright = (a.x[1] - c.x[1])*(b.x[0] - c.x[0]);
+	double det = detleft - detright;
+	double errbound = EA::ccwerrboundA*(fabs(detleft) + fabs(detright));
+	if (det > errbound || -det > errbound) return det;
+
+	// exact fallback
+	EA::Expansion acx = EA::diff(a.x[0], c.x[0]), bcy = EA::diff(b.x[1], c.x[1]);
+	EA::Expansion acy = EA::diff(a.x[1], c.x[1]), bcx = EA::diff(b.x[0], c.x[0]);
+	EA::Expansion d = EA::sum(EA::product(acx, bcy), EA::negate(EA::product(acy, bcx)));
+	return EA::estimate(d);
+}
+
+
+
+// Return positive, zero, or negative value if point d is respectively inside,
+// on, or outside the circle through points a, b, and c (given in
+// counterclockwise order). The sign is exact.
+inline double in_circle(const Point<2> & d, const Point<2> & a, const Point<2> & b, const Point<2> & c) {
+	typedef ExactArithmetic EA;
+
+	double adx = a.x[0] - d.x[0], ady = a.x[1] - d.x[1];
+	double bdx = b.x[0] - d.x[0], bdy = b.x[1] - d.x[1];
+	double cdx = c.x[0] - d.x[0], cdy = c.x[1] - d.x[1];
+
+	double bdxcdy = bdx*cdy, cdxbdy = cdx*bdy;
+	double alift = adx*adx + ady*ady;
+
+	double cdxady = cdx*ady, adxcdy = adx*cdy;
+	double blift = bdx*bdx + bdy*bdy;
+
+	double adxbdy = adx*bdy, bdxady = bdx*ady;
+	double clift = cdx*cdx + cdy*cdy;
+
+	double det = alift*(bdxcdy - cdxbdy) + blift*(cdxady - adxcdy) + clift*(adxbdy - bdxady);
+	double permanent = (fabs(bdxcdy) + fabs(cdxbdy))*alift
+					 + (fabs(cdxady) + fabs(adxcdy))*blift
+					 + (fabs(adxbdy) + fabs(bdxady))*clift;
+	double errbound = EA::iccerrboundA*permanent;
+	if (det > errbound || -det > errbound) return det;
+
+	// exact fallback
+	EA::Expansion eadx = EA::diff(a.x[0], d.x[0]), eady = EA::diff(a.x[1], d.x[1]);
+	EA::Expansion ebdx = EA::diff(b.x[0], d.x[0]), ebdy = EA::diff(b.x[1], d.x[1]);
+	EA::Expansion ecdx = EA::diff(c.x[0], d.x[0]), ecdy = EA::diff(c.x[1], d.x[1]);
+
+	EA::Expansion ealift = EA::sum(EA::product(eadx, eadx), EA::product(eady, eady));
+	EA::Expansion eblift = EA::sum(EA::product(ebdx, ebdx), EA::product(ebdy, ebdy));
+	EA::Expansion eclift = EA::sum(EA::product(ecdx, ecdx), EA::product(ecdy, ecdy));
+
+	EA::Expansion bc = EA::sum(EA::product(ebdx, ecdy), EA::negate(EA::product(ecdx, ebdy)));
+	EA::Expansion ca = EA::sum(EA::product(ecdx, eady), EA::negate(EA::product(eadx, ecdy)));
+	EA::Expansion ab = EA::sum(EA::product(eadx, ebdy), EA::negate(EA::product(ebdx, eady)));
+
+	EA::Expansion e = EA::sum(EA::sum(EA::product(ealift, bc), EA::product(eblift, ca)), EA::product(eclift, ab));
+	return EA::estimate(e);
+}
+
+
+
+// Same as in_circle(), but exact ties are broken by Simulation of Simplicity:
+// the lifted coordinate of each point is perturbed by eps^k, where the
+// point with the largest index receives the largest perturbation. The
+// result is nonzero unless all four points are collinear, so a
+// triangulation built with this test is the unique Delaunay triangulation
+// of the perturbed point set.
+inline double in_circle(const Point<2> & d, const Point<2> & a, const Point<2> & b, const Point<2> & c,
+						long id, long ia, long ib, long ic) {
+	double det = in_circle(d, a, b, c);
+	if (det != 0.0) return det;
+
+	// coefficient of each lifted coordinate in the determinant
+	long idx[4] = {ia, ib, ic, id};
+	double coeff[4] = {orient2d(d, b, c), orient2d(a, d, c), orient2d(a, b, d), -orient2d(a, b, c)};
+
+	// walk the perturbations from most to least significant
+	bool used[4] = {false, false, false, false};
+	for (auto n=0; n<4; n++){
+		int kmax = -1;
+		for (auto k=0; k<4; k++){
+			if (used[k]) continue;
+			if (kmax < 0 || idx[k] > idx[kmax]) kmax = k;
+		}
+		used[kmax] = true;
+		if (coeff[kmax] != 0.0) return coeff[kmax];
+	}
+	return 0.0;
+}
+
+
+
+// Return a positive value if the point d lies below the plane passing
+// through a, b, and c, where a, b, and c appear in counterclockwise order
+// when viewed from above the plane; a negative value if d lies above the
+// plane, and zero if the points are coplanar. The sign is exact.
+inline double orient3d(const Point<3> & a, const Point<3> & b, const Point<3> & c, const Point<3> & d){
+	typedef ExactArithmetic EA;
+
+	double adx = a.x[0] - d.x[0], ady = a.x[1] - d.x[1], adz = a.x[2] - d.x[2];
+	double bdx = b.x[0] - d.x[0], bdy = b.x[1] - d.x[1], bdz = b.x[2] - d.x[2];
+	double cdx = c.x[0] - d.x[0], cdy = c.x[1] - d.x[1], cdz = c.x[2] - d.x[2];
+
+	double bdxcdy = bdx*cdy, cdxbdy = cdx*bdy;
+	double cdxady = cdx*ady, adxcdy = adx*cdy;
+	double adxbdy = adx*bdy, bdxady = bdx*ady;
+
+	double det = adz*(bdxcdy - cdxbdy) + bdz*(cdxady - adxcdy) + cdz*(adxbdy - bdxady);
+	double permanent = (fabs(bdxcdy) + fabs(cdxbdy))*fabs(adz)
+					 + (fabs(cdxady) + fabs(adxcdy))*fabs(bdz)
+					 + (fabs(adxbdy) + fabs(bdxady))*fabs(cdz);
+	double errbound = EA::o3derrboundA*permanent;
+	if (det > errbound || -det > errbound) return det;
+
+	// unrounded evaluation
+	bool rounded = false;
+	adx = EA::checked_diff(a.x[0], d.x[0], rounded); ady = EA::checked_diff(a.x[1], d.x[1], rounded); adz = EA::checked_diff(a.x[2], d.x[2], rounded);
+	bdx = EA::checked_diff(b.x[0], d.x[0], rounded); bdy = EA::checked_diff(b.x[1], d.x[1], rounded); bdz = EA::checked_diff(b.x[2], d.x[2], rounded);
+	cdx = EA::checked_diff(c.x[0], d.x[0], rounded); cdy = EA::checked_diff(c.x[1], d.x[1], rounded); cdz = EA::checked_diff(c.x[2], d.x[2], rounded);
+	if (!rounded){
+		double bc = EA::checked_diff(EA::checked_product(bdx, cdy, rounded), EA::checked_product(cdx, bdy, rounded), rounded);
+		double ca = EA::checked_diff(EA::checked_product(cdx, ady, rounded), EA::checked_product(adx, cdy, rounded), rounded);
+		double ab = EA::checked_diff(EA::checked_product(adx, bdy, rounded), EA::checked_product(bdx, ady, rounded), rounded);
+		det = EA::checked_sum(EA::checked_sum(EA::checked_product(adz, bc, rounded), EA::checked_product(bdz, ca, rounded), rounded),
+							  EA::checked_product(cdz, ab, rounded), rounded);
+		if (!rounded) return det;
+	}
+
+	// exact fallback
+	EA::Expansion eadx = EA::diff(a.x[0], d.x[0]), eady = EA::diff(a.x[1], d.x[1]), eadz = EA::diff(a.x[2], d.x[2]);
+	EA::Expansion ebdx = EA::diff(b.x[0], d.x[0]), ebdy = EA::diff(b.x[1], d.x[1]), ebdz = EA::diff(b.x[2], d.x[2]);
+	EA::Expansion ecdx = EA::diff(c.x[0], d.x[0]), ecdy = EA::diff(c.x[1], d.x[1]), ecdz = EA::diff(c.x[2], d.x[2]);
+
+	EA::Expansion bc = EA::sum(EA::product(ebdx, ecdy), EA::negate(EA::product(ecdx, ebdy)));
+	EA::Expansion ca = EA::sum(EA::product(ecdx, eady), EA::negate(EA::product(eadx, ecdy)));
+	EA::Expansion ab = EA::sum(EA::product(eadx, ebdy), EA::negate(EA::product(ebdx, eady)));
+
+	EA::Expansion e = EA::sum(EA::sum(EA::product(eadz, bc), EA::product(ebdz, ca)), EA::product(ecdz, ab));
+	return EA::estimate(e);
+}
+
+
+
+// Return a positive value if the point e lies inside the sphere passing
+// through a, b, c, and d; a negative value if it lies outside; and zero
+// if the five points are cospherical. The points a, b, c, and d must be
+// ordered so that orient3d(a, b, c, d) is positive. The sign is exact.
+inline double in_sphere(const Point<3> & a, const Point<3> & b, const Point<3> & c, const Point<3> & d, const Point<3> & e){
+	typedef ExactArithmetic EA;
+
+	double aex = a.x[0] - e.x[0], aey = a.x[1] - e.x[1], aez = a.x[2] - e.x[2];
+	double bex = b.x[0] - e.x[0], bey = b.x[1] - e.x[1], bez = b.x[2] - e.x[2];
+	double cex = c.x[0] - e.x[0], cey = c.x[1] - e.x[1], cez = c.x[2] - e.x[2];
+	double dex = d.x[0] - e.x[0], dey = d.x[1] - e.x[1], dez = d.x[2] - e.x[2];
+
+	double aexbey = aex*bey, bexaey = bex*aey;
+	double bexcey = bex*cey, cexbey = cex*bey;
+	double cexdey = cex*dey, dexcey = dex*cey;
+	double dexaey = dex*aey, aexdey = aex*dey;
+	double aexcey = aex*cey, cexaey = cex*aey;
+	double bexdey = bex*dey, dexbey = dex*bey;
+
+	double ab = aexbey - bexaey, bc = bexcey - cexbey, cd = cexdey - dexcey;
+	double da = dexaey - aexdey, ac = aexcey - cexaey, bd = bexdey - dexbey;
+
+	double abc = aez*bc - bez*ac + cez*ab;
+	double bcd = bez*cd - cez*bd + dez*bc;
+	double cda = cez*da + dez*ac + aez*cd;
+	double dab = dez*ab + aez*bd + bez*da;
+
+	double alift = aex*aex + aey*aey + aez*aez;
+	double blift = bex*bex + bey*bey + bez*bez;
+	double clift = cex*cex + cey*cey + cez*cez;
+	double dlift = dex*dex + dey*dey + dez*dez;
+
+	double det = (dlift*abc - clift*dab) + (blift*cda - alift*bcd);
+
+	double abp = fabs(aexbey) + fabs(bexaey), bcp = fabs(bexcey) + fabs(cexbey), cdp = fabs(cexdey) + fabs(dexcey);
+	double dap = fabs(dexaey) + fabs(aexdey), acp = fabs(aexcey) + fabs(cexaey), bdp = fabs(bexdey) + fabs(dexbey);
+	double permanent = (fabs(aez)*bcp + fabs(bez)*acp + fabs(cez)*abp)*dlift
+					 + (fabs(dez)*abp + fabs(aez)*bdp + fabs(bez)*dap)*clift
+					 + (fabs(cez)*dap + fabs(dez)*acp + fabs(aez)*cdp)*blift
+					 + (fabs(bez)*cdp + fabs(cez)*bdp + fabs(dez)*bcp)*alift;
+	double errbound = EA::isperrboundA*permanent;
+	if (det > errbound || -det > errbound) return det;
+
+	// unrounded evaluation
+	bool rounded = false;
+	aex = EA::checked_diff(a.x[0], e.x[0], rounded); aey = EA::checked_diff(a.x[1], e.x[1], rounded); aez = EA::checked_diff(a.x[2], e.x[2], rounded);
+	bex = EA::checked_diff(b.x[0], e.x[0], rounded); bey = EA::checked_diff(b.x[1], e.x[1], rounded); bez = EA::checked_diff(b.x[2], e.x[2], rounded);
+	cex = EA::checked_diff(c.x[0], e.x[0], rounded); cey = EA::checked_diff(c.x[1], e.x[1], rounded); cez = EA::checked_diff(c.x[2], e.x[2], rounded);
+	dex = EA::checked_diff(d.x[0], e.x[0], rounded); dey = EA::checked_diff(d.x[1], e.x[1], rounded); dez = EA::checked_diff(d.x[2], e.x[2], rounded);
+	if (!rounded){
+		auto cross2 = [&rounded](double x1, double y1, double x2, double y2){
+			return EA::checked_diff(EA::checked_product(x1, y2, rounded), EA::checked_product(x2, y1, rounded), rounded);
+		};
+		auto dot3 = [&rounded](double x1, double x2, double y1, double y2, double z1, double z2){
+			return EA::checked_sum(EA::checked_sum(EA::checked_product(x1, x2, rounded), EA::checked_product(y1, y2, rounded), rounded),
+								   EA::checked_product(z1, z2, rounded), rounded);
+		};
+		ab = cross2(aex, aey, bex, bey); bc = cross2(bex, bey, cex, cey); cd = cross2(cex, cey, dex, dey);
+		da = cross2(dex, dey, aex, aey); ac = cross2(aex, aey, cex, cey); bd = cross2(bex, bey, dex, dey);
+		abc = dot3(aez, bc, -bez, ac, cez, ab);
+		bcd = dot3(bez, cd, -cez, bd, dez, bc);
+		cda = dot3(cez, da, dez, ac, aez, cd);
+		dab = dot3(dez, ab, aez, bd, bez, da);
+		alift = dot3(aex, aex, aey, aey, aez, aez);
+		blift = dot3(bex, bex, bey, bey, bez, bez);
+		clift = dot3(cex, cex, cey, cey, cez, cez);
+		dlift = dot3(dex, dex, dey, dey, dez, dez);
+		det = EA::checked_sum(EA::checked_diff(EA::checked_product(dlift, abc, rounded), EA::checked_product(clift, dab, rounded), rounded),
+							  EA::checked_diff(EA::checked_product(blift, cda, rounded), EA::checked_product(alift, bcd, rounded), rounded), rounded);
+		if (!rounded) return det;
+	}
+
+	// exact fallback
+	EA::Expansion eaex = EA::diff(a.x[0], e.x[0]), eaey = EA::diff(a.x[1], e.x[1]), eaez = EA::diff(a.x[2], e.x[2]);
+	EA::Expansion ebex = EA::diff(b.x[0], e.x[0]), ebey = EA::diff(b.x[1], e.x[1]), ebez = EA::diff(b.x[2], e.x[2]);
+	EA::Expansion ecex = EA::diff(c.x[0], e.x[0]), ecey = EA::diff(c.x[1], e.x[1]), ecez = EA::diff(c.x[2], e.x[2]);
+	EA::Expansion edex = EA::diff(d.x[0], e.x[0]), edey = EA::diff(d.x[1], e.x[1]), edez = EA::diff(d.x[2], e.x[2]);
+
+	auto cross2 = [](const EA::Expansion & x1, const EA::Expansion & y1, const EA::Expansion & x2, const EA::Expansion & y2){
+		return EA::sum(EA::product(x1, y2), EA::negate(EA::product(x2, y1)));
+	};
+	EA::Expansion eab = cross2(eaex, eaey, ebex, ebey), ebc = cross2(ebex, ebey, ecex, ecey);
+	EA::Expansion ecd = cross2(ecex, ecey, edex, edey), eda = cross2(edex, edey, eaex, eaey);
+	EA::Expansion eac = cross2(eaex, eaey, ecex, ecey), ebd = cross2(ebex, ebey, edex, edey);
+
+	EA::Expansion eabc = EA::sum(EA::sum(EA::product(eaez, ebc), EA::negate(EA::product(ebez, eac))), EA::product(ecez, eab));
+	EA::Expansion ebcd = EA::sum(EA::sum(EA::product(ebez, ecd), EA::negate(EA::product(ecez, ebd))), EA::product(edez, ebc));
+	EA::Expansion ecda = EA::sum(EA::sum(EA::product(ecez, eda), EA::product(edez, eac)), EA::product(eaez, ecd));
+	EA::Expansion edab = EA::sum(EA::sum(EA::product(edez, eab), EA::product(eaez, ebd)), EA::product(ebez, eda));
+
+	auto lift = [](const EA::Expansion & x, const EA::Expansion & y, const EA::Expansion & z){
+		return EA::sum(EA::sum(EA::product(x, x), EA::product(y, y)), EA::product(z, z));
+	};
+	EA::Expansion ealift = lift(eaex, eaey, eaez), eblift = lift(ebex, ebey, ebez);
+	EA::Expansion eclift = lift(ecex, ecey, ecez), edlift = lift(edex, edey, edez);
+
+	EA::Expansion x = EA::sum(EA::sum(EA::product(edlift, eabc), EA::negate(EA::product(eclift, edab))),
+							  EA::sum(EA::product(eblift, ecda), EA::negate(EA::product(ealift, ebcd))));
+	return EA::estimate(x);
+}
+
+
+
+// Same as in_sphere(), but exact ties are broken by Simulation of
+// Simplicity as in in_circle(): the point with the largest index gets the
+// largest perturbation of its lifted coordinate. The result is nonzero
+// unless all five points are coplanar.
+inline double in_sphere(const Point<3> & a, const Point<3> & b, const Point<3> & c, const Point<3> & d, const Point<3> & e,
+						long ia, long ib, long ic, long id, long ie){
+	double det = in_sphere(a, b, c, d, e);
+	if (det != 0.0) return det;
+
+	// coefficient of each lifted coordinate in the determinant
+	long idx[5] = {ia, ib, ic, id, ie};
+	double coeff[5] = {orient3d(e, b, c, d), orient3d(a, e, c, d), orient3d(a, b, e, d), orient3d(a, b, c, e), -orient3d(a, b, c, d)};
+
+	// walk the perturbations from most to least significant
+	bool used[5] = {false, false, false, false, false};
+	for (auto n=0; n<5; n++){
+		int kmax = -1;
+		for (auto k=0; k<5; k++){
+			if (used[k]) continue;
+			if (kmax < 0 || idx[k] > idx[kmax]) kmax = k;
+		}
+		used[kmax] = true;
+		if (coeff[kmax] != 0.0) return coeff[kmax];
+	}
+	return 0.0;
+}
+
+
+}
+#endif
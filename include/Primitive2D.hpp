@@ -4,6 +4,7 @@
 #include "GeomUtils.hpp"
 #include "PrimitiveTypes.hpp"
 #include <memory>
+#include <limits>
 
 namespace csg{
 
@@ -41,6 +42,11 @@ public:
 		return {h1};
 	}
 
+	// evenly spaced, as few as keep the chords within tol
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		return get_outline(chord_count(m_radius, tol));
+	}
+
 	void translate(const Point<2> & pt) {
 		m_center = m_center + pt;
 	}
@@ -54,6 +60,55 @@ public:
 			   (pt.x[1]-m_center.x[1])*(pt.x[1]-m_center.x[1]) <= m_radius*m_radius; 
 	}
 
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1];
+		const double cx = m_center.x[0], cy = m_center.x[1], rsq = m_radius*m_radius;
+		classify_batch(batch, mask, [=](std::size_t i){
+			return (x[i]-cx)*(x[i]-cx) + (y[i]-cy)*(y[i]-cy) <= rsq;
+		});
+	}
+
+	double signed_distance(const Point<2> & pt) const{
+		return Point<2>::dist(pt, m_center) - m_radius;
+	}
+
+	void signed_distances(const PointBatch<2> & batch, double * dist) const{
+		const double * x = batch.x[0], * y = batch.x[1];
+		const double cx = m_center.x[0], cy = m_center.x[1], r = m_radius;
+		for (std::size_t i=0; i<batch.size; i++) dist[i] = sqrt((x[i]-cx)*(x[i]-cx) + (y[i]-cy)*(y[i]-cy)) - r;
+	}
+
+	// exact in one pass, from the nearest and furthest points of the box
+	RegionClass classify_box(const Box<2> & bx) const{
+		double rsq = m_radius*m_radius;
+		if (Box<2>::distsq(bx, m_center) > rsq) return OUTSIDE;
+		double fx = std::max(fabs(bx.lo.x[0]-m_center.x[0]), fabs(bx.hi.x[0]-m_center.x[0]));
+		double fy = std::max(fabs(bx.lo.x[1]-m_center.x[1]), fabs(bx.hi.x[1]-m_center.x[1]));
+		return (fx*fx + fy*fy <= rsq) ? INSIDE : AMBIGUOUS;
+	}
+
+	// the chord of the scan line, from the quadratic in its parameter
+	void scan_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		double tlo, thi;
+		if (!clip_line_ball(m_center, m_radius, a, step, tlo, thi)) {
+			if (Point<2>::dot(step, step) == 0) Primitive2D::scan_line(a, step, i0, i1, spans);
+			return;
+		}
+		scan_interval(tlo, thi, i0, i1, [&](std::size_t i){return contains_point(scan_sample(a, step, i));});
+		push_span(spans, i0, i1);
+	}
+
+	// exact: the disk reaches a convex polygon if its center is inside or
+	// an edge is within a radius of it. Containment is the default vertex
+	// test, which is exact for convex shapes
+	bool collides_polygon(const std::vector<Point<2>> & poly) const{
+		if (convex_overlap(poly, {m_center})) return true;
+		for (auto i=0; i<poly.size(); i++){
+			if (segment_distance(m_center, poly[i], poly[(i+1)%poly.size()]) <= m_radius) return true;
+		}
+		return false;
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Circle>" << std::endl;
@@ -116,6 +171,10 @@ public:
 
 	Point<2> dims() const {return Point<2>(m_lx, m_ly);};
 
+	Point<2> center() const {return m_center;};
+
+	double rotation() const {return m_rotation;};
+
 	std::vector<Hull<2>> get_outline(unsigned int npts) const {
 		Hull<2> h1;
 		// h1.points.resize(npts);
@@ -137,6 +196,11 @@ public:
 		return {h1};
 	}
 
+	// the corners are exact
+	std::vector<Hull<2>> get_adaptive_outline(double) const {
+		return {Hull<2>(corners())};
+	}
+
 	void translate(const Point<2> & pt) {
 		m_center = m_center + pt;
 	}
@@ -153,6 +217,50 @@ public:
 		return Box<2>::distsq(bx, rotx) < 1.0e-16; 
 	}
 
+	// the same arithmetic as contains_point(), with the branches of the
+	// box distance turned into selects
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1];
+		const double cx = m_center.x[0], cy = m_center.x[1];
+		const double c = cos(m_rotation), s = sin(m_rotation), hx = m_lx/2, hy = m_ly/2;
+		classify_batch(batch, mask, [=](std::size_t i){
+			double x0 = x[i]-cx, x1 = y[i]-cy;
+			double r0 = c*x0+s*x1, r1 = -s*x0+c*x1;
+			double e0 = keep_if(r0+hx, r0 < -hx), e1 = keep_if(r0-hx, r0 > hx);
+			double e2 = keep_if(r1+hy, r1 < -hy), e3 = keep_if(r1-hy, r1 > hy);
+			return e0*e0 + e1*e1 + e2*e2 + e3*e3 < 1.0e-16;
+		});
+	}
+
+	// exact, in the frame of the rectangle
+	double signed_distance(const Point<2> & pt) const{
+		Point<2> x = pt - m_center;
+		double r0 = cos(m_rotation)*x.x[0]+sin(m_rotation)*x.x[1], r1 = -sin(m_rotation)*x.x[0]+cos(m_rotation)*x.x[1];
+		return orthogonal_signed_distance(fabs(r0) - m_lx/2, fabs(r1) - m_ly/2);
+	}
+
+	// the corners, counterclockwise
+	std::vector<Point<2>> corners() const{
+		double c = cos(m_rotation), s = sin(m_rotation), hx = m_lx/2, hy = m_ly/2;
+		return {m_center + Point<2>(-c*hx + s*hy, -s*hx - c*hy),
+				m_center + Point<2>( c*hx + s*hy,  s*hx - c*hy),
+				m_center + Point<2>( c*hx - s*hy,  s*hx + c*hy),
+				m_center + Point<2>(-c*hx - s*hy, -s*hx + c*hy)};
+	}
+
+	// exact, by separating axes
+	bool collides_polygon(const std::vector<Point<2>> & poly) const{
+		return convex_overlap(corners(), poly);
+	}
+
+	// the scan line clipped to the edges
+	void scan_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		double tlo = -std::numeric_limits<double>::infinity(), thi = std::numeric_limits<double>::infinity();
+		if (!clip_line_convex(corners(), a, step, tlo, thi)) return;
+		scan_interval(tlo, thi, i0, i1, [&](std::size_t i){return contains_point(scan_sample(a, step, i));});
+		push_span(spans, i0, i1);
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Rectangle>" << std::endl;
@@ -212,6 +320,38 @@ public:
 		return {h1};
 	}
 
+	// stepped around by the radius of curvature, the smaller of its values
+	// at either end of each step, so that no chord strays more than tol.
+	// The radius only changes monotonically between the ends of the axes,
+	// so the steps stop at each of them. Points are dense where the
+	// ellipse bends sharply and sparse on its flat sides
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		double a = 0.5*Point<2>::dist(m_axis1.begin, m_axis1.end), b = 0.5*Point<2>::dist(m_axis2.begin, m_axis2.end);
+		Point<2> cen = 0.5*(m_axis1.begin+m_axis1.end);
+		double c = cos(m_rotation), s = sin(m_rotation);
+		if (!(tol > 0)){
+			std::cerr << "Ellipse: the outline tolerance must be positive" << std::endl;
+			throw("nonpositive outline tolerance");
+		}
+
+		// the step in the parameter for a chord of the curvature circle at t
+		auto step = [&](double t){
+			double q = a*a*sin(t)*sin(t) + b*b*cos(t)*cos(t);
+			double rho = q*sqrt(q)/(a*b);
+			double dtheta = (tol >= rho) ? pi/2 : 2*acos(1.0 - tol/rho);
+			return std::min(pi/2, dtheta*q/(a*b));
+		};
+		Hull<2> h1;
+		for (double t=0; t<2*pi;){
+			double u = a*cos(t), v = b*sin(t);
+			h1.points.push_back(cen + Point<2>(u*c + v*s, -u*s + v*c));
+			double dt = step(t), tq = (floor(t/(0.5*pi) + 1.0e-9) + 1)*0.5*pi;
+			t = std::min(t + std::min(dt, step(t + dt)), tq);
+			if (t > 2*pi - 1.0e-9) break;
+		}
+		return {h1};
+	}
+
 	void translate(const Point<2> & pt) {
 		m_axis1.begin = m_axis1.begin + pt;
 		m_axis1.end = m_axis1.end + pt;
@@ -232,6 +372,62 @@ public:
 			   (x.x[0]*sin(m_rotation)+x.x[1]*cos(m_rotation))*(x.x[0]*sin(m_rotation)+x.x[1]*cos(m_rotation))/bsq <= 1; 
 	}
 
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1];
+		const double asq = Point<2>::distsq(m_axis1.begin, m_axis1.end)*0.25;
+		const double bsq = Point<2>::distsq(m_axis2.begin, m_axis2.end)*0.25;
+		const Point<2> cen = 0.5*(m_axis1.begin+m_axis1.end);
+		const double cx = cen.x[0], cy = cen.x[1], c = cos(m_rotation), s = sin(m_rotation);
+		classify_batch(batch, mask, [=](std::size_t i){
+			double x0 = x[i]-cx, x1 = y[i]-cy;
+			double u = x0*c-x1*s, v = x0*s+x1*c;
+			return u*u/asq + v*v/bsq <= 1;
+		});
+	}
+
+	// exact, from the closest point on the ellipse in its own frame
+	double signed_distance(const Point<2> & pt) const{
+		double a = 0.5*Point<2>::dist(m_axis1.begin, m_axis1.end);
+		double b = 0.5*Point<2>::dist(m_axis2.begin, m_axis2.end);
+		Point<2> x = pt - 0.5*(m_axis1.begin+m_axis1.end);
+		double u = fabs(x.x[0]*cos(m_rotation)-x.x[1]*sin(m_rotation));
+		double v = fabs(x.x[0]*sin(m_rotation)+x.x[1]*cos(m_rotation));
+		double d = (a >= b) ? ellipse_distance(a, b, u, v) : ellipse_distance(b, a, v, u);
+		return (u*u/(a*a) + v*v/(b*b) <= 1) ? -d : d;
+	}
+
+	// exact: the polygon is mapped to the frame in which the ellipse is
+	// the unit circle, which keeps it convex
+	bool collides_polygon(const std::vector<Point<2>> & poly) const{
+		double a = 0.5*Point<2>::dist(m_axis1.begin, m_axis1.end);
+		double b = 0.5*Point<2>::dist(m_axis2.begin, m_axis2.end);
+		Point<2> cen = 0.5*(m_axis1.begin+m_axis1.end);
+		double c = cos(m_rotation), s = sin(m_rotation);
+		std::vector<Point<2>> q(poly.size());
+		for (auto i=0; i<poly.size(); i++){
+			Point<2> x = poly[i] - cen;
+			q[i] = Point<2>((x.x[0]*c-x.x[1]*s)/a, (x.x[0]*s+x.x[1]*c)/b);
+		}
+		return Circle(Point<2>(0, 0), 1).collides_polygon(q);
+	}
+
+	// the chord of the scan line, in the same frame
+	void scan_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		double ea = 0.5*Point<2>::dist(m_axis1.begin, m_axis1.end);
+		double eb = 0.5*Point<2>::dist(m_axis2.begin, m_axis2.end);
+		Point<2> x = a - 0.5*(m_axis1.begin+m_axis1.end);
+		double c = cos(m_rotation), s = sin(m_rotation);
+		Point<2> ua((x.x[0]*c-x.x[1]*s)/ea, (x.x[0]*s+x.x[1]*c)/eb);
+		Point<2> us((step.x[0]*c-step.x[1]*s)/ea, (step.x[0]*s+step.x[1]*c)/eb);
+		double tlo, thi;
+		if (!clip_line_ball(Point<2>(0, 0), 1, ua, us, tlo, thi)) {
+			if (Point<2>::dot(step, step) == 0) Primitive2D::scan_line(a, step, i0, i1, spans);
+			return;
+		}
+		scan_interval(tlo, thi, i0, i1, [&](std::size_t i){return contains_point(scan_sample(a, step, i));});
+		push_span(spans, i0, i1);
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Ellipse>" << std::endl;
@@ -246,6 +442,39 @@ private:
 
 	double 				m_rotation;	// rotation angle in radians
 	LineSegment 		m_axis1, m_axis2;
+
+	// distance from (y0, y1) with y0, y1 >= 0 to the ellipse with semi-axes
+	// e0 >= e1 along x and y. The closest point is the root of a monotone
+	// function of one parameter, which is found by bisection (D. Eberly,
+	// "Distance from a Point to an Ellipse, an Ellipsoid, or a Hyperellipsoid")
+	static double ellipse_distance(double e0, double e1, double y0, double y1){
+		if (y1 > 0){
+			if (y0 == 0) return fabs(y1 - e1);
+			double z0 = y0/e0, z1 = y1/e1, g = z0*z0 + z1*z1 - 1;
+			if (g == 0) return 0;
+			double r0 = (e0/e1)*(e0/e1), n0 = r0*z0;
+			double s0 = z1 - 1, s1 = (g < 0) ? 0 : sqrt(n0*n0 + z1*z1) - 1, s = 0;
+			for (auto it=0; it<200; it++){
+				s = 0.5*(s0 + s1);
+				if (s == s0 || s == s1) break;
+				double t0 = n0/(s + r0), t1 = z1/(s + 1), gs = t0*t0 + t1*t1 - 1;
+				if (gs > 0) s0 = s;
+				else if (gs < 0) s1 = s;
+				else break;
+			}
+			double x0 = r0*y0/(s + r0), x1 = y1/(s + 1);
+			return sqrt((x0-y0)*(x0-y0) + (x1-y1)*(x1-y1));
+		}
+
+		// on the major axis, the closest point is off the axis if y0 is
+		// inside the evolute
+		double numer = e0*y0, denom = e0*e0 - e1*e1;
+		if (numer < denom){
+			double xd = numer/denom, x0 = e0*xd, x1 = e1*sqrt(1 - xd*xd);
+			return sqrt((x0-y0)*(x0-y0) + x1*x1);
+		}
+		return fabs(y0 - e0);
+	}
 };
 
 
@@ -267,6 +496,8 @@ public:
 
 	std::shared_ptr<Primitive2D> copy() const {return std::make_shared<Triangle>(*this);};
 
+	Point<2> vertex(unsigned int i) const {return (i == 0) ? m_p1 : ((i == 1) ? m_p2 : m_p3);};
+
 	Box<2> get_bounding_box() const {
 		return Box<2>(Point<2>(std::min(std::min(m_p1.x[0],m_p2.x[0]),m_p3.x[0]), 
 					  		   std::min(std::min(m_p1.x[1],m_p2.x[1]),m_p3.x[1])),
@@ -296,6 +527,11 @@ public:
 		return {h1};
 	}
 
+	// the vertices are exact
+	std::vector<Hull<2>> get_adaptive_outline(double) const {
+		return {Hull<2>({m_p1, m_p2, m_p3})};
+	}
+
 	void translate(const Point<2> & pt) {
 		m_p1 = m_p1 + pt;
 		m_p2 = m_p2 + pt; 
@@ -354,6 +590,40 @@ public:
 		return (wn==0)? false : true;
 	}
 
+	// winding number without branches
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1];
+		const double ax = m_p1.x[0], ay = m_p1.x[1], bx = m_p2.x[0], by = m_p2.x[1], cx = m_p3.x[0], cy = m_p3.x[1];
+		classify_batch(batch, mask, [=](std::size_t i){
+			double l1 = (bx-ax)*(y[i]-ay) - (x[i]-ax)*(by-ay);
+			double l2 = (cx-bx)*(y[i]-by) - (x[i]-bx)*(cy-by);
+			double l3 = (ax-cx)*(y[i]-cy) - (x[i]-cx)*(ay-cy);
+			int wn = ((ay <= y[i]) & (by > y[i]) & (l1 >= 0)) - ((ay > y[i]) & (by <= y[i]) & (l1 < 0))
+				   + ((by <= y[i]) & (cy > y[i]) & (l2 >= 0)) - ((by > y[i]) & (cy <= y[i]) & (l2 < 0))
+				   + ((cy <= y[i]) & (ay > y[i]) & (l3 >= 0)) - ((cy > y[i]) & (ay <= y[i]) & (l3 < 0));
+			return wn != 0;
+		});
+	}
+
+	// exact, the distance to the nearest edge
+	double signed_distance(const Point<2> & pt) const{
+		double d = std::min(std::min(segment_distance(pt, m_p1, m_p2), segment_distance(pt, m_p2, m_p3)), segment_distance(pt, m_p3, m_p1));
+		return contains_point(pt) ? -d : d;
+	}
+
+	// exact, by separating axes
+	bool collides_polygon(const std::vector<Point<2>> & poly) const{
+		return convex_overlap({m_p1, m_p2, m_p3}, poly);
+	}
+
+	// the scan line clipped to the edges
+	void scan_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		double tlo = -std::numeric_limits<double>::infinity(), thi = std::numeric_limits<double>::infinity();
+		if (!clip_line_convex({m_p1, m_p2, m_p3}, a, step, tlo, thi)) return;
+		scan_interval(tlo, thi, i0, i1, [&](std::size_t i){return contains_point(scan_sample(a, step, i));});
+		push_span(spans, i0, i1);
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		// os << "Triangle: " << m_p1 << "-->" << m_p2 << "-->" << m_p3 ;
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
@@ -378,35 +648,90 @@ private:
 
 
 
+// the straight edges of a closed curve binned into horizontal slabs of
+// its bounding box, so that a point only winds around the edges that span
+// its height. Each slab keeps its own copy of those edges, contiguously
+struct SlabEdgeIndex{
+	struct Edge{double x0, y0, x1, y1;};
+
+	SlabEdgeIndex() : m_ylo(0), m_yscale(0) {};
+
+	SlabEdgeIndex(const std::vector<Point<2>> & begins, const std::vector<Point<2>> & ends, double ylo, double yhi)
+	: m_ylo(ylo) {
+		// one slab per edge, unless the edges are so tall together that the
+		// copies would pass about four per edge
+		double ysum = 0;
+		for (auto i=0; i<begins.size(); i++) ysum += fabs(ends[i].x[1] - begins[i].x[1]);
+		double nmax = std::max<double>(1, begins.size());
+		if (ysum > 0) nmax = std::min(nmax, 3*nmax*(yhi - ylo)/ysum);
+		std::size_t nslabs = std::max<std::size_t>(1, static_cast<std::size_t>(nmax));
+		m_yscale = (yhi > ylo) ? nslabs/(yhi - ylo) : 0;
+		m_offsets.assign(nslabs+1, 0);
+		for (auto i=0; i<begins.size(); i++){
+			std::size_t s0 = slab(std::min(begins[i].x[1], ends[i].x[1])), s1 = slab(std::max(begins[i].x[1], ends[i].x[1]));
+			for (auto s=s0; s<=s1; s++) m_offsets[s+1]++;
+		}
+		for (auto s=0; s<nslabs; s++) m_offsets[s+1] += m_offsets[s];
+		m_edges.resize(m_offsets[nslabs]);
+		std::vector<std::size_t> fill(m_offsets.begin(), m_offsets.end()-1);
+		for (auto i=0; i<begins.size(); i++){
+			std::size_t s0 = slab(std::min(begins[i].x[1], ends[i].x[1])), s1 = slab(std::max(begins[i].x[1], ends[i].x[1]));
+			for (auto s=s0; s<=s1; s++) m_edges[fill[s]++] = Edge{begins[i].x[0], begins[i].x[1], ends[i].x[0], ends[i].x[1]};
+		}
+	}
+
+	// the slab holding height y, clamped to the box. This is monotone in
+	// y, so an edge is in every slab that any of its heights falls in
+	std::size_t slab(double y) const{
+		double f = (y - m_ylo)*m_yscale;
+		if (!(f > 0)) return 0;
+		return std::min(static_cast<std::size_t>(f), m_offsets.size()-2);
+	}
+
+	// the same crossing rule as Polycurve::contains_point() over the
+	// edges of the slab of pt
+	int winding_number(const Point<2> & pt) const{
+		if (m_edges.empty()) return 0;
+		std::size_t s = slab(pt.x[1]);
+		int wn = 0;
+		for (auto k=m_offsets[s]; k<m_offsets[s+1]; k++){
+			const Edge & e = m_edges[k];
+			double left = (e.x1-e.x0)*(pt.x[1]-e.y0) - (pt.x[0]-e.x0)*(e.y1-e.y0);
+			if (e.y0 <= pt.x[1]){
+				if (e.y1 > pt.x[1] && left >= 0) wn++;
+			}
+			else{
+				if (e.y1 <= pt.x[1] && left < 0) wn--;
+			}
+		}
+		return wn;
+	}
+
+	std::vector<Edge> 			m_edges;		// grouped by slab
+	std::vector<std::size_t> 	m_offsets;		// of each slab in m_edges
+	double 						m_ylo, m_yscale;	// slabs per unit height
+};
+
+
+
+
 // a collection of Segments that connect
 // this is a generalization of a polygon to permit curved segments
+//
+// The chords begin-->end, the bounding box and, if every segment is
+// straight, a slab index over the edges are prepared at construction
 class Polycurve : public Primitive2D
 {
 public:
 
-	Polycurve(){};
+	Polycurve() : m_straight(false) {};
 
 	Polycurve(const std::vector<std::shared_ptr<Segment<2>>> & segs)
-	: m_segments(segs) {};
+	: m_segments(segs) {prepare();};
 
 	virtual std::shared_ptr<Primitive2D> copy() const {return std::make_shared<Polycurve>(*this);};
 
-	Box<2> get_bounding_box() const {
-		Point<2> lo = m_segments[0]->begin;
-		Point<2> hi = lo;
-		for (auto i=0; i<m_segments.size(); i++){
-			lo.x[0] = std::min(lo.x[0],m_segments[i]->begin.x[0]);
-			lo.x[0] = std::min(lo.x[0],m_segments[i]->end.x[0]);
-			lo.x[1] = std::min(lo.x[1],m_segments[i]->begin.x[1]);
-			lo.x[1] = std::min(lo.x[1],m_segments[i]->end.x[1]);
-
-			hi.x[0] = std::max(hi.x[0],m_segments[i]->begin.x[0]);
-			hi.x[0] = std::max(hi.x[0],m_segments[i]->end.x[0]);
-			hi.x[1] = std::max(hi.x[1],m_segments[i]->begin.x[1]);
-			hi.x[1] = std::max(hi.x[1],m_segments[i]->end.x[1]);
-		}
-		return Box<2>(lo,hi);
-	}
+	Box<2> get_bounding_box() const {return m_box;};
 
 	std::vector<Hull<2>> get_outline(unsigned int npts) const {
 		Hull<2> h1;
@@ -425,11 +750,22 @@ public:
 		return {h1};
 	}
 
+	// the ends of the chords, which are exact for polygons and are what
+	// the other queries take curved segments to be
+	std::vector<Hull<2>> get_adaptive_outline(double) const {
+		return {Hull<2>(m_begins)};
+	}
+
+	// the segments may be shared with copies of this curve, so they are
+	// replaced rather than moved in place
 	void translate(const Point<2> & pt) {
 		for (auto i=0; i<m_segments.size(); i++){
+			if (auto ls = dynamic_cast<const LineSegment *>(m_segments[i].get())) m_segments[i] = std::make_shared<LineSegment>(*ls);
+			else if (auto cs = dynamic_cast<const CircleSegment *>(m_segments[i].get())) m_segments[i] = std::make_shared<CircleSegment>(*cs);
 			m_segments[i]->begin = m_segments[i]->begin + pt;
 			m_segments[i]->end = m_segments[i]->end + pt;
 		}
+		prepare();
 	}
 
 	// void rotate(const Point<2> & anchor, double degrees) {
@@ -438,16 +774,15 @@ public:
 
 	bool contains_point(const Point<2> & pt) const{
 		// first check bounding Box
-		Box<2> bx = get_bounding_box();
-		if (Box<2>::dist(bx, pt) > 1.0e-16) return false;
-		// std::cout << "checking polycurve" << std::endl;
+		if (Box<2>::dist(m_box, pt) > 1.0e-16) return false;
+		if (m_straight) return m_index.winding_number(pt) != 0;
 
 		// do more rigorous point-in-polygon check
 		unsigned int wn = 0;
 		for (auto i=0; i<m_segments.size(); i++){
 
-			Point<2> p1 = m_segments[i]->begin;
-			Point<2> p2 = m_segments[i]->end;
+			Point<2> p1 = m_begins[i];
+			Point<2> p2 = m_ends[i];
 			// std::cout << p1 << "-->" << p2 << std::endl;
 			if (p1.x[1] <= pt.x[1]){
 				if (p2.x[1] > pt.x[1]){
@@ -464,6 +799,48 @@ public:
 		return (wn==0)? false : true;
 	}
 
+	// the same test as contains_point(), without a virtual call per point
+	void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		classify_batch(batch, mask, [&](std::size_t i){return Polycurve::contains_point(batch.point(i));});
+	}
+
+	// the distance to the nearest chord begin-->end of the segments, which
+	// are also what contains_point() winds around. This is exact for
+	// polygons
+	double signed_distance(const Point<2> & pt) const{
+		double d = std::numeric_limits<double>::max();
+		for (auto i=0; i<m_begins.size(); i++) d = std::min(d, segment_distance(pt, m_begins[i], m_ends[i]));
+		return Polycurve::contains_point(pt) ? -d : d;
+	}
+
+	// exact for the chords, as above. A convex polygon is inside if its
+	// vertices are and no chord enters its interior
+	bool contains_polygon(const std::vector<Point<2>> & poly) const{
+		for (auto & p : poly) if (!Polycurve::contains_point(p)) return false;
+		for (auto i=0; i<m_begins.size(); i++){
+			if (convex_overlap({m_begins[i], m_ends[i]}, poly, false)) return false;
+		}
+		return !poly.empty();
+	}
+
+	// and it collides if a chord crosses it or it lies inside
+	bool collides_polygon(const std::vector<Point<2>> & poly) const{
+		if (poly.empty()) return false;
+		if (!Box<2>::collides(m_box, bounding_box(poly))) return false;
+		for (auto i=0; i<m_begins.size(); i++){
+			if (convex_overlap({m_begins[i], m_ends[i]}, poly)) return true;
+		}
+		return Polycurve::contains_point(poly[0]);
+	}
+
+	// halved down to the spans between crossings, where the chord tests
+	// above are exact. Curved segments are sampled instead
+	void scan_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		if (!m_straight) {Primitive2D::scan_line(a, step, i0, i1, spans); return;}
+		scan_range(m_box, a, step, i0, i1);
+		if (i0 < i1) scan_by_bisection(*this, a, step, i0, i1, spans);
+	}
+
 	virtual void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Polycurve>" << std::endl;
@@ -478,7 +855,36 @@ public:
 
 protected:
 
+	// derived classes that fill m_segments themselves call this afterward
+	void prepare(){
+		m_begins.resize(m_segments.size());
+		m_ends.resize(m_segments.size());
+		m_straight = true;
+		for (auto i=0; i<m_segments.size(); i++){
+			m_begins[i] = m_segments[i]->begin;
+			m_ends[i] = m_segments[i]->end;
+			m_straight &= dynamic_cast<const LineSegment *>(m_segments[i].get()) != nullptr;
+		}
+
+		Point<2> lo = m_segments.empty() ? Point<2>(0, 0) : m_begins[0];
+		Point<2> hi = lo;
+		for (auto i=0; i<m_segments.size(); i++){
+			for (auto d=0; d<2; d++){
+				lo.x[d] = std::min(lo.x[d], std::min(m_begins[i].x[d], m_ends[i].x[d]));
+				hi.x[d] = std::max(hi.x[d], std::max(m_begins[i].x[d], m_ends[i].x[d]));
+			}
+		}
+		m_box = Box<2>(lo, hi);
+		m_index = m_straight ? SlabEdgeIndex(m_begins, m_ends, lo.x[1], hi.x[1]) : SlabEdgeIndex();
+	}
+
 	std::vector<std::shared_ptr<Segment<2>>> 		m_segments;
+
+	// prepared from the segments
+	std::vector<Point<2>> 							m_begins, m_ends;
+	Box<2> 											m_box;
+	bool 											m_straight;		// if every segment is a LineSegment
+	SlabEdgeIndex 									m_index;
 };
 
 
@@ -496,6 +902,7 @@ public:
 	Polygon(const std::vector<LineSegment> & segs)
 	{
 		for (auto i=0; i<segs.size(); i++) m_segments.push_back(std::shared_ptr<Segment<2>>(new LineSegment(segs[i])));
+		prepare();
 	}
 
 	std::shared_ptr<Primitive2D> copy() const {return std::make_shared<Polygon>(*this);};
@@ -550,6 +957,7 @@ public:
 			m_segments.push_back(std::shared_ptr<Segment<2>>(new LineSegment(s)));
 			theta += dtheta;
 		}
+		prepare();
 
 
 	};
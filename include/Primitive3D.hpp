@@ -20,6 +20,10 @@ public:
 
 	std::shared_ptr<Primitive3D> copy() const {return std::make_shared<Sphere>(*this);};
 
+	double radius() const {return m_radius;};
+
+	Point<3> center() const {return m_center;};
+
 	Box<3> get_bounding_box() const {
 		return Box<3>(Point<3>(m_center.x[0]-m_radius, m_center.x[1]-m_radius, m_center.x[2]-m_radius),
 					  Point<3>(m_center.x[0]+m_radius, m_center.x[1]+m_radius, m_center.x[2]+m_radius));
@@ -39,6 +43,53 @@ public:
 			   (pt.x[2]-m_center.x[2])*(pt.x[2]-m_center.x[2]) <= m_radius*m_radius; 
 	}
 
+	void contains_points(const PointBatch<3> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1], * z = batch.x[2];
+		const double cx = m_center.x[0], cy = m_center.x[1], cz = m_center.x[2], rsq = m_radius*m_radius;
+		classify_batch(batch, mask, [=](std::size_t i){
+			return (x[i]-cx)*(x[i]-cx) + (y[i]-cy)*(y[i]-cy) + (z[i]-cz)*(z[i]-cz) <= rsq;
+		});
+	}
+
+	double signed_distance(const Point<3> & pt) const{
+		return Point<3>::dist(pt, m_center) - m_radius;
+	}
+
+	void signed_distances(const PointBatch<3> & batch, double * dist) const{
+		const double * x = batch.x[0], * y = batch.x[1], * z = batch.x[2];
+		const double cx = m_center.x[0], cy = m_center.x[1], cz = m_center.x[2], r = m_radius;
+		for (std::size_t i=0; i<batch.size; i++) dist[i] = sqrt((x[i]-cx)*(x[i]-cx) + (y[i]-cy)*(y[i]-cy) + (z[i]-cz)*(z[i]-cz)) - r;
+	}
+
+	// exact. Containment is the default corner test, which is exact for
+	// convex shapes
+	bool collides_box(const Box<3> & bx) const{
+		return Box<3>::distsq(bx, m_center) <= m_radius*m_radius;
+	}
+
+	// exact in one pass, from the nearest and furthest points of the box
+	RegionClass classify_box(const Box<3> & bx) const{
+		double rsq = m_radius*m_radius;
+		if (Box<3>::distsq(bx, m_center) > rsq) return OUTSIDE;
+		double fsq = 0;
+		for (auto d=0; d<3; d++){
+			double f = std::max(fabs(bx.lo.x[d]-m_center.x[d]), fabs(bx.hi.x[d]-m_center.x[d]));
+			fsq += f*f;
+		}
+		return (fsq <= rsq) ? INSIDE : AMBIGUOUS;
+	}
+
+	// the chord of the scan line, from the quadratic in its parameter
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		double tlo, thi;
+		if (!clip_line_ball(m_center, m_radius, a, step, tlo, thi)) {
+			if (Point<3>::dot(step, step) == 0) Primitive3D::scan_line(a, step, i0, i1, spans);
+			return;
+		}
+		scan_interval(tlo, thi, i0, i1, [&](std::size_t i){return contains_point(scan_sample(a, step, i));});
+		push_span(spans, i0, i1);
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Sphere>" << std::endl;
@@ -69,44 +120,17 @@ public:
 	Cylinder(const Point<3> & center, const Point<3> & normal, const Point<3> & px, double radius, double height)
 	: m_plane(Plane(center, normal, px))
 	, m_circle(Circle(Point<2>(0,0), radius))
-	, m_height(height) {};
+	, m_height(height) {
+		m_box = slab_bounding_box(m_plane, m_height, m_circle.get_bounding_box());
+	};
 
 	std::shared_ptr<Primitive3D> copy() const {return std::make_shared<Cylinder>(*this);};
 
-	Box<3> get_bounding_box() const {
-		Point<3> yhat = (cross(m_plane.normal, m_plane.posx)).normalize();
-		Point<3> xhat = (m_plane.posx).normalize();
-		Point<3> nhat = (m_plane.normal).normalize();
-
-		Box<2> basebox = m_circle.get_bounding_box();
-
-		// get the 8 box points in 3D space
-		std::vector<Point<3>> bpts(8);
-		bpts[0] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[1] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[2] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-		bpts[3] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-
-		bpts[4] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[5] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[6] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-		bpts[7] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-
-		Point<3> lo = bpts[0];
-		Point<3> hi = bpts[0];
-		for (auto i=0; i<8; i++){
-			lo.x[0] = std::min(lo.x[0], bpts[i].x[0]);
-			lo.x[1] = std::min(lo.x[1], bpts[i].x[1]);
-			lo.x[2] = std::min(lo.x[2], bpts[i].x[2]);
-			hi.x[0] = std::max(hi.x[0], bpts[i].x[0]);
-			hi.x[1] = std::max(hi.x[1], bpts[i].x[1]);
-			hi.x[2] = std::max(hi.x[2], bpts[i].x[2]);
-		}
-		return Box<3>(lo,hi);
-	}
+	Box<3> get_bounding_box() const {return m_box;};
 
 	void translate(const Point<3> & pt) {
 		m_plane.origin = m_plane.origin + pt;
+		m_box = Box<3>(m_box.lo + pt, m_box.hi + pt);
 	}
 
 	// void rotate(const Point<3> & axis, double degrees) {
@@ -123,6 +147,61 @@ public:
 		return m_circle.contains_point(pp);
 	}
 
+	// the same arithmetic as contains_point(), with the plane
+	// projection inlined
+	void contains_points(const PointBatch<3> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1], * z = batch.x[2];
+		const Point<3> o = m_plane.origin, n = m_plane.normal, px = m_plane.posx, py = m_plane.posy;
+		const double h = m_height, cx = m_circle.center().x[0], cy = m_circle.center().x[1];
+		const double rsq = m_circle.radius()*m_circle.radius();
+		classify_batch(batch, mask, [=](std::size_t i){
+			double v0 = x[i]-o.x[0], v1 = y[i]-o.x[1], v2 = z[i]-o.x[2];
+			double proj = v0*n.x[0] + v1*n.x[1] + v2*n.x[2];
+			double u = v0*px.x[0] + v1*px.x[1] + v2*px.x[2];
+			double w = v0*py.x[0] + v1*py.x[1] + v2*py.x[2];
+			return !(proj > h) & !(proj < 0) & ((u-cx)*(u-cx) + (w-cy)*(w-cy) <= rsq);
+		});
+	}
+
+	// exact for an orthonormal frame, from the distances to the circle in
+	// the plane and to the height slab
+	double signed_distance(const Point<3> & pt) const{
+		double proj = Point<3>::dot(pt - m_plane.origin, m_plane.normal);
+		return orthogonal_signed_distance(m_circle.signed_distance(m_plane.project(pt)), fabs(proj - 0.5*m_height) - 0.5*m_height);
+	}
+
+	// exact: the part of the box within the height slab, projected onto
+	// the plane, is a convex polygon that must reach the circle
+	bool collides_box(const Box<3> & bx) const{
+		return m_circle.collides_polygon(slab_section(m_plane, m_height, bx));
+	}
+
+	// exact: the box must lie within the slab and project into the circle
+	bool contains_box(const Box<3> & bx) const{
+		return slab_contains(m_plane, m_height, bx) && m_circle.contains_polygon(slab_section(m_plane, m_height, bx, false));
+	}
+
+	// the box tests are exact, so the line is halved with them and runs
+	// clear of the boundary are taken whole
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_classification(*this, a, step, i0, i1, spans);
+	}
+
+	// the same arithmetic as signed_distance(), with the plane projection
+	// inlined
+	void signed_distances(const PointBatch<3> & batch, double * dist) const{
+		const double * x = batch.x[0], * y = batch.x[1], * z = batch.x[2];
+		const Point<3> o = m_plane.origin, n = m_plane.normal, px = m_plane.posx, py = m_plane.posy;
+		const double hh = 0.5*m_height, cx = m_circle.center().x[0], cy = m_circle.center().x[1], r = m_circle.radius();
+		for (std::size_t i=0; i<batch.size; i++){
+			double v0 = x[i]-o.x[0], v1 = y[i]-o.x[1], v2 = z[i]-o.x[2];
+			double proj = v0*n.x[0] + v1*n.x[1] + v2*n.x[2];
+			double u = v0*px.x[0] + v1*px.x[1] + v2*px.x[2];
+			double w = v0*py.x[0] + v1*py.x[1] + v2*py.x[2];
+			dist[i] = orthogonal_signed_distance(sqrt((u-cx)*(u-cx) + (w-cy)*(w-cy)) - r, fabs(proj - hh) - hh);
+		}
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Cylinder>" << std::endl;
@@ -144,6 +223,7 @@ private:
 	double 			m_height;
 	Plane 			m_plane;
 	Circle 			m_circle;
+	Box<3> 			m_box;		// cached at construction
 };
 
 
@@ -165,44 +245,17 @@ public:
 	RectangularPrism(const Point<3> & center, const Point<3> & normal, const Point<3> & px, const Point<2> & rdims, double height)
 	: m_plane(Plane(center, normal, px))
 	, m_rect(Rectangle(Point<2>(0,0), rdims))
-	, m_height(height) {};
+	, m_height(height) {
+		m_box = slab_bounding_box(m_plane, m_height, m_rect.get_bounding_box());
+	};
 
 	std::shared_ptr<Primitive3D> copy() const {return std::make_shared<RectangularPrism>(*this);};
 
-	Box<3> get_bounding_box() const {
-		Point<3> yhat = (cross(m_plane.normal, m_plane.posx)).normalize();
-		Point<3> xhat = (m_plane.posx).normalize();
-		Point<3> nhat = (m_plane.normal).normalize();
-
-		Box<2> basebox = m_rect.get_bounding_box();
-
-		// get the 8 box points in 3D space
-		std::vector<Point<3>> bpts(8);
-		bpts[0] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[1] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[2] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-		bpts[3] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-
-		bpts[4] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[5] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[6] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-		bpts[7] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-
-		Point<3> lo = bpts[0];
-		Point<3> hi = bpts[0];
-		for (auto i=0; i<8; i++){
-			lo.x[0] = std::min(lo.x[0], bpts[i].x[0]);
-			lo.x[1] = std::min(lo.x[1], bpts[i].x[1]);
-			lo.x[2] = std::min(lo.x[2], bpts[i].x[2]);
-			hi.x[0] = std::max(hi.x[0], bpts[i].x[0]);
-			hi.x[1] = std::max(hi.x[1], bpts[i].x[1]);
-			hi.x[2] = std::max(hi.x[2], bpts[i].x[2]);
-		}
-		return Box<3>(lo,hi);
-	}
+	Box<3> get_bounding_box() const {return m_box;};
 
 	void translate(const Point<3> & pt) {
 		m_plane.origin = m_plane.origin + pt;
+		m_box = Box<3>(m_box.lo + pt, m_box.hi + pt);
 	}
 
 	// void rotate(const Point<3> & axis, double degrees) {
@@ -214,9 +267,74 @@ public:
 		double proj = Point<3>::dot(ptvec, m_plane.normal);
 		if (proj > m_height || proj < 0) return false;
 
-		// now project the point onto the plane
-		Point<2> pp = m_plane.project(pt);
-		return m_rect.contains_point(pp);
+		// now project the point onto the plane, where the rectangle is never
+		// rotated, so its own test reduces to a box distance
+		Point<2> pp = m_plane.project(pt) - m_rect.center();
+		Box<2> bx(-0.5*m_rect.dims(), 0.5*m_rect.dims());
+		return Box<2>::distsq(bx, pp) < 1.0e-16;
+	}
+
+	// the same arithmetic as contains_point(), with the plane projection
+	// and the rectangle test inlined
+	void contains_points(const PointBatch<3> & batch, Ullong * mask) const{
+		const double * x = batch.x[0], * y = batch.x[1], * z = batch.x[2];
+		const Point<3> o = m_plane.origin, n = m_plane.normal, px = m_plane.posx, py = m_plane.posy;
+		const double h = m_height, cx = m_rect.center().x[0], cy = m_rect.center().x[1];
+		const double c = cos(m_rect.rotation()), s = sin(m_rect.rotation());
+		const double hx = m_rect.dims().x[0]/2, hy = m_rect.dims().x[1]/2;
+		classify_batch(batch, mask, [=](std::size_t i){
+			double v0 = x[i]-o.x[0], v1 = y[i]-o.x[1], v2 = z[i]-o.x[2];
+			double proj = v0*n.x[0] + v1*n.x[1] + v2*n.x[2];
+			double x0 = v0*px.x[0] + v1*px.x[1] + v2*px.x[2] - cx;
+			double x1 = v0*py.x[0] + v1*py.x[1] + v2*py.x[2] - cy;
+			double r0 = c*x0+s*x1, r1 = -s*x0+c*x1;
+			double e0 = keep_if(r0+hx, r0 < -hx), e1 = keep_if(r0-hx, r0 > hx);
+			double e2 = keep_if(r1+hy, r1 < -hy), e3 = keep_if(r1-hy, r1 > hy);
+			return !(proj > h) & !(proj < 0) & (e0*e0 + e1*e1 + e2*e2 + e3*e3 < 1.0e-16);
+		});
+	}
+
+	// exact for an orthonormal frame, from the distances to the rectangle
+	// in the plane and to the height slab
+	double signed_distance(const Point<3> & pt) const{
+		double proj = Point<3>::dot(pt - m_plane.origin, m_plane.normal);
+		Point<2> pp = m_plane.project(pt) - m_rect.center();
+		return orthogonal_signed_distance(orthogonal_signed_distance(fabs(pp.x[0]) - 0.5*m_rect.dims().x[0], fabs(pp.x[1]) - 0.5*m_rect.dims().x[1]), fabs(proj - 0.5*m_height) - 0.5*m_height);
+	}
+
+	// exact: the part of the box within the height slab, projected onto
+	// the plane, is a convex polygon that must reach the rectangle
+	bool collides_box(const Box<3> & bx) const{
+		return m_rect.collides_polygon(slab_section(m_plane, m_height, bx));
+	}
+
+	// exact: the box must lie within the slab and project into the rectangle
+	bool contains_box(const Box<3> & bx) const{
+		return slab_contains(m_plane, m_height, bx) && m_rect.contains_polygon(slab_section(m_plane, m_height, bx, false));
+	}
+
+	// the box tests are exact, so the line is halved with them and runs
+	// clear of the boundary are taken whole
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_classification(*this, a, step, i0, i1, spans);
+	}
+
+	// the same arithmetic as signed_distance(), with the plane projection
+	// and the rectangle distance inlined
+	void signed_distances(const PointBatch<3> & batch, double * dist) const{
+		const double * x = batch.x[0], * y = batch.x[1], * z = batch.x[2];
+		const Point<3> o = m_plane.origin, n = m_plane.normal, px = m_plane.posx, py = m_plane.posy;
+		const double hh = 0.5*m_height, cx = m_rect.center().x[0], cy = m_rect.center().x[1];
+		const double c = cos(m_rect.rotation()), s = sin(m_rect.rotation());
+		const double hx = m_rect.dims().x[0]/2, hy = m_rect.dims().x[1]/2;
+		for (std::size_t i=0; i<batch.size; i++){
+			double v0 = x[i]-o.x[0], v1 = y[i]-o.x[1], v2 = z[i]-o.x[2];
+			double proj = v0*n.x[0] + v1*n.x[1] + v2*n.x[2];
+			double x0 = v0*px.x[0] + v1*px.x[1] + v2*px.x[2] - cx;
+			double x1 = v0*py.x[0] + v1*py.x[1] + v2*py.x[2] - cy;
+			double r0 = c*x0+s*x1, r1 = -s*x0+c*x1;
+			dist[i] = orthogonal_signed_distance(orthogonal_signed_distance(fabs(r0) - hx, fabs(r1) - hy), fabs(proj - hh) - hh);
+		}
 	}
 
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
@@ -243,6 +361,7 @@ private:
 	double 			m_height;
 	Plane 			m_plane;
 	Rectangle 		m_rect;
+	Box<3> 			m_box;		// cached at construction
 };
 
 
@@ -262,43 +381,26 @@ public:
 	Pyramid(const Primitive2D & base, const Point<3> & center, const Point<3> & normal, const Point<3> & px, double height)
 	: m_plane(Plane(center, normal, px))
 	, m_base(base.copy())
-	, m_height(height) {};
+	, m_height(height) {
+		Box<2> bb = m_base->get_bounding_box();
+		m_box = slab_bounding_box(m_plane, m_height, bb);
+
+		// the farthest corner of the base from the apex sets the slope
+		double rsq = 0;
+		for (auto c=0; c<4; c++){
+			Point<2> corner((c & 1) ? bb.hi.x[0] : bb.lo.x[0], (c & 2) ? bb.hi.x[1] : bb.lo.x[1]);
+			rsq = std::max(rsq, Point<2>::dot(corner, corner));
+		}
+		m_slope = sqrt(1.0 + rsq/(m_height*m_height));
+	};
 
 	std::shared_ptr<Primitive3D> copy() const {return std::make_shared<Pyramid>(*this);};
 
-	Box<3> get_bounding_box() const {
-		Point<3> yhat = (cross(m_plane.normal, m_plane.posx)).normalize();
-		Point<3> xhat = (m_plane.posx).normalize();
-		Point<3> nhat = (m_plane.normal).normalize();
-		Box<2> basebox = m_base->get_bounding_box();
-
-		// get the 8 box points in 3D space
-		std::vector<Point<3>> bpts(8);
-		bpts[0] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[1] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[2] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-		bpts[3] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-
-		bpts[4] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[5] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[6] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-		bpts[7] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-
-		Point<3> lo = bpts[0];
-		Point<3> hi = bpts[0];
-		for (auto i=0; i<8; i++){
-			lo.x[0] = std::min(lo.x[0], bpts[i].x[0]);
-			lo.x[1] = std::min(lo.x[1], bpts[i].x[1]);
-			lo.x[2] = std::min(lo.x[2], bpts[i].x[2]);
-			hi.x[0] = std::max(hi.x[0], bpts[i].x[0]);
-			hi.x[1] = std::max(hi.x[1], bpts[i].x[1]);
-			hi.x[2] = std::max(hi.x[2], bpts[i].x[2]);
-		}
-		return Box<3>(lo,hi);
-	}
+	Box<3> get_bounding_box() const {return m_box;};
 
 	void translate(const Point<3> & pt) {
 		m_plane.origin = m_plane.origin + pt;
+		m_box = Box<3>(m_box.lo + pt, m_box.hi + pt);
 	}
 
 	// void rotate(const Point<3> & axis, double degrees) {
@@ -318,6 +420,39 @@ public:
 		return m_base->contains_point(pp);
 	}
 
+	// the distance to the height slab, or the distance to the cross-section
+	// at the height of the point divided by the steepest slope of the sides,
+	// the larger of the two. This is a bound for bases that are star-shaped
+	// about the apex. Above the apex, the cross-section is the apex itself
+	double signed_distance(const Point<3> & pt) const{
+		double proj = Point<3>::dot(pt - m_plane.origin, m_plane.normal);
+		double dz = std::max(-proj, proj - m_height);
+		Point<2> pp = m_plane.project(pt);
+		if (proj >= m_height) return std::max(dz, pp.norm()/m_slope);
+		double t = 1.0-proj/m_height;
+		return std::max(dz, t*m_base->signed_distance(1.0/t*pp)/m_slope);
+	}
+
+	// the cross sections of the box shrink toward the apex, so these are
+	// resolved from the signed distance above, conservatively
+	bool collides_box(const Box<3> & bx) const{
+		return sdf_collides_box(*this, bx);
+	}
+
+	bool contains_box(const Box<3> & bx) const{
+		return sdf_contains_box(*this, bx);
+	}
+
+	RegionClass classify_box(const Box<3> & bx) const{
+		return sdf_classify_box(*this, bx);
+	}
+
+	// the box tests are conservative, so the line is halved with them and runs
+	// clear of the boundary are taken whole
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_classification(*this, a, step, i0, i1, spans);
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Pyramid>" << std::endl;
@@ -342,6 +477,8 @@ private:
 	std::shared_ptr<Primitive2D> 	m_base;
 	double 							m_height;
 	Plane 							m_plane;
+	Box<3> 							m_box;		// cached at construction
+	double 							m_slope;	// of the steepest side, cached at construction
 
 };
 
@@ -360,42 +497,17 @@ public:
 	Extrusion(const Primitive2D & base, const Point<3> & center, const Point<3> & normal, const Point<3> & px, double height)
 	: m_plane(Plane(center, normal, px))
 	, m_base(base.copy())
-	, m_height(height) {};
+	, m_height(height) {
+		m_box = slab_bounding_box(m_plane, m_height, m_base->get_bounding_box());
+	};
 
 	std::shared_ptr<Primitive3D> copy() const {return std::make_shared<Extrusion>(*this);};
 
-	Box<3> get_bounding_box() const {
-		Point<3> yhat = (cross(m_plane.normal, m_plane.posx)).normalize();
-		Point<3> xhat = (m_plane.posx).normalize();
-		Point<3> nhat = (m_plane.normal).normalize();
-		Box<2> basebox = m_base->get_bounding_box();
-
-		// get the 8 box points in 3D space
-		std::vector<Point<3>> bpts(8);
-		bpts[0] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[1] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin;
-		bpts[2] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-		bpts[3] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin;
-
-		bpts[4] = xhat*basebox.lo.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[5] = xhat*basebox.hi.x[0] + yhat*basebox.lo.x[1] + m_plane.origin + m_height*nhat;
-		bpts[6] = xhat*basebox.hi.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-		bpts[7] = xhat*basebox.lo.x[0] + yhat*basebox.hi.x[1] + m_plane.origin + m_height*nhat;
-
-		Point<3> lo = bpts[0];
-		Point<3> hi = bpts[0];
-		for (auto i=0; i<8; i++){
-			lo.x[0] = std::min(lo.x[0], bpts[i].x[0]);
-			lo.x[1] = std::min(lo.x[1], bpts[i].x[1]);
-			lo.x[2] = std::min(lo.x[2], bpts[i].x[2]);
-			hi.x[0] = std::max(hi.x[0], bpts[i].x[0]);
-			hi.x[1] = std::max(hi.x[1], bpts[i].x[1]);
-			hi.x[2] = std::max(hi.x[2], bpts[i].x[2]);
-		}
-		return Box<3>(lo,hi);	}
+	Box<3> get_bounding_box() const {return m_box;};
 
 	void translate(const Point<3> & pt) {
 		m_plane.origin = m_plane.origin + pt;
+		m_box = Box<3>(m_box.lo + pt, m_box.hi + pt);
 	}
 
 	// void rotate(const Point<3> & axis, double degrees) {
@@ -413,6 +525,24 @@ public:
 		return m_base->contains_point(pp);
 	}
 
+	// exact for an orthonormal frame if the distance to the base is, from
+	// the distances to the base in the plane and to the height slab
+	double signed_distance(const Point<3> & pt) const{
+		double proj = Point<3>::dot(pt - m_plane.origin, m_plane.normal);
+		return orthogonal_signed_distance(m_base->signed_distance(m_plane.project(pt)), fabs(proj - 0.5*m_height) - 0.5*m_height);
+	}
+
+	// exact: the part of the box within the height slab, projected onto
+	// the plane, is a convex polygon that must reach the base
+	bool collides_box(const Box<3> & bx) const{
+		return m_base->collides_polygon(slab_section(m_plane, m_height, bx));
+	}
+
+	// exact: the box must lie within the slab and project into the base
+	bool contains_box(const Box<3> & bx) const{
+		return slab_contains(m_plane, m_height, bx) && m_base->contains_polygon(slab_section(m_plane, m_height, bx, false));
+	}
+
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
 		os << "<Extrusion>" << std::endl;
@@ -437,6 +567,7 @@ private:
 	std::shared_ptr<Primitive2D> 	m_base;
 	double 							m_height;
 	Plane 							m_plane;
+	Box<3> 							m_box;		// cached at construction
 
 };
 
@@ -456,66 +587,97 @@ public:
 	: m_plane(Plane(center, normal, px))
 	, m_base(base.copy())
 	, m_line(ln)
-	, m_angle(angle) {};
+	, m_angle(angle) {
+		// the meridian frame: the axis, the direction from the axis toward
+		// the base center (or across the plane normal if the center is on
+		// the axis), and the direction of turning
+		m_axis = m_line.dir.normalize();
+		Point<3> o = m_plane.origin - m_line.pt;
+		Point<3> w = o - Point<3>::dot(o, m_axis)*m_axis;
+		axis_frame(m_axis, w.norm() < 1e-16 ? cross(m_plane.normal, m_axis) : w, m_radial, m_tangent);
+		m_offset = Point<2>(Point<3>::dot(o, m_radial), Point<3>::dot(o, m_axis));
+		m_arad = m_angle*pi/180.0;
+
+		// the base box placed in the meridian half-plane, turned about the axis
+		Box<2> bb = m_base->get_bounding_box();
+		Point<3> c0 = m_line.pt + (m_offset.x[0] + bb.lo.x[0])*m_radial + (m_offset.x[1] + bb.lo.x[1])*m_axis;
+		Point<3> c1 = m_line.pt + (m_offset.x[0] + bb.hi.x[0])*m_radial + (m_offset.x[1] + bb.hi.x[1])*m_axis;
+		Point<3> c2 = m_line.pt + (m_offset.x[0] + bb.lo.x[0])*m_radial + (m_offset.x[1] + bb.hi.x[1])*m_axis;
+		Point<3> c3 = m_line.pt + (m_offset.x[0] + bb.hi.x[0])*m_radial + (m_offset.x[1] + bb.lo.x[1])*m_axis;
+		Box<3> mb = Box<3>::bounding_box(Box<3>(c0, c0), Box<3>(c1, c1));
+		mb = Box<3>::bounding_box(mb, Box<3>::bounding_box(Box<3>(c2, c2), Box<3>(c3, c3)));
+		m_box = revolved_bounding_box(m_line.pt, m_axis, mb);
+	};
 
 	std::shared_ptr<Primitive3D> copy() const {return std::make_shared<Sweep>(*this);};
 
-	Box<3> get_bounding_box() const {
-		Point<3> o = m_plane.origin - m_line.pt;
-		double distsq = Point<3>::dot(o,o);
-		Point<2> dims = m_base->get_bounding_box().hi - m_base->get_bounding_box().lo;
-		double maxdim = std::max(dims.x[0], dims.x[1]);
-		return Box<3>(m_line.pt+(2*sqrt(distsq)+maxdim/4)*Point<3>(1,1,1),
-					  m_line.pt-(2*sqrt(distsq)+maxdim/4)*Point<3>(1,1,1));
-	}
+	Box<3> get_bounding_box() const {return m_box;};
 
 	void translate(const Point<3> & pt) {
 		m_plane.origin = m_plane.origin + pt;
 		m_line.pt = m_line.pt + pt;
+		m_box = Box<3>(m_box.lo + pt, m_box.hi + pt);
 	}
 
 	// void rotate(const Point<3> & axis, double degrees) {
 
 	// }
 
+	// the point is turned back into the meridian half-plane, where its
+	// radial and axial coordinates locate it relative to the base
 	bool contains_point(const Point<3> & pt) const{
-		// center everything around the line point
 		Point<3> rho = pt - m_line.pt;
-		Point<3> o = m_plane.origin - m_line.pt;
-		Point<3> odir;
-
-		Point<3> yhat;
-		if (o.norm() < 1e-16){
-			yhat = m_plane.normal;
-			odir = cross(yhat, m_line.dir).normalize();
-		}
-		else {
-			yhat = (cross(m_line.dir, o)).normalize();
-			odir = o.normalize();
+		double a = Point<3>::dot(rho, m_axis);
+		double x = Point<3>::dot(rho, m_radial), y = Point<3>::dot(rho, m_tangent);
+		if (m_angle < 360.0){
+			double theta = atan2(y, x);
+			if (theta < 0) theta += 2*pi;
+			if (theta > m_arad) return false;
 		}
+		return m_base->contains_point(Point<2>(sqrt(x*x + y*y) - m_offset.x[0], a - m_offset.x[1]));
+	}
 
-		// project onto line
-		Box<2> bb = m_base->get_bounding_box();
-		double pproj_l = Point<3>::dot(rho, m_line.dir);
-		// subtract out the l component of rho
-		Point<3> p_yo = rho - pproj_l*m_line.dir;
-
-		// project rho onto the y-o plane
-		double theta = atan2(Point<3>::dot(p_yo, yhat), Point<3>::dot(p_yo, odir));
-		double ang = theta*180.0/3.14159265;
-		if (ang < 0) ang += 360.0;
-		if (ang > m_angle) return false;
-
-		// rotate rho to the l-o plane
-		theta = -theta;
-		Point<3> u = m_line.dir;
-		Point<3> p_lo(rho.x[0]*(cos(theta) + u.x[0]*u.x[0]*(1.0-cos(theta))) 		+ rho.x[1]*(u.x[0]*u.x[1]*(1-cos(theta)) - u.x[2]*sin(theta)) 	+ rho.x[2]*(u.x[0]*u.x[2]*(1-cos(theta))+u.x[1]*sin(theta)),
-					   rho.x[0]*(u.x[1]*u.x[0]*(1-cos(theta))+u.x[2]*sin(theta)) 	+ rho.x[1]*(cos(theta) + u.x[1]*u.x[1]*(1.0-cos(theta))) 		+ rho.x[2]*(u.x[1]*u.x[2]*(1-cos(theta))+u.x[0]*sin(theta)),
-					   rho.x[0]*(u.x[2]*u.x[0]*(1-cos(theta))+u.x[1]*sin(theta)) 	+ rho.x[1]*(u.x[2]*u.x[1]*(1-cos(theta))+u.x[0]*sin(theta)) 	+ rho.x[2]*(cos(theta) + u.x[2]*u.x[2]*(1.0-cos(theta)))
-					   );
-		Point<3> p_lo_mo = p_lo - o;
-		Point<2> dprime(Point<3>::dot(p_lo_mo, odir), Point<3>::dot(p_lo_mo, u));
-		return m_base->contains_point(dprime);
+	// the distance to the base in the half-plane through the axis and the
+	// point, which is exact for a full turn of a base on one side of the
+	// axis, combined with the distance to the wedge of swept angles
+	double signed_distance(const Point<3> & pt) const{
+		Point<3> rho = pt - m_line.pt;
+		double a = Point<3>::dot(rho, m_axis);
+		double x = Point<3>::dot(rho, m_radial), y = Point<3>::dot(rho, m_tangent);
+		double r = sqrt(x*x + y*y);
+		double d = m_base->signed_distance(Point<2>(r - m_offset.x[0], a - m_offset.x[1]));
+		if (m_angle >= 360.0) return d;
+
+		// distance to the half-planes at angles 0 and m_angle
+		double theta = atan2(y, x);
+		if (theta < 0) theta += 2*pi;
+		auto halfplane = [r](double delta){
+			delta = fabs(delta);
+			if (delta > pi) delta = 2*pi - delta;
+			return (delta < pi/2) ? r*sin(delta) : r;
+		};
+		double dw = std::min(halfplane(theta), halfplane(theta - m_arad));
+		return std::max(d, (theta <= m_arad) ? -dw : dw);
+	}
+
+	// the box maps to a curved region of the meridian plane, so these are
+	// resolved from the signed distance above, conservatively
+	bool collides_box(const Box<3> & bx) const{
+		return sdf_collides_box(*this, bx);
+	}
+
+	bool contains_box(const Box<3> & bx) const{
+		return sdf_contains_box(*this, bx);
+	}
+
+	RegionClass classify_box(const Box<3> & bx) const{
+		return sdf_classify_box(*this, bx);
+	}
+
+	// the box tests are conservative, so the line is halved with them and runs
+	// clear of the boundary are taken whole
+	void scan_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_classification(*this, a, step, i0, i1, spans);
 	}
 
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
@@ -553,6 +715,12 @@ private:
 	Plane 								m_plane;
 	Line<3> 							m_line;
 
+	// cached at construction
+	Point<3> 							m_axis, m_radial, m_tangent;	// the meridian frame
+	Point<2> 							m_offset;	// of the base center in the frame
+	double 								m_arad;		// sweep angle in radians
+	Box<3> 								m_box;
+
 };
 
 
@@ -4,6 +4,8 @@
 #include "GeomUtils.hpp"
 #include "Delaunay.hpp"
 #include <memory>
+#include <cstring>
+#include <limits>
 
 namespace csg{
 
@@ -16,6 +18,453 @@ struct BoxContainment {};
 
 
 
+// a batch of points in structure-of-arrays layout, where coordinate d of
+// point i is x[d][i]. Batched membership queries write a bitmask of
+// nwords() words, with bit i%64 of word i/64 set if point i is inside.
+// Bits past the last point are zero.
+// The optional bounds hold the bounding box of each word, which lets the
+// CSG trees skip or accept whole words against the bounding box of a leaf
+template <std::size_t dim>
+struct PointBatch{
+	const double * 		x[dim];
+	std::size_t 		size;
+	const Box<dim> * 	bounds = nullptr;
+
+	std::size_t nwords() const {return (size+63)/64;};
+
+	Point<dim> point(std::size_t i) const{
+		Point<dim> pt;
+		for (auto d=0; d<dim; d++) pt.x[d] = x[d][i];
+		return pt;
+	}
+};
+
+// the bounding box of each word of a batch
+template <std::size_t dim>
+inline std::vector<Box<dim>> word_bounds(const PointBatch<dim> & batch){
+	std::vector<Box<dim>> bounds(batch.nwords());
+	for (std::size_t w=0; w<bounds.size(); w++){
+		std::size_t i0 = 64*w, i1 = std::min<std::size_t>(64*w+64, batch.size);
+		for (auto d=0; d<dim; d++){
+			double lo = batch.x[d][i0], hi = lo;
+			for (std::size_t i=i0+1; i<i1; i++){
+				lo = std::min(lo, batch.x[d][i]);
+				hi = std::max(hi, batch.x[d][i]);
+			}
+			bounds[w].lo.x[d] = lo;
+			bounds[w].hi.x[d] = hi;
+		}
+	}
+	return bounds;
+}
+
+// v if keep is true and 0 otherwise, selected on the bits so that the
+// compiler does not turn it back into a branch
+inline double keep_if(double v, bool keep){
+	Ullong bits;
+	std::memcpy(&bits, &v, sizeof(double));
+	bits &= -Ullong(keep);
+	std::memcpy(&v, &bits, sizeof(double));
+	return v;
+}
+
+// evaluate a point predicate inside(i) over a batch, 64 points at a time.
+// Predicates should be written without branches, since membership of
+// scattered points is unpredictable and the loop can then be vectorized
+template <std::size_t dim, typename Predicate>
+inline void classify_batch(const PointBatch<dim> & batch, Ullong * mask, Predicate inside){
+	for (std::size_t w=0, nw=batch.nwords(); w<nw; w++){
+		std::size_t i0 = 64*w, n = std::min<std::size_t>(64, batch.size-i0);
+		Ullong word = 0;
+		for (std::size_t j=0; j<n; j++) word |= Ullong(inside(i0+j)) << j;
+		mask[w] = word;
+	}
+}
+
+// combine the bitmask right into left with a CSG operation
+inline void combine_masks(Ullong * left, const Ullong * right, std::size_t nwords, Operation op){
+	switch (op){
+		case UNION:
+			for (auto w=0; w<nwords; w++) left[w] |= right[w];
+			break;
+		case INTERSECT:
+			for (auto w=0; w<nwords; w++) left[w] &= right[w];
+			break;
+		case DIFFERENCE:
+			for (auto w=0; w<nwords; w++) left[w] &= ~right[w];
+			break;
+		case XOR:
+			for (auto w=0; w<nwords; w++) left[w] ^= right[w];
+			break;
+	}
+}
+
+// combine the signed distances a and b of the left and right operands of
+// a CSG operation. The result is no larger in magnitude than the true
+// distance if a and b are not, and exact outside a union or inside an
+// intersection of exact distances
+inline double combine_distances(double a, double b, Operation op){
+	switch (op){
+		case UNION:			return std::min(a, b);
+		case INTERSECT:		return std::max(a, b);
+		case DIFFERENCE:	return std::max(a, -b);
+		case XOR:			return std::max(std::min(a, b), -std::max(a, b));
+	}
+	return a;
+}
+
+// false if the right operand of op cannot change the signed distance a of
+// the left operand, at a point a distance bd from the right's bounding
+// box: for a union if the point is closer to the left operand, and for a
+// difference if it is outside the left operand
+inline bool right_matters(double a, double bd, Operation op){
+	switch (op){
+		case UNION:			return bd == 0 || a > bd;
+		case DIFFERENCE:	return bd == 0 || a < 0;
+		default:			return true;
+	}
+}
+
+// the distance b of the right operand, raised to the distance bd to its
+// bounding box, which also bounds it from below. This makes skipping the
+// right operand give the same result as evaluating it
+inline double right_distance(double b, double bd){
+	return (bd > 0) ? std::max(b, bd) : b;
+}
+
+// signed distances of a batch of points under op, where left(batch, dist)
+// and right(batch, dist) give the distances of the operands and rbox
+// bounds the right operand. The right operand is evaluated on a batch of
+// the points where it can change the result, and large batches go in
+// chunks that stay in cache down the tree
+template <std::size_t dim, typename LeftF, typename RightF>
+void combine_signed_distances(const PointBatch<dim> & batch, double * dist, Operation op, const Box<dim> & rbox, const LeftF & left, const RightF & right){
+	if (batch.size > 4096){
+		for (std::size_t i0=0; i0<batch.size; i0+=4096){
+			PointBatch<dim> chunk;
+			for (auto d=0; d<dim; d++) chunk.x[d] = batch.x[d]+i0;
+			chunk.size = std::min<std::size_t>(4096, batch.size-i0);
+			combine_signed_distances(chunk, dist+i0, op, rbox, left, right);
+		}
+		return;
+	}
+	left(batch, dist);
+
+	// gather the points where the right operand matters
+	std::vector<double> bd(batch.size);
+	std::vector<std::size_t> idx;
+	for (std::size_t i=0; i<batch.size; i++){
+		bd[i] = Box<dim>::dist(rbox, batch.point(i));
+		if (right_matters(dist[i], bd[i], op)) idx.push_back(i);
+	}
+	if (idx.empty()) return;
+
+	std::vector<double> sub(dim*idx.size()), rdist(idx.size());
+	PointBatch<dim> run;
+	for (auto d=0; d<dim; d++){
+		run.x[d] = &sub[d*idx.size()];
+		for (std::size_t k=0; k<idx.size(); k++) sub[d*idx.size()+k] = batch.x[d][idx[k]];
+	}
+	run.size = idx.size();
+	right(run, rdist.data());
+	for (std::size_t k=0; k<idx.size(); k++){
+		dist[idx[k]] = combine_distances(dist[idx[k]], right_distance(rdist[k], bd[idx[k]]), op);
+	}
+}
+
+// true if no bit is set
+inline bool mask_empty(const Ullong * mask, std::size_t nwords){
+	Ullong any = 0;
+	for (auto w=0; w<nwords; w++) any |= mask[w];
+	return any == 0;
+}
+
+// pack 64 flags of 0 or 1 into a word, 8 at a time. Each group of 8 is
+// assembled into bytes and its bits gathered into the top byte with one
+// multiplication
+inline Ullong pack_flags(const double * flags){
+	Ullong word = 0;
+	for (auto k=0; k<64; k+=8){
+		Ullong v = 0;
+		for (auto j=0; j<8; j++) v |= Ullong(flags[k+j] != 0) << (8*j);
+		word |= ((v*0x0102040810204080ULL) >> 56) << k;
+	}
+	return word;
+}
+
+// classify a batch with the leaf geometry g, keeping only the points in its
+// bounding box bx as the pointwise queries do. Words are accepted or
+// rejected whole by their bounds where possible, and runs of words without
+// a point in the box are not passed to the leaf
+template <std::size_t dim, typename LeafPtr>
+inline void classify_in_box(const LeafPtr & g, const Box<dim> & bx, const PointBatch<dim> & batch, Ullong * mask){
+	std::size_t nw = batch.nwords();
+	for (std::size_t w=0; w<nw; w++){
+		std::size_t i0 = 64*w, n = std::min<std::size_t>(64, batch.size-i0);
+		if (batch.bounds != nullptr && !Box<dim>::collides(bx, batch.bounds[w])) {mask[w] = 0; continue;}
+		if (batch.bounds != nullptr && Box<dim>::contains(bx, batch.bounds[w])) {mask[w] = (n == 64) ? ~0ULL : (1ULL << n)-1; continue;}
+		double flags[64] = {};
+		for (std::size_t j=0; j<n; j++){
+			bool in = true;
+			for (auto d=0; d<dim; d++) in &= !(batch.x[d][i0+j] < bx.lo.x[d]) & !(batch.x[d][i0+j] > bx.hi.x[d]);
+			flags[j] = in ? 1.0 : 0.0;
+		}
+		mask[w] = pack_flags(flags);
+	}
+
+	std::vector<Ullong> leaf(nw);
+	for (std::size_t w0=0; w0<nw;){
+		if (!mask[w0]) {w0++; continue;}
+		std::size_t w1 = w0+1;
+		while (w1 < nw && mask[w1]) w1++;
+
+		PointBatch<dim> run;
+		for (auto d=0; d<dim; d++) run.x[d] = batch.x[d]+64*w0;
+		run.size = std::min(batch.size, 64*w1) - 64*w0;
+		run.bounds = (batch.bounds != nullptr) ? batch.bounds+w0 : nullptr;
+		g->contains_points(run, &leaf[w0]);
+		for (auto w=w0; w<w1; w++) mask[w] &= leaf[w];
+		w0 = w1;
+	}
+}
+
+// the classification of a region against a geometry: entirely outside,
+// entirely inside, or crossed by the boundary as far as the test can tell
+enum RegionClass {OUTSIDE, AMBIGUOUS, INSIDE};
+
+// combine the classifications a and b of the left and right operands of a
+// CSG operation on the same region
+inline RegionClass combine_classes(RegionClass a, RegionClass b, Operation op){
+	switch (op){
+		case UNION:
+			if (a == INSIDE || b == INSIDE) return INSIDE;
+			return (a == OUTSIDE && b == OUTSIDE) ? OUTSIDE : AMBIGUOUS;
+		case INTERSECT:
+			if (a == OUTSIDE || b == OUTSIDE) return OUTSIDE;
+			return (a == INSIDE && b == INSIDE) ? INSIDE : AMBIGUOUS;
+		case DIFFERENCE:
+			if (a == OUTSIDE || b == INSIDE) return OUTSIDE;
+			return (a == INSIDE && b == OUTSIDE) ? INSIDE : AMBIGUOUS;
+		case XOR:
+			if (a == AMBIGUOUS || b == AMBIGUOUS) return AMBIGUOUS;
+			return (a != b) ? INSIDE : OUTSIDE;
+	}
+	return AMBIGUOUS;
+}
+
+// the k-th of the 2^dim boxes that bx splits into at its center
+template <std::size_t dim>
+inline Box<dim> sub_box(const Box<dim> & bx, unsigned int k){
+	Box<dim> sub;
+	for (auto d=0; d<dim; d++){
+		double mid = 0.5*(bx.lo.x[d] + bx.hi.x[d]);
+		sub.lo.x[d] = (k & (1u<<d)) ? mid : bx.lo.x[d];
+		sub.hi.x[d] = (k & (1u<<d)) ? bx.hi.x[d] : mid;
+	}
+	return sub;
+}
+
+// box tests for geometries whose signed distance never overestimates.
+// A box whose center is further out than its half diagonal misses the
+// geometry, and one whose center is further in lies inside it. Undecided
+// boxes are split up to depth times, after which they are assumed to
+// collide but not to be contained, so that neither test ever gives a
+// false positive for uniformity
+template <std::size_t dim, typename GeometryT>
+bool sdf_collides_box(const GeometryT & g, const Box<dim> & bx, unsigned int depth = 3){
+	double hd = 0.5*(bx.hi - bx.lo).norm();
+	double d = g.signed_distance(0.5*(bx.lo + bx.hi));
+	if (d > hd) return false;
+	if (d <= 0 || depth == 0) return true;
+	for (unsigned int k=0; k<(1u<<dim); k++){
+		if (sdf_collides_box(g, sub_box(bx, k), depth-1)) return true;
+	}
+	return false;
+}
+
+// both tests at once, from one distance per box
+template <std::size_t dim, typename GeometryT>
+RegionClass sdf_classify_box(const GeometryT & g, const Box<dim> & bx, unsigned int depth = 3){
+	double hd = 0.5*(bx.hi - bx.lo).norm();
+	double d = g.signed_distance(0.5*(bx.lo + bx.hi));
+	if (d > hd) return OUTSIDE;
+	if (d < -hd) return INSIDE;
+	if (depth == 0) return AMBIGUOUS;
+	RegionClass c = sdf_classify_box(g, sub_box(bx, 0), depth-1);
+	for (unsigned int k=1; k<(1u<<dim) && c != AMBIGUOUS; k++){
+		if (sdf_classify_box(g, sub_box(bx, k), depth-1) != c) c = AMBIGUOUS;
+	}
+	return c;
+}
+
+template <std::size_t dim, typename GeometryT>
+bool sdf_contains_box(const GeometryT & g, const Box<dim> & bx, unsigned int depth = 3){
+	double hd = 0.5*(bx.hi - bx.lo).norm();
+	double d = g.signed_distance(0.5*(bx.lo + bx.hi));
+	if (d < -hd) return true;
+	if (d > 0 || depth == 0) return false;
+	for (unsigned int k=0; k<(1u<<dim); k++){
+		if (!sdf_contains_box(g, sub_box(bx, k), depth-1)) return false;
+	}
+	return true;
+}
+
+
+
+
+
+// a run [begin, end) of the samples along a scan line
+struct Span{
+	std::size_t 	begin, end;
+};
+
+// sample i of the scan line a + t*step, at t = i+0.5. Scan lines and the
+// pointwise queries they stand in for must compute samples the same way
+template <std::size_t dim>
+inline Point<dim> scan_sample(const Point<dim> & a, const Point<dim> & step, std::size_t i){
+	return a + (double(i)+0.5)*step;
+}
+
+// append [begin, end) to sorted spans, merging it with an adjacent last span
+inline void push_span(std::vector<Span> & spans, std::size_t begin, std::size_t end){
+	if (begin >= end) return;
+	if (!spans.empty() && spans.back().end == begin) spans.back().end = end;
+	else spans.push_back({begin, end});
+}
+
+// combine the sorted spans left and right with a CSG operation, by a
+// sweep over the ends of both
+inline void combine_spans(const std::vector<Span> & left, const std::vector<Span> & right, Operation op, std::vector<Span> & out){
+	std::size_t i = 0, j = 0, nl = 2*left.size(), nr = 2*right.size(), start = 0;
+	bool inl = false, inr = false, in = false;
+	while (i < nl || j < nr){
+		std::size_t pl = (i < nl) ? ((i & 1) ? left[i/2].end : left[i/2].begin) : std::size_t(-1);
+		std::size_t pr = (j < nr) ? ((j & 1) ? right[j/2].end : right[j/2].begin) : std::size_t(-1);
+		std::size_t pos = std::min(pl, pr);
+		if (pl == pos) {inl = !inl; i++;}
+		if (pr == pos) {inr = !inr; j++;}
+		bool now = false;
+		switch (op){
+			case UNION:			now = inl || inr; break;
+			case INTERSECT:		now = inl && inr; break;
+			case DIFFERENCE:	now = inl && !inr; break;
+			case XOR:			now = inl != inr; break;
+		}
+		if (now == in) continue;
+		if (now) start = pos;
+		else push_span(out, start, pos);
+		in = now;
+	}
+}
+
+// narrow the samples [i0, i1) of a scan line to those with t in
+// [tlo, thi], then move each end by single samples until inside(i)
+// agrees, so that rounding in an analytic interval can't disagree with
+// the pointwise test
+template <typename Predicate>
+inline void scan_interval(double tlo, double thi, std::size_t & i0, std::size_t & i1, Predicate inside){
+	std::size_t lo = i0, hi = i1;
+	double b = std::max(double(lo), std::ceil(tlo-0.5)), e = std::min(double(hi), std::floor(thi-0.5)+1);
+	if (!(b < e)) {i1 = i0; return;}
+	i0 = std::size_t(b);
+	i1 = std::size_t(e);
+	while (i0 < i1 && !inside(i0)) i0++;
+	while (i1 > i0 && !inside(i1-1)) i1--;
+	if (i0 == i1) return;
+	while (i0 > lo && inside(i0-1)) i0--;
+	while (i1 < hi && inside(i1)) i1++;
+}
+
+// narrow the samples [i0, i1) of a scan line to those inside the box bx
+template <std::size_t dim>
+inline void scan_range(const Box<dim> & bx, const Point<dim> & a, const Point<dim> & step, std::size_t & i0, std::size_t & i1){
+	double tlo = -std::numeric_limits<double>::infinity(), thi = std::numeric_limits<double>::infinity();
+	for (auto d=0; d<dim; d++){
+		if (step.x[d] == 0 || bx.lo.x[d] > bx.hi.x[d]){
+			if (a.x[d] < bx.lo.x[d] || a.x[d] > bx.hi.x[d]) {i1 = i0; return;}
+			continue;
+		}
+		double t0 = (bx.lo.x[d]-a.x[d])/step.x[d], t1 = (bx.hi.x[d]-a.x[d])/step.x[d];
+		tlo = std::max(tlo, std::min(t0, t1));
+		thi = std::min(thi, std::max(t0, t1));
+	}
+	scan_interval(tlo, thi, i0, i1, [&](std::size_t i){return Box<dim>::contains(bx, scan_sample(a, step, i));});
+}
+
+// the samples [i0, i1) of a scan line that g contains, classified in
+// batches with g.contains_points()
+template <std::size_t dim, typename GeometryT>
+void scan_by_samples(const GeometryT & g, const Point<dim> & a, const Point<dim> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans){
+	double x[dim][256];
+	Ullong mask[4];
+	for (std::size_t c0=i0; c0<i1; c0+=256){
+		std::size_t n = std::min<std::size_t>(256, i1-c0);
+		for (std::size_t j=0; j<n; j++){
+			Point<dim> p = scan_sample(a, step, c0+j);
+			for (auto d=0; d<dim; d++) x[d][j] = p.x[d];
+		}
+		PointBatch<dim> batch;
+		for (auto d=0; d<dim; d++) batch.x[d] = x[d];
+		batch.size = n;
+		g.contains_points(batch, mask);
+		for (std::size_t j=0; j<n;){
+			if (!(mask[j/64] >> (j%64) & 1)) {j++; continue;}
+			std::size_t k = j+1;
+			while (k < n && (mask[k/64] >> (k%64) & 1)) k++;
+			push_span(spans, c0+j, c0+k);
+			j = k;
+		}
+	}
+}
+
+// the samples [i0, i1) of a scan line that g contains, for geometries whose
+// classify_box() never calls a box uniform wrongly. The line is halved
+// until the bounding box of each piece is inside or outside
+template <std::size_t dim, typename GeometryT>
+void scan_by_classification(const GeometryT & g, const Point<dim> & a, const Point<dim> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans){
+	if (i1 - i0 <= 8){
+		for (auto i=i0; i<i1; i++) if (g.contains_point(scan_sample(a, step, i))) push_span(spans, i, i+1);
+		return;
+	}
+	Point<dim> p0 = scan_sample(a, step, i0), p1 = scan_sample(a, step, i1-1);
+	RegionClass c = g.classify_box(Box<dim>::bounding_box(Box<dim>(p0, p0), Box<dim>(p1, p1)));
+	if (c == OUTSIDE) return;
+	if (c == INSIDE) {push_span(spans, i0, i1); return;}
+	std::size_t mid = i0 + (i1-i0)/2;
+	scan_by_classification(g, a, step, i0, mid, spans);
+	scan_by_classification(g, a, step, mid, i1, spans);
+}
+
+// the samples [i0, i1) of a scan line that g contains, for geometries whose
+// contains_polygon() and collides_polygon() are exact. The line is halved
+// until its pieces are inside or outside as a whole
+template <typename GeometryT>
+void scan_by_bisection(const GeometryT & g, const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans){
+	if (i1 - i0 <= 8){
+		for (auto i=i0; i<i1; i++) if (g.contains_point(scan_sample(a, step, i))) push_span(spans, i, i+1);
+		return;
+	}
+	std::vector<Point<2>> seg = {scan_sample(a, step, i0), scan_sample(a, step, i1-1)};
+	if (!g.collides_polygon(seg)) return;
+	if (g.contains_polygon(seg)) {push_span(spans, i0, i1); return;}
+	std::size_t mid = i0 + (i1-i0)/2;
+	scan_by_bisection(g, a, step, i0, mid, spans);
+	scan_by_bisection(g, a, step, mid, i1, spans);
+}
+
+// the number of points, evenly spaced around a circle of the given radius,
+// whose chords stray at most tol from it
+inline unsigned int chord_count(double radius, double tol){
+	if (!(tol > 0)){
+		std::cerr << "chord_count: the tolerance must be positive" << std::endl;
+		throw("nonpositive outline tolerance");
+	}
+	if (tol >= radius) return 4;
+	double n = ceil(pi/acos(1.0 - tol/radius));
+	return static_cast<unsigned int>(std::min(std::max(n, 4.0), 1.0e+7));
+}
+
+
 
 
 template <std::size_t dim>
@@ -34,6 +483,25 @@ public:
 	// contains point
 	virtual bool contains_point(const PointT & pt) const = 0;
 
+	// contains points of a batch, as a bitmask. This default goes one
+	// point at a time
+	virtual void contains_points(const PointBatch<dim> & batch, Ullong * mask) const{
+		classify_batch(batch, mask, [&](std::size_t i){return contains_point(batch.point(i));});
+	}
+
+	// signed distance to the boundary, negative inside. Primitives give
+	// the exact distance or a bound that is never larger in magnitude
+	virtual double signed_distance(const PointT & pt) const{
+		std::cerr << "PrimitiveGeometry: signed_distance is not implemented for this type" << std::endl;
+		throw("signed_distance not implemented");
+	}
+
+	// signed distances of the points of a batch. This default goes one
+	// point at a time
+	virtual void signed_distances(const PointBatch<dim> & batch, double * dist) const{
+		for (std::size_t i=0; i<batch.size; i++) dist[i] = signed_distance(batch.point(i));
+	}
+
 	// contains box
 	virtual bool contains_box(const BoxT & bx) const = 0;
 
@@ -62,6 +530,14 @@ public:
 	// get outline
 	virtual std::vector<Hull<2>> get_outline(unsigned int npts) const = 0;
 
+	// get an outline whose chords stray at most tol from the boundary.
+	// This default samples as finely as the circle around the bounding box
+	// would need, which suits boundaries that curve no more tightly
+	virtual std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		BoxT bb = get_bounding_box();
+		return get_outline(chord_count(0.5*Point<2>::dist(bb.lo, bb.hi), tol));
+	}
+
 	// get outline points
 	std::vector<Point<2>> get_outline_points(unsigned int npts) const {
 		std::vector<Hull<2>> hv = get_outline(npts);
@@ -70,63 +546,84 @@ public:
 		return pts;
 	}
 
-	// get a triangulation of the object
-	Triangulation<2> get_triangulation(unsigned int npts) const {
-		// first get set of points that define the outline
-		Triangulation<2> tout;
-		tout.points = get_outline_points(npts);
-
-		// do a Delaunay triangulation of these points
-		Delaunay del(tout.points, 1);
+	// get a triangulation of the object. If minangle (degrees) or
+	// maxarea are positive, the mesh is refined to meet them
+	Triangulation<2> get_triangulation(unsigned int npts, double minangle = 0, double maxarea = 0) const {
+		// the outline hulls are closed rings; their segments
+		// become constraints of the Delaunay triangulation
+		std::vector<Point<2>> pts;
+		std::vector<IntPoint2> segs;
+		get_hull_segments(get_outline(npts), pts, segs);
+		Delaunay del(pts, segs, 1);
+
+		// keep only the triangles enclosed by the rings
+		del.remove_exterior();
+		if (minangle > 0 || maxarea > 0) del.refine(minangle, maxarea);
+		return del.get_triangulation();
+	}
 
-		// go through the triangulation and remove triangles with
-		// 2 or more edges whose centerpoint is not contained 
-		// within the geometry
-		unsigned int ct;
-		for (auto it=del.triangles.begin(); it != del.triangles.end(); it++){
-			if (it->state <= 0) continue;
+	// contains point
+	virtual bool contains_point(const PointT & pt) const = 0;
 
-			ct=0;
-			if (!contains_point(0.5*(del.points[it->vertices[0]]+del.points[it->vertices[1]]))) ct++;
-			if (!contains_point(0.5*(del.points[it->vertices[1]]+del.points[it->vertices[2]]))) ct++;
-			if (!contains_point(0.5*(del.points[it->vertices[2]]+del.points[it->vertices[0]]))) ct++;
-			if (!contains_point(1.0/3.0*(del.points[it->vertices[0]]+del.points[it->vertices[1]]+del.points[it->vertices[2]]))) ct++;
+	// contains points of a batch, as a bitmask. This default goes one
+	// point at a time
+	virtual void contains_points(const PointBatch<2> & batch, Ullong * mask) const{
+		classify_batch(batch, mask, [&](std::size_t i){return contains_point(batch.point(i));});
+	}
 
-			if (ct > 1){
-				del.erase_triangle(it->vertices[0], it->vertices[1], it->vertices[2],
-								   -1, -1, -1);
-			}
-		}
+	// signed distance to the boundary, negative inside. Primitives give
+	// the exact distance or a bound that is never larger in magnitude
+	virtual double signed_distance(const PointT &) const{
+		std::cerr << "PrimitiveGeometry: signed_distance is not implemented for this type" << std::endl;
+		throw("signed_distance not implemented");
+	}
 
-		unsigned int pos = 0;
-		tout.triangles.resize(del.ntri);
-		for (auto it=del.triangles.begin(); it != del.triangles.end(); it++){
-			if (it->state <= 0) continue;
+	// signed distances of the points of a batch. This default goes one
+	// point at a time
+	virtual void signed_distances(const PointBatch<2> & batch, double * dist) const{
+		for (std::size_t i=0; i<batch.size; i++) dist[i] = signed_distance(batch.point(i));
+	}
 
-			tout.triangles[pos] = {static_cast<int>(it->vertices[0]), static_cast<int>(it->vertices[1]), static_cast<int>(it->vertices[2])};
-			pos++;
-		}
+	// the samples a + (i+0.5)*step, for i in [i0, i1), that the object
+	// contains, appended to spans in order. This default classifies them
+	// in batches, which primitives replace by solving for the ends of
+	// the spans
+	virtual void scan_line(const PointT & a, const PointT & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_samples(*this, a, step, i0, i1, spans);
+	}
 
-		return tout;
+	// contains the convex polygon with vertices poly in consecutive order.
+	// This default tests the vertices, which primitives refine into
+	// exact tests
+	virtual bool contains_polygon(const std::vector<PointT> & poly) const{
+		for (auto & p : poly) if (!contains_point(p)) return false;
+		return !poly.empty();
 	}
 
-	// contains point
-	virtual bool contains_point(const PointT & pt) const = 0;
+	// overlaps the convex polygon with vertices poly in consecutive order.
+	// This default tests the vertices
+	virtual bool collides_polygon(const std::vector<PointT> & poly) const{
+		for (auto & p : poly) if (contains_point(p)) return true;
+		return false;
+	}
 
 	// contains box
-	bool contains_box(const BoxT & bx) const{
-		return contains_point(bx.lo) && contains_point(bx.hi) &&
-			   contains_point(PointT(bx.lo.x[0], bx.hi.x[1])) &&
-			   contains_point(PointT(bx.hi.x[0], bx.lo.x[1]));
+	virtual bool contains_box(const BoxT & bx) const{
+		return contains_polygon(box_corners(bx));
 	};
 
 	// collides box
-	bool collides_box(const BoxT & bx) const{
-		return contains_point(bx.lo) || contains_point(bx.hi) ||
-			   contains_point(PointT(bx.lo.x[0], bx.hi.x[1])) ||
-			   contains_point(PointT(bx.hi.x[0], bx.lo.x[1]));
+	virtual bool collides_box(const BoxT & bx) const{
+		return collides_polygon(box_corners(bx));
 	};
 
+	// classify box as outside, inside or ambiguous. This default asks
+	// collides_box() and then contains_box()
+	virtual RegionClass classify_box(const BoxT & bx) const{
+		if (!collides_box(bx)) return OUTSIDE;
+		return contains_box(bx) ? INSIDE : AMBIGUOUS;
+	}
+
 	virtual void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const = 0;
 };
 
@@ -148,8 +645,37 @@ public:
 	// contains point
 	virtual bool contains_point(const PointT & pt) const = 0;
 
-	// contains box
-	bool contains_box(const BoxT & bx) const{
+	// contains points of a batch, as a bitmask. This default goes one
+	// point at a time
+	virtual void contains_points(const PointBatch<3> & batch, Ullong * mask) const{
+		classify_batch(batch, mask, [&](std::size_t i){return contains_point(batch.point(i));});
+	}
+
+	// signed distance to the boundary, negative inside. Primitives give
+	// the exact distance or a bound that is never larger in magnitude
+	virtual double signed_distance(const PointT &) const{
+		std::cerr << "PrimitiveGeometry: signed_distance is not implemented for this type" << std::endl;
+		throw("signed_distance not implemented");
+	}
+
+	// signed distances of the points of a batch. This default goes one
+	// point at a time
+	virtual void signed_distances(const PointBatch<3> & batch, double * dist) const{
+		for (std::size_t i=0; i<batch.size; i++) dist[i] = signed_distance(batch.point(i));
+	}
+
+	// the samples a + (i+0.5)*step, for i in [i0, i1), that the object
+	// contains, appended to spans in order. This default classifies them
+	// in batches, since the default box tests below only look at the
+	// corners. Primitives with conservative box tests halve the line with
+	// scan_by_classification() instead
+	virtual void scan_line(const PointT & a, const PointT & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const{
+		scan_by_samples(*this, a, step, i0, i1, spans);
+	}
+
+	// contains box. This default tests the corners, which primitives
+	// refine into exact tests
+	virtual bool contains_box(const BoxT & bx) const{
 		return contains_point(PointT(bx.lo.x[0], bx.lo.x[1], bx.hi.x[2])) &&
 			   contains_point(PointT(bx.hi.x[0], bx.hi.x[1], bx.hi.x[2])) &&
 			   contains_point(PointT(bx.lo.x[0], bx.hi.x[1], bx.hi.x[2])) &&
@@ -161,8 +687,8 @@ public:
 			   contains_point(PointT(bx.hi.x[0], bx.lo.x[1], bx.lo.x[2])) ;
 	}
 
-	// collides box
-	bool collides_box(const BoxT & bx) const{
+	// collides box. This default tests the corners
+	virtual bool collides_box(const BoxT & bx) const{
 		return contains_point(PointT(bx.lo.x[0], bx.lo.x[1], bx.hi.x[2])) ||
 			   contains_point(PointT(bx.hi.x[0], bx.hi.x[1], bx.hi.x[2])) ||
 			   contains_point(PointT(bx.lo.x[0], bx.hi.x[1], bx.hi.x[2])) ||
@@ -174,6 +700,13 @@ public:
 			   contains_point(PointT(bx.hi.x[0], bx.lo.x[1], bx.lo.x[2])) ;
 	}
 
+	// classify box as outside, inside or ambiguous. This default asks
+	// collides_box() and then contains_box()
+	virtual RegionClass classify_box(const BoxT & bx) const{
+		if (!collides_box(bx)) return OUTSIDE;
+		return contains_box(bx) ? INSIDE : AMBIGUOUS;
+	}
+
 	virtual void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const = 0;
 };
 
@@ -0,0 +1,222 @@
+#ifndef _PRIMITIVEVARIANT_H
+#define _PRIMITIVEVARIANT_H
+
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include "GeomUtils.hpp"
+#include "PrimitiveTypes.hpp"
+#include "Primitive2D.hpp"
+#include "Primitive3D.hpp"
+
+namespace csg{
+
+
+// the position of T in the list Ts, and whether it is there at all
+template <class T, class... Ts>
+struct VariantIndex{
+	static const std::size_t value = 0;
+	static const bool found = false;
+};
+
+template <class T, class... Rest>
+struct VariantIndex<T, T, Rest...>{
+	static const std::size_t value = 0;
+	static const bool found = true;
+};
+
+template <class T, class U, class... Rest>
+struct VariantIndex<T, U, Rest...>{
+	static const std::size_t value = 1 + VariantIndex<T, Rest...>::value;
+	static const bool found = VariantIndex<T, Rest...>::found;
+};
+
+
+
+// a primitive drawn from the closed list Ts, held by value along with the
+// index of the one that is stored. Queries dispatch on the index straight
+// to the stored primitive's own functions, called
+// non-virtually so that the compiler can inline them, and a vector of
+// variants keeps the primitives themselves contiguous. It can be the leaf
+// type of a CSGTree, whose nodes then share no virtual calls down to the
+// leaves. This is the C++14 counterpart of std::variant<Ts...>
+//
+// An empty variant (default constructed) holds nothing and throws if it
+// is queried. Subtrees of a CSGTree over variants are combined through
+// the shared_ptr<CSGTree> constructors, since a tree is not a variant
+template <class BaseType, class... Ts>
+class PrimitiveVariant{
+public:
+	typedef BaseType 									BaseT;	// Primitive2D or Primitive3D
+	typedef typename PointTypedef<BaseType>::type 		PointT;
+	typedef typename BoxTypedef<BaseType>::type 		BoxT;
+	static const std::size_t 							dim = std::extent<decltype(PointT::x)>::value;
+	static const std::size_t 							npos = sizeof...(Ts);
+
+	PrimitiveVariant() : m_index(npos) {};
+
+	template <class T, typename std::enable_if<VariantIndex<T, Ts...>::found, int>::type = 0>
+	PrimitiveVariant(const T & prim) : m_index(VariantIndex<T, Ts...>::value) {
+		new (&m_storage) T(prim);
+	};
+
+	PrimitiveVariant(const PrimitiveVariant & v) : m_index(v.m_index) {
+		if (m_index != npos) copy_table()[m_index](&m_storage, &v.m_storage);
+	};
+
+	PrimitiveVariant & operator=(const PrimitiveVariant & v){
+		if (this == &v) return *this;
+		clear();
+		if (v.m_index != npos) copy_table()[v.m_index](&m_storage, &v.m_storage);
+		m_index = v.m_index;
+		return *this;
+	}
+
+	~PrimitiveVariant() {clear();};
+
+	// the position of the stored primitive in Ts, or npos if empty
+	std::size_t index() const {return m_index;};
+	bool empty() const {return m_index == npos;};
+
+	// the stored primitive if it is a T, otherwise nullptr
+	template <class T>
+	const T * get_if() const {
+		if (!VariantIndex<T, Ts...>::found || m_index != VariantIndex<T, Ts...>::value) return nullptr;
+		return reinterpret_cast<const T *>(&m_storage);
+	}
+
+	// calls f on the stored primitive, as its own type. The dispatch is a
+	// chain of index comparisons that the compiler can see through, so f
+	// is inlined for each alternative
+	template <class F>
+	auto visit(F && f) const -> decltype(f(std::declval<const typename std::tuple_element<0, std::tuple<Ts...>>::type &>())) {
+		typedef decltype(f(std::declval<const typename std::tuple_element<0, std::tuple<Ts...>>::type &>())) R;
+		return visit_from<R>(f, std::integral_constant<std::size_t, 0>());
+	}
+
+	// the stored primitive behind the virtual interface, for containers
+	// that take any primitive
+	std::shared_ptr<BaseT> to_primitive() const {
+		return visit([](const auto & p) -> std::shared_ptr<BaseT> {return p.copy();});
+	}
+
+
+	///////////// functions that implement the Base Interface
+	// each calls the stored primitive's own function by its qualified
+	// name, so the call is not virtual
+	std::shared_ptr<PrimitiveVariant> copy() const {return std::make_shared<PrimitiveVariant>(*this);};
+
+	BoxT get_bounding_box() const {
+		return visit([](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::get_bounding_box();});
+	}
+
+	// this is only for 2D
+	std::vector<Hull<2>> get_outline(unsigned int npts) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::get_outline(npts);});
+	}
+
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::get_adaptive_outline(tol);});
+	}
+
+	bool contains_point(const PointT & pt) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::contains_point(pt);});
+	}
+
+	void contains_points(const PointBatch<dim> & batch, Ullong * mask) const {
+		visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; p.T::contains_points(batch, mask); return 0;});
+	}
+
+	double signed_distance(const PointT & pt) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::signed_distance(pt);});
+	}
+
+	void signed_distances(const PointBatch<dim> & batch, double * dist) const {
+		visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; p.T::signed_distances(batch, dist); return 0;});
+	}
+
+	void scan_line(const PointT & a, const PointT & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const {
+		visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; p.T::scan_line(a, step, i0, i1, spans); return 0;});
+	}
+
+	// these are only for 2D
+	bool contains_polygon(const std::vector<Point<2>> & poly) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::contains_polygon(poly);});
+	}
+
+	bool collides_polygon(const std::vector<Point<2>> & poly) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::collides_polygon(poly);});
+	}
+
+	bool contains_box(const BoxT & bx) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::contains_box(bx);});
+	}
+
+	bool collides_box(const BoxT & bx) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::collides_box(bx);});
+	}
+
+	RegionClass classify_box(const BoxT & bx) const {
+		return visit([&](const auto & p){typedef typename std::decay<decltype(p)>::type T; return p.T::classify_box(bx);});
+	}
+
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const {
+		visit([&](const auto & p){p.print_summary(os, ntabs); return 0;});
+	}
+	///////////////////////////////////////
+
+private:
+
+	template <class R, class F, std::size_t I>
+	R visit_from(F & f, std::integral_constant<std::size_t, I>) const {
+		typedef typename std::tuple_element<I, std::tuple<Ts...>>::type T;
+		if (m_index == I) return f(*reinterpret_cast<const T *>(&m_storage));
+		return visit_from<R>(f, std::integral_constant<std::size_t, I+1>());
+	}
+
+	template <class R, class F>
+	R visit_from(F &, std::integral_constant<std::size_t, npos>) const {
+		std::cerr << "PrimitiveVariant: queried while empty" << std::endl;
+		throw("empty primitive variant");
+	}
+
+	template <class T>
+	static void copy_as(void * dst, const void * src) {new (dst) T(*static_cast<const T *>(src));};
+
+	template <class T>
+	static void destroy_as(void * s) {static_cast<T *>(s)->~T();};
+
+	typedef void (*CopyFn)(void *, const void *);
+	typedef void (*DestroyFn)(void *);
+
+	static const CopyFn * copy_table(){
+		static const CopyFn table[] = {&copy_as<Ts>...};
+		return table;
+	}
+
+	void clear(){
+		static const DestroyFn table[] = {&destroy_as<Ts>...};
+		if (m_index != npos) table[m_index](&m_storage);
+		m_index = npos;
+	}
+
+	typename std::aligned_union<0, Ts...>::type 	m_storage;
+	std::size_t 									m_index;
+};
+
+
+template <class BaseType, class... Ts>
+struct BoxTypedef<PrimitiveVariant<BaseType, Ts...>> {typedef typename BoxTypedef<BaseType>::type type;};
+
+template <class BaseType, class... Ts>
+struct PointTypedef<PrimitiveVariant<BaseType, Ts...>> {typedef typename PointTypedef<BaseType>::type type;};
+
+
+// the closed sets of the concrete primitives
+typedef PrimitiveVariant<Primitive2D, Circle, Rectangle, Ellipse, Triangle, Polygon, RegularPolygon> 		PrimitiveVariant2D;
+typedef PrimitiveVariant<Primitive3D, Sphere, Cylinder, RectangularPrism, Pyramid, Extrusion, Sweep> 		PrimitiveVariant3D;
+
+
+}
+#endif
@@ -3,47 +3,297 @@
 
 #include <memory>
 #include <map>
-// #include "GeomUtils.hpp"
+#include <type_traits>
+#include "GeomUtils.hpp"
+#include "PrimitiveTypes.hpp"
 // #include "Delaunay.hpp"
 
 namespace csg{
 
+// a bounding volume hierarchy over a list of boxes, which finds the lowest
+// index whose box holds a point and that passes a test. The boxes are
+// grouped with locality_sort() and the order is halved down to small
+// leaves. Each node keeps the lowest index below it, so that subtrees that
+// can't beat a match already found are skipped
+template <std::size_t dim>
+class BoxHierarchy{
+public:
+
+	BoxHierarchy(){};
+
+	BoxHierarchy(const std::vector<Box<dim>> & boxes)
+	: mBoxes(boxes.size()), mOrder(boxes.size()) {
+		for (auto i=0; i<mOrder.size(); i++) mOrder[i] = i;
+		if (boxes.empty()) return;
+		locality_sort(boxes, mOrder, 0, mOrder.size());
+		build(boxes, 0, mOrder.size());
+		for (auto k=0; k<mOrder.size(); k++) mBoxes[k] = boxes[mOrder[k]];
+	}
+
+	std::size_t size() const {return mBoxes.size();};
+
+	// the lowest index i whose box contains pt and for which test(i) is
+	// true, or size() if there is none
+	template <typename Test>
+	std::size_t first_match(const Point<dim> & pt, Test test) const{
+		std::size_t best = mBoxes.size();
+		if (mNodes.empty()) return best;
+
+		std::size_t stack[2*sizeof(std::size_t)*8];
+		std::size_t top = 0;
+		stack[top++] = 0;
+		while (top > 0){
+			const Node & nd = mNodes[stack[--top]];
+			if (nd.lo >= best || !Box<dim>::contains(nd.box, pt)) continue;
+			if (nd.left == 0){
+				for (auto k=nd.begin; k<nd.end; k++){
+					std::size_t i = mOrder[k];
+					if (i >= best) break;
+					if (Box<dim>::contains(mBoxes[k], pt) && test(i)) {best = i; break;}
+				}
+				continue;
+			}
+
+			// visit the child with the lower index first
+			if (mNodes[nd.left].lo < mNodes[nd.right].lo){
+				stack[top++] = nd.right;
+				stack[top++] = nd.left;
+			}
+			else {
+				stack[top++] = nd.left;
+				stack[top++] = nd.right;
+			}
+		}
+		return best;
+	}
+
+	// append the indices whose boxes collide with bx to out, in
+	// increasing order. Gives up and returns false once more than limit
+	// are found
+	bool collisions(const Box<dim> & bx, std::vector<std::size_t> & out, std::size_t limit) const{
+		if (mNodes.empty()) return true;
+		std::size_t first = out.size();
+		std::size_t stack[2*sizeof(std::size_t)*8];
+		std::size_t top = 0;
+		stack[top++] = 0;
+		while (top > 0){
+			const Node & nd = mNodes[stack[--top]];
+			if (!Box<dim>::collides(nd.box, bx)) continue;
+			if (nd.left == 0){
+				for (auto k=nd.begin; k<nd.end; k++){
+					if (Box<dim>::collides(mBoxes[k], bx)) out.push_back(mOrder[k]);
+				}
+				if (out.size() - first > limit) return false;
+				continue;
+			}
+			stack[top++] = nd.right;
+			stack[top++] = nd.left;
+		}
+		std::sort(out.begin()+first, out.end());
+		return true;
+	}
+
+private:
+
+	struct Node{
+		Box<dim> 		box;
+		std::size_t 	lo;				// the lowest index below this node
+		std::size_t 	begin, end;		// the range of mOrder below this node
+		std::size_t 	left, right;	// the daughters, or 0 for leaves
+	};
+
+	static const std::size_t 	sLeafSize = 4;
+
+	std::vector<Box<dim>> 		mBoxes;		// the boxes in the order of the leaves
+	std::vector<std::size_t> 	mOrder;		// the index of each of them
+	std::vector<Node> 			mNodes;
+
+	// build the node over mOrder[begin, end) and return its position.
+	// The leaves list their indices in increasing order
+	std::size_t build(const std::vector<Box<dim>> & boxes, std::size_t begin, std::size_t end){
+		std::size_t n = mNodes.size();
+		mNodes.push_back(Node());
+		mNodes[n].begin = begin;
+		mNodes[n].end = end;
+		if (end - begin <= sLeafSize){
+			std::sort(mOrder.begin()+begin, mOrder.begin()+end);
+			mNodes[n].box = boxes[mOrder[begin]];
+			for (auto k=begin+1; k<end; k++) mNodes[n].box = Box<dim>::bounding_box(mNodes[n].box, boxes[mOrder[k]]);
+			mNodes[n].lo = mOrder[begin];
+			mNodes[n].left = mNodes[n].right = 0;
+			return n;
+		}
+
+		std::size_t mid = begin + (end-begin)/2;
+		std::size_t l = build(boxes, begin, mid);
+		std::size_t r = build(boxes, mid, end);
+		mNodes[n].box = Box<dim>::bounding_box(mNodes[l].box, mNodes[r].box);
+		mNodes[n].lo = std::min(mNodes[l].lo, mNodes[r].lo);
+		mNodes[n].left = l;
+		mNodes[n].right = r;
+		return n;
+	}
+};
+
+
+
+// a collection of geometries with identifiers. A point belongs to the
+// first geometry in identifier order that contains it, or else to the
+// background. Queries go through a bounding volume hierarchy over the
+// geometries, which is built on the first query after the scene changes.
+// Geometries changed in place through their pointers need update_index()
 template <typename Identifier, typename PrimitiveType>
 class Scene : public std::map<Identifier, std::shared_ptr<PrimitiveType>>
 {
 private:
 	typedef std::map<Identifier, std::shared_ptr<PrimitiveType>> base_type;
+	typedef typename PointTypedef<PrimitiveType>::type 	PointT;
+	typedef typename BoxTypedef<PrimitiveType>::type 	BoxT;
+	static const std::size_t dim = std::extent<decltype(PointT::x)>::value;
+	static const std::size_t sWordCandidates = 256;	// most objects a word is classified against
 	using base_type::begin;
 	using base_type::end;
 	using base_type::cbegin;
 	using base_type::cend;
 	using iterator = typename base_type::iterator;
+	using const_iterator = typename base_type::const_iterator;
+	using reverse_iterator = typename base_type::reverse_iterator;
+	using const_reverse_iterator = typename base_type::const_reverse_iterator;
+
+	// the geometries in identifier order, their boxes and the hierarchy
+	// over them
+	struct Index{
+		std::vector<Identifier> 						ids;
+		std::vector<std::shared_ptr<PrimitiveType>> 	prims;
+		std::vector<BoxT> 								boxes;
+		BoxHierarchy<dim> 								bvh;
+
+		Index(const base_type & m){
+			for (auto it=m.begin(); it!=m.end(); it++){
+				ids.push_back(it->first);
+				prims.push_back(it->second);
+				boxes.push_back(it->second->get_bounding_box());
+			}
+			bvh = BoxHierarchy<dim>(boxes);
+		}
+	};
+
 public:
-	using base_type::insert;
+	using typename base_type::value_type;
 
 	Scene(Identifier bg) : mBackground(bg) {};
 
 
-	Identifier query_point(const Point<2> & pt) const {
-		Identifier id = mBackground;
-		for (auto it=begin(); it!=end(); it++){
-			if (it->second->contains_point(pt)){
-				id = it->first;
-				break;
+	Identifier query_point(const Point<2> & pt) const {return query_point_impl(pt);};
+	Identifier query_point(const Point<3> & pt) const {return query_point_impl(pt);};
+
+	template <typename PointType>
+	Identifier query_point_impl(const PointType & pt) const {
+		std::shared_ptr<const Index> idx = index();
+		std::size_t i = idx->bvh.first_match(pt, [&](std::size_t k){return idx->prims[k]->contains_point(pt);});
+		return (i < idx->ids.size()) ? idx->ids[i] : mBackground;
+	}
+
+	// classify a batch of points, writing to ids[i] the identifier of
+	// the first object that contains point i. Each word of 64 points is
+	// classified at once by the objects whose boxes meet its bounds, in
+	// order, until every point of the word is claimed. Words spread over
+	// too many objects are queried one point at a time
+	template <typename BatchType>
+	void query_points_impl(const BatchType & batch, Identifier * ids) const {
+		if (batch.bounds == nullptr){
+			auto bounds = word_bounds(batch);
+			BatchType bounded = batch;
+			bounded.bounds = bounds.data();
+			query_points_impl(bounded, ids);
+			return;
+		}
+
+		std::shared_ptr<const Index> idx = index();
+		std::vector<std::size_t> cand;
+		for (std::size_t w=0, nw=batch.nwords(); w<nw; w++){
+			std::size_t n = std::min<std::size_t>(64, batch.size-64*w);
+			cand.clear();
+			if (!idx->bvh.collisions(batch.bounds[w], cand, sWordCandidates)){
+				for (auto j=0; j<n; j++) ids[64*w+j] = query_point_impl(batch.point(64*w+j));
+				continue;
+			}
+
+			for (auto j=0; j<n; j++) ids[64*w+j] = mBackground;
+			Ullong open = (n == 64) ? ~0ULL : (1ULL << n) - 1;
+			BatchType run;
+			for (auto d=0; d<dim; d++) run.x[d] = batch.x[d]+64*w;
+			run.size = n;
+			run.bounds = batch.bounds+w;
+			for (auto k=0; k<cand.size() && open; k++){
+				Ullong mask;
+				idx->prims[cand[k]]->contains_points(run, &mask);
+				Ullong hit = mask & open;
+				open &= ~hit;
+				for (auto b=0; hit; b++, hit >>= 1){
+					if (hit & 1) ids[64*w+b] = idx->ids[cand[k]];
+				}
 			}
 		}
-		return id;
 	}
 
-	Identifier query_point(const Point<3> & pt) const {
-		Identifier id = mBackground;
-		for (auto it=begin(); it!=end(); it++){
-			if (it->second->contains_point(pt)){
-				id = it->first;
-				break;
+	void query_points(const PointBatch<2> & batch, Identifier * ids) const {query_points_impl(batch, ids);};
+	void query_points(const PointBatch<3> & batch, Identifier * ids) const {query_points_impl(batch, ids);};
+
+	// write to ids[i] the identifier of sample a + (i+0.5)*step of a scan
+	// line, for i in [i0, i1). The objects whose boxes meet the line give
+	// their spans of samples, and a sweep over the ends of all spans keeps
+	// the lowest object covering each stretch between them, which is then
+	// filled at once
+	template <typename PointType>
+	void query_line_impl(const PointType & a, const PointType & step, std::size_t i0, std::size_t i1, Identifier * ids) const {
+		if (i0 >= i1) return;
+		std::shared_ptr<const Index> idx = index();
+		PointType p0 = scan_sample(a, step, i0), p1 = scan_sample(a, step, i1-1);
+		std::vector<std::size_t> cand;
+		idx->bvh.collisions(BoxT::bounding_box(BoxT(p0, p0), BoxT(p1, p1)), cand, std::size_t(-1));
+
+		// the ends of the spans, as (sample, candidate, begins)
+		struct End{
+			std::size_t 	pos, k;
+			bool 			begin;
+		};
+		std::vector<End> ends;
+		std::vector<Span> spans;
+		for (std::size_t k=0; k<cand.size(); k++){
+			std::size_t b = i0, e = i1;
+			scan_range(idx->boxes[cand[k]], a, step, b, e);
+			if (b >= e) continue;
+			spans.clear();
+			idx->prims[cand[k]]->scan_line(a, step, b, e, spans);
+			for (auto & sp : spans){
+				ends.push_back({sp.begin, k, true});
+				ends.push_back({sp.end, k, false});
 			}
 		}
-		return id;
+		std::sort(ends.begin(), ends.end(), [](const End & x, const End & y){return x.pos < y.pos;});
+
+		// the candidates covering the current stretch, in increasing order
+		std::vector<std::size_t> active;
+		std::size_t cur = i0;
+		for (auto & en : ends){
+			if (en.pos > cur){
+				std::fill(ids+cur, ids+en.pos, active.empty() ? mBackground : idx->ids[cand[active.front()]]);
+				cur = en.pos;
+			}
+			auto it = std::lower_bound(active.begin(), active.end(), en.k);
+			if (en.begin) active.insert(it, en.k);
+			else active.erase(it);
+		}
+		std::fill(ids+cur, ids+i1, mBackground);
+	}
+
+	void query_line(const Point<2> & a, const Point<2> & step, std::size_t i0, std::size_t i1, Identifier * ids) const {query_line_impl(a, step, i0, i1, ids);};
+	void query_line(const Point<3> & a, const Point<3> & step, std::size_t i0, std::size_t i1, Identifier * ids) const {query_line_impl(a, step, i0, i1, ids);};
+
+	// rebuild the index, after geometries have been changed in place
+	void update_index() const {
+		std::atomic_store(&mIndex, std::shared_ptr<const Index>(std::make_shared<Index>(*this)));
 	}
 
 	template <typename CastableType>
@@ -58,10 +308,127 @@ public:
 		return insert(make_pair(id, castable_shared));
 	}
 
+	// the modifiers of the map, and the accessors that hand out mutable
+	// references to its entries, drop the index. A non-const scene thus
+	// rebuilds it on the next query even if nothing was changed; iterators
+	// kept across queries and then written through need update_index()
+	std::pair<iterator, bool> insert(const value_type & v){
+		invalidate();
+		return base_type::insert(v);
+	}
+
+	std::pair<iterator, bool> insert(value_type && v){
+		invalidate();
+		return base_type::insert(std::move(v));
+	}
+
+	void insert(std::initializer_list<value_type> il){
+		invalidate();
+		base_type::insert(il);
+	}
+
+	template <typename... Args>
+	auto insert(Args &&... args) -> decltype(base_type::insert(std::forward<Args>(args)...)) {
+		invalidate();
+		return base_type::insert(std::forward<Args>(args)...);
+	}
+
+	template <typename... Args>
+	auto emplace(Args &&... args) -> decltype(base_type::emplace(std::forward<Args>(args)...)) {
+		invalidate();
+		return base_type::emplace(std::forward<Args>(args)...);
+	}
+
+	template <typename... Args>
+	auto emplace_hint(Args &&... args) -> decltype(base_type::emplace_hint(std::forward<Args>(args)...)) {
+		invalidate();
+		return base_type::emplace_hint(std::forward<Args>(args)...);
+	}
+
+	template <typename... Args>
+	auto erase(Args &&... args) -> decltype(base_type::erase(std::forward<Args>(args)...)) {
+		invalidate();
+		return base_type::erase(std::forward<Args>(args)...);
+	}
+
+	void clear() {
+		invalidate();
+		base_type::clear();
+	}
+
+	void swap(Scene & other) {
+		invalidate();
+		other.invalidate();
+		base_type::swap(other);
+		std::swap(mBackground, other.mBackground);
+	}
+
+	std::shared_ptr<PrimitiveType> & operator[](const Identifier & id) {
+		invalidate();
+		return base_type::operator[](id);
+	}
+
+	std::shared_ptr<PrimitiveType> & at(const Identifier & id) {
+		invalidate();
+		return base_type::at(id);
+	}
+	const std::shared_ptr<PrimitiveType> & at(const Identifier & id) const {return base_type::at(id);};
+
+	iterator find(const Identifier & id) {
+		invalidate();
+		return base_type::find(id);
+	}
+	const_iterator find(const Identifier & id) const {return base_type::find(id);};
+
+	iterator lower_bound(const Identifier & id) {
+		invalidate();
+		return base_type::lower_bound(id);
+	}
+	const_iterator lower_bound(const Identifier & id) const {return base_type::lower_bound(id);};
+
+	iterator upper_bound(const Identifier & id) {
+		invalidate();
+		return base_type::upper_bound(id);
+	}
+	const_iterator upper_bound(const Identifier & id) const {return base_type::upper_bound(id);};
+
+	std::pair<iterator, iterator> equal_range(const Identifier & id) {
+		invalidate();
+		return base_type::equal_range(id);
+	}
+	std::pair<const_iterator, const_iterator> equal_range(const Identifier & id) const {return base_type::equal_range(id);};
+
+	reverse_iterator rbegin() {
+		invalidate();
+		return base_type::rbegin();
+	}
+	const_reverse_iterator rbegin() const {return base_type::rbegin();};
+
+	reverse_iterator rend() {
+		invalidate();
+		return base_type::rend();
+	}
+	const_reverse_iterator rend() const {return base_type::rend();};
+
 
 protected:
-	Identifier 			mBackground;
+	Identifier 							mBackground;
+	mutable std::shared_ptr<const Index> mIndex;
+
+	// the current index, built if the scene has changed. Concurrent
+	// queries may each build one, and any of them can be kept
+	std::shared_ptr<const Index> index() const {
+		std::shared_ptr<const Index> idx = std::atomic_load(&mIndex);
+		if (idx != nullptr && idx->ids.size() == base_type::size()) return idx;
+		idx = std::make_shared<Index>(*this);
+		std::atomic_store(&mIndex, idx);
+		return idx;
+	}
+
+	void invalidate() {
+		std::atomic_store(&mIndex, std::shared_ptr<const Index>());
+	}
 };
 
 } // end namespace csg
-#endif
\ No newline at end of file
+#endif
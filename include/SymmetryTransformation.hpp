@@ -3,10 +3,106 @@
 
 #include "GeomUtils.hpp"
 #include <memory>
+#include <vector>
+#include <cmath>
+#include <limits>
 
 namespace csg{
 
 
+// the whole number of periods nearest to t, with half periods rounding
+// toward zero so that the boundary stays with the base cell
+inline double nearest_period(double t){
+	return t > 0 ? std::ceil(t-0.5) : std::floor(t+0.5);
+}
+
+
+
+// the outline of a symmetry transformation as copies of the primitive's
+// outline, each hull generated only when the iterator reaches it. Copies
+// whose box misses the viewport are skipped, so a view holds one copy of
+// the outline however many copies it visits. The map supplies the
+// candidate copy indices for a box and a viewport (copy_range) and the
+// image of a point in copy k (copy_map)
+template <class MapPolicy>
+class SymmetryOutlineView{
+public:
+
+	class iterator{
+	public:
+		iterator(const SymmetryOutlineView * v, long k, std::size_t h) : mView(v), mK(k), mH(h) {};
+
+		Hull<2> operator*() const {
+			Hull<2> out(mView->mBase[mH]);
+			for (auto & p : out.points) p = mView->mMap.copy_map(p, mK);
+			return out;
+		}
+
+		// the copy index of the current hull
+		long copy() const {return mK;};
+
+		iterator & operator++(){
+			if (++mH == mView->mBase.size()){
+				mH = 0;
+				mK = mView->next_copy(mK+1);
+			}
+			return *this;
+		}
+
+		bool operator==(const iterator & it) const {return mK == it.mK && mH == it.mH;};
+		bool operator!=(const iterator & it) const {return !(*this == it);};
+
+	private:
+		const SymmetryOutlineView * 	mView;
+		long 							mK;	// copy index
+		std::size_t 					mH; // hull index within the copy
+	};
+
+	SymmetryOutlineView(const MapPolicy & m, const std::vector<Hull<2>> & base, const Box<2> & viewport)
+	: mMap(m), mBase(base), mView(viewport), mK0(0), mK1(0) {
+		std::size_t npts = 0;
+		for (auto & h : mBase) npts += h.points.size();
+		if (npts == 0) {mBase.clear(); return;}
+		Point<2> p0;
+		for (auto & h : mBase) if (!h.points.empty()) p0 = h.points[0];
+		mBox = Box<2>(p0, p0);
+		for (auto & h : mBase) for (auto & p : h.points) mBox = Box<2>::bounding_box(mBox, Box<2>(p, p));
+		mMap.copy_range(mBox, mView, mK0, mK1);
+		mK0 = next_copy(mK0);
+	};
+
+	iterator begin() const {return iterator(this, mBase.empty() ? mK1 : mK0, 0);};
+	iterator end() const {return iterator(this, mK1, 0);};
+
+	// all the visible hulls at once
+	std::vector<Hull<2>> materialize() const {
+		std::vector<Hull<2>> out;
+		for (auto it=begin(); it!=end(); ++it) out.push_back(*it);
+		return out;
+	}
+
+private:
+
+	// the first copy from k on whose mapped box meets the viewport
+	long next_copy(long k) const {
+		for (; k<mK1; k++){
+			Point<2> c = mMap.copy_map(mBox.lo, k);
+			Box<2> bx(c, c);
+			for (auto q : {Point<2>(mBox.hi.x[0], mBox.lo.x[1]), Point<2>(mBox.lo.x[0], mBox.hi.x[1]), mBox.hi}){
+				c = mMap.copy_map(q, k);
+				bx = Box<2>::bounding_box(bx, Box<2>(c, c));
+			}
+			if (Box<2>::collides(bx, mView)) return k;
+		}
+		return mK1;
+	}
+
+	MapPolicy 						mMap;
+	std::vector<Hull<2>>			mBase; // the outline of the primitive itself
+	Box<2> 							mBox, mView; // box around mBase, and the viewport
+	long 							mK0, mK1; // candidate copies are [mK0, mK1)
+};
+
 
 
 // Discrete Translation symmetry map 
@@ -15,8 +111,9 @@ public:
 	typedef Point<2> 					PointT;
 	typedef Box<2>						BoxT;
 	PointT 								mCen, mSvec;
+	PointT 								mSdual; // mSvec/|mSvec|^2, so that dot(v, mSdual) counts periods
 
-	DiscreteTranslationSymmetryMap2D(const PointT & t, const PointT & c) : mSvec(t), mCen(c) {};
+	DiscreteTranslationSymmetryMap2D(const PointT & t, const PointT & c) : mSvec(t), mCen(c), mSdual(t/PointT::dot(t, t)) {};
 
 	template <typename PrimitiveT>
 	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
@@ -25,19 +122,11 @@ public:
 		// return prim->get_bounding_box();
 	}
 
+	// step back to the base cell in one go: the nearest whole number of
+	// periods, with half-periods staying put as in the stepping loop
 	PointT inverse_map(const PointT & p) const{
 		PointT v = p-mCen;
-		double amagn = mSvec.norm();
-		double proj = PointT::dot(v, mSvec);
-		// double vmagn = v.norm();
-		while (fabs(proj/(amagn*amagn)) > 0.5){
-			// if (fabs(proj/amagn) > 1.0) std::cout << "proj/a: " << proj/amagn << std::endl;
-			v = v - static_cast<double>(sgn(proj))*mSvec;
-			proj = PointT::dot(v, mSvec);
-			// vmagn = v.norm();
-		}
-		// std::cout << "end" << std::endl;
-		return v+mCen;
+		return v - nearest_period(PointT::dot(v, mSdual))*mSvec + mCen;
 	};
 
 	PointT forward_map(const PointT & p) const{
@@ -50,18 +139,38 @@ public:
 	}
 
 
+	// copy k is translated by k periods. Along each axis the period moves
+	// the box at a constant rate, which bounds the copies meeting vp
+	PointT copy_map(const PointT & p, long k) const{
+		return p + static_cast<double>(k)*mSvec;
+	}
+
+	void copy_range(const BoxT & bx, const BoxT & vp, long & k0, long & k1) const{
+		double lo = -std::numeric_limits<double>::infinity(), hi = std::numeric_limits<double>::infinity();
+		for (auto d=0; d<2; d++){
+			if (mSvec.x[d] == 0){
+				if (bx.hi.x[d] < vp.lo.x[d] || bx.lo.x[d] > vp.hi.x[d]) {k0 = k1 = 0; return;}
+				continue;
+			}
+			double a = (vp.lo.x[d]-bx.hi.x[d])/mSvec.x[d], b = (vp.hi.x[d]-bx.lo.x[d])/mSvec.x[d];
+			lo = std::max(lo, std::min(a, b));
+			hi = std::min(hi, std::max(a, b));
+		}
+		k0 = static_cast<long>(std::ceil(lo));
+		k1 = std::max(k0, static_cast<long>(std::floor(hi))+1);
+	}
+
+	// the copies of the outline o of prim out to exactly 10 periods either
+	// way, from a view over the box those copies span. For a primitive
+	// wider than a period the view also meets the next copies, which are
+	// left out
 	template <typename PrimitiveT>
-	std::vector<Hull<2>> get_outline(unsigned int npts, const std::shared_ptr<PrimitiveT> prim) const {
-		std::vector<Hull<2>> o = prim->get_outline(npts);
+	std::vector<Hull<2>> map_outline(const std::vector<Hull<2>> & o, const std::shared_ptr<PrimitiveT> prim) const {
+		BoxT bb = prim->get_bounding_box();
+		SymmetryOutlineView<DiscreteTranslationSymmetryMap2D> view(*this, o, bounding_box(BoxT::translate(bb, -10.0*mSvec), BoxT::translate(bb, 10.0*mSvec)));
 		std::vector<Hull<2>> out;
-		for (auto it=o.begin(); it!=o.end(); it++){
-			for (int i=-10; i<=10; i++){
-				out.push_back(*it);
-				auto mit = --out.end();
-				for (auto p=mit->points.begin(); p!=mit->points.end(); p++){
-					*p = *p + static_cast<double>(i)*mSvec;
-				}
-			}
+		for (auto it=view.begin(); it!=view.end(); ++it){
+			if (it.copy() >= -10 && it.copy() <= 10) out.push_back(*it);
 		}
 		return out;
 	}
@@ -101,10 +210,19 @@ public:
 		os << "<ContinuousTranslationSymmetryMapping>" << mSvec << ", " << mCen << "</ContinuousTranslationSymmetryMapping>" << std::endl;
 	}
 
+	// the outline is the primitive's own, as a single copy
+	PointT copy_map(const PointT & p, long) const{
+		return p;
+	}
+
+	void copy_range(const BoxT &, const BoxT &, long & k0, long & k1) const{
+		k0 = 0;
+		k1 = 1;
+	}
+
 	// this is only for 2D
 	template <typename PrimitiveT>
-	std::vector<Hull<2>> get_outline(unsigned int npts, const std::shared_ptr<PrimitiveT> prim) const {
-		std::vector<Hull<2>> o = prim->get_outline(npts);
+	std::vector<Hull<2>> map_outline(std::vector<Hull<2>> o, const std::shared_ptr<PrimitiveT> prim) const {
 		for (auto it=o.begin(); it!=o.end(); it++){
 			for (auto p=it->points.begin(); p!=it->points.end(); p++){
 				*p = forward_map(*p);
@@ -123,26 +241,35 @@ public:
 	typedef Box<2>						BoxT;
 	PointT 								mCen, mRpt;
 	std::size_t 						mN; // number of copies per 360 degrees
+	PointT 								mDir; // unit vector from the rotation point to the base sector (zero if they coincide)
+	std::vector<double>					mCos, mSin; // rotation by -k sectors, for k in [0, mN)
 
-	DiscreteRotationSymmetryMap2D(const PointT & R, const PointT & c, std::size_t N) : mN(N), mCen(c), mRpt(R) {};
+	DiscreteRotationSymmetryMap2D(const PointT & R, const PointT & c, std::size_t N)
+	: mN(N), mCen(c), mRpt(R), mDir(c == R ? PointT(0, 0) : (c-R).normalize()), mCos(N), mSin(N) {
+		double angle = 2.0*pi/static_cast<double>(mN);
+		for (std::size_t k=0; k<mN; k++){
+			mCos[k] = cos(angle*k);
+			mSin[k] = -sin(angle*k);
+		}
+	};
 
 	template <typename PrimitiveT>
 	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
-		double rmax = std::max(PointT::dist(mRpt, prim->get_bounding_box().lo), PointT::dist(mRpt, prim->get_bounding_box().hi));
-		return BoxT(mCen+PointT(rmax, rmax), mCen-PointT(rmax,rmax));
+		// the copies sweep around the rotation point, out to the farthest corner
+		BoxT bb = prim->get_bounding_box();
+		double rmax = std::max(std::max(PointT::dist(mRpt, bb.lo), PointT::dist(mRpt, bb.hi)),
+							   std::max(PointT::dist(mRpt, PointT(bb.lo.x[0], bb.hi.x[1])), PointT::dist(mRpt, PointT(bb.hi.x[0], bb.lo.x[1]))));
+		return BoxT(mRpt-PointT(rmax, rmax), mRpt+PointT(rmax,rmax));
 	}
 
+	// find the sector from the angle to the base direction, then rotate
+	// back by that many sectors with the tabulated trig
 	PointT inverse_map(const PointT & p) const{
-		double angle = 2.0*pi/static_cast<double>(mN);
 		PointT pp = p - mRpt;
-		PointT v = mCen - mRpt;
-		double proj = cross(pp, v);
-		while (PointT::dot(pp, v) < 0 || fabs(asin(proj/(v.norm()*pp.norm()))) > angle/2.0){
-			// rotate
-			pp = Point<2>(cos(angle)*pp.x[0] + sin(angle)*pp.x[1], -sin(angle)*pp.x[0] + cos(angle)*pp.x[1]);
-			proj = cross(pp, v);
-		}
-		return pp + mRpt;
+		double theta = atan2(cross(mDir, pp), PointT::dot(mDir, pp));
+		long k = std::lround(theta*static_cast<double>(mN)/(2.0*pi));
+		std::size_t s = static_cast<std::size_t>((k % static_cast<long>(mN) + static_cast<long>(mN)) % static_cast<long>(mN));
+		return Point<2>(mCos[s]*pp.x[0] - mSin[s]*pp.x[1], mSin[s]*pp.x[0] + mCos[s]*pp.x[1]) + mRpt;
 	};
 
 	PointT forward_map(const PointT & p) const{
@@ -160,29 +287,21 @@ public:
 		os << "</DiscreteRotationSymmetryMapping>" << std::endl;
 	}
 
-	// this is only for 2D
-	template <typename PrimitiveT>
-	std::vector<Hull<2>> get_outline(unsigned int npts, const std::shared_ptr<PrimitiveT> prim) const {
-		std::vector<Hull<2>> o = prim->get_outline(npts);
-		std::vector<Hull<2>> out;
-		double angle = 2.0*pi/static_cast<double>(mN);
-		for (auto it=o.begin(); it!=o.end(); it++){
-			for (std::size_t i=0; i<mN; i++){
-				double theta = static_cast<double>(i)*angle;
-				out.push_back(*it);
-				auto mit = --out.end();
-				for (auto p=mit->points.begin(); p!=mit->points.end(); p++){
-					// (*p) = inverse_map(*p);
-					PointT pp = *p - mRpt;
-					pp = Point<2>(cos(theta)*pp.x[0] + sin(theta)*pp.x[1], -sin(theta)*pp.x[0] + cos(theta)*pp.x[1]);
-					*p = pp + mRpt;
-				}
-			}
-		}
+	// copy k is turned by k sectors, with the tabulated trig
+	PointT copy_map(const PointT & p, long k) const{
+		PointT pp = p - mRpt;
+		return Point<2>(mCos[k]*pp.x[0] - mSin[k]*pp.x[1], mSin[k]*pp.x[0] + mCos[k]*pp.x[1]) + mRpt;
+	}
 
-		std::cout << "size of in: " << o.size() << std::endl;
-		std::cout << "size of out: " << out.size() << std::endl;
-		return out;
+	void copy_range(const BoxT &, const BoxT &, long & k0, long & k1) const{
+		k0 = 0;
+		k1 = static_cast<long>(mN);
+	}
+
+	// all mN copies of the outline o of prim
+	template <typename PrimitiveT>
+	std::vector<Hull<2>> map_outline(const std::vector<Hull<2>> & o, const std::shared_ptr<PrimitiveT> prim) const {
+		return SymmetryOutlineView<DiscreteRotationSymmetryMap2D>(*this, o, get_bounding_box(prim)).materialize();
 	}
 };
 
@@ -199,8 +318,11 @@ public:
 
 	template <typename PrimitiveT>
 	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
-		double rmax = std::max(PointT::dist(mRpt, prim->get_bounding_box().lo), PointT::dist(mRpt, prim->get_bounding_box().hi));
-		return BoxT(mCen+PointT(rmax, rmax), mCen-PointT(rmax,rmax));
+		// the copies sweep around the rotation point, out to the farthest corner
+		BoxT bb = prim->get_bounding_box();
+		double rmax = std::max(std::max(PointT::dist(mRpt, bb.lo), PointT::dist(mRpt, bb.hi)),
+							   std::max(PointT::dist(mRpt, PointT(bb.lo.x[0], bb.hi.x[1])), PointT::dist(mRpt, PointT(bb.hi.x[0], bb.lo.x[1]))));
+		return BoxT(mRpt-PointT(rmax, rmax), mRpt+PointT(rmax,rmax));
 	}
 
 	PointT inverse_map(const PointT & p) const{
@@ -221,10 +343,19 @@ public:
 		os << "<ContinuousRotationSymmetryMapping>" << mRpt << ", " << mCen << "</ContinuousRotationSymmetryMapping>" << std::endl;
 	}
 
+	// the outline is the primitive's own, as a single copy
+	PointT copy_map(const PointT & p, long) const{
+		return p;
+	}
+
+	void copy_range(const BoxT &, const BoxT &, long & k0, long & k1) const{
+		k0 = 0;
+		k1 = 1;
+	}
+
 	// this is only for 2D
 	template <typename PrimitiveT>
-	std::vector<Hull<2>> get_outline(unsigned int npts, const std::shared_ptr<PrimitiveT> prim) const {
-		std::vector<Hull<2>> o = prim->get_outline(npts);
+	std::vector<Hull<2>> map_outline(std::vector<Hull<2>> o, const std::shared_ptr<PrimitiveT> prim) const {
 		for (auto it=o.begin(); it!=o.end(); it++){
 			for (auto p=it->points.begin(); p!=it->points.end(); p++){
 				*p = forward_map(*p);
@@ -237,35 +368,267 @@ public:
 
 
 
-// // Helical symmetry map 
-// struct HelicalSymmetryMap2D{
-// public:
-// 	typedef Point<2> 					PointT;
-// 	typedef Box<2>						BoxT;
-// 	PointT 								mCen, mVec;
-// 	double 								mR;
-// 	// std::size_t 						mN; // number of copies per 360 degrees
+//////////////////////////////// 3D symmetry maps
+
+// Discrete Translation symmetry map over a lattice of one, two or three
+// period vectors. The dual vectors count periods along each one, so a
+// point is brought back to the base cell by rounding them
+struct DiscreteTranslationSymmetryMap3D{
+public:
+	typedef Point<3> 					PointT;
+	typedef Box<3>						BoxT;
+	PointT 								mCen;
+	std::vector<PointT> 				mSvec, mSdual;
+
+	DiscreteTranslationSymmetryMap3D(const std::vector<PointT> & t, const PointT & c) : mSvec(t), mCen(c), mSdual(t.size()) {
+		// each dual vector is its period with the span of the others
+		// projected out, scaled to unit projection on the period
+		for (auto i=0; i<mSvec.size(); i++){
+			PointT w = mSvec[i];
+			if (mSvec.size() == 2){
+				const PointT & o = mSvec[1-i];
+				w = w - PointT::dot(w, o)/PointT::dot(o, o)*o;
+			}
+			else if (mSvec.size() == 3) w = cross(mSvec[(i+1)%3], mSvec[(i+2)%3]);
+			double wv = PointT::dot(w, mSvec[i]);
+			if (mSvec.size() > 3 || wv == 0.0){
+				std::cerr << "DiscreteTranslationSymmetryMap3D: needs 1 to 3 independent period vectors" << std::endl;
+				throw("degenerate translation lattice");
+			}
+			mSdual[i] = w/wv;
+		}
+	};
+
+	template <typename PrimitiveT>
+	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
+		BoxT bb = prim->get_bounding_box();
+		for (auto i=0; i<mSvec.size(); i++){
+			for (auto d=0; d<3; d++){
+				bb.lo.x[d] -= 1.0e+6*fabs(mSvec[i].x[d]);
+				bb.hi.x[d] += 1.0e+6*fabs(mSvec[i].x[d]);
+			}
+		}
+		return bb;
+	}
+
+	PointT inverse_map(const PointT & p) const{
+		PointT v = p-mCen;
+		PointT out = p;
+		for (auto i=0; i<mSvec.size(); i++) out = out - nearest_period(PointT::dot(v, mSdual[i]))*mSvec[i];
+		return out;
+	};
+
+	PointT forward_map(const PointT & p) const{
+		return p;
+	};
+
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "<DiscreteTranslationSymmetryMapping>";
+		for (auto i=0; i<mSvec.size(); i++) os << mSvec[i] << ", ";
+		os << mCen << "</DiscreteTranslationSymmetryMapping>" << std::endl;
+	}
+};
+
+
+// Continuous Translation symmetry map 
+struct ContinuousTranslationSymmetryMap3D{
+public:
+	typedef Point<3> 					PointT;
+	typedef Box<3>						BoxT;
+	PointT 								mCen, mSvec;
+
+	ContinuousTranslationSymmetryMap3D(const PointT & t, const PointT & c) : mSvec(t), mCen(c) {};
+
+	template <typename PrimitiveT>
+	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
+		return BoxT::bounding_box(BoxT::translate(prim->get_bounding_box(), -1.0e+6*mSvec),
+								  BoxT::translate(prim->get_bounding_box(), +1.0e+6*mSvec));
+	}
+
+	PointT inverse_map(const PointT & p) const{
+		PointT v = p-mCen;
+		return v - PointT::dot(v, mSvec)/PointT::dot(mSvec, mSvec)*mSvec + mCen;
+	};
+
+	PointT forward_map(const PointT & p) const{
+		return p;
+	};
+
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "<ContinuousTranslationSymmetryMapping>" << mSvec << ", " << mCen << "</ContinuousTranslationSymmetryMapping>" << std::endl;
+	}
+};
+
+
+
+// Discrete Rotation symmetry map about the axis through mRpt along mAxis
+struct DiscreteRotationSymmetryMap3D{
+public:
+	typedef Point<3> 					PointT;
+	typedef Box<3>						BoxT;
+	PointT 								mCen, mRpt, mAxis;
+	std::size_t 						mN; // number of copies per 360 degrees
+	PointT 								mE1, mE2; // frame about the axis, mE1 toward the base sector
+	std::vector<double>					mCos, mSin; // rotation by -k sectors, for k in [0, mN)
+
+	DiscreteRotationSymmetryMap3D(const PointT & R, const PointT & axis, const PointT & c, std::size_t N)
+	: mN(N), mCen(c), mRpt(R), mAxis(axis.normalize()), mCos(N), mSin(N) {
+		axis_frame(mAxis, c-R, mE1, mE2);
+		double angle = 2.0*pi/static_cast<double>(mN);
+		for (std::size_t k=0; k<mN; k++){
+			mCos[k] = cos(angle*k);
+			mSin[k] = -sin(angle*k);
+		}
+	};
+
+	template <typename PrimitiveT>
+	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
+		return revolved_bounding_box(mRpt, mAxis, prim->get_bounding_box());
+	}
+
+	// find the sector from the angle about the axis, then rotate back by
+	// that many sectors with the tabulated trig
+	PointT inverse_map(const PointT & p) const{
+		PointT q = p - mRpt;
+		double a = PointT::dot(q, mAxis), x = PointT::dot(q, mE1), y = PointT::dot(q, mE2);
+		long k = std::lround(atan2(y, x)*static_cast<double>(mN)/(2.0*pi));
+		std::size_t s = static_cast<std::size_t>((k % static_cast<long>(mN) + static_cast<long>(mN)) % static_cast<long>(mN));
+		return mRpt + a*mAxis + (mCos[s]*x - mSin[s]*y)*mE1 + (mSin[s]*x + mCos[s]*y)*mE2;
+	};
+
+	PointT forward_map(const PointT & p) const{
+		return p;
+	};
+
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "<DiscreteRotationSymmetryMapping>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<N>" << mN << "</N>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<Center>" << mRpt << "</Center>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<Axis>" << mAxis << "</Axis>" << std::endl;
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "</DiscreteRotationSymmetryMapping>" << std::endl;
+	}
+};
+
+
+// Continuous Rotation symmetry map about the axis through mRpt along
+// mAxis, which turns the primitive into a solid of revolution
+struct ContinuousRotationSymmetryMap3D{
+public:
+	typedef Point<3> 					PointT;
+	typedef Box<3>						BoxT;
+	PointT 								mCen, mRpt, mAxis;
+	PointT 								mE1, mE2; // frame about the axis, mE1 toward the primitive
+
+	ContinuousRotationSymmetryMap3D(const PointT & R, const PointT & axis, const PointT & c)
+	: mCen(c), mRpt(R), mAxis(axis.normalize()) {
+		axis_frame(mAxis, c-R, mE1, mE2);
+	};
+
+	template <typename PrimitiveT>
+	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
+		return revolved_bounding_box(mRpt, mAxis, prim->get_bounding_box());
+	}
+
+	// turn the point about the axis into the half plane of the primitive
+	PointT inverse_map(const PointT & p) const{
+		PointT q = p - mRpt;
+		double a = PointT::dot(q, mAxis), x = PointT::dot(q, mE1), y = PointT::dot(q, mE2);
+		return mRpt + a*mAxis + sqrt(x*x + y*y)*mE1;
+	};
+
+	PointT forward_map(const PointT & p) const{
+		return p;
+	};
+
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "<ContinuousRotationSymmetryMapping>" << mRpt << ", " << mAxis << ", " << mCen << "</ContinuousRotationSymmetryMapping>" << std::endl;
+	}
+};
+
+
+
+// Helical symmetry map: the primitive is screwed about the axis through
+// mRpt along mAxis, advancing mPitch per turn. With mN > 0 there are mN
+// copies per turn, otherwise the screw is continuous, like a thread
+struct HelicalSymmetryMap3D{
+public:
+	typedef Point<3> 					PointT;
+	typedef Box<3>						BoxT;
+	PointT 								mCen, mRpt, mAxis;
+	double 								mPitch; // advance along the axis per turn
+	std::size_t 						mN; // number of copies per turn, or 0 if continuous
+	PointT 								mE1, mE2; // frame about the axis, mE1 toward the primitive
+	double 								mA0; // axial position of the primitive
+	std::vector<double>					mCos, mSin; // rotation by -k sectors, for k in [0, mN)
+
+	HelicalSymmetryMap3D(const PointT & R, const PointT & axis, const PointT & c, double pitch, std::size_t N = 0)
+	: mCen(c), mRpt(R), mAxis(axis.normalize()), mPitch(pitch), mN(N), mCos(N), mSin(N) {
+		axis_frame(mAxis, c-R, mE1, mE2);
+		mA0 = PointT::dot(c-R, mAxis);
+		double angle = 2.0*pi/static_cast<double>(std::max<std::size_t>(mN, 1));
+		for (std::size_t k=0; k<mN; k++){
+			mCos[k] = cos(angle*k);
+			mSin[k] = -sin(angle*k);
+		}
+	};
 
-// 	HelicalSymmetryMap2D(const PointT & vec, const PointT & c, double r) : mCen(c), mVec(vec), mR(r) {};
+	template <typename PrimitiveT>
+	BoxT get_bounding_box(const std::shared_ptr<PrimitiveT> prim) const {
+		return revolved_bounding_box(mRpt, mAxis, prim->get_bounding_box(), 1.0e+6*fabs(mPitch));
+	}
 
-// 	PointT inverse_map(const PointT & p) const{
-// 		PointT pp = p - mRpt;
-// 		PointT v = mCen - mRpt;
-// 		if (PointT::dot(pp, v) < 0) pp = Point<2>(cos(pi)*pp.x[0] + sin(pi)*pp.x[1], -sin(pi)*pp.x[0] + cos(pi)*pp.x[1]);
-// 		double proj = asin(cross(pp, v)/(v.norm()*pp.norm()));
-// 		pp = Point<2>(cos(proj)*pp.x[0] - sin(proj)*pp.x[1], sin(proj)*pp.x[0] + cos(proj)*pp.x[1]);
-// 		return pp + mRpt;
-// 	};
+	// undo the screw up to the angle of the point: all the way to the half
+	// plane of the primitive if continuous, or by whole sectors if not.
+	// The axial position is then brought within half a pitch of the
+	// primitive, since a full turn is a plain translation by the pitch
+	PointT inverse_map(const PointT & p) const{
+		PointT q = p - mRpt;
+		double a = PointT::dot(q, mAxis), x = PointT::dot(q, mE1), y = PointT::dot(q, mE2);
+		double theta = atan2(y, x);
+		if (mN == 0){
+			a -= mPitch*theta/(2.0*pi);
+			x = sqrt(x*x + y*y);
+			y = 0;
+		}
+		else {
+			long k = std::lround(theta*static_cast<double>(mN)/(2.0*pi));
+			std::size_t s = static_cast<std::size_t>((k % static_cast<long>(mN) + static_cast<long>(mN)) % static_cast<long>(mN));
+			a -= mPitch*static_cast<double>(k)/static_cast<double>(mN);
+			double xr = mCos[s]*x - mSin[s]*y;
+			y = mSin[s]*x + mCos[s]*y;
+			x = xr;
+		}
+		if (mPitch != 0) a -= mPitch*nearest_period((a-mA0)/mPitch);
+		return mRpt + a*mAxis + x*mE1 + y*mE2;
+	};
 
-// 	PointT forward_map(const PointT & p) const{
-// 		return p;
-// 	};
+	PointT forward_map(const PointT & p) const{
+		return p;
+	};
 
-// 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
-// 		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
-// 		os << "<HelicalSymmetryMapping>" << mRpt << ", " << mCen << "</HelicalSymmetryMapping>" << std::endl;
-// 	}
-// };
+	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "<HelicalSymmetryMapping>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<N>" << mN << "</N>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<Pitch>" << mPitch << "</Pitch>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<Center>" << mRpt << "</Center>" << std::endl;
+		for (auto i=0; i<ntabs+1; i++) os << "\t" ;
+		os << "<Axis>" << mAxis << "</Axis>" << std::endl;
+		for (auto i=0; i<ntabs; i++) os << "\t" ;
+		os << "</HelicalSymmetryMapping>" << std::endl;
+	}
+};
 
 
 
@@ -317,13 +680,30 @@ public:
 		// 	}
 		// }
 		// return o;
-		return mMap.get_outline(npts, mPrim);
+		return mMap.map_outline(mPrim->get_outline(npts), mPrim);
+	}
+
+	// the maps move the outline rigidly, so the tolerance carries over
+	std::vector<Hull<2>> get_adaptive_outline(double tol) const {
+		return mMap.map_outline(mPrim->get_adaptive_outline(tol), mPrim);
+	}
+
+	// the copies of the outline that meet the viewport, generated as they
+	// are visited. This is only for 2D
+	SymmetryOutlineView<MapPolicy> outline_view(unsigned int npts, const Box<2> & viewport) const {
+		return SymmetryOutlineView<MapPolicy>(mMap, mPrim->get_outline(npts), viewport);
 	}
 
 	bool contains_point(const PointT & pt) const {
 		return mPrim->contains_point(mMap.inverse_map(pt));
 	}
 
+	// the box tests are the approximate defaults, so scan lines are
+	// sampled rather than halved by box classification
+	void scan_line(const PointT & a, const PointT & step, std::size_t i0, std::size_t i1, std::vector<Span> & spans) const {
+		scan_by_samples(*this, a, step, i0, i1, spans);
+	}
+
 
 	void print_summary(std::ostream & os = std::cout, unsigned int ntabs=0) const{
 		for (auto i=0; i<ntabs; i++) os << "\t" ;
@@ -382,5 +762,48 @@ SymmetryTransformation<Primitive2D, ContinuousRotationSymmetryMap2D> continuous_
 }
 
 
+
+template <typename DerivedType>
+SymmetryTransformation<Primitive3D, DiscreteTranslationSymmetryMap3D> discrete_translation_symmetry(const DerivedType & c, const std::vector<Point<3>> & svecs){
+	Box<3> bx = c.get_bounding_box();
+	Point<3> center = 0.5*(bx.hi+bx.lo);
+	return SymmetryTransformation<Primitive3D, DiscreteTranslationSymmetryMap3D>(c.copy(), DiscreteTranslationSymmetryMap3D(svecs, center));
+}
+
+template <typename DerivedType>
+SymmetryTransformation<Primitive3D, DiscreteTranslationSymmetryMap3D> discrete_translation_symmetry(const DerivedType & c, const Point<3> & svec){
+	return discrete_translation_symmetry(c, std::vector<Point<3>>(1, svec));
+}
+
+template <typename DerivedType>
+SymmetryTransformation<Primitive3D, ContinuousTranslationSymmetryMap3D> continuous_translation_symmetry(const DerivedType & c, const Point<3> & svec){
+	Box<3> bx = c.get_bounding_box();
+	Point<3> center = 0.5*(bx.hi+bx.lo);
+	return SymmetryTransformation<Primitive3D, ContinuousTranslationSymmetryMap3D>(c.copy(), ContinuousTranslationSymmetryMap3D(svec, center));
+}
+
+template <typename DerivedType>
+SymmetryTransformation<Primitive3D, DiscreteRotationSymmetryMap3D> discrete_rotation_symmetry(const DerivedType & c, const Point<3> & rpt, const Point<3> & axis, std::size_t N){
+	Box<3> bx = c.get_bounding_box();
+	Point<3> center = 0.5*(bx.hi+bx.lo);
+	return SymmetryTransformation<Primitive3D, DiscreteRotationSymmetryMap3D>(c.copy(), DiscreteRotationSymmetryMap3D(rpt, axis, center, N));
+}
+
+template <typename DerivedType>
+SymmetryTransformation<Primitive3D, ContinuousRotationSymmetryMap3D> continuous_rotation_symmetry(const DerivedType & c, const Point<3> & rpt, const Point<3> & axis){
+	Box<3> bx = c.get_bounding_box();
+	Point<3> center = 0.5*(bx.hi+bx.lo);
+	return SymmetryTransformation<Primitive3D, ContinuousRotationSymmetryMap3D>(c.copy(), ContinuousRotationSymmetryMap3D(rpt, axis, center));
+}
+
+// N copies per turn, or a continuous screw if N is 0
+template <typename DerivedType>
+SymmetryTransformation<Primitive3D, HelicalSymmetryMap3D> helical_symmetry(const DerivedType & c, const Point<3> & rpt, const Point<3> & axis, double pitch, std::size_t N = 0){
+	Box<3> bx = c.get_bounding_box();
+	Point<3> center = 0.5*(bx.hi+bx.lo);
+	return SymmetryTransformation<Primitive3D, HelicalSymmetryMap3D>(c.copy(), HelicalSymmetryMap3D(rpt, axis, center, pitch, N));
+}
+
+
 } // end namespace csg
 #endif
\ No newline at end of file
@@ -0,0 +1,397 @@
+#ifndef _TRIANGULATIONLOCATOR_H
+#define _TRIANGULATIONLOCATOR_H
+
+#include "GeomUtils.hpp"
+#include "Predicates.hpp"
+#include "Delaunay.hpp"
+
+#include <unordered_map>
+#include <queue>
+#include <stack>
+#include <thread>
+#include <limits>
+
+namespace csg{
+
+
+// Point location and interpolation on a finished 2D triangulation
+//
+// A uniform grid over the bounding box stores one seed triangle per cell
+// (the triangle whose centroid lies closest to the cell center). A query
+// jumps to the seed of its cell and then performs a visibility walk over the
+// triangle adjacency, so neither the Delaunay history DAG nor its hash maps
+// need to be kept around after construction.
+//
+// The walk assumes the triangulation covers its convex hull (as Delaunay
+// output does). For non-convex meshes, queries that walk off the boundary
+// fall back to a linear scan of the triangles.
+class TriangulationLocator
+{
+public:
+
+	TriangulationLocator(const Triangulation<2> & tri)
+	: mPoints(tri.points), mTris(tri.triangles) {build();};
+
+	// build from the live, non-fictitious triangles of a Delaunay object.
+	// Vertex indices (and interpolated values) follow del.points.
+	TriangulationLocator(const Delaunay & del)
+	: mPoints(del.points) {
+		for (auto j=0; j<del.ntree; j++){
+			const TriElem & t = del.triangles[j];
+			if (t.state <= 0) continue;
+			if (del.is_fictitious(t.vertices[0]) || del.is_fictitious(t.vertices[1]) || del.is_fictitious(t.vertices[2])) continue;
+			mTris.push_back(IntPoint3(t.vertices[0], t.vertices[1], t.vertices[2]));
+		}
+		build();
+	}
+
+	std::size_t num_triangles() const {return mTris.size();};
+
+	const std::vector<Point<2>> & points() const {return mPoints;};
+
+	const std::vector<IntPoint3> & triangles() const {return mTris;};
+
+	// neighbor of triangle t across the edge from vertex e to vertex (e+1)%3,
+	// or -1 on the boundary
+	int neighbor(std::size_t t, unsigned int e) const {return mNeighbors[t].x[e];};
+
+	// return the index of a triangle containing p (possibly on its boundary),
+	// or -1 if p is outside the triangulation. A valid hint triangle near p
+	// skips the grid lookup.
+	int locate(const Point<2> & p, int hint=-1) const {
+		if (mTris.empty()) return -1;
+		if (!Box<2>::contains(mBox, p)) return -1;
+		int t = (hint >= 0 && hint < mTris.size()) ? hint : mSeeds[cell_index(p)];
+		t = walk(p, t);
+		if (t < 0 && !mConvex) t = scan(p);
+		return t;
+	}
+
+	// locate a batch of points in parallel. Each thread works on a
+	// contiguous chunk, so spatially coherent inputs (e.g. raster rows)
+	// reuse the previous result as the starting triangle.
+	std::vector<int> locate(const std::vector<Point<2>> & pts, unsigned int nthreads=0) const {
+		std::vector<int> out(pts.size());
+		parallel_for(pts.size(), nthreads, [&](std::size_t begin, std::size_t end){
+			int hint = -1;
+			for (auto i=begin; i<end; i++){
+				out[i] = locate(pts[i], (hint >= 0 && walk_is_short(pts[i], hint)) ? hint : -1);
+				if (out[i] >= 0) hint = out[i];
+			}
+		});
+		return out;
+	}
+
+	// barycentric (linear) interpolation of per-vertex values. Returns NaN
+	// outside the triangulation.
+	double interpolate_linear(const Point<2> & p, const std::vector<double> & vals, int hint=-1) const {
+		int t = locate(p, hint);
+		if (t < 0) return std::numeric_limits<double>::quiet_NaN();
+		return barycentric(p, t, vals);
+	}
+
+	std::vector<double> interpolate_linear(const std::vector<Point<2>> & pts, const std::vector<double> & vals, unsigned int nthreads=0) const {
+		std::vector<double> out(pts.size());
+		parallel_for(pts.size(), nthreads, [&](std::size_t begin, std::size_t end){
+			int hint = -1;
+			for (auto i=begin; i<end; i++){
+				int t = locate(pts[i], (hint >= 0 && walk_is_short(pts[i], hint)) ? hint : -1);
+				if (t < 0) {out[i] = std::numeric_limits<double>::quiet_NaN(); continue;}
+				out[i] = barycentric(pts[i], t, vals);
+				hint = t;
+			}
+		});
+		return out;
+	}
+
+	// Sibson natural-neighbor interpolation of per-vertex values (Watson's
+	// method over the Bowyer-Watson cavity of p). Requires a Delaunay
+	// triangulation. Returns NaN outside the triangulation.
+	double interpolate_natural_neighbor(const Point<2> & p, const std::vector<double> & vals, int hint=-1) const {
+		int t = locate(p, hint);
+		if (t < 0) return std::numeric_limits<double>::quiet_NaN();
+		return natural_neighbor(p, t, vals);
+	}
+
+	std::vector<double> interpolate_natural_neighbor(const std::vector<Point<2>> & pts, const std::vector<double> & vals, unsigned int nthreads=0) const {
+		std::vector<double> out(pts.size());
+		parallel_for(pts.size(), nthreads, [&](std::size_t begin, std::size_t end){
+			int hint = -1;
+			for (auto i=begin; i<end; i++){
+				int t = locate(pts[i], (hint >= 0 && walk_is_short(pts[i], hint)) ? hint : -1);
+				if (t < 0) {out[i] = std::numeric_limits<double>::quiet_NaN(); continue;}
+				out[i] = natural_neighbor(pts[i], t, vals);
+				hint = t;
+			}
+		});
+		return out;
+	}
+
+private:
+
+	std::vector<Point<2>> 		mPoints;
+	std::vector<IntPoint3> 		mTris;
+	std::vector<IntPoint3> 		mNeighbors;	// neighbor across edge (v[e], v[e+1])
+	bool 						mConvex;
+
+	Box<2> 						mBox;
+	std::size_t 				mNx, mNy;
+	double 						mDx, mDy;
+	std::vector<int> 			mSeeds;		// seed triangle for each grid cell
+
+
+	void build(){
+		// orient all triangles counterclockwise
+		for (auto t=0; t<mTris.size(); t++){
+			IntPoint3 & v = mTris[t];
+			if (orient2d(mPoints[v.x[0]], mPoints[v.x[1]], mPoints[v.x[2]]) < 0) std::swap(v.x[1], v.x[2]);
+		}
+
+		// adjacency from directed edges
+		std::unordered_map<Ullong, int> edges;
+		edges.reserve(3*mTris.size());
+		for (auto t=0; t<mTris.size(); t++){
+			for (auto e=0; e<3; e++){
+				edges[edge_key(mTris[t].x[e], mTris[t].x[(e+1)%3])] = 3*t+e;
+			}
+		}
+		mNeighbors.resize(mTris.size());
+		std::unordered_map<int, int> bnext; // boundary edges, from vertex -> to vertex
+		for (auto t=0; t<mTris.size(); t++){
+			for (auto e=0; e<3; e++){
+				int a = mTris[t].x[e], b = mTris[t].x[(e+1)%3];
+				auto it = edges.find(edge_key(b, a));
+				mNeighbors[t].x[e] = (it == edges.end()) ? -1 : it->second/3;
+				if (it == edges.end()) bnext[a] = b;
+			}
+		}
+
+		// the walk can only conclude "outside" safely if the
+		// boundary is a single convex loop
+		mConvex = !bnext.empty();
+		if (mConvex){
+			int start = bnext.begin()->first, a = start, n = 0;
+			do {
+				auto ib = bnext.find(a);
+				if (ib == bnext.end()) {mConvex = false; break;}
+				auto ic = bnext.find(ib->second);
+				if (ic == bnext.end()) {mConvex = false; break;}
+				if (orient2d(mPoints[a], mPoints[ib->second], mPoints[ic->second]) < 0) {mConvex = false; break;}
+				a = ib->second;
+				n++;
+			} while (a != start && n <= bnext.size());
+			if (n != bnext.size()) mConvex = false;
+		}
+
+		// bounding box of the vertices used by triangles
+		if (mTris.empty()) return;
+		mBox = Box<2>(mPoints[mTris[0].x[0]], mPoints[mTris[0].x[0]]);
+		for (auto t=0; t<mTris.size(); t++){
+			for (auto e=0; e<3; e++){
+				const Point<2> & p = mPoints[mTris[t].x[e]];
+				mBox = Box<2>::bounding_box(mBox, Box<2>(p, p));
+			}
+		}
+
+		// seed grid with roughly two triangles per cell
+		double lx = mBox.hi.x[0]-mBox.lo.x[0], ly = mBox.hi.x[1]-mBox.lo.x[1];
+		double ncell = std::max(1.0, 0.5*mTris.size());
+		double aspect = (lx > 0 && ly > 0) ? lx/ly : 1.0;
+		mNx = std::max<std::size_t>(1, static_cast<std::size_t>(sqrt(ncell*aspect)));
+		mNy = std::max<std::size_t>(1, static_cast<std::size_t>(ncell/mNx));
+		mDx = (lx > 0) ? lx/mNx : 1.0;
+		mDy = (ly > 0) ? ly/mNy : 1.0;
+
+		mSeeds.assign(mNx*mNy, -1);
+		std::vector<double> best(mNx*mNy, std::numeric_limits<double>::max());
+		for (auto t=0; t<mTris.size(); t++){
+			Point<2> c = 1.0/3.0*(mPoints[mTris[t].x[0]]+mPoints[mTris[t].x[1]]+mPoints[mTris[t].x[2]]);
+			std::size_t k = cell_index(c);
+			Point<2> cc(mBox.lo.x[0]+(k%mNx+0.5)*mDx, mBox.lo.x[1]+(k/mNx+0.5)*mDy);
+			double d = Point<2>::distsq(c, cc);
+			if (d < best[k]) {best[k] = d; mSeeds[k] = t;}
+		}
+
+		// empty cells inherit the seed of the nearest filled cell (BFS)
+		std::queue<std::size_t> q;
+		for (auto k=0; k<mSeeds.size(); k++) if (mSeeds[k] >= 0) q.push(k);
+		while (!q.empty()){
+			std::size_t k = q.front(); q.pop();
+			std::size_t i = k%mNx, j = k/mNx;
+			std::size_t nb[4] = {(i > 0) ? k-1 : k, (i+1 < mNx) ? k+1 : k,
+								 (j > 0) ? k-mNx : k, (j+1 < mNy) ? k+mNx : k};
+			for (auto n=0; n<4; n++){
+				if (mSeeds[nb[n]] >= 0) continue;
+				mSeeds[nb[n]] = mSeeds[k];
+				q.push(nb[n]);
+			}
+		}
+	}
+
+	static Ullong edge_key(int a, int b){
+		return (static_cast<Ullong>(static_cast<Uint>(a)) << 32) | static_cast<Uint>(b);
+	}
+
+	std::size_t cell_index(const Point<2> & p) const {
+		long i = static_cast<long>((p.x[0]-mBox.lo.x[0])/mDx);
+		long j = static_cast<long>((p.x[1]-mBox.lo.x[1])/mDy);
+		i = std::min<long>(std::max<long>(i, 0), mNx-1);
+		j = std::min<long>(std::max<long>(j, 0), mNy-1);
+		return j*mNx + i;
+	}
+
+	// a hint is only worth following if it is within a couple of cells
+	bool walk_is_short(const Point<2> & p, int hint) const {
+		Point<2> c = mPoints[mTris[hint].x[0]];
+		return fabs(c.x[0]-p.x[0]) < 2*mDx && fabs(c.x[1]-p.x[1]) < 2*mDy;
+	}
+
+	// stochastic visibility walk starting from triangle t
+	int walk(const Point<2> & p, int t) const {
+		unsigned int rnd = 2463534242u;
+		std::size_t maxsteps = mTris.size()+3;
+		for (std::size_t step=0; step<maxsteps; step++){
+			rnd ^= rnd << 13; rnd ^= rnd >> 17; rnd ^= rnd << 5;
+			unsigned int e0 = rnd%3;
+			int next = -1;
+			bool boundary = false;
+			for (auto k=0; k<3; k++){
+				unsigned int e = (e0+k)%3;
+				if (orient2d(mPoints[mTris[t].x[e]], mPoints[mTris[t].x[(e+1)%3]], p) >= 0) continue;
+				if (mNeighbors[t].x[e] < 0) {boundary = true; continue;}
+				next = mNeighbors[t].x[e];
+				break;
+			}
+			if (next < 0) return boundary ? -1 : t;
+			t = next;
+		}
+		return -1;
+	}
+
+	int scan(const Point<2> & p) const {
+		for (auto t=0; t<mTris.size(); t++){
+			if (orient2d(mPoints[mTris[t].x[0]], mPoints[mTris[t].x[1]], p) >= 0 &&
+				orient2d(mPoints[mTris[t].x[1]], mPoints[mTris[t].x[2]], p) >= 0 &&
+				orient2d(mPoints[mTris[t].x[2]], mPoints[mTris[t].x[0]], p) >= 0) return t;
+		}
+		return -1;
+	}
+
+	double barycentric(const Point<2> & p, int t, const std::vector<double> & vals) const {
+		const Point<2> & a = mPoints[mTris[t].x[0]];
+		const Point<2> & b = mPoints[mTris[t].x[1]];
+		const Point<2> & c = mPoints[mTris[t].x[2]];
+		double area = orient2d(a, b, c);
+		double wa = orient2d(p, b, c)/area;
+		double wb = orient2d(a, p, c)/area;
+		return wa*vals[mTris[t].x[0]] + wb*vals[mTris[t].x[1]] + (1.0-wa-wb)*vals[mTris[t].x[2]];
+	}
+
+	double natural_neighbor(const Point<2> & p, int t, const std::vector<double> & vals) const {
+		// a query on top of a vertex takes its value
+		for (auto e=0; e<3; e++) if (mPoints[mTris[t].x[e]] == p) return vals[mTris[t].x[e]];
+
+		// collect the cavity: triangles whose circumcircle contains p
+		std::vector<int> cavity;
+		std::unordered_map<int, bool> incavity;
+		std::stack<int> todo;
+		todo.push(t); incavity[t] = true;
+		while (!todo.empty()){
+			int c = todo.top(); todo.pop();
+			cavity.push_back(c);
+			for (auto e=0; e<3; e++){
+				int n = mNeighbors[c].x[e];
+				if (n < 0 || incavity.count(n)) continue;
+				bool in = in_circle(p, mPoints[mTris[n].x[0]], mPoints[mTris[n].x[1]], mPoints[mTris[n].x[2]]) > 0;
+				incavity[n] = in;
+				if (in) todo.push(n);
+			}
+		}
+		auto on_boundary = [&](int c, unsigned int e){
+			int n = mNeighbors[c].x[e];
+			return n < 0 || !incavity[n];
+		};
+
+		// a query (nearly) collinear with a cavity boundary edge puts a new
+		// Voronoi vertex at infinity; the interpolant is continuous, so
+		// nudge it towards the centroid
+		Point<2> q = p;
+		Point<2> ctr = 1.0/3.0*(mPoints[mTris[t].x[0]]+mPoints[mTris[t].x[1]]+mPoints[mTris[t].x[2]]);
+		for (auto tries=0; tries<8; tries++){
+			bool degenerate = false;
+			for (auto c=0; c<cavity.size() && !degenerate; c++){
+				for (auto e=0; e<3; e++){
+					if (!on_boundary(cavity[c], e)) continue;
+					if (nearly_collinear(q, mPoints[mTris[cavity[c]].x[e]], mPoints[mTris[cavity[c]].x[(e+1)%3]])) {degenerate = true; break;}
+				}
+			}
+			if (!degenerate) break;
+			q = q + (1.0e-9*(tries+1))*(ctr - p);
+		}
+
+		// Sibson weights: the area each vertex loses to the new Voronoi cell
+		// of q. The lost region of vertex a is bounded by the old Voronoi
+		// vertices (cavity circumcenters) around a and by the new Voronoi
+		// vertices on the cavity boundary edges at a. Its closing edge lies on
+		// the bisector of q and a, so taking the midpoint of q and a as the
+		// origin of the shoelace sum drops that term.
+		std::vector<Point<2>> centers(cavity.size());
+		std::unordered_map<int, int> slot;
+		for (auto c=0; c<cavity.size(); c++){
+			const IntPoint3 & v = mTris[cavity[c]];
+			centers[c] = circumcenter(mPoints[v.x[0]], mPoints[v.x[1]], mPoints[v.x[2]]);
+			slot[cavity[c]] = c;
+		}
+
+		std::unordered_map<int, double> weights;
+		double wsum = 0.0;
+		for (auto c=0; c<cavity.size(); c++){
+			const IntPoint3 & v = mTris[cavity[c]];
+			for (auto e=0; e<3; e++){
+				int a = v.x[e], b = v.x[(e+1)%3], cc = v.x[(e+2)%3];
+				Point<2> o = 0.5*(q + mPoints[a]);
+				Point<2> ct = centers[c] - o;
+				double w = 0.0;
+
+				// incoming side a->b
+				if (on_boundary(cavity[c], e)) w += cross(circumcenter(q, mPoints[a], mPoints[b]) - o, ct);
+				else w += cross(centers[slot[mNeighbors[cavity[c]].x[e]]] - o, ct);
+
+				// outgoing side cc->a, if it closes the fan
+				if (on_boundary(cavity[c], (e+2)%3)) w += cross(ct, circumcenter(q, mPoints[cc], mPoints[a]) - o);
+
+				weights[a] += 0.5*w;
+				wsum += 0.5*w;
+			}
+		}
+
+		double val = 0.0;
+		for (auto it=weights.begin(); it!=weights.end(); it++) val += it->second*vals[it->first];
+		return val/wsum;
+	}
+
+	static bool nearly_collinear(const Point<2> & p, const Point<2> & a, const Point<2> & b){
+		Point<2> u = a-p, w = b-p;
+		return fabs(cross(u, w)) <= 1.0e-12*(Point<2>::dot(u, u) + Point<2>::dot(w, w));
+	}
+
+	// split [0, n) into contiguous chunks, one per thread
+	template <typename Function>
+	static void parallel_for(std::size_t n, unsigned int nthreads, const Function & f){
+		if (nthreads == 0) nthreads = std::max(1u, std::thread::hardware_concurrency());
+		nthreads = std::min<std::size_t>(nthreads, std::max<std::size_t>(1, n/1024));
+		if (nthreads <= 1) {f(0, n); return;}
+
+		std::vector<std::thread> threads;
+		std::size_t chunk = (n + nthreads - 1)/nthreads;
+		for (auto i=0; i<nthreads; i++){
+			std::size_t begin = i*chunk, end = std::min(n, begin+chunk);
+			if (begin >= end) break;
+			threads.push_back(std::thread(f, begin, end));
+		}
+		for (auto i=0; i<threads.size(); i++) threads[i].join();
+	}
+};
+
+}
+#endif